@@ -0,0 +1,97 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * Utilities for use with Clutter
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "clutter-utils.h"
+#include "util-private.h"
+
+/**
+ * meta_restack_actors:
+ * @container: a #ClutterContainer
+ * @actors: (element-type ClutterActor): children of @container, from
+ *   bottom to top
+ *
+ * Restacks the children of @container so that @actors end up in the
+ * given order, moving as few of them as possible: the longest run of
+ * @actors that is already stacked in the right order stays where it is,
+ * and each of the others is raised to just above its predecessor in
+ * @actors. Other children keep their position relative to the actors
+ * that don't move. Actors that aren't children of @container are
+ * ignored.
+ *
+ * Return value: the number of actors that were moved
+ */
+int
+meta_restack_actors (ClutterContainer *container,
+                     GList            *actors)
+{
+  GHashTable *child_positions;
+  GList *children, *l;
+  ClutterActor *below;
+  int *positions;
+  gboolean *keep;
+  int n_actors;
+  int n_moved;
+  int i;
+
+  children = clutter_container_get_children (container);
+  child_positions = g_hash_table_new (NULL, NULL);
+  for (l = children, i = 1; l; l = l->next, i++)
+    g_hash_table_insert (child_positions, l->data, GINT_TO_POINTER (i));
+  g_list_free (children);
+
+  n_actors = g_list_length (actors);
+  positions = g_new (int, n_actors);
+  keep = g_new (gboolean, n_actors);
+
+  for (l = actors, i = 0; l; l = l->next, i++)
+    positions[i] = GPOINTER_TO_INT (g_hash_table_lookup (child_positions,
+                                                         l->data)) - 1;
+
+  g_hash_table_destroy (child_positions);
+
+  meta_find_longest_increasing (positions, n_actors, keep);
+
+  n_moved = 0;
+  below = NULL;
+  for (l = actors, i = 0; l; l = l->next, i++)
+    {
+      ClutterActor *actor = l->data;
+
+      if (positions[i] < 0)
+        continue;
+
+      if (!keep[i])
+        {
+          if (below)
+            clutter_actor_raise (actor, below);
+          else
+            clutter_actor_lower_bottom (actor);
+
+          n_moved++;
+        }
+
+      below = actor;
+    }
+
+  g_free (positions);
+  g_free (keep);
+
+  return n_moved;
+}
@@ -39,6 +39,10 @@ struct _MetaCompScreen
   ClutterActor		*hidden_group;
   GList                 *windows;
   GHashTable            *windows_by_xid;
+  /* Actors that need meta_window_actor_pre_paint() before the next frame */
+  GList                 *dirty_windows;
+  /* How many actors were pre-painted for the last frame */
+  guint                  n_pre_painted;
   Window                 output;
 
   /* Before we create the output window */
@@ -66,4 +70,8 @@ void     meta_end_modal_for_plugin   (MetaScreen       *screen,
 
 void meta_check_end_modal (MetaScreen *screen);
 
+void meta_get_pre_paint_stats (MetaScreen *screen,
+                               guint      *n_pre_painted,
+                               guint      *n_windows);
+
 #endif /* META_COMPOSITOR_PRIVATE_H */
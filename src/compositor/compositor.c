@@ -16,6 +16,7 @@
 #include "meta-window-actor-private.h"
 #include "meta-window-group.h"
 #include "meta-background-actor.h"
+#include "clutter-utils.h"
 #include "window-private.h" /* to check window->hidden */
 #include "display-private.h" /* for meta_display_lookup_x_window() */
 #include <X11/extensions/shape.h>
@@ -877,7 +878,9 @@ sync_actor_stacking (MetaCompScreen *info)
   GList *children;
   GList *tmp;
   GList *old;
+  GList *stack;
   gboolean reordered;
+  int n_moved;
 
   /* NB: The first entries in the lists are stacked the lowest */
 
@@ -931,14 +934,13 @@ sync_actor_stacking (MetaCompScreen *info)
   if (!reordered)
     return;
 
-  for (tmp = g_list_last (info->windows); tmp != NULL; tmp = tmp->prev)
-    {
-      MetaWindowActor *window_actor = tmp->data;
-
-      clutter_actor_lower_bottom (CLUTTER_ACTOR (window_actor));
-    }
+  /* Usually only a window or two changed places; leave the rest alone */
+  stack = g_list_prepend (g_list_copy (info->windows), info->background_actor);
+  n_moved = meta_restack_actors (CLUTTER_CONTAINER (info->window_group), stack);
+  g_list_free (stack);
 
-  clutter_actor_lower_bottom (info->background_actor);
+  meta_verbose ("Restacked %d of %d window actors\n",
+                n_moved, g_list_length (info->windows));
 }
 
 void
@@ -1097,10 +1099,47 @@ meta_compositor_sync_screen_size (MetaCompositor  *compositor,
 static void
 pre_paint_windows (MetaCompScreen *info)
 {
-  GList *l;
+  GList *dirty, *l;
 
-  for (l = info->windows; l; l = l->next)
-    meta_window_actor_pre_paint (l->data);
+  /* Only actors that queued themselves since the last frame need
+   * attention. Take the list first: actors that change again while
+   * others are processed queue themselves for the next frame.
+   */
+  dirty = info->dirty_windows;
+  info->dirty_windows = NULL;
+
+  info->n_pre_painted = 0;
+  for (l = dirty; l; l = l->next)
+    {
+      meta_window_actor_pre_paint (l->data);
+      info->n_pre_painted++;
+    }
+
+  g_list_free (dirty);
+}
+
+/**
+ * meta_get_pre_paint_stats: (skip)
+ * @screen: a #MetaScreen
+ * @n_pre_painted: (out) (allow-none): location to store the number of
+ *   window actors processed before the last frame
+ * @n_windows: (out) (allow-none): location to store the number of
+ *   window actors on the screen
+ *
+ * Gets statistics about how much window actor state had to be updated
+ * before the most recent frame.
+ */
+void
+meta_get_pre_paint_stats (MetaScreen *screen,
+                          guint      *n_pre_painted,
+                          guint      *n_windows)
+{
+  MetaCompScreen *info = meta_screen_get_compositor_data (screen);
+
+  if (n_pre_painted)
+    *n_pre_painted = info ? info->n_pre_painted : 0;
+  if (n_windows)
+    *n_windows = info ? g_list_length (info->windows) : 0;
 }
 
 static gboolean
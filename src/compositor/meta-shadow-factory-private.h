@@ -58,6 +58,30 @@ void        meta_shadow_get_bounds  (MetaShadow            *shadow,
 
 MetaShadowFactory *meta_shadow_factory_new (void);
 
+/**
+ * MetaShadowBlurImpl:
+ * @META_SHADOW_BLUR_AUTO: the fastest implementation supported by the CPU
+ * @META_SHADOW_BLUR_SCALAR: plain C implementation
+ * @META_SHADOW_BLUR_SSE2: SSE2 implementation
+ * @META_SHADOW_BLUR_AVX2: AVX2 implementation
+ *
+ * Implementations of the blur used to generate shadow textures.
+ */
+typedef enum
+{
+  META_SHADOW_BLUR_AUTO,
+  META_SHADOW_BLUR_SCALAR,
+  META_SHADOW_BLUR_SSE2,
+  META_SHADOW_BLUR_AVX2
+} MetaShadowBlurImpl;
+
+gboolean meta_shadow_blur_impl_supported (MetaShadowBlurImpl  impl);
+guchar  *meta_shadow_blur_region         (cairo_region_t     *region,
+                                          int                 radius,
+                                          MetaShadowBlurImpl  impl,
+                                          int                *buffer_width,
+                                          int                *buffer_height);
+
 MetaShadow *meta_shadow_factory_get_shadow (MetaShadowFactory *factory,
                                             MetaWindowShape   *shape,
                                             int                width,
@@ -29,6 +29,14 @@
 #include "meta-shadow-factory-private.h"
 #include "region-utils.h"
 
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_SHADOW_BLUR_SIMD 1
+#include <immintrin.h>
+#define SSE2_FUNC __attribute__ ((target ("sse2")))
+#define AVX2_FUNC __attribute__ ((target ("avx2")))
+#endif
+
 /* This file implements blurring the shape of a window to produce a
  * shadow texture. The details are discussed below; a quick summary
  * of the optimizations we use:
@@ -47,6 +55,10 @@
  *   in blocks, blur rows again, and then transpose back.
  *
  * - We approximate the 1D gaussian blur as 3 successive box filters.
+ *
+ * - Where the CPU supports it, the box filters are run on 8 or 16
+ *   columns at once with SSE2 or AVX2; the implementation is picked
+ *   at runtime.
  */
 
 typedef struct _MetaShadowCacheKey  MetaShadowCacheKey;
@@ -504,6 +516,27 @@ get_shadow_spread (int radius)
     return 3 * (d / 2) - 1;
 }
 
+/* The box blurs divide the sum of d pixels by d as a multiplication by
+ * a 32.32 fixed point reciprocal, rounded up, which is off by less than
+ * 1 / 2^32 of the dividend, sum + d / 2. That is less than 256 * d, so
+ * the error is less than 256 * d / 2^32, while the exact quotient is at
+ * least 1 / d below the next integer. So the truncated result is always
+ * the same as that of (sum + d / 2) / d as long as 256 * d * d <= 2^32,
+ * that is d <= 4096; larger filters divide.
+ */
+#define MAX_RECIPROCAL_FILTER_SIZE 4096
+
+static inline guchar
+box_average (int     sum,
+             int     d,
+             guint64 multiplier)
+{
+  if (d > MAX_RECIPROCAL_FILTER_SIZE)
+    return (sum + d / 2) / d;
+
+  return ((sum + d / 2) * multiplier) >> 32;
+}
+
 /* This applies a single box blur pass to a horizontal range of pixels;
  * since the box blur has the same weight for all pixels, we can
  * implement an efficient sliding window algorithm where we add
@@ -523,6 +556,7 @@ blur_xspan (guchar *row,
             int     d,
             int     shift)
 {
+  guint64 multiplier = (G_GUINT64_CONSTANT (0xffffffff) + d) / d;
   int offset;
   int sum = 0;
   int i;
@@ -535,11 +569,7 @@ blur_xspan (guchar *row,
   /* All the conditionals in here look slow, but the branches will
    * be well predicted and there are enough different possibilities
    * that trying to write this as a series of unconditional loops
-   * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division for pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
+   * is hard and not an obvious win.
    */
   for (i = x0 - d + offset; i < x1 + offset; i++)
     {
@@ -551,7 +581,7 @@ blur_xspan (guchar *row,
 	  if (i >= d)
 	    sum -= row[i - d];
 
-	  tmp_buffer[i - offset] = (sum + d / 2) / d;
+	  tmp_buffer[i - offset] = box_average (sum, d, multiplier);
 	}
     }
 
@@ -610,6 +640,336 @@ blur_rows (cairo_region_t   *convolve_region,
   g_free (tmp_buffer);
 }
 
+#ifdef HAVE_SHADOW_BLUR_SIMD
+/* The vectorized blur works on a group of adjacent columns at once; the
+ * sliding window sums for each column are kept in a 16-bit lane, and the
+ * pixels coming into and leaving the window for all the columns are
+ * loaded with a single read of consecutive bytes from a row. So instead
+ * of flipping the buffer to blur the columns, we blur the columns in
+ * place, and flip the buffer to blur the rows.
+ *
+ * The result of each pass is rounded back to bytes exactly as in
+ * blur_xspan(), so the output is identical to that of the scalar code.
+ * The division is done in single precision: we compute
+ * (sum + d / 2 + 0.5) / d, which is at least 0.5 / d away from the next
+ * integer, while the rounding error is less than 2^-15, so truncating
+ * always gives the right answer.
+ *
+ * A 16-bit lane holds a sum of d bytes as long as d is at most 256; for
+ * larger filters (radius > 135 or so) we just use the scalar code.
+ */
+#define MAX_SIMD_FILTER_SIZE 256
+
+typedef void (*BlurYSpanFunc) (guchar *buffer,
+                               guchar *tmp_buffer,
+                               int     buffer_width,
+                               int     buffer_height,
+                               int     x,
+                               int     y0,
+                               int     y1,
+                               int     d,
+                               int     shift);
+
+/* Like blur_xspan(), but for a vertical range of a single column;
+ * used for columns left over after blurring groups of columns */
+static void
+blur_yspan (guchar *buffer,
+            guchar *tmp_buffer,
+            int     buffer_width,
+            int     buffer_height,
+            int     x,
+            int     y0,
+            int     y1,
+            int     d,
+            int     shift)
+{
+  guint64 multiplier = (G_GUINT64_CONSTANT (0xffffffff) + d) / d;
+  guchar *column = buffer + x;
+  int offset;
+  int sum = 0;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = y0 - d + offset; i < y1 + offset; i++)
+    {
+      if (i >= 0 && i < buffer_height)
+	sum += column[i * buffer_width];
+
+      if (i >= y0 + offset)
+	{
+	  if (i >= d)
+	    sum -= column[(i - d) * buffer_width];
+
+	  tmp_buffer[i - offset] = box_average (sum, d, multiplier);
+	}
+    }
+
+  for (i = y0; i < y1; i++)
+    column[i * buffer_width] = tmp_buffer[i];
+}
+
+static inline __m128i SSE2_FUNC
+load_8_sse2 (const guchar *p)
+{
+  return _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)p),
+                            _mm_setzero_si128 ());
+}
+
+/* Blurs the columns x ... x + 7 */
+static void SSE2_FUNC
+blur_yspan_sse2 (guchar *buffer,
+                 guchar *tmp_buffer,
+                 int     buffer_width,
+                 int     buffer_height,
+                 int     x,
+                 int     y0,
+                 int     y1,
+                 int     d,
+                 int     shift)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i rounding = _mm_set1_epi16 (d / 2);
+  const __m128 point_five = _mm_set1_ps (0.5f);
+  const __m128 reciprocal = _mm_set1_ps (1.0f / d);
+  __m128i sum = zero;
+  int offset;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = y0 - d + offset; i < y1 + offset; i++)
+    {
+      if (i >= 0 && i < buffer_height)
+        sum = _mm_add_epi16 (sum, load_8_sse2 (buffer + i * buffer_width + x));
+
+      if (i >= y0 + offset)
+        {
+          __m128i t, lo, hi;
+
+          if (i >= d)
+            sum = _mm_sub_epi16 (sum, load_8_sse2 (buffer + (i - d) * buffer_width + x));
+
+          t = _mm_add_epi16 (sum, rounding);
+          lo = _mm_cvttps_epi32 (_mm_mul_ps (_mm_add_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (t, zero)),
+                                                         point_five),
+                                             reciprocal));
+          hi = _mm_cvttps_epi32 (_mm_mul_ps (_mm_add_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (t, zero)),
+                                                         point_five),
+                                             reciprocal));
+          t = _mm_packs_epi32 (lo, hi);
+          _mm_storel_epi64 ((__m128i *)(tmp_buffer + (i - offset) * 8),
+                            _mm_packus_epi16 (t, t));
+        }
+    }
+
+  for (i = y0; i < y1; i++)
+    memcpy (buffer + i * buffer_width + x, tmp_buffer + i * 8, 8);
+}
+
+/* Blurs the columns x ... x + 15 */
+static void AVX2_FUNC
+blur_yspan_avx2 (guchar *buffer,
+                 guchar *tmp_buffer,
+                 int     buffer_width,
+                 int     buffer_height,
+                 int     x,
+                 int     y0,
+                 int     y1,
+                 int     d,
+                 int     shift)
+{
+  const __m256i rounding = _mm256_set1_epi16 (d / 2);
+  const __m256 point_five = _mm256_set1_ps (0.5f);
+  const __m256 reciprocal = _mm256_set1_ps (1.0f / d);
+  __m256i sum = _mm256_setzero_si256 ();
+  int offset;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = y0 - d + offset; i < y1 + offset; i++)
+    {
+      if (i >= 0 && i < buffer_height)
+        sum = _mm256_add_epi16 (sum,
+                                _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *)(buffer + i * buffer_width + x))));
+
+      if (i >= y0 + offset)
+        {
+          __m256i t, lo, hi;
+
+          if (i >= d)
+            sum = _mm256_sub_epi16 (sum,
+                                    _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *)(buffer + (i - d) * buffer_width + x))));
+
+          t = _mm256_add_epi16 (sum, rounding);
+          lo = _mm256_cvttps_epi32 (_mm256_mul_ps (_mm256_add_ps (_mm256_cvtepi32_ps (_mm256_cvtepu16_epi32 (_mm256_castsi256_si128 (t))),
+                                                                  point_five),
+                                                   reciprocal));
+          hi = _mm256_cvttps_epi32 (_mm256_mul_ps (_mm256_add_ps (_mm256_cvtepi32_ps (_mm256_cvtepu16_epi32 (_mm256_extracti128_si256 (t, 1))),
+                                                                  point_five),
+                                                   reciprocal));
+
+          /* The AVX2 pack instructions work within 128-bit lanes, so
+           * we have to put the quadwords back in order after each */
+          t = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (lo, hi), 0xd8);
+          t = _mm256_permute4x64_epi64 (_mm256_packus_epi16 (t, t), 0x08);
+          _mm_storeu_si128 ((__m128i *)(tmp_buffer + (i - offset) * 16),
+                            _mm256_castsi256_si128 (t));
+        }
+    }
+
+  for (i = y0; i < y1; i++)
+    memcpy (buffer + i * buffer_width + x, tmp_buffer + i * 16, 16);
+}
+
+/* Like blur_rows(), but blurs columns; the rectangles of @convolve_region
+ * are flipped, so a rectangle's vertical extent is the range of columns
+ * to blur and its horizontal extent is the range of rows.
+ */
+static void
+blur_columns (cairo_region_t   *convolve_region,
+              int               x_offset,
+              int               y_offset,
+              guchar           *buffer,
+              int               buffer_width,
+              int               buffer_height,
+              int               d,
+              BlurYSpanFunc     blur_func,
+              int               n_columns)
+{
+  int i, x;
+  int n_rectangles;
+  guchar *tmp_buffer;
+
+  tmp_buffer = g_malloc (buffer_height * n_columns);
+
+  n_rectangles = cairo_region_num_rectangles (convolve_region);
+  for (i = 0; i < n_rectangles; i++)
+    {
+      cairo_rectangle_int_t rect;
+      int x0, x1, y0, y1;
+
+      cairo_region_get_rectangle (convolve_region, i, &rect);
+
+      x0 = x_offset + rect.y;
+      x1 = x0 + rect.height;
+      y0 = y_offset + rect.x;
+      y1 = y0 + rect.width;
+
+      /* See blur_rows() for the choice of passes */
+      for (x = x0; x + n_columns <= x1; x += n_columns)
+        {
+          if (d % 2 == 1)
+            {
+              blur_func (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, 0);
+              blur_func (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, 0);
+              blur_func (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, 0);
+            }
+          else
+            {
+              blur_func (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, 1);
+              blur_func (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, -1);
+              blur_func (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d + 1, 0);
+            }
+        }
+
+      for (; x < x1; x++)
+        {
+          if (d % 2 == 1)
+            {
+              blur_yspan (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, 0);
+              blur_yspan (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, 0);
+              blur_yspan (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, 0);
+            }
+          else
+            {
+              blur_yspan (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, 1);
+              blur_yspan (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d, -1);
+              blur_yspan (buffer, tmp_buffer, buffer_width, buffer_height, x, y0, y1, d + 1, 0);
+            }
+        }
+    }
+
+  g_free (tmp_buffer);
+}
+
+/* Transposes a 16x16 block of bytes held in 16 registers; interleaving
+ * row k with row k + 8 four times moves each byte to its transposed
+ * position.
+ */
+static inline void SSE2_FUNC
+transpose_16x16_sse2 (__m128i rows[16])
+{
+  __m128i tmp[16];
+  int pass, k;
+
+  for (pass = 0; pass < 4; pass++)
+    {
+      for (k = 0; k < 8; k++)
+        {
+          tmp[2 * k] = _mm_unpacklo_epi8 (rows[k], rows[k + 8]);
+          tmp[2 * k + 1] = _mm_unpackhi_epi8 (rows[k], rows[k + 8]);
+        }
+
+      memcpy (rows, tmp, sizeof (tmp));
+    }
+}
+
+/* Stores the transpose of the 16x16 block at @a into @b and the
+ * transpose of @b into @a; @a and @b may be the same block */
+static void SSE2_FUNC
+swap_blocks_sse2 (guchar *a,
+                  guchar *b,
+                  int     stride)
+{
+  __m128i block_a[16], block_b[16];
+  int k;
+
+  for (k = 0; k < 16; k++)
+    {
+      block_a[k] = _mm_loadu_si128 ((const __m128i *)(a + k * stride));
+      block_b[k] = _mm_loadu_si128 ((const __m128i *)(b + k * stride));
+    }
+
+  transpose_16x16_sse2 (block_a);
+  transpose_16x16_sse2 (block_b);
+
+  for (k = 0; k < 16; k++)
+    {
+      _mm_storeu_si128 ((__m128i *)(b + k * stride), block_a[k]);
+      _mm_storeu_si128 ((__m128i *)(a + k * stride), block_b[k]);
+    }
+}
+
+static void SSE2_FUNC
+transpose_block_sse2 (const guchar *src,
+                      int           src_stride,
+                      guchar       *dest,
+                      int           dest_stride)
+{
+  __m128i block[16];
+  int k;
+
+  for (k = 0; k < 16; k++)
+    block[k] = _mm_loadu_si128 ((const __m128i *)(src + k * src_stride));
+
+  transpose_16x16_sse2 (block);
+
+  for (k = 0; k < 16; k++)
+    _mm_storeu_si128 ((__m128i *)(dest + k * dest_stride), block[k]);
+}
+#endif /* HAVE_SHADOW_BLUR_SIMD */
+
 static void
 fade_bytes (guchar *bytes,
             int     width,
@@ -625,12 +985,14 @@ fade_bytes (guchar *bytes,
 
 /* Swaps width and height. Either swaps in-place and returns the original
  * buffer or allocates a new buffer, frees the original buffer and returns
- * the new buffer.
+ * the new buffer. If @use_simd is set, full blocks are transposed with
+ * SSE2.
  */
 static guchar *
-flip_buffer (guchar *buffer,
-	     int     width,
-             int     height)
+flip_buffer (guchar  *buffer,
+	     int      width,
+             int      height,
+             gboolean use_simd)
 {
   /* Working in blocks increases cache efficiency, compared to reading
    * or writing an entire column at once */
@@ -647,6 +1009,16 @@ flip_buffer (guchar *buffer,
 	    int max_i = MIN(i0 + BLOCK_SIZE, width);
 	    int i, j;
 
+#ifdef HAVE_SHADOW_BLUR_SIMD
+            if (use_simd && max_i - i0 == BLOCK_SIZE && max_j - j0 == BLOCK_SIZE)
+              {
+                swap_blocks_sse2 (buffer + j0 * width + i0,
+                                  buffer + i0 * width + j0,
+                                  width);
+                continue;
+              }
+#endif
+
 	    if (i0 == j0)
 	      {
 		for (j = j0; j < max_j; j++)
@@ -683,6 +1055,15 @@ flip_buffer (guchar *buffer,
 	    int max_i = MIN(i0 + BLOCK_SIZE, width);
 	    int i, j;
 
+#ifdef HAVE_SHADOW_BLUR_SIMD
+            if (use_simd && max_i - i0 == BLOCK_SIZE && max_j - j0 == BLOCK_SIZE)
+              {
+                transpose_block_sse2 (buffer + j0 * width + i0, width,
+                                      new_buffer + i0 * height + j0, height);
+                continue;
+              }
+#endif
+
             for (i = i0; i < max_i; i++)
               for (j = j0; j < max_j; j++)
 		new_buffer[i * height + j] = buffer[j * width + i];
@@ -695,12 +1076,73 @@ flip_buffer (guchar *buffer,
 #undef BLOCK_SIZE
 }
 
-static void
-make_shadow (MetaShadow     *shadow,
-             cairo_region_t *region)
+/**
+ * meta_shadow_blur_impl_supported:
+ * @impl: a blur implementation
+ *
+ * Return value: %TRUE if @impl can be used on this machine
+ */
+gboolean
+meta_shadow_blur_impl_supported (MetaShadowBlurImpl impl)
 {
-  int d = get_box_filter_size (shadow->key.radius);
-  int spread = get_shadow_spread (shadow->key.radius);
+  switch (impl)
+    {
+    case META_SHADOW_BLUR_AUTO:
+    case META_SHADOW_BLUR_SCALAR:
+      return TRUE;
+#ifdef HAVE_SHADOW_BLUR_SIMD
+    case META_SHADOW_BLUR_SSE2:
+      return __builtin_cpu_supports ("sse2");
+    case META_SHADOW_BLUR_AVX2:
+      return __builtin_cpu_supports ("avx2");
+#endif
+    default:
+      return FALSE;
+    }
+}
+
+static MetaShadowBlurImpl
+get_default_blur_impl (void)
+{
+  static MetaShadowBlurImpl default_impl = META_SHADOW_BLUR_AUTO;
+
+  if (default_impl == META_SHADOW_BLUR_AUTO)
+    {
+      if (meta_shadow_blur_impl_supported (META_SHADOW_BLUR_AVX2))
+        default_impl = META_SHADOW_BLUR_AVX2;
+      else if (meta_shadow_blur_impl_supported (META_SHADOW_BLUR_SSE2))
+        default_impl = META_SHADOW_BLUR_SSE2;
+      else
+        default_impl = META_SHADOW_BLUR_SCALAR;
+    }
+
+  return default_impl;
+}
+
+/**
+ * meta_shadow_blur_region:
+ * @region: the region to blur
+ * @radius: the radius of the gaussian blur
+ * @impl: which implementation of the blur to use
+ * @buffer_width: (out): location to store the width of the result
+ * @buffer_height: (out): location to store the height of the result
+ *
+ * Renders @region as an 8-bit alpha image and blurs it; the region is
+ * offset within the result by the spread of the blur in both directions.
+ * All implementations produce the same result; @impl exists so that
+ * they can be compared.
+ *
+ * Return value: the blurred image; free with g_free()
+ */
+guchar *
+meta_shadow_blur_region (cairo_region_t     *region,
+                         int                 radius,
+                         MetaShadowBlurImpl  impl,
+                         int                *buffer_width_out,
+                         int                *buffer_height_out)
+{
+  int d = get_box_filter_size (radius);
+  int spread = get_shadow_spread (radius);
   cairo_rectangle_int_t extents;
   cairo_region_t *row_convolve_region;
   cairo_region_t *column_convolve_region;
@@ -711,6 +1153,11 @@ make_shadow (MetaShadow     *shadow,
   int y_offset;
   int n_rectangles, j, k;
 
+  if (impl == META_SHADOW_BLUR_AUTO)
+    impl = get_default_blur_impl ();
+
+  g_return_val_if_fail (meta_shadow_blur_impl_supported (impl), NULL);
+
   cairo_region_get_extents (region, &extents);
 
   /* In the case where top_fade >= 0 and the portion above the top
@@ -761,23 +1208,92 @@ make_shadow (MetaShadow     *shadow,
 	memset (buffer + buffer_width * j + x_offset + rect.x, 255, rect.width);
     }
 
-  /* Step 2: swap rows and columns */
-  buffer = flip_buffer (buffer, buffer_width, buffer_height);
+#ifdef HAVE_SHADOW_BLUR_SIMD
+  if (impl != META_SHADOW_BLUR_SCALAR && d < MAX_SIMD_FILTER_SIZE)
+    {
+      BlurYSpanFunc blur_func;
+      int n_columns;
+
+      if (impl == META_SHADOW_BLUR_AVX2)
+        {
+          blur_func = blur_yspan_avx2;
+          n_columns = 16;
+        }
+      else
+        {
+          blur_func = blur_yspan_sse2;
+          n_columns = 8;
+        }
+
+      /* Step 2: blur columns */
+      blur_columns (column_convolve_region, x_offset, y_offset,
+                    buffer, buffer_width, buffer_height,
+                    d, blur_func, n_columns);
+
+      /* Step 3: swap rows and columns */
+      buffer = flip_buffer (buffer, buffer_width, buffer_height, TRUE);
+
+      /* Step 4: blur columns (really rows) */
+      blur_columns (row_convolve_region, y_offset, x_offset,
+                    buffer, buffer_height, buffer_width,
+                    d, blur_func, n_columns);
+
+      /* Step 5: swap rows and columns */
+      buffer = flip_buffer (buffer, buffer_height, buffer_width, TRUE);
+    }
+  else
+#endif /* HAVE_SHADOW_BLUR_SIMD */
+    {
+      /* Step 2: swap rows and columns */
+      buffer = flip_buffer (buffer, buffer_width, buffer_height, FALSE);
+
+      /* Step 3: blur rows (really columns) */
+      blur_rows (column_convolve_region, y_offset, x_offset,
+                 buffer, buffer_height, buffer_width,
+                 d);
+
+      /* Step 4: swap rows and columns */
+      buffer = flip_buffer (buffer, buffer_height, buffer_width, FALSE);
+
+      /* Step 5: blur rows */
+      blur_rows (row_convolve_region, x_offset, y_offset,
+                 buffer, buffer_width, buffer_height,
+                 d);
+    }
+
+  cairo_region_destroy (row_convolve_region);
+  cairo_region_destroy (column_convolve_region);
 
-  /* Step 3: blur rows (really columns) */
-  blur_rows (column_convolve_region, y_offset, x_offset,
-             buffer, buffer_height, buffer_width,
-             d);
+  *buffer_width_out = buffer_width;
+  *buffer_height_out = buffer_height;
 
-  /* Step 4: swap rows and columns */
-  buffer = flip_buffer (buffer, buffer_height, buffer_width);
+  return buffer;
+}
 
-  /* Step 5: blur rows */
-  blur_rows (row_convolve_region, x_offset, y_offset,
-             buffer, buffer_width, buffer_height,
-             d);
+static void
+make_shadow (MetaShadow     *shadow,
+             cairo_region_t *region)
+{
+  int spread = get_shadow_spread (shadow->key.radius);
+  cairo_rectangle_int_t extents;
+  guchar *buffer;
+  int buffer_width;
+  int buffer_height;
+  int x_offset;
+  int y_offset;
+  int j;
+
+  cairo_region_get_extents (region, &extents);
 
-  /* Step 6: fade out the top, if applicable */
+  buffer = meta_shadow_blur_region (region, shadow->key.radius,
+                                    META_SHADOW_BLUR_AUTO,
+                                    &buffer_width, &buffer_height);
+
+  /* Offsets between coordinates of the region and coordinates in the buffer */
+  x_offset = spread;
+  y_offset = spread;
+
+  /* Fade out the top, if applicable */
   if (shadow->key.top_fade >= 0)
     {
       for (j = y_offset; j < y_offset + MIN (shadow->key.top_fade, extents.height + shadow->outer_border_bottom); j++)
@@ -798,8 +1314,6 @@ make_shadow (MetaShadow     *shadow,
                                                  (y_offset - shadow->outer_border_top) * buffer_width +
                                                  (x_offset - shadow->outer_border_left)));
 
-  cairo_region_destroy (row_convolve_region);
-  cairo_region_destroy (column_convolve_region);
   g_free (buffer);
 
   shadow->material = meta_create_texture_material (shadow->texture);
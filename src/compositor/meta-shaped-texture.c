@@ -188,7 +188,7 @@ scan_visible_region (MetaShapedTexture *stex,
   MetaShapedTexturePrivate *priv = stex->priv;
   cairo_region_t *visible_pixels_region;
   cairo_region_t *overlay_region;
-  int i, n_rects;
+  cairo_region_t *scanned_region;
 
   /* The visible pixels region contains all pixel values above 0.
    * This is somewhat complicated when there's an overlay: we
@@ -212,36 +212,10 @@ scan_visible_region (MetaShapedTexture *stex,
    * scan all the pixels potentially added by the overlay path. */
   cairo_region_subtract (visible_pixels_region, overlay_region);
 
-  n_rects = cairo_region_num_rectangles (overlay_region);
-
-  for (i = 0; i < n_rects; i ++)
-    {
-      int x, y;
-      cairo_rectangle_int_t rect;
-
-      cairo_region_get_rectangle (overlay_region, i, &rect);
-
-      for (y = rect.y; y < (rect.y + rect.height); y ++)
-        {
-          for (x = rect.x; x < (rect.x + rect.width); x ++)
-            {
-              int w = x;
-              while (mask_data[y * stride + w] > 0 && w < (rect.x + rect.width))
-                w ++;
-
-              if (w > 0)
-                {
-                  cairo_rectangle_int_t tmp;
-                  tmp.x = x;
-                  tmp.y = y;
-                  tmp.width = w - x;
-                  tmp.height = 1;
-                  cairo_region_union_rectangle (visible_pixels_region, &tmp);
-                  x = w;
-                }
-            }
-        }
-    }
+  scanned_region = meta_make_region_from_mask (mask_data, stride,
+                                               overlay_region);
+  cairo_region_union (visible_pixels_region, scanned_region);
+  cairo_region_destroy (scanned_region);
 
   priv->visible_pixels_region = visible_pixels_region;
 }
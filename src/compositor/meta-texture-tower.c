@@ -28,6 +28,10 @@
 #include "meta-texture-tower.h"
 #include "meta-texture-rectangle.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifndef M_LOG2E
 #define M_LOG2E 1.4426950408889634074
 #endif
@@ -435,37 +439,157 @@ texture_tower_revalidate_fbo (MetaTextureTower *tower,
   return TRUE;
 }
 
+/* Client-side scaling is done into a scratch buffer; revalidation
+ * only happens when painting, so a single buffer can be shared by all
+ * towers and reused from one level and one frame to the next. We don't
+ * hold on to huge buffers, though, since they're only needed when a
+ * large area of a large window has been damaged.
+ */
+#define MAX_RETAINED_SCRATCH_SIZE (16 * 1024 * 1024)
+
+static guchar *scratch_buffer = NULL;
+static gsize scratch_buffer_size = 0;
+
+static guchar *
+get_scratch_buffer (gsize size)
+{
+  if (size > scratch_buffer_size)
+    {
+      g_free (scratch_buffer);
+      scratch_buffer = g_malloc (size);
+      scratch_buffer_size = size;
+    }
+
+  return scratch_buffer;
+}
+
+static void
+release_scratch_buffer (void)
+{
+  if (scratch_buffer_size > MAX_RETAINED_SCRATCH_SIZE)
+    {
+      g_free (scratch_buffer);
+      scratch_buffer = NULL;
+      scratch_buffer_size = 0;
+    }
+}
+
+/* Rounds up, like the SSE2 pavgb instruction, so that the vectorized
+ * and unvectorized code produce the same results */
+#define AVERAGE(a, b) (((a) + (b) + 1) >> 1)
+
+/* Averages two rows of @n_bytes; @dest may be the same as @source1 */
 static void
-fill_copy (guchar       *buf,
-           const guchar *source,
-           int           width)
+average_rows (guchar       *dest,
+              const guchar *source1,
+              const guchar *source2,
+              int           n_bytes)
 {
-  memcpy (buf, source, width * 4);
+  int i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= n_bytes; i += 16)
+    _mm_storeu_si128 ((__m128i *)(dest + i),
+                      _mm_avg_epu8 (_mm_loadu_si128 ((const __m128i *)(source1 + i)),
+                                    _mm_loadu_si128 ((const __m128i *)(source2 + i))));
+#endif
+
+  for (; i < n_bytes; i++)
+    dest[i] = AVERAGE (source1[i], source2[i]);
 }
 
+/* Averages 2x2 blocks of pixels from two rows into @dest_width pixels;
+ * if @source1 and @source2 are the same, only averages horizontally.
+ * @dest may be the same as @source1, since we always read a pixel before
+ * writing over it.
+ */
 static void
-fill_scale_down (guchar       *buf,
-                 const guchar *source,
-                 int           width)
+scale_down_row (guchar       *dest,
+                const guchar *source1,
+                const guchar *source2,
+                int           dest_width)
 {
-  while (width > 1)
+  int i = 0;
+
+#ifdef __SSE2__
+  for (; i + 4 <= dest_width; i += 4)
+    {
+      __m128i a, b, even, odd;
+
+      a = _mm_avg_epu8 (_mm_loadu_si128 ((const __m128i *)(source1 + 8 * i)),
+                        _mm_loadu_si128 ((const __m128i *)(source2 + 8 * i)));
+      b = _mm_avg_epu8 (_mm_loadu_si128 ((const __m128i *)(source1 + 8 * i + 16)),
+                        _mm_loadu_si128 ((const __m128i *)(source2 + 8 * i + 16)));
+
+      /* Separate the even and odd pixels and average them */
+      even = _mm_unpacklo_epi64 (_mm_shuffle_epi32 (a, _MM_SHUFFLE (2, 0, 2, 0)),
+                                 _mm_shuffle_epi32 (b, _MM_SHUFFLE (2, 0, 2, 0)));
+      odd = _mm_unpacklo_epi64 (_mm_shuffle_epi32 (a, _MM_SHUFFLE (3, 1, 3, 1)),
+                                _mm_shuffle_epi32 (b, _MM_SHUFFLE (3, 1, 3, 1)));
+
+      _mm_storeu_si128 ((__m128i *)(dest + 4 * i), _mm_avg_epu8 (even, odd));
+    }
+#endif
+
+  for (; i < dest_width; i++)
     {
-      buf[0] = (source[0] + source[4]) / 2;
-      buf[1] = (source[1] + source[5]) / 2;
-      buf[2] = (source[2] + source[6]) / 2;
-      buf[3] = (source[3] + source[7]) / 2;
-
-      buf += 4;
-      source += 8;
-      width -= 2;
+      const guchar *s1 = source1 + 8 * i;
+      const guchar *s2 = source2 + 8 * i;
+      guchar *d = dest + 4 * i;
+
+      d[0] = AVERAGE (AVERAGE (s1[0], s2[0]), AVERAGE (s1[4], s2[4]));
+      d[1] = AVERAGE (AVERAGE (s1[1], s2[1]), AVERAGE (s1[5], s2[5]));
+      d[2] = AVERAGE (AVERAGE (s1[2], s2[2]), AVERAGE (s1[6], s2[6]));
+      d[3] = AVERAGE (AVERAGE (s1[3], s2[3]), AVERAGE (s1[7], s2[7]));
     }
+}
+
+#undef AVERAGE
+
+/**
+ * meta_texture_tower_scale_down:
+ * @data: pixel data, 4 bytes per pixel, with a rowstride of 4 * @width
+ * @width: width of @data in pixels
+ * @height: height of @data in pixels
+ * @scale_x: whether to halve the width
+ * @scale_y: whether to halve the height
+ *
+ * Scales @data down with a 2x2 box filter, in place; the result has a
+ * rowstride of 4 times the new width. If the width or height is odd, the
+ * last column or row is dropped, to match the size of the next level
+ * of the tower.
+ */
+void
+meta_texture_tower_scale_down (guchar   *data,
+                               int       width,
+                               int       height,
+                               gboolean  scale_x,
+                               gboolean  scale_y)
+{
+  int source_rowstride = width * 4;
+  int dest_width = scale_x ? width / 2 : width;
+  int dest_height = scale_y ? height / 2 : height;
+  int dest_rowstride = dest_width * 4;
+  int i;
 
-  if (width > 0)
+  for (i = 0; i < dest_height; i++)
     {
-      buf[0] = source[0] / 2;
-      buf[1] = source[1] / 2;
-      buf[2] = source[2] / 2;
-      buf[3] = source[3] / 2;
+      const guchar *source1, *source2;
+
+      if (scale_y)
+        {
+          source1 = data + 2 * i * source_rowstride;
+          source2 = source1 + source_rowstride;
+        }
+      else
+        {
+          source1 = source2 = data + i * source_rowstride;
+        }
+
+      if (scale_x)
+        scale_down_row (data + i * dest_rowstride, source1, source2, dest_width);
+      else if (scale_y)
+        average_rows (data + i * dest_rowstride, source1, source2, dest_rowstride);
     }
 }
 
@@ -476,79 +600,39 @@ texture_tower_revalidate_client (MetaTextureTower *tower,
   CoglHandle source_texture = tower->textures[level - 1];
   int source_texture_width = cogl_texture_get_width (source_texture);
   int source_texture_height = cogl_texture_get_height (source_texture);
-  guint source_rowstride;
-  guchar *source_data;
   CoglHandle dest_texture = tower->textures[level];
   int dest_texture_width = cogl_texture_get_width (dest_texture);
   int dest_texture_height = cogl_texture_get_height (dest_texture);
+  gboolean scale_x = dest_texture_width < source_texture_width;
+  gboolean scale_y = dest_texture_height < source_texture_height;
   int dest_x = tower->invalid[level].x1;
   int dest_y = tower->invalid[level].y1;
   int dest_width = tower->invalid[level].x2 - tower->invalid[level].x1;
   int dest_height = tower->invalid[level].y2 - tower->invalid[level].y1;
-  guchar *dest_data;
-  guchar *source_tmp1 = NULL, *source_tmp2 = NULL;
-  int i, j;
-
-  source_rowstride = source_texture_width * 4;
-
-  source_data = g_malloc (source_texture_height * source_rowstride);
-  cogl_texture_get_data (source_texture, TEXTURE_FORMAT, source_rowstride,
-                         source_data);
-
-  dest_data = g_malloc (dest_height * dest_width * 4);
-
-  if (dest_texture_height < source_texture_height)
-    {
-      source_tmp1 = g_malloc (dest_width * 4);
-      source_tmp2 = g_malloc (dest_width * 4);
-    }
-
-  for (i = 0; i < dest_height; i++)
-    {
-      guchar *dest_row = dest_data + i * dest_width * 4;
-      if (dest_texture_height < source_texture_height)
-        {
-          guchar *source1, *source2;
-          guchar *dest;
-
-          if (dest_texture_width < source_texture_width)
-            {
-              fill_scale_down (source_tmp1,
-                               source_data + ((i + dest_y) * 2) * source_rowstride + dest_x * 2 * 4,
-                               dest_width * 2);
-              fill_scale_down (source_tmp2,
-                               source_data + ((i + dest_y) * 2 + 1) * source_rowstride + dest_x * 2 * 4,
-                               dest_width * 2);
-            }
-          else
-            {
-              fill_copy (source_tmp1,
-                         source_data + ((i + dest_y) * 2) * source_rowstride + dest_x * 4,
-                         dest_width);
-              fill_copy (source_tmp2,
-                         source_data + ((i + dest_y) * 2 + 1) * source_rowstride + dest_x * 4,
-                         dest_width);
-            }
+  int source_x = scale_x ? 2 * dest_x : dest_x;
+  int source_y = scale_y ? 2 * dest_y : dest_y;
+  int source_width = scale_x ? 2 * dest_width : dest_width;
+  int source_height = scale_y ? 2 * dest_height : dest_height;
+  CoglHandle source_area;
+  guchar *data;
+
+  /* Only download the part of the source level that covers the invalid
+   * area, and scale it down in place in the same buffer */
+  if (source_x == 0 && source_y == 0 &&
+      source_width == source_texture_width &&
+      source_height == source_texture_height)
+    source_area = cogl_handle_ref (source_texture);
+  else
+    source_area = cogl_texture_new_from_sub_texture (source_texture,
+                                                     source_x, source_y,
+                                                     source_width, source_height);
 
-          source1 = source_tmp1;
-          source2 = source_tmp2;
+  data = get_scratch_buffer (source_height * source_width * 4);
+  cogl_texture_get_data (source_area, TEXTURE_FORMAT, source_width * 4, data);
+  cogl_handle_unref (source_area);
 
-          dest = dest_row;
-          for (j = 0; j < dest_width * 4; j++)
-            *(dest++) = (*(source1++) + *(source2++)) / 2;
-        }
-      else
-        {
-          if (dest_texture_width < source_texture_width)
-            fill_scale_down (dest_row,
-                             source_data + (i + dest_y) * source_rowstride + dest_x * 2 * 4,
-                             dest_width * 2);
-          else
-            fill_copy (dest_row,
-                       source_data + (i + dest_y) * source_rowstride,
-                       dest_width);
-        }
-    }
+  meta_texture_tower_scale_down (data, source_width, source_height,
+                                 scale_x, scale_y);
 
   cogl_texture_set_region (dest_texture,
                            0, 0,
@@ -557,16 +641,9 @@ texture_tower_revalidate_client (MetaTextureTower *tower,
                            dest_width, dest_height,
                            TEXTURE_FORMAT,
                            4 * dest_width,
-                           dest_data);
+                           data);
 
-  if (dest_height < source_texture_height)
-    {
-      g_free (source_tmp1);
-      g_free (source_tmp2);
-    }
-
-  g_free (source_data);
-  g_free (dest_data);
+  release_scratch_buffer ();
 }
 
 static void
@@ -575,6 +652,9 @@ texture_tower_revalidate (MetaTextureTower *tower,
 {
   if (!texture_tower_revalidate_fbo (tower, level))
     texture_tower_revalidate_client (tower, level);
+
+  tower->invalid[level].x1 = tower->invalid[level].x2 = 0;
+  tower->invalid[level].y1 = tower->invalid[level].y2 = 0;
 }
 
 /**
@@ -627,8 +707,8 @@ meta_texture_tower_get_paint_texture (MetaTextureTower *tower)
 
       for (i = 1; i <= level; i++)
        {
-         if (tower->invalid[level].x2 != tower->invalid[level].x1 &&
-             tower->invalid[level].y2 != tower->invalid[level].y1)
+         if (tower->invalid[i].x2 != tower->invalid[i].x1 &&
+             tower->invalid[i].y2 != tower->invalid[i].y1)
            texture_tower_revalidate (tower, i);
        }
    }
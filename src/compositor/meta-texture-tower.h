@@ -64,6 +64,12 @@ void              meta_texture_tower_update_area       (MetaTextureTower *tower,
                                                         int               height);
 CoglHandle        meta_texture_tower_get_paint_texture (MetaTextureTower *tower);
 
+void              meta_texture_tower_scale_down        (guchar           *data,
+                                                        int               width,
+                                                        int               height,
+                                                        gboolean          scale_x,
+                                                        gboolean          scale_y);
+
 G_BEGIN_DECLS
 
 #endif /* __META_TEXTURE_TOWER_H__ */
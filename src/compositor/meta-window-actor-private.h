@@ -28,6 +28,11 @@ void meta_window_actor_process_damage (MetaWindowActor    *self,
                                        XDamageNotifyEvent *event);
 void meta_window_actor_pre_paint      (MetaWindowActor    *self);
 
+void meta_window_actor_get_damage_stats (MetaWindowActor *self,
+                                         guint           *n_events,
+                                         guint64         *area,
+                                         guint           *n_updates);
+
 void meta_window_actor_invalidate_shadow (MetaWindowActor *self);
 
 gboolean meta_window_actor_effect_in_progress  (MetaWindowActor *self);
@@ -39,6 +44,7 @@ void     meta_window_actor_mapped              (MetaWindowActor *self);
 void     meta_window_actor_unmapped            (MetaWindowActor *self);
 
 cairo_region_t *meta_window_actor_get_obscured_region (MetaWindowActor *self);
+guint           meta_window_actor_get_obscured_serial (MetaWindowActor *self);
 
 void meta_window_actor_set_visible_region         (MetaWindowActor *self,
                                                    cairo_region_t  *visible_region);
@@ -33,6 +33,10 @@ enum {
 
 static guint signals[LAST_SIGNAL] = {0};
 
+/* Shared between all actors so that a serial is never reused by a
+ * different actor; see meta_window_actor_get_obscured_serial() */
+static guint next_obscured_serial = 0;
+
 
 struct _MetaWindowActorPrivate
 {
@@ -71,6 +75,20 @@ struct _MetaWindowActorPrivate
   cairo_region_t   *bounding_region;
   /* The region we should clip to when painting the shadow */
   cairo_region_t   *shadow_clip;
+  /* Damage received since the last pre-paint, not yet applied to the
+   * texture
+   */
+  cairo_region_t   *damage_region;
+
+  /* For debugging: damage events received, the total area they
+   * covered, and the texture updates they were applied with
+   */
+  guint             n_damage_events;
+  guint64           damaged_area;
+  guint             n_damage_updates;
+
+  /* Changes whenever the result of get_obscured_region() may change */
+  guint             obscured_serial;
 
   /* Extracted size-invariant shape used for shadows */
   MetaWindowShape  *shadow_shape;
@@ -114,6 +132,9 @@ struct _MetaWindowActorPrivate
   guint             no_shadow              : 1;
 
   guint             no_more_x_calls        : 1;
+
+  /* On MetaCompScreen.dirty_windows, waiting for pre-paint */
+  guint             pre_paint_queued       : 1;
 };
 
 enum
@@ -126,6 +147,12 @@ enum
   PROP_SHADOW_CLASS
 };
 
+/* Damage fragmented into more rectangles than this is applied as its
+ * bounding box: each texture update has a fixed cost, and uploading a
+ * bit more than was damaged is cheaper than many small uploads.
+ */
+#define MAX_DAMAGE_RECTANGLES 16
+
 #define DEFAULT_SHADOW_RADIUS 12
 #define DEFAULT_SHADOW_X_OFFSET 0
 #define DEFAULT_SHADOW_Y_OFFSET 8
@@ -154,6 +181,11 @@ static gboolean meta_window_actor_has_shadow (MetaWindowActor *self);
 static void meta_window_actor_clear_shape_region    (MetaWindowActor *self);
 static void meta_window_actor_clear_bounding_region (MetaWindowActor *self);
 static void meta_window_actor_clear_shadow_clip     (MetaWindowActor *self);
+static void meta_window_actor_clear_damage_region   (MetaWindowActor *self);
+static void meta_window_actor_obscured_changed      (MetaWindowActor *self);
+static void meta_window_actor_queue_pre_paint       (MetaWindowActor *self);
+
+static void check_needs_update (MetaWindowActor *self);
 
 G_DEFINE_TYPE (MetaWindowActor, meta_window_actor, CLUTTER_TYPE_GROUP);
 
@@ -251,6 +283,7 @@ meta_window_actor_init (MetaWindowActor *self)
 						   META_TYPE_WINDOW_ACTOR,
 						   MetaWindowActorPrivate);
   priv->opacity = 0xff;
+  priv->obscured_serial = ++next_obscured_serial;
   priv->shadow_class = NULL;
 }
 
@@ -308,9 +341,20 @@ window_appears_focused_notify (MetaWindow *mw,
                                GParamSpec *arg1,
                                gpointer    data)
 {
+  /* We switch between the focused and unfocused shadow at pre-paint */
+  meta_window_actor_queue_pre_paint (META_WINDOW_ACTOR (data));
   clutter_actor_queue_redraw (CLUTTER_ACTOR (data));
 }
 
+static void
+window_type_notify (MetaWindow *mw,
+                    GParamSpec *arg1,
+                    gpointer    data)
+{
+  /* Whether we have a shadow depends on the window type */
+  meta_window_actor_queue_pre_paint (META_WINDOW_ACTOR (data));
+}
+
 static void
 meta_window_actor_constructed (GObject *object)
 {
@@ -329,7 +373,10 @@ meta_window_actor_constructed (GObject *object)
   format = XRenderFindVisualFormat (xdisplay, window->xvisual);
 
   if (format && format->type == PictTypeDirect && format->direct.alphaMask)
-    priv->argb32 = TRUE;
+    {
+      priv->argb32 = TRUE;
+      meta_window_actor_obscured_changed (self);
+    }
 
   if (!priv->actor)
     {
@@ -350,6 +397,8 @@ meta_window_actor_constructed (GObject *object)
                         G_CALLBACK (window_decorated_notify), self);
       g_signal_connect (window, "notify::appears-focused",
                         G_CALLBACK (window_appears_focused_notify), self);
+      g_signal_connect (window, "notify::window-type",
+                        G_CALLBACK (window_type_notify), self);
     }
   else
     {
@@ -389,6 +438,7 @@ meta_window_actor_dispose (GObject *object)
   meta_window_actor_clear_shape_region (self);
   meta_window_actor_clear_bounding_region (self);
   meta_window_actor_clear_shadow_clip (self);
+  meta_window_actor_clear_damage_region (self);
 
   if (priv->shadow_class != NULL)
     {
@@ -425,6 +475,12 @@ meta_window_actor_dispose (GObject *object)
 
   info->windows = g_list_remove (info->windows, (gconstpointer) self);
 
+  if (priv->pre_paint_queued)
+    {
+      info->dirty_windows = g_list_remove (info->dirty_windows, self);
+      priv->pre_paint_queued = FALSE;
+    }
+
   if (priv->window)
     {
       g_object_unref (priv->window);
@@ -692,8 +748,9 @@ meta_window_actor_get_paint_volume (ClutterActor       *actor,
   ClutterVertex origin;
 
   /* The paint volume is computed before paint functions are called
-   * so our bounds might not be updated yet. Force an update. */
-  meta_window_actor_pre_paint (self);
+   * so our bounds might not be updated yet. Force an update; if we are
+   * queued we stay queued, which is harmless. */
+  check_needs_update (self);
 
   meta_window_actor_get_shape_bounds (self, &bounds);
 
@@ -961,6 +1018,10 @@ meta_window_actor_damage_all (MetaWindowActor *self)
                                           0,
                                           pixmap_width,
                                           pixmap_height);
+  priv->n_damage_updates++;
+
+  /* That covers any damage we were still holding on to */
+  meta_window_actor_clear_damage_region (self);
 
   priv->needs_damage_all = FALSE;
 }
@@ -980,6 +1041,9 @@ meta_window_actor_thaw (MetaWindowActor *self)
   if (self->priv->freeze_count)
     return;
 
+  /* Pre-paint skipped us while we were frozen */
+  meta_window_actor_queue_pre_paint (self);
+
   /* Since we ignore damage events while a window is frozen for certain effects
    * we may need to issue an update_area() covering the whole pixmap if we
    * don't know what real damage has happened. */
@@ -1014,8 +1078,10 @@ meta_window_actor_queue_create_pixmap (MetaWindowActor *self)
    * need to repair the window anyways, and can wait until
    * the stage is redrawn for some other reason
    *
-   * The compositor paint function repairs all windows.
+   * The compositor paint function repairs the windows queued for
+   * pre-paint.
    */
+  meta_window_actor_queue_pre_paint (self);
   clutter_actor_queue_redraw (priv->actor);
 }
 
@@ -1206,6 +1272,7 @@ meta_window_actor_detach (MetaWindowActor *self)
 
   XFreePixmap (xdisplay, priv->back_pixmap);
   priv->back_pixmap = None;
+  meta_window_actor_obscured_changed (self);
 
   meta_window_actor_queue_create_pixmap (self);
 }
@@ -1278,6 +1345,9 @@ meta_window_actor_sync_actor_position (MetaWindowActor *self)
       priv->last_height = window_rect.height;
     }
 
+  /* Maximizing or going fullscreen can take away our shadow */
+  meta_window_actor_queue_pre_paint (self);
+
   if (meta_window_actor_effect_in_progress (self))
     return;
 
@@ -1509,6 +1579,15 @@ meta_window_actor_unmapped (MetaWindowActor *self)
   priv->needs_pixmap = FALSE;
 }
 
+static void
+meta_window_actor_obscured_changed (MetaWindowActor *self)
+{
+  self->priv->obscured_serial = ++next_obscured_serial;
+}
+
+/* Both clear functions are always called before the corresponding region
+ * is replaced, so bumping the serial here also covers the new region.
+ */
 static void
 meta_window_actor_clear_shape_region (MetaWindowActor *self)
 {
@@ -1519,6 +1598,8 @@ meta_window_actor_clear_shape_region (MetaWindowActor *self)
       cairo_region_destroy (priv->shape_region);
       priv->shape_region = NULL;
     }
+
+  meta_window_actor_obscured_changed (self);
 }
 
 static void
@@ -1531,6 +1612,8 @@ meta_window_actor_clear_bounding_region (MetaWindowActor *self)
       cairo_region_destroy (priv->bounding_region);
       priv->bounding_region = NULL;
     }
+
+  meta_window_actor_obscured_changed (self);
 }
 
 static void
@@ -1545,6 +1628,18 @@ meta_window_actor_clear_shadow_clip (MetaWindowActor *self)
     }
 }
 
+static void
+meta_window_actor_clear_damage_region (MetaWindowActor *self)
+{
+  MetaWindowActorPrivate *priv = self->priv;
+
+  if (priv->damage_region)
+    {
+      cairo_region_destroy (priv->damage_region);
+      priv->damage_region = NULL;
+    }
+}
+
 static void
 meta_window_actor_update_bounding_region_and_borders (MetaWindowActor *self,
                                                       int              width,
@@ -1655,6 +1750,22 @@ meta_window_actor_get_obscured_region (MetaWindowActor *self)
     return NULL;
 }
 
+/**
+ * meta_window_actor_get_obscured_serial:
+ * @self: a #MetaWindowActor
+ *
+ * Gets a serial number that changes whenever the region returned by
+ * meta_window_actor_get_obscured_region() might have changed. Serials
+ * are unique across all window actors.
+ *
+ * Return value: the current obscured region serial
+ */
+guint
+meta_window_actor_get_obscured_serial (MetaWindowActor *self)
+{
+  return self->priv->obscured_serial;
+}
+
 #if 0
 /* Print out a region; useful for debugging */
 static void
@@ -1832,10 +1943,13 @@ check_needs_pixmap (MetaWindowActor *self)
           priv->back_pixmap = None;
         }
 
+      meta_window_actor_obscured_changed (self);
+
       if (priv->back_pixmap == None)
         {
           meta_verbose ("Unable to get named pixmap for %p\n", self);
           meta_window_actor_update_bounding_region_and_borders (self, 0, 0);
+          meta_error_trap_pop (display);
           return;
         }
 
@@ -1846,6 +1960,10 @@ check_needs_pixmap (MetaWindowActor *self)
       clutter_x11_texture_pixmap_set_pixmap
                        (CLUTTER_X11_TEXTURE_PIXMAP (priv->actor),
                         priv->back_pixmap);
+      /* The whole new pixmap is taken, so damage to the old one no
+       * longer needs applying
+       */
+      meta_window_actor_clear_damage_region (self);
       /*
        * This only works *after* actually setting the pixmap, so we have to
        * do it here.
@@ -1951,9 +2069,13 @@ meta_window_actor_process_damage (MetaWindowActor    *self,
                                   XDamageNotifyEvent *event)
 {
   MetaWindowActorPrivate *priv = self->priv;
-  ClutterX11TexturePixmap *texture_x11 = CLUTTER_X11_TEXTURE_PIXMAP (priv->actor);
+  cairo_rectangle_int_t rect;
 
   priv->received_damage = TRUE;
+  meta_window_actor_queue_pre_paint (self);
+
+  priv->n_damage_events++;
+  priv->damaged_area += (guint64) event->area.width * event->area.height;
 
   if (is_frozen (self))
     {
@@ -1975,12 +2097,89 @@ meta_window_actor_process_damage (MetaWindowActor    *self,
       return;
     }
 
+  /* Clients often damage many small areas per frame, so rather than
+   * updating the texture for each event, collect the damage and apply
+   * it once in pre-paint.
+   */
+  rect.x = event->area.x;
+  rect.y = event->area.y;
+  rect.width = event->area.width;
+  rect.height = event->area.height;
 
-  clutter_x11_texture_pixmap_update_area (texture_x11,
-                                          event->area.x,
-                                          event->area.y,
-                                          event->area.width,
-                                          event->area.height);
+  if (priv->damage_region == NULL)
+    {
+      priv->damage_region = cairo_region_create_rectangle (&rect);
+
+      /* Make sure there is a frame to apply it in */
+      clutter_actor_queue_redraw (priv->actor);
+      return;
+    }
+
+  cairo_region_union_rectangle (priv->damage_region, &rect);
+
+  if (cairo_region_num_rectangles (priv->damage_region) > MAX_DAMAGE_RECTANGLES)
+    {
+      cairo_region_get_extents (priv->damage_region, &rect);
+      cairo_region_destroy (priv->damage_region);
+      priv->damage_region = cairo_region_create_rectangle (&rect);
+    }
+}
+
+static void
+check_needs_damage (MetaWindowActor *self)
+{
+  MetaWindowActorPrivate *priv = self->priv;
+  ClutterX11TexturePixmap *texture_x11 = CLUTTER_X11_TEXTURE_PIXMAP (priv->actor);
+  int i, n_rects;
+
+  if (priv->damage_region == NULL)
+    return;
+
+  n_rects = cairo_region_num_rectangles (priv->damage_region);
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (priv->damage_region, i, &rect);
+      clutter_x11_texture_pixmap_update_area (texture_x11,
+                                              rect.x,
+                                              rect.y,
+                                              rect.width,
+                                              rect.height);
+    }
+
+  priv->n_damage_updates += n_rects;
+
+  meta_window_actor_clear_damage_region (self);
+}
+
+/**
+ * meta_window_actor_get_damage_stats: (skip)
+ * @self: a #MetaWindowActor
+ * @n_events: (out) (allow-none): location to store the number of damage
+ *   events received for the window
+ * @area: (out) (allow-none): location to store the total area of the
+ *   damage, in pixels
+ * @n_updates: (out) (allow-none): location to store the number of texture
+ *   updates the damage was applied with
+ *
+ * Gets statistics about the damage to the window since its actor was
+ * created, for debugging.
+ */
+void
+meta_window_actor_get_damage_stats (MetaWindowActor *self,
+                                    guint           *n_events,
+                                    guint64         *area,
+                                    guint           *n_updates)
+{
+  MetaWindowActorPrivate *priv = self->priv;
+
+  if (n_events)
+    *n_events = priv->n_damage_events;
+  if (area)
+    *area = priv->damaged_area;
+  if (n_updates)
+    *n_updates = priv->n_damage_updates;
 }
 
 void
@@ -2194,11 +2393,32 @@ meta_window_actor_update_shape (MetaWindowActor *self)
       priv->shadow_shape = NULL;
     }
 
+  meta_window_actor_queue_pre_paint (self);
   clutter_actor_queue_redraw (priv->actor);
 }
 
-void
-meta_window_actor_pre_paint (MetaWindowActor *self)
+/*
+ * Adds the actor to the screen's list of actors that need
+ * meta_window_actor_pre_paint() before the next frame. Anything that sets
+ * one of the flags handled there, or changes what check_needs_shadow()
+ * would decide, must call this.
+ */
+static void
+meta_window_actor_queue_pre_paint (MetaWindowActor *self)
+{
+  MetaWindowActorPrivate *priv = self->priv;
+  MetaCompScreen *info;
+
+  if (priv->pre_paint_queued || priv->disposed)
+    return;
+
+  info = meta_screen_get_compositor_data (priv->screen);
+  info->dirty_windows = g_list_prepend (info->dirty_windows, self);
+  priv->pre_paint_queued = TRUE;
+}
+
+static void
+check_needs_update (MetaWindowActor *self)
 {
   MetaWindowActorPrivate *priv = self->priv;
   MetaScreen          *screen   = priv->screen;
@@ -2208,7 +2428,8 @@ meta_window_actor_pre_paint (MetaWindowActor *self)
   if (is_frozen (self))
     {
       /* The window is frozen due to a pending animation: we'll wait until
-       * the animation finishes to reshape and repair the window */
+       * the animation finishes to reshape and repair the window; thawing
+       * queues us again */
       return;
     }
 
@@ -2221,10 +2442,25 @@ meta_window_actor_pre_paint (MetaWindowActor *self)
     }
 
   check_needs_pixmap (self);
+  check_needs_damage (self);
   check_needs_reshape (self);
   check_needs_shadow (self);
 }
 
+/*
+ * Called by the compositor for each actor on MetaCompScreen.dirty_windows,
+ * after taking the list. Changes made while we process the actor are
+ * handled in this same pass, so the actor stays marked as queued until
+ * we are done.
+ */
+void
+meta_window_actor_pre_paint (MetaWindowActor *self)
+{
+  check_needs_update (self);
+
+  self->priv->pre_paint_queued = FALSE;
+}
+
 void
 meta_window_actor_invalidate_shadow (MetaWindowActor *self)
 {
@@ -2232,6 +2468,7 @@ meta_window_actor_invalidate_shadow (MetaWindowActor *self)
 
   priv->recompute_focused_shadow = TRUE;
   priv->recompute_unfocused_shadow = TRUE;
+  meta_window_actor_queue_pre_paint (self);
   clutter_actor_queue_redraw (CLUTTER_ACTOR (self));
 }
 
@@ -2254,6 +2491,13 @@ meta_window_actor_update_opacity (MetaWindowActor *self)
   else
     opacity = 255;
 
+  if (self->priv->opacity != opacity)
+    {
+      meta_window_actor_obscured_changed (self);
+      /* Translucent windows don't get shadows */
+      meta_window_actor_queue_pre_paint (self);
+    }
+
   self->priv->opacity = opacity;
   clutter_actor_set_opacity (self->priv->actor, opacity);
 }
@@ -16,11 +16,38 @@ struct _MetaWindowGroupClass
   ClutterGroupClass parent_class;
 };
 
+/* One entry per window or background actor that was visible in the
+ * last paint, in top-to-bottom order. @visible is the part of the stage
+ * not obscured by anything above the actor and @beneath the part not
+ * obscured by the actor or anything above it, both in stage coordinates
+ * and independent of the redraw clip, so they stay valid across frames
+ * as long as nothing at or above this entry changed.
+ */
+typedef struct
+{
+  ClutterActor   *actor;
+  guint           obscured_serial;
+  int             x;
+  int             y;
+  guint           untransformed : 1;
+  guint           opaque        : 1;
+
+  cairo_region_t *visible;
+  cairo_region_t *beneath;
+} MetaWindowGroupEntry;
+
 struct _MetaWindowGroup
 {
   ClutterGroup parent;
 
   MetaScreen *screen;
+
+  GArray *entries;
+  int stage_width;
+  int stage_height;
+
+  guint n_recomputed;
+  guint n_reused;
 };
 
 G_DEFINE_TYPE (MetaWindowGroup, meta_window_group, CLUTTER_TYPE_GROUP);
@@ -100,20 +127,59 @@ actor_is_untransformed (ClutterActor *actor,
   return TRUE;
 }
 
+static void
+clear_entry (MetaWindowGroupEntry *entry)
+{
+  if (entry->visible)
+    cairo_region_destroy (entry->visible);
+  if (entry->beneath)
+    cairo_region_destroy (entry->beneath);
+
+  entry->visible = NULL;
+  entry->beneath = NULL;
+}
+
+static void
+truncate_entries (MetaWindowGroup *window_group,
+                  guint            length)
+{
+  guint i;
+
+  for (i = length; i < window_group->entries->len; i++)
+    clear_entry (&g_array_index (window_group->entries, MetaWindowGroupEntry, i));
+
+  g_array_set_size (window_group->entries, MIN (length, window_group->entries->len));
+}
+
+static cairo_region_t *
+clip_region (cairo_region_t        *region,
+             cairo_rectangle_int_t *clip_rect,
+             int                    x,
+             int                    y)
+{
+  cairo_region_t *result;
+
+  result = cairo_region_copy (region);
+  cairo_region_intersect_rectangle (result, clip_rect);
+  cairo_region_translate (result, - x, - y);
+
+  return result;
+}
+
 static void
 meta_window_group_paint (ClutterActor *actor)
 {
-  cairo_region_t *visible_region;
+  MetaWindowGroup *window_group = META_WINDOW_GROUP (actor);
+  cairo_region_t *unobscured_region;
   ClutterActor *stage;
   cairo_rectangle_int_t visible_rect;
+  cairo_rectangle_int_t stage_rect = { 0, };
+  gfloat stage_width, stage_height;
   GList *children, *l;
+  gboolean cache_valid;
+  guint n_entries;
 
-  /* We walk the list from top to bottom (opposite of painting order),
-   * and subtract the opaque area of each window out of the visible
-   * region that we pass to the windows below.
-   */
   children = clutter_container_get_children (CLUTTER_CONTAINER (actor));
-  children = g_list_reverse (children);
 
   /* Get the clipped redraw bounds from Clutter so that we can avoid
    * painting shadows on windows that don't need to be painted in this
@@ -125,44 +191,137 @@ meta_window_group_paint (ClutterActor *actor)
   clutter_stage_get_redraw_clip_bounds (CLUTTER_STAGE (stage),
                                         &visible_rect);
 
-  visible_region = cairo_region_create_rectangle (&visible_rect);
+  /* The cached regions are relative to the whole stage rather than to
+   * the redraw clip, which is applied separately for each actor below.
+   */
+  clutter_actor_get_size (stage, &stage_width, &stage_height);
+  stage_rect.width = stage_width;
+  stage_rect.height = stage_height;
+
+  cache_valid = (stage_rect.width == window_group->stage_width &&
+                 stage_rect.height == window_group->stage_height);
+  window_group->stage_width = stage_rect.width;
+  window_group->stage_height = stage_rect.height;
 
-  for (l = children; l; l = l->next)
+  window_group->n_recomputed = 0;
+  window_group->n_reused = 0;
+
+  unobscured_region = cairo_region_create_rectangle (&stage_rect);
+  n_entries = 0;
+
+  /* We walk the list from top to bottom (opposite of painting order),
+   * and subtract the opaque area of each window out of the visible
+   * region that we pass to the windows below. Entries are reused until
+   * the first actor whose stacking position, position, opacity or
+   * obscured region changed; everything below it is recomputed.
+   */
+  for (l = g_list_last (children); l; l = l->prev)
     {
-      if (!CLUTTER_ACTOR_IS_VISIBLE (l->data))
+      ClutterActor *child = l->data;
+      MetaWindowGroupEntry current = { 0, };
+      MetaWindowGroupEntry *entry;
+
+      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
         continue;
 
-      if (META_IS_WINDOW_ACTOR (l->data))
+      if (META_IS_WINDOW_ACTOR (child))
         {
-          MetaWindowActor *window_actor = l->data;
-          gboolean x, y;
+          MetaWindowActor *window_actor = META_WINDOW_ACTOR (child);
 
-          if (!actor_is_untransformed (CLUTTER_ACTOR (window_actor), &x, &y))
-            continue;
+          current.untransformed = actor_is_untransformed (child, &current.x, &current.y);
+          current.opaque = clutter_actor_get_paint_opacity (child) == 0xff;
+          current.obscured_serial = meta_window_actor_get_obscured_serial (window_actor);
+        }
+      else if (!META_IS_BACKGROUND_ACTOR (child))
+        continue;
+
+      current.actor = child;
+
+      if (n_entries == window_group->entries->len)
+        {
+          g_array_append_val (window_group->entries, current);
+          cache_valid = FALSE;
+        }
+
+      entry = &g_array_index (window_group->entries, MetaWindowGroupEntry, n_entries);
+      n_entries++;
 
-          /* Temporarily move to the coordinate system of the actor */
-          cairo_region_translate (visible_region, - x, - y);
+      if (cache_valid &&
+          entry->actor == current.actor &&
+          entry->obscured_serial == current.obscured_serial &&
+          entry->untransformed == current.untransformed &&
+          entry->opaque == current.opaque &&
+          (!current.untransformed ||
+           (entry->x == current.x && entry->y == current.y)))
+        {
+          window_group->n_reused++;
+        }
+      else
+        {
+          cache_valid = FALSE;
+          clear_entry (entry);
+          *entry = current;
 
-          meta_window_actor_set_visible_region (window_actor, visible_region);
+          entry->visible = cairo_region_reference (unobscured_region);
 
-          if (clutter_actor_get_paint_opacity (CLUTTER_ACTOR (window_actor)) == 0xff)
+          if (META_IS_WINDOW_ACTOR (child) && current.untransformed && current.opaque)
             {
-              cairo_region_t *obscured_region = meta_window_actor_get_obscured_region (window_actor);
+              cairo_region_t *obscured_region;
+
+              obscured_region = meta_window_actor_get_obscured_region (META_WINDOW_ACTOR (child));
               if (obscured_region)
-                cairo_region_subtract (visible_region, obscured_region);
+                {
+                  cairo_region_t *beneath_region;
+
+                  beneath_region = cairo_region_copy (unobscured_region);
+                  cairo_region_translate (beneath_region, - current.x, - current.y);
+                  cairo_region_subtract (beneath_region, obscured_region);
+                  cairo_region_translate (beneath_region, current.x, current.y);
+                  entry->beneath = beneath_region;
+                }
             }
 
-          meta_window_actor_set_visible_region_beneath (window_actor, visible_region);
-          cairo_region_translate (visible_region, x, y);
+          if (!entry->beneath)
+            entry->beneath = cairo_region_reference (unobscured_region);
+
+          window_group->n_recomputed++;
         }
-      else if (META_IS_BACKGROUND_ACTOR (l->data))
+
+      cairo_region_destroy (unobscured_region);
+      unobscured_region = cairo_region_reference (entry->beneath);
+
+      if (META_IS_WINDOW_ACTOR (child))
         {
-          MetaBackgroundActor *background_actor = l->data;
-          meta_background_actor_set_visible_region (background_actor, visible_region);
+          MetaWindowActor *window_actor = META_WINDOW_ACTOR (child);
+          cairo_region_t *region;
+
+          if (!entry->untransformed)
+            continue;
+
+          region = clip_region (entry->visible, &visible_rect, entry->x, entry->y);
+          meta_window_actor_set_visible_region (window_actor, region);
+          cairo_region_destroy (region);
+
+          region = clip_region (entry->beneath, &visible_rect, entry->x, entry->y);
+          meta_window_actor_set_visible_region_beneath (window_actor, region);
+          cairo_region_destroy (region);
+        }
+      else
+        {
+          MetaBackgroundActor *background_actor = META_BACKGROUND_ACTOR (child);
+          cairo_region_t *region;
+
+          region = clip_region (entry->visible, &visible_rect, 0, 0);
+          meta_background_actor_set_visible_region (background_actor, region);
+          cairo_region_destroy (region);
         }
     }
 
-  cairo_region_destroy (visible_region);
+  cairo_region_destroy (unobscured_region);
+
+  /* Drop entries for actors that are no longer visible at the bottom
+   * of the stack */
+  truncate_entries (window_group, n_entries);
 
   CLUTTER_ACTOR_CLASS (meta_window_group_parent_class)->paint (actor);
 
@@ -187,17 +346,32 @@ meta_window_group_paint (ClutterActor *actor)
   g_list_free (children);
 }
 
+static void
+meta_window_group_finalize (GObject *object)
+{
+  MetaWindowGroup *window_group = META_WINDOW_GROUP (object);
+
+  truncate_entries (window_group, 0);
+  g_array_free (window_group->entries, TRUE);
+
+  G_OBJECT_CLASS (meta_window_group_parent_class)->finalize (object);
+}
+
 static void
 meta_window_group_class_init (MetaWindowGroupClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   ClutterActorClass *actor_class = CLUTTER_ACTOR_CLASS (klass);
 
+  object_class->finalize = meta_window_group_finalize;
+
   actor_class->paint = meta_window_group_paint;
 }
 
 static void
 meta_window_group_init (MetaWindowGroup *window_group)
 {
+  window_group->entries = g_array_new (FALSE, FALSE, sizeof (MetaWindowGroupEntry));
 }
 
 ClutterActor *
@@ -211,3 +385,26 @@ meta_window_group_new (MetaScreen *screen)
 
   return CLUTTER_ACTOR (window_group);
 }
+
+/**
+ * meta_window_group_get_occlusion_stats:
+ * @window_group: a #MetaWindowGroup
+ * @n_recomputed: (out) (allow-none): location to store the number of actors
+ *   whose visible region was recomputed in the last paint
+ * @n_reused: (out) (allow-none): location to store the number of actors
+ *   whose cached visible region was reused in the last paint
+ *
+ * Gets statistics about the occlusion cache for the most recent paint.
+ */
+void
+meta_window_group_get_occlusion_stats (MetaWindowGroup *window_group,
+                                       guint           *n_recomputed,
+                                       guint           *n_reused)
+{
+  g_return_if_fail (META_IS_WINDOW_GROUP (window_group));
+
+  if (n_recomputed)
+    *n_recomputed = window_group->n_recomputed;
+  if (n_reused)
+    *n_reused = window_group->n_reused;
+}
@@ -49,4 +49,8 @@ GType meta_window_group_get_type (void);
 
 ClutterActor *meta_window_group_new (MetaScreen *screen);
 
+void meta_window_group_get_occlusion_stats (MetaWindowGroup *window_group,
+                                            guint           *n_recomputed,
+                                            guint           *n_reused);
+
 #endif /* META_WINDOW_GROUP_H */
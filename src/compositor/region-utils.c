@@ -23,6 +23,11 @@
 #include "region-utils.h"
 
 #include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /* MetaRegionBuilder */
 
@@ -328,3 +333,176 @@ meta_make_border_region (cairo_region_t *region,
 
   return border_region;
 }
+
+/* Returns the first position in [x, x_end) where the mask byte is
+ * zero if @in_run is set, or non-zero otherwise; x_end if there is none */
+static int
+scan_mask_row (const guchar *row,
+               int           x,
+               int           x_end,
+               gboolean      in_run)
+{
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128 ();
+
+  /* Test 16 bytes at a time; in the common case of long runs of
+   * fully transparent or fully opaque pixels we skip right over them */
+  for (; x + 16 <= x_end; x += 16)
+    {
+      __m128i bytes = _mm_loadu_si128 ((const __m128i *)(row + x));
+      guint zero_bits = _mm_movemask_epi8 (_mm_cmpeq_epi8 (bytes, zero));
+      guint bits = in_run ? zero_bits : (~zero_bits & 0xffff);
+
+      if (bits != 0)
+        return x + g_bit_nth_lsf (bits, -1);
+    }
+#endif
+
+  for (; x < x_end; x++)
+    if ((row[x] != 0) != in_run)
+      return x;
+
+  return x_end;
+}
+
+/* Finds the runs of non-zero bytes of a row within a horizontal band of
+ * rectangles; stores the start and end of each run in @runs and returns
+ * the number of values stored */
+static int
+find_mask_row_runs (const guchar          *row,
+                    cairo_rectangle_int_t *band,
+                    int                    n_band_rects,
+                    int                   *runs)
+{
+  int n_runs = 0;
+  int i;
+
+  for (i = 0; i < n_band_rects; i++)
+    {
+      int x = band[i].x;
+      int x_end = band[i].x + band[i].width;
+
+      while (x < x_end)
+        {
+          x = scan_mask_row (row, x, x_end, FALSE);
+          if (x == x_end)
+            break;
+
+          runs[n_runs++] = x;
+          x = scan_mask_row (row, x, x_end, TRUE);
+          runs[n_runs++] = x;
+        }
+    }
+
+  return n_runs;
+}
+
+static void
+add_mask_runs (MetaRegionBuilder *builder,
+               int               *runs,
+               int                n_runs,
+               int                y,
+               int                height)
+{
+  int i;
+
+  for (i = 0; i < n_runs; i += 2)
+    meta_region_builder_add_rectangle (builder,
+                                       runs[i], y,
+                                       runs[i + 1] - runs[i], height);
+}
+
+/**
+ * meta_make_region_from_mask:
+ * @mask: 8-bit mask data
+ * @stride: rowstride of @mask
+ * @area: the area of @mask to scan
+ *
+ * Computes the region covered by the non-zero pixels of @mask within
+ * @area, which must lie entirely inside the mask. Rather than adding
+ * each run of pixels separately, runs are found a row at a time, and
+ * rows with the same runs as the row above extend the rectangles for
+ * that row downwards, so mostly rectangular shapes such as frames with
+ * rounded corners produce few rectangles.
+ *
+ * Return value: a new region
+ */
+cairo_region_t *
+meta_make_region_from_mask (const guchar   *mask,
+                            int             stride,
+                            cairo_region_t *area)
+{
+  MetaRegionBuilder builder;
+  cairo_rectangle_int_t extents;
+  cairo_rectangle_int_t *rects;
+  int *runs, *last_runs;
+  int n_rects;
+  int i;
+
+  meta_region_builder_init (&builder);
+
+  n_rects = cairo_region_num_rectangles (area);
+  if (n_rects == 0)
+    return meta_region_builder_finish (&builder);
+
+  rects = g_new (cairo_rectangle_int_t, n_rects);
+  for (i = 0; i < n_rects; i++)
+    cairo_region_get_rectangle (area, i, &rects[i]);
+
+  /* A run takes at least two pixels, counting the gap after it,
+   * except at the end of each rectangle */
+  cairo_region_get_extents (area, &extents);
+  runs = g_new (int, extents.width + n_rects + 1);
+  last_runs = g_new (int, extents.width + n_rects + 1);
+
+  i = 0;
+  while (i < n_rects)
+    {
+      cairo_rectangle_int_t *band = &rects[i];
+      int n_band_rects = 0;
+      int n_last_runs = 0;
+      int last_y;
+      int y;
+
+      /* cairo regions are y-x banded; all the rectangles in a band
+       * have the same vertical extents */
+      while (i + n_band_rects < n_rects &&
+             rects[i + n_band_rects].y == band->y)
+        n_band_rects++;
+
+      last_y = band->y;
+      for (y = band->y; y < band->y + band->height; y++)
+        {
+          int n_runs = find_mask_row_runs (mask + y * stride,
+                                           band, n_band_rects, runs);
+
+          if (y > band->y &&
+              (n_runs != n_last_runs ||
+               memcmp (runs, last_runs, n_runs * sizeof (int)) != 0))
+            {
+              add_mask_runs (&builder, last_runs, n_last_runs,
+                             last_y, y - last_y);
+              last_y = y;
+            }
+
+          if (y == last_y)
+            {
+              int *tmp = last_runs;
+              last_runs = runs;
+              runs = tmp;
+              n_last_runs = n_runs;
+            }
+        }
+
+      add_mask_runs (&builder, last_runs, n_last_runs,
+                     last_y, band->y + band->height - last_y);
+
+      i += n_band_rects;
+    }
+
+  g_free (rects);
+  g_free (runs);
+  g_free (last_runs);
+
+  return meta_region_builder_finish (&builder);
+}
@@ -73,4 +73,8 @@ cairo_region_t *meta_make_border_region (cairo_region_t *region,
                                          int             y_amount,
                                          gboolean        flip);
 
+cairo_region_t *meta_make_region_from_mask (const guchar   *mask,
+                                            int             stride,
+                                            cairo_region_t *area);
+
 #endif /* __META_REGION_UTILS_H__ */
@@ -0,0 +1,246 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Mutter actor restacking testing and benchmarking program */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "clutter-utils.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_RANDOM_RUNS 500
+
+/* How long to run each benchmark for, in seconds */
+#define BENCHMARK_TIME 2.0
+
+#define N_ACTORS 300
+
+/* Actors in the group that aren't in the list we restack, like the
+ * actors plugins add to the window group */
+#define N_OTHER_ACTORS 5
+
+static ClutterActor *
+create_group (ClutterActor **actors,
+              int            n_actors,
+              ClutterActor **others,
+              int            n_others)
+{
+  ClutterActor *group = clutter_group_new ();
+  int i;
+
+  for (i = 0; i < n_actors; i++)
+    {
+      actors[i] = clutter_rectangle_new ();
+      clutter_container_add_actor (CLUTTER_CONTAINER (group), actors[i]);
+    }
+
+  for (i = 0; i < n_others; i++)
+    {
+      others[i] = clutter_rectangle_new ();
+      clutter_container_add_actor (CLUTTER_CONTAINER (group), others[i]);
+    }
+
+  return group;
+}
+
+static void
+shuffle_children (ClutterActor *group)
+{
+  GList *children, *l;
+
+  children = clutter_container_get_children (CLUTTER_CONTAINER (group));
+  for (l = children; l; l = l->next)
+    {
+      int n = g_random_int_range (0, 4);
+
+      if (n == 0)
+        clutter_actor_lower_bottom (l->data);
+      else if (n == 1)
+        clutter_actor_raise_top (l->data);
+    }
+
+  g_list_free (children);
+}
+
+/* Length of the longest increasing subsequence, the slow way */
+static int
+longest_increasing (const int *values,
+                    int        n_values)
+{
+  int *lengths = g_new (int, n_values);
+  int best = 0;
+  int i, j;
+
+  for (i = 0; i < n_values; i++)
+    {
+      lengths[i] = 1;
+      for (j = 0; j < i; j++)
+        if (values[j] < values[i] && lengths[j] + 1 > lengths[i])
+          lengths[i] = lengths[j] + 1;
+      best = MAX (best, lengths[i]);
+    }
+
+  g_free (lengths);
+
+  return best;
+}
+
+static void
+test_restack (void)
+{
+  ClutterActor *actors[N_ACTORS];
+  ClutterActor *others[N_OTHER_ACTORS];
+  ClutterActor *group;
+  int run;
+
+  group = create_group (actors, N_ACTORS, others, N_OTHER_ACTORS);
+
+  for (run = 0; run < NUM_RANDOM_RUNS; run++)
+    {
+      GList *stack = NULL;
+      GList *children, *before, *l, *c;
+      int positions[N_ACTORS];
+      int n_moved, i;
+
+      shuffle_children (group);
+
+      for (i = 0; i < N_ACTORS; i++)
+        if (g_random_int_range (0, 10) != 0)
+          stack = g_list_insert (stack, actors[i],
+                                 g_random_int_range (0, i + 1));
+
+      before = clutter_container_get_children (CLUTTER_CONTAINER (group));
+      for (l = stack, i = 0; l; l = l->next, i++)
+        positions[i] = g_list_index (before, l->data);
+
+      n_moved = meta_restack_actors (CLUTTER_CONTAINER (group), stack);
+
+      g_assert (n_moved == i - longest_increasing (positions, i));
+
+      children = clutter_container_get_children (CLUTTER_CONTAINER (group));
+
+      /* The restacked actors are in order */
+      l = stack;
+      for (c = children; c; c = c->next)
+        if (l && c->data == l->data)
+          l = l->next;
+      g_assert (l == NULL);
+
+      /* Actors we didn't ask about haven't moved relative to each other */
+      c = children;
+      for (l = before; l; l = l->next)
+        {
+          if (g_list_find (stack, l->data))
+            continue;
+
+          while (c && g_list_find (stack, c->data))
+            c = c->next;
+          g_assert (c && c->data == l->data);
+          c = c->next;
+        }
+
+      g_list_free (before);
+      g_list_free (children);
+      g_list_free (stack);
+    }
+
+  clutter_actor_destroy (group);
+
+  printf ("Actors restack correctly.\n");
+}
+
+/* What sync_actor_stacking() used to do */
+static void
+restack_all (GList *stack)
+{
+  GList *l;
+
+  for (l = g_list_last (stack); l; l = l->prev)
+    clutter_actor_lower_bottom (l->data);
+}
+
+static void
+benchmark_raise (gboolean minimal)
+{
+  ClutterActor *actors[N_ACTORS];
+  ClutterActor *others[N_OTHER_ACTORS];
+  ClutterActor *group;
+  GList *stack = NULL;
+  GTimer *timer;
+  double elapsed;
+  int n_runs, n_moved, i;
+
+  group = create_group (actors, N_ACTORS, others, N_OTHER_ACTORS);
+
+  for (i = N_ACTORS - 1; i >= 0; i--)
+    stack = g_list_prepend (stack, actors[i]);
+
+  timer = g_timer_new ();
+  n_runs = 0;
+  n_moved = 0;
+  do
+    {
+      /* Raise a random window to the top of the stack */
+      GList *link = g_list_nth (stack, g_random_int_range (0, N_ACTORS));
+
+      stack = g_list_remove_link (stack, link);
+      stack = g_list_concat (stack, link);
+
+      if (minimal)
+        n_moved += meta_restack_actors (CLUTTER_CONTAINER (group), stack);
+      else
+        {
+          restack_all (stack);
+          n_moved += N_ACTORS;
+        }
+
+      n_runs++;
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  printf ("%d actors, %s: %.1f raises per second, %.1f actors moved per raise\n",
+          N_ACTORS, minimal ? "minimal moves" : "restacking everything",
+          n_runs / elapsed, n_moved / (double) n_runs);
+
+  g_timer_destroy (timer);
+  g_list_free (stack);
+  clutter_actor_destroy (group);
+}
+
+int
+main (int argc, char **argv)
+{
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    {
+      printf ("Can't initialize Clutter, skipping.\n");
+      return 0;
+    }
+
+  test_restack ();
+
+  if (argc > 1 && strcmp (argv[1], "--benchmark") == 0)
+    {
+      benchmark_raise (FALSE);
+      benchmark_raise (TRUE);
+    }
+
+  return 0;
+}
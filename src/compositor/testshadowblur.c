@@ -0,0 +1,222 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Mutter shadow blur testing and benchmarking program */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "meta-shadow-factory-private.h"
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* How long to run each benchmark for, in seconds */
+#define BENCHMARK_TIME 0.5
+
+static const char *impl_names[] = {
+  "auto", "scalar", "sse2", "avx2"
+};
+
+/* A window shape with rounded top corners, like most themes produce */
+static cairo_region_t *
+make_window_region (int width,
+                    int height,
+                    int corner_radius)
+{
+  cairo_region_t *region;
+  cairo_rectangle_int_t rect;
+  int i;
+
+  rect.x = 0;
+  rect.y = corner_radius;
+  rect.width = width;
+  rect.height = height - corner_radius;
+  region = cairo_region_create_rectangle (&rect);
+
+  for (i = 0; i < corner_radius; i++)
+    {
+      int inset = corner_radius - (int)(0.5 + sqrt (corner_radius * corner_radius -
+                                                     (corner_radius - i) * (corner_radius - i)));
+
+      rect.x = inset;
+      rect.y = i;
+      rect.width = width - 2 * inset;
+      rect.height = 1;
+      cairo_region_union_rectangle (region, &rect);
+    }
+
+  return region;
+}
+
+/* An irregular region, to exercise the handling of multiple
+ * rectangles in the convolve regions */
+static cairo_region_t *
+make_random_region (int width,
+                    int height)
+{
+  cairo_region_t *region = cairo_region_create ();
+  int i;
+
+  for (i = 0; i < 20; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      rect.x = g_random_int_range (0, width);
+      rect.y = g_random_int_range (0, height);
+      rect.width = g_random_int_range (1, width - rect.x + 1);
+      rect.height = g_random_int_range (1, height - rect.y + 1);
+      cairo_region_union_rectangle (region, &rect);
+    }
+
+  return region;
+}
+
+static void
+check_region (cairo_region_t *region,
+              int             radius)
+{
+  guchar *expected;
+  int expected_width, expected_height;
+  MetaShadowBlurImpl impl;
+
+  expected = meta_shadow_blur_region (region, radius, META_SHADOW_BLUR_SCALAR,
+                                      &expected_width, &expected_height);
+
+  for (impl = META_SHADOW_BLUR_SSE2; impl <= META_SHADOW_BLUR_AVX2; impl++)
+    {
+      guchar *buffer;
+      int width, height;
+
+      if (!meta_shadow_blur_impl_supported (impl))
+        continue;
+
+      buffer = meta_shadow_blur_region (region, radius, impl, &width, &height);
+
+      g_assert (width == expected_width && height == expected_height);
+      if (memcmp (buffer, expected, width * height) != 0)
+        {
+          g_printerr ("%s blur differs from scalar blur for radius %d\n",
+                      impl_names[impl], radius);
+          exit (1);
+        }
+
+      g_free (buffer);
+    }
+
+  g_free (expected);
+}
+
+static void
+test_blur_identical (void)
+{
+  int radius;
+
+  for (radius = 1; radius <= 160; radius += (radius < 16 ? 1 : 9))
+    {
+      cairo_region_t *region;
+
+      region = make_window_region (g_random_int_range (1, 400),
+                                   g_random_int_range (8, 400),
+                                   g_random_int_range (0, 8));
+      check_region (region, radius);
+      cairo_region_destroy (region);
+
+      region = make_random_region (g_random_int_range (1, 300),
+                                   g_random_int_range (1, 300));
+      check_region (region, radius);
+      cairo_region_destroy (region);
+    }
+
+  printf ("Shadow blur implementations produce identical output.\n");
+}
+
+static double
+benchmark_blur (cairo_region_t     *region,
+                int                 radius,
+                MetaShadowBlurImpl  impl)
+{
+  GTimer *timer = g_timer_new ();
+  int n_shadows = 0;
+  double elapsed;
+
+  do
+    {
+      guchar *buffer;
+      int width, height;
+
+      buffer = meta_shadow_blur_region (region, radius, impl, &width, &height);
+      g_free (buffer);
+
+      n_shadows++;
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  g_timer_destroy (timer);
+
+  return n_shadows / elapsed;
+}
+
+static void
+benchmark_shape (const char     *name,
+                 cairo_region_t *region)
+{
+  static const int radii[] = { 1, 3, 6, 12, 24, 48 };
+  MetaShadowBlurImpl impl;
+  guint i;
+
+  printf ("\n%s (shadows per second)\n", name);
+  printf ("%8s", "radius");
+  for (impl = META_SHADOW_BLUR_SCALAR; impl <= META_SHADOW_BLUR_AVX2; impl++)
+    if (meta_shadow_blur_impl_supported (impl))
+      printf (" %10s", impl_names[impl]);
+  printf ("\n");
+
+  for (i = 0; i < G_N_ELEMENTS (radii); i++)
+    {
+      printf ("%8d", radii[i]);
+      for (impl = META_SHADOW_BLUR_SCALAR; impl <= META_SHADOW_BLUR_AVX2; impl++)
+        if (meta_shadow_blur_impl_supported (impl))
+          printf (" %10.0f", benchmark_blur (region, radii[i], impl));
+      printf ("\n");
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  cairo_region_t *region;
+
+  test_blur_identical ();
+
+  if (argc > 1 && strcmp (argv[1], "--benchmark") == 0)
+    {
+      /* The size-invariant shape used for 9-sliced shadows */
+      region = make_window_region (20, 20, 6);
+      benchmark_shape ("9-sliced window shape", region);
+      cairo_region_destroy (region);
+
+      /* A shadow too small to 9-slice is made at full size */
+      region = make_window_region (640, 480, 6);
+      benchmark_shape ("640x480 window", region);
+      cairo_region_destroy (region);
+    }
+
+  return 0;
+}
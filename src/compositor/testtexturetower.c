@@ -0,0 +1,135 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Mutter texture tower scaling testing and benchmarking program */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "meta-texture-tower.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_RANDOM_RUNS 1000
+
+/* How long to run the benchmark for, in seconds */
+#define BENCHMARK_TIME 2.0
+
+#define AVERAGE(a, b) (((a) + (b) + 1) >> 1)
+
+static void
+test_scale_down (void)
+{
+  int run;
+
+  for (run = 0; run < NUM_RANDOM_RUNS; run++)
+    {
+      int width = g_random_int_range (1, 100);
+      int height = g_random_int_range (1, 50);
+      gboolean scale_x = g_random_boolean ();
+      gboolean scale_y = g_random_boolean ();
+      int dest_width = scale_x ? width / 2 : width;
+      int dest_height = scale_y ? height / 2 : height;
+      guchar *source, *data;
+      int x, y, c;
+
+      source = g_malloc (width * height * 4);
+      for (x = 0; x < width * height * 4; x++)
+        source[x] = g_random_int_range (0, 256);
+
+      data = g_memdup (source, width * height * 4);
+      meta_texture_tower_scale_down (data, width, height, scale_x, scale_y);
+
+      for (y = 0; y < dest_height; y++)
+        for (x = 0; x < dest_width; x++)
+          for (c = 0; c < 4; c++)
+            {
+              int x1 = scale_x ? 2 * x : x;
+              int x2 = scale_x ? 2 * x + 1 : x;
+              int y1 = scale_y ? 2 * y : y;
+              int y2 = scale_y ? 2 * y + 1 : y;
+              int expected;
+
+#define PIXEL(px, py) source[((py) * width + (px)) * 4 + c]
+              expected = AVERAGE (AVERAGE (PIXEL (x1, y1), PIXEL (x1, y2)),
+                                  AVERAGE (PIXEL (x2, y1), PIXEL (x2, y2)));
+#undef PIXEL
+
+              g_assert (data[(y * dest_width + x) * 4 + c] == expected);
+            }
+
+      g_free (source);
+      g_free (data);
+    }
+
+  printf ("Scaling down produces the expected results.\n");
+}
+
+/* Builds a full tower from a 4K window each time; the copy stands in
+ * for downloading the base level from the texture */
+static void
+benchmark_scale_down (void)
+{
+  const int width = 3840;
+  const int height = 2160;
+  GTimer *timer = g_timer_new ();
+  guchar *base, *data;
+  int n_levels = 0;
+  double elapsed;
+
+  base = g_malloc (width * height * 4);
+  data = g_malloc (width * height * 4);
+  memset (base, 0x80, width * height * 4);
+
+  do
+    {
+      int level_width = width;
+      int level_height = height;
+
+      memcpy (data, base, width * height * 4);
+
+      while (level_width > 1 || level_height > 1)
+        {
+          meta_texture_tower_scale_down (data, level_width, level_height,
+                                         level_width > 1, level_height > 1);
+          level_width = MAX (1, level_width / 2);
+          level_height = MAX (1, level_height / 2);
+          n_levels++;
+        }
+
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  printf ("%dx%d: %.1f levels per second\n", width, height, n_levels / elapsed);
+
+  g_timer_destroy (timer);
+  g_free (base);
+  g_free (data);
+}
+
+int
+main (int argc, char **argv)
+{
+  test_scale_down ();
+
+  if (argc > 1 && strcmp (argv[1], "--benchmark") == 0)
+    benchmark_scale_down ();
+
+  return 0;
+}
@@ -40,10 +40,24 @@ typedef enum
   FIXED_DIRECTION_Y    = 1 << 1,
 } FixedDirections;
 
+/* A MetaRegion is a spanning set (see
+ * meta_rectangle_get_minimal_spanning_set_for_region() below) kept as one
+ * contiguous array of rectangles, in the same order as the list version,
+ * rather than as a list of separately allocated ones.  Workspaces keep
+ * their onscreen and per-monitor regions in this form since the
+ * constraints code walks them on every move and resize.
+ */
+typedef struct _MetaRegion MetaRegion;
+struct _MetaRegion
+{
+  MetaRectangle *rects;
+  int            n_rects;
+};
+
 /* Output functions -- note that the output buffer had better be big enough:
  *   rect_to_string:   RECT_LENGTH
  *   region_to_string: (RECT_LENGTH+strlen(separator_string)) *
- *                     g_list_length (region)
+ *                     g_list_length (region)  (or region->n_rects)
  *   edge_to_string:   EDGE_LENGTH
  *   edge_list_to_...: (EDGE_LENGTH+strlen(separator_string)) * 
  *                     g_list_length (edge_list)
@@ -55,6 +69,9 @@ char* meta_rectangle_to_string        (const MetaRectangle *rect,
 char* meta_rectangle_region_to_string (GList               *region,
                                        const char          *separator_string,
                                        char                *output);
+char* meta_region_to_string           (const MetaRegion    *region,
+                                       const char          *separator_string,
+                                       char                *output);
 char* meta_rectangle_edge_to_string   (const MetaEdge      *edge,
                                        char                *output);
 char* meta_rectangle_edge_list_to_string (
@@ -90,6 +107,15 @@ GList*   meta_rectangle_get_minimal_spanning_set_for_region (
                                          const MetaRectangle *basic_rect,
                                          const GSList        *all_struts);
 
+/* The same spanning set as a MetaRegion, and the functions to create and
+ * free those; meta_region_new() copies n_rects rects from rects.
+ */
+MetaRegion* meta_region_new_spanning_set (const MetaRectangle *basic_rect,
+                                          const GSList        *all_struts);
+MetaRegion* meta_region_new              (const MetaRectangle *rects,
+                                          int                  n_rects);
+void        meta_region_free             (MetaRegion          *region);
+
 /* Expand all rectangles in region by the given amount on each side */
 GList*   meta_rectangle_expand_region   (GList               *region,
                                          const int            left_expand,
@@ -108,6 +134,20 @@ GList*   meta_rectangle_expand_region_conditionally (
                                          const int            min_x,
                                          const int            min_y);
 
+void     meta_region_expand             (MetaRegion          *region,
+                                         const int            left_expand,
+                                         const int            right_expand,
+                                         const int            top_expand,
+                                         const int            bottom_expand);
+void     meta_region_expand_conditionally (
+                                         MetaRegion          *region,
+                                         const int            left_expand,
+                                         const int            right_expand,
+                                         const int            top_expand,
+                                         const int            bottom_expand,
+                                         const int            min_x,
+                                         const int            min_y);
+
 /* Expand rect in direction to the size of expand_to, and then clip out any
  * overlapping struts oriented orthognal to the expansion direction.  (Think
  * horizontal or vertical maximization)
@@ -140,6 +180,12 @@ gboolean meta_rectangle_contained_in_region (
 gboolean meta_rectangle_overlaps_with_region (
                                          const GList         *spanning_rects,
                                          const MetaRectangle *rect);
+gboolean meta_region_could_fit_rect     (const MetaRegion    *region,
+                                         const MetaRectangle *rect);
+gboolean meta_region_contains_rect      (const MetaRegion    *region,
+                                         const MetaRectangle *rect);
+gboolean meta_region_overlaps_rect      (const MetaRegion    *region,
+                                         const MetaRectangle *rect);
 
 /* Make the rectangle small enough to fit into one of the spanning_rects,
  * but make it no smaller than min_size.
@@ -149,6 +195,10 @@ void     meta_rectangle_clamp_to_fit_into_region (
                                          FixedDirections      fixed_directions,
                                          MetaRectangle       *rect,
                                          const MetaRectangle *min_size);
+void     meta_region_clamp_rect_to_fit  (const MetaRegion    *region,
+                                         FixedDirections      fixed_directions,
+                                         MetaRectangle       *rect,
+                                         const MetaRectangle *min_size);
 
 /* Clip the rectangle so that it fits into one of the spanning_rects, assuming
  * it overlaps with at least one of them
@@ -156,6 +206,9 @@ void     meta_rectangle_clamp_to_fit_into_region (
 void     meta_rectangle_clip_to_region  (const GList         *spanning_rects,
                                          FixedDirections      fixed_directions,
                                          MetaRectangle       *rect);
+void     meta_region_clip_rect          (const MetaRegion    *region,
+                                         FixedDirections      fixed_directions,
+                                         MetaRectangle       *rect);
 
 /* Shove the rectangle into one of the spanning_rects, assuming it fits in
  * one of them.
@@ -164,6 +217,9 @@ void     meta_rectangle_shove_into_region(
                                          const GList         *spanning_rects,
                                          FixedDirections      fixed_directions,
                                          MetaRectangle       *rect);
+void     meta_region_shove_rect         (const MetaRegion    *region,
+                                         FixedDirections      fixed_directions,
+                                         MetaRectangle       *rect);
 
 /* Finds the point on the line connecting (x1,y1) to (x2,y2) which is closest
  * to (px, py).  Useful for finding an optimal rectangle size when given a
@@ -29,6 +29,7 @@
 #include "boxes-private.h"
 #include <meta/util.h>
 #include <X11/Xutil.h>  /* Just for the definition of the various gravities */
+#include <string.h>
 
 /* It would make sense to use GSlice here, but until we clean up the
  * rest of this file and the internal API to use these functions, we
@@ -105,6 +106,33 @@ meta_rectangle_region_to_string (GList      *region,
   return output;
 }
 
+char*
+meta_region_to_string (const MetaRegion *region,
+                       const char       *separator_string,
+                       char             *output)
+{
+  /* Same format as meta_rectangle_region_to_string() */
+  char rect_string[RECT_LENGTH];
+
+  char *cur = output;
+  int i;
+
+  if (region->n_rects == 0)
+    g_snprintf (output, 10, "(EMPTY)");
+
+  for (i = 0; i < region->n_rects; i++)
+    {
+      const MetaRectangle *rect = &region->rects[i];
+      g_snprintf (rect_string, RECT_LENGTH, "[%d,%d +%d,%d]", 
+                  rect->x, rect->y, rect->width, rect->height);
+      cur = g_stpcpy (cur, rect_string);
+      if (i + 1 < region->n_rects)
+        cur = g_stpcpy (cur, separator_string);
+    }
+
+  return output;
+}
+
 char*
 meta_rectangle_edge_to_string (const MetaEdge *edge,
                                char           *output)
@@ -421,127 +449,301 @@ meta_rectangle_resize_with_gravity (const MetaRectangle *old_rect,
   rect->height = new_height;
 }
 
-/* Not so simple helper function for get_minimal_spanning_set_for_region() */
-static GList*
-merge_spanning_rects_in_region (GList *region)
+/* Scratch space for the spanning set code below.  Allocating from it is
+ * just a bump of the used count and everything is released at once by
+ * resetting it, so computing a spanning set no longer costs a g_malloc()
+ * per intermediate rectangle; the block itself is kept for the next
+ * caller.  It can move when it grows, so callers hold on to offsets into
+ * it rather than pointers.
+ */
+typedef struct
+{
+  MetaRectangle *rects;
+  int            used;
+  int            size;
+} RectArena;
+
+static RectArena scratch_arena = { NULL, 0, 0 };
+
+static int
+rect_arena_alloc (RectArena *arena,
+                  int        n_rects)
+{
+  int offset = arena->used;
+
+  if (arena->used + n_rects > arena->size)
+    {
+      arena->size = MAX (MAX (2 * arena->size, arena->used + n_rects), 64);
+      arena->rects = g_renew (MetaRectangle, arena->rects, arena->size);
+    }
+
+  arena->used += n_rects;
+  return offset;
+}
+
+static void
+rect_arena_reset (RectArena *arena)
+{
+  arena->used = 0;
+}
+
+/* Merges b into a if possible; returns whether b is no longer needed */
+static gboolean
+merge_spanning_rects (MetaRectangle       *a,
+                      const MetaRectangle *b)
+{
+  g_assert (b->width > 0 && b->height > 0);
+
+  /* If a contains b, just remove b.  The rects are sorted by decreasing
+   * area (and a only grows), so b can only contain a if they're equal.
+   */
+  if (meta_rectangle_contains_rect (a, b))
+    return TRUE;
+  /* If a and b might be mergeable horizontally */
+  else if (a->y == b->y && a->height == b->height)
+    {
+      /* If a and b overlap or are adjacent */
+      if (meta_rectangle_overlap (a, b) ||
+          a->x + a->width == b->x || a->x == b->x + b->width)
+        {
+          int new_x = MIN (a->x, b->x);
+          a->width = MAX (a->x + a->width, b->x + b->width) - new_x;
+          a->x = new_x;
+          return TRUE;
+        }
+    }
+  /* If a and b might be mergeable vertically */
+  else if (a->x == b->x && a->width == b->width)
+    {
+      /* If a and b overlap or are adjacent */
+      if (meta_rectangle_overlap (a, b) ||
+          a->y + a->height == b->y || a->y == b->y + b->height)
+        {
+          int new_y = MIN (a->y, b->y);
+          a->height = MAX (a->y + a->height, b->y + b->height) - new_y;
+          a->y = new_y;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/* Not so simple helper function for get_minimal_spanning_set_for_region();
+ * merges rects in place and returns how many are left.
+ */
+static int
+merge_spanning_rects_in_region (MetaRectangle *rects,
+                                int            n_rects)
 {
   /* NOTE FOR ANY OPTIMIZATION PEOPLE OUT THERE: Please see the
    * documentation of get_minimal_spanning_set_for_region() for performance
    * considerations that also apply to this function.
    */
 
-  GList* compare;
-  compare = region;
+  int i, j;
 
-  if (region == NULL)
+  if (n_rects == 0)
     {
       meta_warning ("Region to merge was empty!  Either you have a some "
                     "pathological STRUT list or there's a bug somewhere!\n");
-      return NULL;
+      return 0;
     }
 
-  while (compare && compare->next)
+  for (i = 0; i + 1 < n_rects; i++)
     {
-      MetaRectangle *a = compare->data;
-      GList *other = compare->next;
+      MetaRectangle *a = &rects[i];
+      int n_kept = i + 1;
 
       g_assert (a->width > 0 && a->height > 0);
 
-      while (other)
+      /* Compact the rects that survive being compared against a */
+      for (j = i + 1; j < n_rects; j++)
         {
-          MetaRectangle *b = other->data;
-          GList *delete_me = NULL;
+          if (!merge_spanning_rects (a, &rects[j]))
+            rects[n_kept++] = rects[j];
+        }
+
+      n_rects = n_kept;
+    }
 
-          g_assert (b->width > 0 && b->height > 0);
+  return n_rects;
+}
 
-          /* If a contains b, just remove b */
-          if (meta_rectangle_contains_rect (a, b))
+/* Simple helper function for get_minimal_spanning_set_for_region()... */
+static gint
+compare_rect_areas (gconstpointer a, gconstpointer b)
+{
+  const MetaRectangle *a_rect = (gconstpointer) a;
+  const MetaRectangle *b_rect = (gconstpointer) b;
+
+  int a_area = meta_rectangle_area (a_rect);
+  int b_area = meta_rectangle_area (b_rect);
+
+  return b_area - a_area; /* positive ret value denotes b > a, ... */
+}
+
+/* Stable merge sort of rects by compare_rect_areas(), in the same order
+ * g_list_sort() used to leave them in; tmp must hold n_rects rects.
+ */
+static void
+sort_rects_by_area (MetaRectangle *rects,
+                    MetaRectangle *tmp,
+                    int            n_rects)
+{
+  int width, start;
+
+  for (width = 1; width < n_rects; width *= 2)
+    {
+      for (start = 0; start < n_rects; start += 2 * width)
+        {
+          int mid = MIN (start + width, n_rects);
+          int end = MIN (start + 2 * width, n_rects);
+          int left = start, right = mid, out = start;
+
+          while (left < mid && right < end)
             {
-              delete_me = other;
+              if (compare_rect_areas (&rects[left], &rects[right]) > 0)
+                tmp[out++] = rects[right++];
+              else
+                tmp[out++] = rects[left++];
             }
-          /* If b contains a, just remove a */
-          else if (meta_rectangle_contains_rect (a, b))
+          while (left < mid)
+            tmp[out++] = rects[left++];
+          while (right < end)
+            tmp[out++] = rects[right++];
+        }
+
+      memcpy (rects, tmp, n_rects * sizeof (MetaRectangle));
+    }
+}
+
+/* Does the work for get_minimal_spanning_set_for_region() in
+ * scratch_arena; the spanning set is left at the start of the arena and
+ * the number of rects in it is returned.
+ */
+static int
+compute_spanning_set (const MetaRectangle *basic_rect,
+                      const GSList        *all_struts)
+{
+  RectArena     *arena = &scratch_arena;
+  const GSList  *strut_iter;
+  int            n_rects, tmp;
+  gboolean       reversed;
+
+  /* The algorithm is basically as follows:
+   *   Initialize rectangle_set to basic_rect
+   *   Foreach strut:
+   *     Foreach rectangle in rectangle_set:
+   *       - Split the rectangle into new rectangles that don't overlap the
+   *         strut (but which are as big as possible otherwise)
+   *       - Remove the old (pre-split) rectangle from the rectangle_set,
+   *         and replace it with the new rectangles generated from the
+   *         splitting
+   *
+   * The set is kept at the start of the arena, with the split rects
+   * written after it and then moved down.  Each pass walks the set in
+   * order and the list version prepended what it generated, so the set
+   * changes direction on every pass; "reversed" tracks that instead of
+   * copying, so the output order is the same as it has always been.
+   */
+
+  rect_arena_reset (arena);
+  rect_arena_alloc (arena, 1);
+  arena->rects[0] = *basic_rect;
+  n_rects = 1;
+  reversed = FALSE;
+
+  for (strut_iter = all_struts; strut_iter; strut_iter = strut_iter->next)
+    {
+      const MetaRectangle *strut_rect = &((MetaStrut*)strut_iter->data)->rect;
+      MetaRectangle *rects, *split;
+      int            split_start, n_split, i;
+
+      /* A strut missing basic_rect can't split anything */
+      if (!meta_rectangle_overlap (basic_rect, strut_rect))
+        {
+          reversed = !reversed;
+          continue;
+        }
+
+      split_start = rect_arena_alloc (arena, 4 * n_rects);
+      rects = arena->rects;
+      split = arena->rects + split_start;
+      n_split = 0;
+
+      for (i = 0; i < n_rects; i++)
+        {
+          const MetaRectangle *rect = &rects[reversed ? n_rects - 1 - i : i];
+
+          if (!meta_rectangle_overlap (rect, strut_rect))
             {
-              delete_me = compare;
+              split[n_split++] = *rect;
+              continue;
             }
-          /* If a and b might be mergeable horizontally */
-          else if (a->y == b->y && a->height == b->height)
+
+          /* If there is area in rect left of strut */
+          if (BOX_LEFT (*rect) < BOX_LEFT (*strut_rect))
             {
-              /* If a and b overlap */
-              if (meta_rectangle_overlap (a, b))
-                {
-                  int new_x = MIN (a->x, b->x);
-                  a->width = MAX (a->x + a->width, b->x + b->width) - new_x;
-                  a->x = new_x;
-                  delete_me = other;
-                }
-              /* If a and b are adjacent */
-              else if (a->x + a->width == b->x || a->x == b->x + b->width)
-                {
-                  int new_x = MIN (a->x, b->x);
-                  a->width = MAX (a->x + a->width, b->x + b->width) - new_x;
-                  a->x = new_x;
-                  delete_me = other;
-                }
+              split[n_split] = *rect;
+              split[n_split].width = BOX_LEFT (*strut_rect) - BOX_LEFT (*rect);
+              n_split++;
             }
-          /* If a and b might be mergeable vertically */
-          else if (a->x == b->x && a->width == b->width)
+          /* If there is area in rect right of strut */
+          if (BOX_RIGHT (*rect) > BOX_RIGHT (*strut_rect))
             {
-              /* If a and b overlap */
-              if (meta_rectangle_overlap (a, b))
-                {
-                  int new_y = MIN (a->y, b->y);
-                  a->height = MAX (a->y + a->height, b->y + b->height) - new_y;
-                  a->y = new_y;
-                  delete_me = other;
-                }
-              /* If a and b are adjacent */
-              else if (a->y + a->height == b->y || a->y == b->y + b->height)
-                {
-                  int new_y = MIN (a->y, b->y);
-                  a->height = MAX (a->y + a->height, b->y + b->height) - new_y;
-                  a->y = new_y;
-                  delete_me = other;
-                }
+              int new_x = BOX_RIGHT (*strut_rect);
+              split[n_split] = *rect;
+              split[n_split].width = BOX_RIGHT (*rect) - new_x;
+              split[n_split].x = new_x;
+              n_split++;
             }
-
-          other = other->next;
-
-          /* Delete any rectangle in the list that is no longer wanted */
-          if (delete_me != NULL)
+          /* If there is area in rect above strut */
+          if (BOX_TOP (*rect) < BOX_TOP (*strut_rect))
             {
-              /* Deleting the rect we compare others to is a little tricker */
-              if (compare == delete_me)
-                {
-                  compare = compare->next;
-                  other = compare->next;
-                  a = compare->data;
-                }
-
-              /* Okay, we can free it now */
-              g_free (delete_me->data);
-              region = g_list_delete_link (region, delete_me);
+              split[n_split] = *rect;
+              split[n_split].height = BOX_TOP (*strut_rect) - BOX_TOP (*rect);
+              n_split++;
+            }
+          /* If there is area in rect below strut */
+          if (BOX_BOTTOM (*rect) > BOX_BOTTOM (*strut_rect))
+            {
+              int new_y = BOX_BOTTOM (*strut_rect);
+              split[n_split] = *rect;
+              split[n_split].height = BOX_BOTTOM (*rect) - new_y;
+              split[n_split].y = new_y;
+              n_split++;
             }
-
         }
 
-      compare = compare->next;
+      memmove (rects, split, n_split * sizeof (MetaRectangle));
+      arena->used = n_split;
+      n_rects = n_split;
+      reversed = TRUE;
     }
 
-  return region;
-}
+  if (reversed)
+    {
+      int i;
 
-/* Simple helper function for get_minimal_spanning_set_for_region()... */
-static gint
-compare_rect_areas (gconstpointer a, gconstpointer b)
-{
-  const MetaRectangle *a_rect = (gconstpointer) a;
-  const MetaRectangle *b_rect = (gconstpointer) b;
+      for (i = 0; i < n_rects / 2; i++)
+        {
+          MetaRectangle swap = arena->rects[i];
+          arena->rects[i] = arena->rects[n_rects - 1 - i];
+          arena->rects[n_rects - 1 - i] = swap;
+        }
+    }
 
-  int a_area = meta_rectangle_area (a_rect);
-  int b_area = meta_rectangle_area (b_rect);
+  /* Sort by maximal area, just because I feel like it... */
+  tmp = rect_arena_alloc (arena, n_rects);
+  sort_rects_by_area (arena->rects, arena->rects + tmp, n_rects);
+  arena->used = n_rects;
 
-  return b_area - a_area; /* positive ret value denotes b > a, ... */
+  /* Merge rectangles if possible so that the list really is minimal */
+  n_rects = merge_spanning_rects_in_region (arena->rects, n_rects);
+  arena->used = n_rects;
+
+  return n_rects;
 }
 
 /**
@@ -572,8 +774,10 @@ meta_rectangle_get_minimal_spanning_set_for_region (
   /* NOTE FOR OPTIMIZERS: This function *might* be somewhat slow,
    * especially due to the call to merge_spanning_rects_in_region() (which
    * is O(n^2) where n is the size of the list generated in this function).
-   * This is made more onerous due to the fact that it involves a fair
-   * number of memory allocation and deallocation calls.  However, n is 1
+   * The intermediate rectangles live in a flat scratch arena, so at least
+   * that part no longer involves a fair number of memory allocation and
+   * deallocation calls; only the returned list does (workspaces use
+   * meta_region_new_spanning_set() to avoid even that).  However, n is 1
    * for default installations of Gnome (because partial struts aren't used
    * by default and only partial struts increase the size of the spanning
    * set generated).  With one partial strut, n will be 2 or 3.  With 2
@@ -605,94 +809,58 @@ meta_rectangle_get_minimal_spanning_set_for_region (
    *     URL splitting.)
    */
 
-  GList         *ret;
-  GList         *tmp_list;
-  const GSList  *strut_iter;
-  MetaRectangle *temp_rect;
+  GList *ret;
+  int    n_rects, i;
 
-  /* The algorithm is basically as follows:
-   *   Initialize rectangle_set to basic_rect
-   *   Foreach strut:
-   *     Foreach rectangle in rectangle_set:
-   *       - Split the rectangle into new rectangles that don't overlap the
-   *         strut (but which are as big as possible otherwise)
-   *       - Remove the old (pre-split) rectangle from the rectangle_set,
-   *         and replace it with the new rectangles generated from the
-   *         splitting
-   */
+  n_rects = compute_spanning_set (basic_rect, all_struts);
 
-  temp_rect = g_new (MetaRectangle, 1);
-  *temp_rect = *basic_rect;
-  ret = g_list_prepend (NULL, temp_rect);
+  ret = NULL;
+  for (i = n_rects - 1; i >= 0; i--)
+    ret = g_list_prepend (ret, meta_rectangle_copy (&scratch_arena.rects[i]));
 
-  strut_iter = all_struts;
-  for (strut_iter = all_struts; strut_iter; strut_iter = strut_iter->next)
-    {
-      GList *rect_iter; 
-      MetaRectangle *strut_rect = &((MetaStrut*)strut_iter->data)->rect;
+  return ret;
+}
 
-      tmp_list = ret;
-      ret = NULL;
-      rect_iter = tmp_list;
-      while (rect_iter)
-        {
-          MetaRectangle *rect = (MetaRectangle*) rect_iter->data;
-          if (!meta_rectangle_overlap (rect, strut_rect))
-            ret = g_list_prepend (ret, rect);
-          else
-            {
-              /* If there is area in rect left of strut */
-              if (BOX_LEFT (*rect) < BOX_LEFT (*strut_rect))
-                {
-                  temp_rect = g_new (MetaRectangle, 1);
-                  *temp_rect = *rect;
-                  temp_rect->width = BOX_LEFT (*strut_rect) - BOX_LEFT (*rect);
-                  ret = g_list_prepend (ret, temp_rect);
-                }
-              /* If there is area in rect right of strut */
-              if (BOX_RIGHT (*rect) > BOX_RIGHT (*strut_rect))
-                {
-                  int new_x;
-                  temp_rect = g_new (MetaRectangle, 1);
-                  *temp_rect = *rect;
-                  new_x = BOX_RIGHT (*strut_rect);
-                  temp_rect->width = BOX_RIGHT(*rect) - new_x;
-                  temp_rect->x = new_x;
-                  ret = g_list_prepend (ret, temp_rect);
-                }
-              /* If there is area in rect above strut */
-              if (BOX_TOP (*rect) < BOX_TOP (*strut_rect))
-                {
-                  temp_rect = g_new (MetaRectangle, 1);
-                  *temp_rect = *rect;
-                  temp_rect->height = BOX_TOP (*strut_rect) - BOX_TOP (*rect);
-                  ret = g_list_prepend (ret, temp_rect);
-                }
-              /* If there is area in rect below strut */
-              if (BOX_BOTTOM (*rect) > BOX_BOTTOM (*strut_rect))
-                {
-                  int new_y;
-                  temp_rect = g_new (MetaRectangle, 1);
-                  *temp_rect = *rect;
-                  new_y = BOX_BOTTOM (*strut_rect);
-                  temp_rect->height = BOX_BOTTOM (*rect) - new_y;
-                  temp_rect->y = new_y;
-                  ret = g_list_prepend (ret, temp_rect);
-                }
-              g_free (rect);
-            }
-          rect_iter = rect_iter->next;
-        }
-      g_list_free (tmp_list);
-    }
+/**
+ * meta_region_new_spanning_set: (skip)
+ * @basic_rect: Input rectangle
+ * @all_struts: List of struts
+ *
+ * Like meta_rectangle_get_minimal_spanning_set_for_region(), but returns
+ * the spanning set as a single #MetaRegion.
+ *
+ * Returns: a new region, free with meta_region_free()
+ */
+MetaRegion*
+meta_region_new_spanning_set (const MetaRectangle *basic_rect,
+                              const GSList        *all_struts)
+{
+  int n_rects;
 
-  /* Sort by maximal area, just because I feel like it... */
-  ret = g_list_sort (ret, compare_rect_areas);
+  n_rects = compute_spanning_set (basic_rect, all_struts);
 
-  /* Merge rectangles if possible so that the list really is minimal */
-  ret = merge_spanning_rects_in_region (ret);
+  return meta_region_new (scratch_arena.rects, n_rects);
+}
 
-  return ret;
+static void
+expand_rect_conditionally (MetaRectangle *rect,
+                           const int      left_expand,
+                           const int      right_expand,
+                           const int      top_expand,
+                           const int      bottom_expand,
+                           const int      min_x,
+                           const int      min_y)
+{
+  if (rect->width >= min_x)
+    {
+      rect->x      -= left_expand;
+      rect->width  += (left_expand + right_expand);
+    }
+  if (rect->height >= min_y)
+    {
+      rect->y      -= top_expand;
+      rect->height += (top_expand + bottom_expand);
+    }
 }
 
 /**
@@ -731,23 +899,50 @@ meta_rectangle_expand_region_conditionally (GList     *region,
   GList *tmp_list = region;
   while (tmp_list)
     {
-      MetaRectangle *rect = (MetaRectangle*) tmp_list->data;
-      if (rect->width >= min_x)
-        {
-          rect->x      -= left_expand;
-          rect->width  += (left_expand + right_expand);
-        }
-      if (rect->height >= min_y)
-        {
-          rect->y      -= top_expand;
-          rect->height += (top_expand + bottom_expand);
-        }
+      expand_rect_conditionally ((MetaRectangle*) tmp_list->data,
+                                 left_expand, right_expand,
+                                 top_expand, bottom_expand,
+                                 min_x, min_y);
       tmp_list = tmp_list->next;
     }
 
   return region;
 }
 
+void
+meta_region_expand (MetaRegion *region,
+                    const int   left_expand,
+                    const int   right_expand,
+                    const int   top_expand,
+                    const int   bottom_expand)
+{
+  meta_region_expand_conditionally (region,
+                                    left_expand,
+                                    right_expand,
+                                    top_expand,
+                                    bottom_expand,
+                                    0,
+                                    0);
+}
+
+void
+meta_region_expand_conditionally (MetaRegion *region,
+                                  const int   left_expand,
+                                  const int   right_expand,
+                                  const int   top_expand,
+                                  const int   bottom_expand,
+                                  const int   min_x,
+                                  const int   min_y)
+{
+  int i;
+
+  for (i = 0; i < region->n_rects; i++)
+    expand_rect_conditionally (&region->rects[i],
+                               left_expand, right_expand,
+                               top_expand, bottom_expand,
+                               min_x, min_y);
+}
+
 void
 meta_rectangle_expand_to_avoiding_struts (MetaRectangle       *rect,
                                           const MetaRectangle *expand_to,
@@ -827,77 +1022,141 @@ meta_rectangle_free_list_and_elements (GList *filled_list)
   g_list_free (filled_list);
 }
 
+/**
+ * meta_region_new: (skip)
+ * @rects: array of rectangles
+ * @n_rects: number of rectangles in @rects
+ *
+ * Returns: a new region holding a copy of @rects; the rectangles are
+ * allocated together with the region itself.
+ */
+MetaRegion*
+meta_region_new (const MetaRectangle *rects,
+                 int                  n_rects)
+{
+  MetaRegion *region;
+
+  region = g_malloc (sizeof (MetaRegion) + n_rects * sizeof (MetaRectangle));
+  region->rects = (MetaRectangle*) (region + 1);
+  region->n_rects = n_rects;
+  memcpy (region->rects, rects, n_rects * sizeof (MetaRectangle));
+
+  return region;
+}
+
+void
+meta_region_free (MetaRegion *region)
+{
+  g_free (region);
+}
+
+/* Copies a list of spanning rects into scratch_arena so the list based
+ * functions below can share the MetaRegion code.  The result is only
+ * valid until the arena is next used.
+ */
+static MetaRegion
+region_from_list (const GList *spanning_rects)
+{
+  MetaRegion region;
+  int        offset;
+
+  rect_arena_reset (&scratch_arena);
+  offset = rect_arena_alloc (&scratch_arena, g_list_length ((GList*) spanning_rects));
+
+  region.rects = scratch_arena.rects + offset;
+  region.n_rects = 0;
+  for (; spanning_rects; spanning_rects = spanning_rects->next)
+    region.rects[region.n_rects++] = *(MetaRectangle*) spanning_rects->data;
+
+  return region;
+}
+
 gboolean
-meta_rectangle_could_fit_in_region (const GList         *spanning_rects,
-                                    const MetaRectangle *rect)
+meta_region_could_fit_rect (const MetaRegion    *region,
+                            const MetaRectangle *rect)
 {
-  const GList *temp;
-  gboolean     could_fit;
+  gboolean could_fit;
+  int      i;
 
-  temp = spanning_rects;
   could_fit = FALSE;
-  while (!could_fit && temp != NULL)
-    {
-      could_fit = could_fit || meta_rectangle_could_fit_rect (temp->data, rect);
-      temp = temp->next;
-    }
+  for (i = 0; !could_fit && i < region->n_rects; i++)
+    could_fit = meta_rectangle_could_fit_rect (&region->rects[i], rect);
 
   return could_fit;
 }
 
 gboolean
-meta_rectangle_contained_in_region (const GList         *spanning_rects,
+meta_rectangle_could_fit_in_region (const GList         *spanning_rects,
                                     const MetaRectangle *rect)
 {
-  const GList *temp;
-  gboolean     contained;
+  MetaRegion region = region_from_list (spanning_rects);
+
+  return meta_region_could_fit_rect (&region, rect);
+}
+
+gboolean
+meta_region_contains_rect (const MetaRegion    *region,
+                           const MetaRectangle *rect)
+{
+  gboolean contained;
+  int      i;
 
-  temp = spanning_rects;
   contained = FALSE;
-  while (!contained && temp != NULL)
-    {
-      contained = contained || meta_rectangle_contains_rect (temp->data, rect);
-      temp = temp->next;
-    }
+  for (i = 0; !contained && i < region->n_rects; i++)
+    contained = meta_rectangle_contains_rect (&region->rects[i], rect);
 
   return contained;
 }
 
 gboolean
-meta_rectangle_overlaps_with_region (const GList         *spanning_rects,
-                                     const MetaRectangle *rect)
+meta_rectangle_contained_in_region (const GList         *spanning_rects,
+                                    const MetaRectangle *rect)
+{
+  MetaRegion region = region_from_list (spanning_rects);
+
+  return meta_region_contains_rect (&region, rect);
+}
+
+gboolean
+meta_region_overlaps_rect (const MetaRegion    *region,
+                           const MetaRectangle *rect)
 {
-  const GList *temp;
-  gboolean     overlaps;
+  gboolean overlaps;
+  int      i;
 
-  temp = spanning_rects;
   overlaps = FALSE;
-  while (!overlaps && temp != NULL)
-    {
-      overlaps = overlaps || meta_rectangle_overlap (temp->data, rect);
-      temp = temp->next;
-    }
+  for (i = 0; !overlaps && i < region->n_rects; i++)
+    overlaps = meta_rectangle_overlap (&region->rects[i], rect);
 
   return overlaps;
 }
 
+gboolean
+meta_rectangle_overlaps_with_region (const GList         *spanning_rects,
+                                     const MetaRectangle *rect)
+{
+  MetaRegion region = region_from_list (spanning_rects);
+
+  return meta_region_overlaps_rect (&region, rect);
+}
+
 
 void
-meta_rectangle_clamp_to_fit_into_region (const GList         *spanning_rects,
-                                         FixedDirections      fixed_directions,
-                                         MetaRectangle       *rect,
-                                         const MetaRectangle *min_size)
+meta_region_clamp_rect_to_fit (const MetaRegion    *region,
+                               FixedDirections      fixed_directions,
+                               MetaRectangle       *rect,
+                               const MetaRectangle *min_size)
 {
-  const GList *temp;
   const MetaRectangle *best_rect = NULL;
   int                  best_overlap = 0;
+  int                  i;
 
-  /* First, find best rectangle from spanning_rects to which we can clamp
+  /* First, find best rectangle from region to which we can clamp
    * rect to fit into.
    */
-  for (temp = spanning_rects; temp; temp = temp->next)
+  for (i = 0; i < region->n_rects; i++)
     {
-      MetaRectangle *compare_rect = temp->data;
+      const MetaRectangle *compare_rect = &region->rects[i];
       int            maximal_overlap_amount_for_compare;
       
       /* If x is fixed and the entire width of rect doesn't fit in compare,
@@ -953,20 +1212,31 @@ meta_rectangle_clamp_to_fit_into_region (const GList         *spanning_rects,
 }
 
 void
-meta_rectangle_clip_to_region (const GList         *spanning_rects,
-                               FixedDirections      fixed_directions,
-                               MetaRectangle       *rect)
+meta_rectangle_clamp_to_fit_into_region (const GList         *spanning_rects,
+                                         FixedDirections      fixed_directions,
+                                         MetaRectangle       *rect,
+                                         const MetaRectangle *min_size)
+{
+  MetaRegion region = region_from_list (spanning_rects);
+
+  meta_region_clamp_rect_to_fit (&region, fixed_directions, rect, min_size);
+}
+
+void
+meta_region_clip_rect (const MetaRegion    *region,
+                       FixedDirections      fixed_directions,
+                       MetaRectangle       *rect)
 {
-  const GList *temp;
   const MetaRectangle *best_rect = NULL;
   int                  best_overlap = 0;
+  int                  i;
 
-  /* First, find best rectangle from spanning_rects to which we will clip
+  /* First, find best rectangle from region to which we will clip
    * rect into.
    */
-  for (temp = spanning_rects; temp; temp = temp->next)
+  for (i = 0; i < region->n_rects; i++)
     {
-      MetaRectangle *compare_rect = temp->data;
+      const MetaRectangle *compare_rect = &region->rects[i];
       MetaRectangle  overlap;
       int            maximal_overlap_amount_for_compare;
      
@@ -1030,22 +1300,32 @@ meta_rectangle_clip_to_region (const GList         *spanning_rects,
 }
 
 void
-meta_rectangle_shove_into_region (const GList         *spanning_rects,
-                                  FixedDirections      fixed_directions,
-                                  MetaRectangle       *rect)
+meta_rectangle_clip_to_region (const GList         *spanning_rects,
+                               FixedDirections      fixed_directions,
+                               MetaRectangle       *rect)
+{
+  MetaRegion region = region_from_list (spanning_rects);
+
+  meta_region_clip_rect (&region, fixed_directions, rect);
+}
+
+void
+meta_region_shove_rect (const MetaRegion    *region,
+                        FixedDirections      fixed_directions,
+                        MetaRectangle       *rect)
 {
-  const GList *temp;
   const MetaRectangle *best_rect = NULL;
   int                  best_overlap = 0;
   int                  shortest_distance = G_MAXINT;
+  int                  i;
 
-  /* First, find best rectangle from spanning_rects to which we will shove
+  /* First, find best rectangle from region to which we will shove
    * rect into.
    */
   
-  for (temp = spanning_rects; temp; temp = temp->next)
+  for (i = 0; i < region->n_rects; i++)
     {
-      MetaRectangle *compare_rect = temp->data;
+      const MetaRectangle *compare_rect = &region->rects[i];
       int            maximal_overlap_amount_for_compare;
       int            dist_to_compare;
       
@@ -1129,6 +1409,16 @@ meta_rectangle_shove_into_region (const GList         *spanning_rects,
     }
 }
 
+void
+meta_rectangle_shove_into_region (const GList         *spanning_rects,
+                                  FixedDirections      fixed_directions,
+                                  MetaRectangle       *rect)
+{
+  MetaRegion region = region_from_list (spanning_rects);
+
+  meta_region_shove_rect (&region, fixed_directions, rect);
+}
+
 void
 meta_rectangle_find_linepoint_closest_to_point (double x1,
                                                 double y1,
@@ -139,12 +139,12 @@ typedef struct
   /* Spanning rectangles for the non-covered (by struts) region of the
    * screen and also for just the current monitor
    */
-  GList  *usable_screen_region;
-  GList  *usable_monitor_region;
+  MetaRegion *usable_screen_region;
+  MetaRegion *usable_monitor_region;
 } ConstraintInfo;
 
 static gboolean do_screen_and_monitor_relative_constraints (MetaWindow     *window,
-                                                            GList          *region_spanning_rectangles,
+                                                            MetaRegion     *region,
                                                             ConstraintInfo *info,
                                                             gboolean        check_only);
 static gboolean constrain_modal_dialog       (MetaWindow         *window,
@@ -638,8 +638,8 @@ update_onscreen_requirements (MetaWindow     *window,
    */
   old = window->require_fully_onscreen;
   window->require_fully_onscreen =
-    meta_rectangle_contained_in_region (info->usable_screen_region,
-                                        &info->current);
+    meta_region_contains_rect (info->usable_screen_region,
+                               &info->current);
   if (old ^ window->require_fully_onscreen)
     meta_topic (META_DEBUG_GEOMETRY,
                 "require_fully_onscreen for %s toggled to %s\n",
@@ -651,8 +651,8 @@ update_onscreen_requirements (MetaWindow     *window,
    */
   old = window->require_on_single_monitor;
   window->require_on_single_monitor =
-    meta_rectangle_contained_in_region (info->usable_monitor_region,
-                                        &info->current);
+    meta_region_contains_rect (info->usable_monitor_region,
+                               &info->current);
   if (old ^ window->require_on_single_monitor)
     meta_topic (META_DEBUG_GEOMETRY,
                 "require_on_single_monitor for %s toggled to %s\n",
@@ -670,8 +670,8 @@ update_onscreen_requirements (MetaWindow     *window,
       titlebar_rect.height = info->borders->visible.top;
       old = window->require_titlebar_visible;
       window->require_titlebar_visible =
-        meta_rectangle_overlaps_with_region (info->usable_screen_region,
-                                             &titlebar_rect);
+        meta_region_overlaps_rect (info->usable_screen_region,
+                                   &titlebar_rect);
       if (old ^ window->require_titlebar_visible)
         meta_topic (META_DEBUG_GEOMETRY,
                     "require_titlebar_visible for %s toggled to %s\n",
@@ -1221,7 +1221,7 @@ constrain_aspect_ratio (MetaWindow         *window,
 static gboolean
 do_screen_and_monitor_relative_constraints (
   MetaWindow     *window,
-  GList          *region_spanning_rectangles,
+  MetaRegion     *region,
   ConstraintInfo *info,
   gboolean        check_only)
 {
@@ -1232,12 +1232,11 @@ do_screen_and_monitor_relative_constraints (
   if (meta_is_verbose ())
     {
       /* First, log some debugging information */
-      char spanning_region[1 + 28 * g_list_length (region_spanning_rectangles)];
+      char spanning_region[1 + 28 * region->n_rects];
 
       meta_topic (META_DEBUG_GEOMETRY,
              "screen/monitor constraint; region_spanning_rectangles: %s\n",
-             meta_rectangle_region_to_string (region_spanning_rectangles, ", ",
-                                              spanning_region));
+             meta_region_to_string (region, ", ", spanning_region));
     }
 #endif
 
@@ -1254,14 +1253,12 @@ do_screen_and_monitor_relative_constraints (
       if (!(info->fixed_directions & FIXED_DIRECTION_Y))
         how_far_it_can_be_smushed.height = min_size.height;
     }
-  if (!meta_rectangle_could_fit_in_region (region_spanning_rectangles,
-                                           &how_far_it_can_be_smushed))
+  if (!meta_region_could_fit_rect (region, &how_far_it_can_be_smushed))
     exit_early = TRUE;
 
   /* Determine whether constraint is already satisfied; exit if it is */
   constraint_satisfied = 
-    meta_rectangle_contained_in_region (region_spanning_rectangles,
-                                        &info->current);
+    meta_region_contains_rect (region, &info->current);
   if (exit_early || constraint_satisfied || check_only)
     {
       unextend_by_frame (&info->current, info->borders);
@@ -1272,21 +1269,21 @@ do_screen_and_monitor_relative_constraints (
 
   /* Clamp rectangle size for resize or move+resize actions */
   if (info->action_type != ACTION_MOVE)
-    meta_rectangle_clamp_to_fit_into_region (region_spanning_rectangles,
-                                             info->fixed_directions,
-                                             &info->current,
-                                             &min_size);
+    meta_region_clamp_rect_to_fit (region,
+                                   info->fixed_directions,
+                                   &info->current,
+                                   &min_size);
 
   if (info->is_user_action && info->action_type == ACTION_RESIZE)
     /* For user resize, clip to the relevant region */
-    meta_rectangle_clip_to_region (region_spanning_rectangles,
-                                   info->fixed_directions,
-                                   &info->current);
+    meta_region_clip_rect (region,
+                           info->fixed_directions,
+                           &info->current);
   else
     /* For everything else, shove the rectangle into the relevant region */
-    meta_rectangle_shove_into_region (region_spanning_rectangles,
-                                      info->fixed_directions,
-                                      &info->current);
+    meta_region_shove_rect (region,
+                            info->fixed_directions,
+                            &info->current);
 
   unextend_by_frame (&info->current, info->borders);
   return TRUE;
@@ -1410,25 +1407,25 @@ constrain_titlebar_visible (MetaWindow         *window,
   /* Extend the region, have a helper function handle the constraint,
    * then return the region to its original size.
    */
-  meta_rectangle_expand_region_conditionally (info->usable_screen_region,
-                                              horiz_amount_offscreen,
-                                              horiz_amount_offscreen, 
-                                              0, /* Don't let titlebar off */
-                                              bottom_amount,
-                                              horiz_amount_onscreen,
-                                              vert_amount_onscreen);
+  meta_region_expand_conditionally (info->usable_screen_region,
+                                    horiz_amount_offscreen,
+                                    horiz_amount_offscreen, 
+                                    0, /* Don't let titlebar off */
+                                    bottom_amount,
+                                    horiz_amount_onscreen,
+                                    vert_amount_onscreen);
   retval =
     do_screen_and_monitor_relative_constraints (window, 
                                                 info->usable_screen_region,
                                                 info,
                                                 check_only);
-  meta_rectangle_expand_region_conditionally (info->usable_screen_region,
-                                              -horiz_amount_offscreen,
-                                              -horiz_amount_offscreen,
-                                              0, /* Don't let titlebar off */
-                                              -bottom_amount,
-                                              horiz_amount_onscreen,
-                                              vert_amount_onscreen);
+  meta_region_expand_conditionally (info->usable_screen_region,
+                                    -horiz_amount_offscreen,
+                                    -horiz_amount_offscreen,
+                                    0, /* Don't let titlebar off */
+                                    -bottom_amount,
+                                    horiz_amount_onscreen,
+                                    vert_amount_onscreen);
 
   return retval;
 }
@@ -1485,25 +1482,25 @@ constrain_partially_onscreen (MetaWindow         *window,
   /* Extend the region, have a helper function handle the constraint,
    * then return the region to its original size.
    */
-  meta_rectangle_expand_region_conditionally (info->usable_screen_region,
-                                              horiz_amount_offscreen,
-                                              horiz_amount_offscreen, 
-                                              top_amount,
-                                              bottom_amount,
-                                              horiz_amount_onscreen,
-                                              vert_amount_onscreen);
+  meta_region_expand_conditionally (info->usable_screen_region,
+                                    horiz_amount_offscreen,
+                                    horiz_amount_offscreen, 
+                                    top_amount,
+                                    bottom_amount,
+                                    horiz_amount_onscreen,
+                                    vert_amount_onscreen);
   retval =
     do_screen_and_monitor_relative_constraints (window, 
                                                 info->usable_screen_region,
                                                 info,
                                                 check_only);
-  meta_rectangle_expand_region_conditionally (info->usable_screen_region,
-                                              -horiz_amount_offscreen,
-                                              -horiz_amount_offscreen,
-                                              -top_amount,
-                                              -bottom_amount,
-                                              horiz_amount_onscreen,
-                                              vert_amount_onscreen);
+  meta_region_expand_conditionally (info->usable_screen_region,
+                                    -horiz_amount_offscreen,
+                                    -horiz_amount_offscreen,
+                                    -top_amount,
+                                    -bottom_amount,
+                                    horiz_amount_onscreen,
+                                    vert_amount_onscreen);
 
   return retval;
 }
@@ -236,6 +236,7 @@ lower_window_and_transients (MetaWindow *window,
           window->screen->active_workspace->mru_list = 
             g_list_append (window->screen->active_workspace->mru_list, 
                            window);
+          meta_display_invalidate_tab_lists (window->display);
         }
     }
 
@@ -55,6 +55,12 @@ typedef struct _MetaGroupPropHooks  MetaGroupPropHooks;
 typedef struct _MetaWindowPropHooks MetaWindowPropHooks;
 
 typedef struct MetaEdgeResistanceData MetaEdgeResistanceData;
+typedef struct MetaEdgeCache MetaEdgeCache;
+
+/* The windows of a tab list in order, see meta_display_get_tab_list() */
+typedef struct _MetaTabChain MetaTabChain;
+
+#define META_N_TAB_LISTS (META_TAB_LIST_GROUP + 1)
 
 typedef void (* MetaWindowPingFunc) (MetaDisplay *display,
 				     Window       xwindow,
@@ -116,6 +122,16 @@ struct _MetaDisplay
    */
   MetaWindow *expected_focus_window;
 
+  /* The windows demanding attention, which are in the tab lists of
+   * every workspace
+   */
+  GHashTable *attention_windows;
+
+  /* Changes whenever the tab lists might have, so that the tab chains
+   * of the workspaces know to rebuild themselves
+   */
+  guint tab_list_serial;
+
   /* last timestamp passed to XSetInputFocus */
   guint32 last_focus_time;
 
@@ -139,14 +155,13 @@ struct _MetaDisplay
   guint static_gravity_works : 1;
   
   /*< private-ish >*/
-  guint error_trap_synced_at_last_pop : 1;
   MetaEventQueue *events;
   GSList *screens;
   MetaScreen *active_screen;
   GHashTable *window_ids;
-  int error_traps;
-  int (* error_trap_handler) (Display     *display,
-                              XErrorEvent *error);  
+  /* Location => number of times popping a trap there had to sync */
+  GHashTable *error_trap_syncs;
+  guint error_trap_syncs_avoided;
   int server_grab_count;
 
   /* serials of leave/unmap events that may
@@ -204,6 +219,7 @@ struct _MetaDisplay
   guint32     grab_motion_notify_time;
   GList*      grab_old_window_stacking;
   MetaEdgeResistanceData *grab_edge_resistance_data;
+  MetaEdgeCache *edge_cache;
   unsigned int grab_last_user_action_was_snap;
 
   /* we use property updates as sentinels for certain window focus events
@@ -224,6 +240,7 @@ struct _MetaDisplay
   /* Keybindings stuff */
   MetaKeyBinding *key_bindings;
   int             n_key_bindings;
+  MetaKeyBindingIndex *key_binding_index;
   int             min_keycode;
   int             max_keycode;
   KeySym *keymap;
@@ -242,6 +259,15 @@ struct _MetaDisplay
   /* Monitor cache */
   unsigned int monitor_cache_invalidated : 1;
 
+  /* Where the pointer was at the last event that told us, so that the
+   * current monitor can be found without asking the server
+   */
+  unsigned int pointer_position_valid : 1;
+  Window pointer_root;
+  int pointer_x;
+  int pointer_y;
+  guint pointer_queries_avoided;
+
   /* Opening the display */
   unsigned int display_opening : 1;
 
@@ -289,6 +315,9 @@ struct _MetaDisplay
   int shape_event_base;
   int shape_error_base;
 #endif
+#ifdef HAVE_XINPUT2
+  int xinput2_opcode;
+#endif
 #ifdef HAVE_XSYNC
   unsigned int have_xsync : 1;
 #define META_DISPLAY_HAS_XSYNC(display) ((display)->have_xsync)
@@ -300,6 +329,12 @@ struct _MetaDisplay
 #define META_DISPLAY_HAS_SHAPE(display) ((display)->have_shape)
 #else
 #define META_DISPLAY_HAS_SHAPE(display) FALSE
+#endif
+#ifdef HAVE_XINPUT2
+  unsigned int have_xinput2 : 1;
+#define META_DISPLAY_HAS_XINPUT2(display) ((display)->have_xinput2)
+#else
+#define META_DISPLAY_HAS_XINPUT2(display) FALSE
 #endif
   unsigned int have_render : 1;
 #define META_DISPLAY_HAS_RENDER(display) ((display)->have_render)
@@ -396,8 +431,9 @@ void meta_display_grab_focus_window_button   (MetaDisplay *display,
 void meta_display_ungrab_focus_window_button (MetaDisplay *display,
                                               MetaWindow  *window);
 
-/* Next function is defined in edge-resistance.c */
+/* Next functions are defined in edge-resistance.c */
 void meta_display_cleanup_edges              (MetaDisplay *display);
+void meta_display_free_edge_cache            (MetaDisplay *display);
 
 /* make a request to ensure the event serial has changed */
 void     meta_display_increment_event_serial (MetaDisplay *display);
@@ -442,6 +478,16 @@ void meta_display_remove_autoraise_callback (MetaDisplay *display);
 
 void meta_display_overlay_key_activate (MetaDisplay *display);
 
+void meta_display_invalidate_pointer_position (MetaDisplay *display);
+
+void meta_display_init_error_traps     (MetaDisplay *display);
+void meta_display_shutdown_error_traps (MetaDisplay *display);
+
+void meta_display_invalidate_tab_lists     (MetaDisplay  *display);
+void meta_display_update_attention_windows (MetaDisplay  *display,
+                                            MetaWindow   *window);
+void meta_tab_chain_free                   (MetaTabChain *chain);
+
 /* In above-tab-keycode.c */
 guint meta_display_get_above_tab_keycode (MetaDisplay *display);
 
@@ -66,6 +66,9 @@
 #ifdef HAVE_XKB
 #include <X11/XKBlib.h>
 #endif
+#ifdef HAVE_XINPUT2
+#include <X11/extensions/XInput2.h>
+#endif
 #ifdef HAVE_XCURSOR
 #include <X11/Xcursor/Xcursor.h>
 #endif
@@ -452,9 +455,7 @@ meta_display_open (void)
       buf[sizeof(buf)-1] = '\0';
       the_display->hostname = g_strdup (buf);
     }
-  the_display->error_trap_synced_at_last_pop = TRUE;
-  the_display->error_traps = 0;
-  the_display->error_trap_handler = NULL;
+  meta_display_init_error_traps (the_display);
   the_display->server_grab_count = 0;
   the_display->display_opening = TRUE;
 
@@ -463,6 +464,8 @@ meta_display_open (void)
   the_display->autoraise_window = NULL;
   the_display->focus_window = NULL;
   the_display->expected_focus_window = NULL;
+  the_display->attention_windows = g_hash_table_new (NULL, NULL);
+  the_display->tab_list_serial = 0;
   the_display->grab_old_window_stacking = NULL;
 
   the_display->mouse_mode = TRUE; /* Only relevant for mouse or sloppy focus */
@@ -506,6 +509,11 @@ meta_display_open (void)
   the_display->timestamp_pinging_window = None;
 
   the_display->monitor_cache_invalidated = TRUE;
+  the_display->pointer_position_valid = FALSE;
+  the_display->pointer_root = None;
+  the_display->pointer_x = 0;
+  the_display->pointer_y = 0;
+  the_display->pointer_queries_avoided = 0;
 
   the_display->groups_by_leader = NULL;
 
@@ -556,6 +564,7 @@ meta_display_open (void)
   the_display->grab_tile_mode = META_TILE_NONE;
 
   the_display->grab_edge_resistance_data = NULL;
+  the_display->edge_cache = NULL;
 
 #ifdef HAVE_XSYNC
   {
@@ -617,6 +626,47 @@ meta_display_open (void)
   meta_verbose ("Not compiled with Shape support\n");
 #endif /* !HAVE_SHAPE */
 
+#ifdef HAVE_XINPUT2
+  {
+    int event_base, error_base;
+    int major, minor;
+
+    the_display->have_xinput2 = FALSE;
+    the_display->xinput2_opcode = 0;
+
+    /* Since XInput 2.1, raw events reach the root window even while
+     * another client holds a grab; before 2.1 they did not, so we need
+     * at least that.
+     */
+    major = 2;
+    minor = 1;
+
+    if (XQueryExtension (the_display->xdisplay, "XInputExtension",
+                         &the_display->xinput2_opcode,
+                         &event_base, &error_base))
+      {
+        Status status;
+
+        meta_error_trap_push_with_return (the_display);
+        status = XIQueryVersion (the_display->xdisplay, &major, &minor);
+
+        if (meta_error_trap_pop_with_return (the_display) == Success &&
+            status == Success &&
+            (major > 2 || (major == 2 && minor >= 1)))
+          the_display->have_xinput2 = TRUE;
+      }
+
+    if (!the_display->have_xinput2)
+      the_display->xinput2_opcode = 0;
+
+    meta_verbose ("Attempted to init XInput2, found version %d.%d opcode %d\n",
+                  major, minor,
+                  the_display->xinput2_opcode);
+  }
+#else  /* HAVE_XINPUT2 */
+  meta_verbose ("Not compiled with XInput2 support\n");
+#endif /* !HAVE_XINPUT2 */
+
   {
     the_display->have_render = FALSE;
     
@@ -978,9 +1028,6 @@ meta_display_close (MetaDisplay *display,
       return;
     }
 
-  if (display->error_traps > 0)
-    meta_bug ("Display closed with error traps pending\n");
-
   display->closing += 1;
 
   meta_prefs_remove_listener (prefs_changed_callback, display);
@@ -1019,6 +1066,7 @@ meta_display_close (MetaDisplay *display,
    * unregister windows
    */
   g_hash_table_destroy (display->window_ids);
+  g_hash_table_destroy (display->attention_windows);
 
   if (display->leader_window != None)
     XDestroyWindow (display->xdisplay, display->leader_window);
@@ -1027,6 +1075,7 @@ meta_display_close (MetaDisplay *display,
 
   meta_display_free_window_prop_hooks (display);
   meta_display_free_group_prop_hooks (display);
+  meta_display_free_edge_cache (display);
   
   g_free (display->name);
 
@@ -1034,6 +1083,8 @@ meta_display_close (MetaDisplay *display,
 
   if (display->compositor)
     meta_compositor_destroy (display->compositor);
+
+  meta_display_shutdown_error_traps (display);
   
   g_object_unref (display);
   the_display = NULL;
@@ -1553,6 +1604,103 @@ handle_net_restack_window (MetaDisplay* display,
 }
 #endif
 
+/**
+ * meta_display_invalidate_pointer_position: (skip)
+ * @display: a #MetaDisplay
+ *
+ * Forgets where the pointer is, for when it may have moved without us
+ * getting an event that says where to, so that the next time we need
+ * to know we ask the server.
+ */
+void
+meta_display_invalidate_pointer_position (MetaDisplay *display)
+{
+  display->pointer_position_valid = FALSE;
+  display->monitor_cache_invalidated = TRUE;
+}
+
+/* Keeps track of where the pointer is from the events that carry its
+ * position, so that finding the current monitor doesn't need a round
+ * trip to the server for each event.
+ */
+static void
+update_pointer_position (MetaDisplay *display,
+                         XEvent      *event)
+{
+  Window root;
+  int x, y;
+  Bool same_screen;
+
+  switch (event->type)
+    {
+    case KeyPress:
+    case KeyRelease:
+      root = event->xkey.root;
+      x = event->xkey.x_root;
+      y = event->xkey.y_root;
+      same_screen = event->xkey.same_screen;
+      break;
+    case ButtonPress:
+    case ButtonRelease:
+      root = event->xbutton.root;
+      x = event->xbutton.x_root;
+      y = event->xbutton.y_root;
+      same_screen = event->xbutton.same_screen;
+      break;
+    case MotionNotify:
+      root = event->xmotion.root;
+      x = event->xmotion.x_root;
+      y = event->xmotion.y_root;
+      same_screen = event->xmotion.same_screen;
+      break;
+    case EnterNotify:
+    case LeaveNotify:
+      root = event->xcrossing.root;
+      x = event->xcrossing.x_root;
+      y = event->xcrossing.y_root;
+      same_screen = event->xcrossing.same_screen;
+      break;
+    default:
+#ifdef HAVE_XINPUT2
+      /* With raw motion selected on the root windows, any motion of
+       * the pointer we aren't told the position of shows up as a raw
+       * event, so other events don't tell us anything.
+       */
+      if (META_DISPLAY_HAS_XINPUT2 (display))
+        {
+          if (event->type == GenericEvent &&
+              event->xcookie.extension == display->xinput2_opcode &&
+              event->xcookie.evtype == XI_RawMotion)
+            meta_display_invalidate_pointer_position (display);
+          return;
+        }
+#endif
+      /* Otherwise the pointer may have moved anywhere since the last
+       * event that told us where it was.
+       */
+      meta_display_invalidate_pointer_position (display);
+      return;
+    }
+
+  if (!same_screen)
+    {
+      meta_display_invalidate_pointer_position (display);
+      return;
+    }
+
+  if (display->pointer_position_valid &&
+      display->pointer_root == root &&
+      display->pointer_x == x &&
+      display->pointer_y == y)
+    return;
+
+  display->pointer_position_valid = TRUE;
+  display->pointer_root = root;
+  display->pointer_x = x;
+  display->pointer_y = y;
+  display->monitor_cache_invalidated = TRUE;
+}
+
 /**
  * This is the most important function in the whole program. It is the heart,
  * it is the nexus, it is the Grand Central Station of Mutter's world.
@@ -1594,7 +1742,7 @@ event_callback (XEvent   *event,
   bypass_compositor = FALSE;
   filter_out_event = FALSE;
   display->current_time = event_get_time (display, event);
-  display->monitor_cache_invalidated = TRUE;
+  update_pointer_position (display, event);
   
   modified = event_get_modified_window (display, event);
   
@@ -4451,87 +4599,156 @@ get_focussed_group (MetaDisplay *display)
     || ((t) == META_TAB_LIST_DOCKS && META_WINDOW_IN_DOCK_TAB_CHAIN (w)) \
     || ((t) == META_TAB_LIST_GROUP && META_WINDOW_IN_GROUP_TAB_CHAIN (w, get_focussed_group(w->display))))
 
-static MetaWindow*
-find_tab_forward (MetaDisplay   *display,
-                  MetaTabList    type,
-                  MetaScreen    *screen, 
-                  MetaWorkspace *workspace,
-                  GList         *start,
-                  gboolean       skip_first)
+struct _MetaTabChain
 {
-  GList *tmp;
+  MetaScreen *screen;
 
-  g_return_val_if_fail (start != NULL, NULL);
-  g_return_val_if_fail (workspace != NULL, NULL);
+  /* display->tab_list_serial when the chain was built */
+  guint serial;
 
-  tmp = start;
-  if (skip_first)
-    tmp = tmp->next;
+  /* The windows in tab order */
+  GPtrArray *windows;
 
-  while (tmp != NULL)
-    {
-      MetaWindow *window = tmp->data;
+  /* MetaWindow => index in windows + 1 */
+  GHashTable *positions;
+};
 
-      if (window->screen == screen &&
-	  IN_TAB_CHAIN (window, type))
-        return window;
+/**
+ * meta_display_invalidate_tab_lists: (skip)
+ * @display: a #MetaDisplay
+ *
+ * Makes the tab chains of all workspaces rebuild themselves next time
+ * they are used.  This needs to be called whenever a workspace's MRU
+ * list, the focus window, or anything IN_TAB_CHAIN() looks at changes.
+ */
+void
+meta_display_invalidate_tab_lists (MetaDisplay *display)
+{
+  display->tab_list_serial++;
+}
 
-      tmp = tmp->next;
-    }
+/**
+ * meta_display_update_attention_windows: (skip)
+ * @display: a #MetaDisplay
+ * @window: a #MetaWindow
+ *
+ * Adds @window to or removes it from the windows demanding attention,
+ * according to whether it demands attention and is still managed.
+ */
+void
+meta_display_update_attention_windows (MetaDisplay *display,
+                                       MetaWindow  *window)
+{
+  gboolean demands_attention;
 
-  tmp = workspace->mru_list;
-  while (tmp != start)
-    {
-      MetaWindow *window = tmp->data;
+  demands_attention = window->wm_state_demands_attention &&
+    !window->unmanaging;
 
-      if (IN_TAB_CHAIN (window, type))
-        return window;
+  if (demands_attention ==
+      (g_hash_table_lookup (display->attention_windows, window) != NULL))
+    return;
 
-      tmp = tmp->next;
-    }  
+  if (demands_attention)
+    g_hash_table_insert (display->attention_windows, window, window);
+  else
+    g_hash_table_remove (display->attention_windows, window);
 
-  return NULL;
+  meta_display_invalidate_tab_lists (display);
+}
+
+void
+meta_tab_chain_free (MetaTabChain *chain)
+{
+  g_ptr_array_free (chain->windows, TRUE);
+  g_hash_table_destroy (chain->positions);
+  g_slice_free (MetaTabChain, chain);
+}
+
+static void
+tab_chain_add (MetaTabChain *chain,
+               MetaWindow   *window)
+{
+  if (g_hash_table_lookup (chain->positions, window))
+    return;
+
+  g_ptr_array_add (chain->windows, window);
+  g_hash_table_insert (chain->positions, window,
+                       GUINT_TO_POINTER (chain->windows->len));
 }
 
-static MetaWindow*
-find_tab_backward (MetaDisplay   *display,
-                   MetaTabList    type,
-                   MetaScreen    *screen, 
-                   MetaWorkspace *workspace,
-                   GList         *start,
-                   gboolean       skip_last)
+static MetaTabChain *
+get_tab_chain (MetaDisplay   *display,
+               MetaTabList    type,
+               MetaScreen    *screen,
+               MetaWorkspace *workspace)
 {
+  MetaTabChain *chain;
+  GHashTableIter iter;
+  gpointer key;
   GList *tmp;
 
-  g_return_val_if_fail (start != NULL, NULL);
-  g_return_val_if_fail (workspace != NULL, NULL);
+  chain = workspace->tab_chains[type];
+  if (chain != NULL &&
+      chain->serial == display->tab_list_serial &&
+      chain->screen == screen)
+    return chain;
 
-  tmp = start;
-  if (skip_last)  
-    tmp = tmp->prev;
-  while (tmp != NULL)
+  if (chain == NULL)
     {
-      MetaWindow *window = tmp->data;
+      chain = g_slice_new (MetaTabChain);
+      chain->windows = g_ptr_array_new ();
+      chain->positions = g_hash_table_new (NULL, NULL);
+      workspace->tab_chains[type] = chain;
+    }
+  else
+    {
+      g_ptr_array_set_size (chain->windows, 0);
+      g_hash_table_remove_all (chain->positions);
+    }
 
-      if (window->screen == screen &&
-	  IN_TAB_CHAIN (window, type))
-        return window;
+  chain->screen = screen;
+  chain->serial = display->tab_list_serial;
 
-      tmp = tmp->prev;
+  /* Windows on other workspaces demanding attention go first */
+  g_hash_table_iter_init (&iter, display->attention_windows);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      MetaWindow *window = key;
+
+      if (window->workspace != workspace &&
+          window->screen == screen &&
+          IN_TAB_CHAIN (window, type))
+        tab_chain_add (chain, window);
     }
 
-  tmp = g_list_last (workspace->mru_list);
-  while (tmp != start)
+  /* Windows sellout mode - MRU order. Collect unminimized windows
+   * then minimized so minimized windows aren't in the way so much.
+   */
+  for (tmp = workspace->mru_list; tmp != NULL; tmp = tmp->next)
     {
       MetaWindow *window = tmp->data;
 
-      if (IN_TAB_CHAIN (window, type))
-        return window;
+      if (!window->minimized &&
+          window->screen == screen &&
+          IN_TAB_CHAIN (window, type))
+        tab_chain_add (chain, window);
+    }
 
-      tmp = tmp->prev;
+  for (tmp = workspace->mru_list; tmp != NULL; tmp = tmp->next)
+    {
+      MetaWindow *window = tmp->data;
+
+      if (window->minimized &&
+          window->screen == screen &&
+          IN_TAB_CHAIN (window, type))
+        tab_chain_add (chain, window);
     }
 
-  return NULL;
+  meta_topic (META_DEBUG_FOCUS,
+              "Built tab list %u of workspace %d with %u windows\n",
+              type, meta_workspace_index (workspace), chain->windows->len);
+
+  return chain;
 }
 
 /**
@@ -4552,74 +4769,19 @@ meta_display_get_tab_list (MetaDisplay   *display,
                            MetaScreen    *screen,
                            MetaWorkspace *workspace)
 {
+  MetaTabChain *chain;
   GList *tab_list;
+  int i;
 
   g_return_val_if_fail (workspace != NULL, NULL);
 
-  /* Windows sellout mode - MRU order. Collect unminimized windows
-   * then minimized so minimized windows aren't in the way so much.
-   */
-  {
-    GList *tmp;
-    
-    tab_list = NULL;
-    tmp = workspace->mru_list;
-    while (tmp != NULL)
-      {
-        MetaWindow *window = tmp->data;
-        
-        if (!window->minimized &&
-            window->screen == screen &&
-            IN_TAB_CHAIN (window, type))
-          tab_list = g_list_prepend (tab_list, window);
-        
-        tmp = tmp->next;
-      }
-  }
-
-  {
-    GList *tmp;
-    
-    tmp = workspace->mru_list;
-    while (tmp != NULL)
-      {
-        MetaWindow *window = tmp->data;
-        
-        if (window->minimized &&
-            window->screen == screen &&
-            IN_TAB_CHAIN (window, type))
-          tab_list = g_list_prepend (tab_list, window);
-        
-        tmp = tmp->next;
-      }
-  }
-
-  tab_list = g_list_reverse (tab_list);
-
-  {
-    GSList *tmp;
-    MetaWindow *l_window;
-
-    tmp = meta_display_list_windows (display, META_LIST_DEFAULT);
-
-    /* Go through all windows */
-    while (tmp != NULL)
-      {
-        l_window=tmp->data;
+  chain = get_tab_chain (display, type, screen, workspace);
 
-        /* Check to see if it demands attention */
-        if (l_window->wm_state_demands_attention && 
-            l_window->workspace!=workspace &&
-            IN_TAB_CHAIN (l_window, type)) 
-          {
-            /* if it does, add it to the popup */
-            tab_list = g_list_prepend (tab_list, l_window);
-          }
+  tab_list = NULL;
+  for (i = chain->windows->len - 1; i >= 0; i--)
+    tab_list = g_list_prepend (tab_list,
+                               g_ptr_array_index (chain->windows, i));
 
-        tmp = tmp->next;
-      } /* End while tmp!=NULL */
-  }
-  
   return tab_list;
 }
 
@@ -4646,46 +4808,42 @@ meta_display_get_tab_next (MetaDisplay   *display,
                            MetaWindow    *window,
                            gboolean       backward)
 {
-  gboolean skip;
-  GList *tab_list;
-  MetaWindow *ret;
-  tab_list = meta_display_get_tab_list(display,
-                                       type,
-                                       screen,
-                                       workspace);
+  MetaTabChain *chain;
+  guint n_windows;
+  guint i;
+
+  g_return_val_if_fail (workspace != NULL, NULL);
 
-  if (tab_list == NULL)
+  chain = get_tab_chain (display, type, screen, workspace);
+  n_windows = chain->windows->len;
+
+  if (n_windows == 0)
     return NULL;
   
   if (window != NULL)
     {
       g_assert (window->display == display);
-      
-      if (backward)
-        ret = find_tab_backward (display, type, screen, workspace,
-                                 g_list_find (tab_list,
-                                              window),
-                                 TRUE);
-      else
-        ret = find_tab_forward (display, type, screen, workspace,
-                                g_list_find (tab_list,
-                                             window),
-                                TRUE);
+
+      i = GPOINTER_TO_UINT (g_hash_table_lookup (chain->positions, window));
+      if (i == 0)
+        return NULL;
+      i--;
     }
   else
     {
-      skip = display->focus_window != NULL && 
-             tab_list->data == display->focus_window;
-      if (backward)
-        ret = find_tab_backward (display, type, screen, workspace,
-                                 tab_list, skip);
-      else
-        ret = find_tab_forward (display, type, screen, workspace,
-                                tab_list, skip);
+      /* Start from the first window, skipping it if it's focused */
+      i = 0;
+      if (display->focus_window == NULL ||
+          g_ptr_array_index (chain->windows, 0) != display->focus_window)
+        return g_ptr_array_index (chain->windows, 0);
     }
 
-  g_list_free (tab_list);
-  return ret;
+  if (backward)
+    i = (i + n_windows - 1) % n_windows;
+  else
+    i = (i + 1) % n_windows;
+
+  return g_ptr_array_index (chain->windows, i);
 }
 
 /**
@@ -671,62 +671,14 @@ apply_edge_resistance_to_each_side (MetaDisplay         *display,
 void
 meta_display_cleanup_edges (MetaDisplay *display)
 {
-  guint i,j;
   MetaEdgeResistanceData *edge_data = display->grab_edge_resistance_data;
-  GHashTable *edges_to_be_freed;
 
   if (edge_data == NULL) /* Not currently cached */
     return;
 
-  /* We first need to clean out any window edges */
-  edges_to_be_freed = g_hash_table_new_full (g_direct_hash, g_direct_equal,
-                                             g_free, NULL);
-  for (i = 0; i < 4; i++)
-    {
-      GArray *tmp = NULL;
-      MetaSide side;
-      switch (i)
-        {
-        case 0:
-          tmp = edge_data->left_edges;
-          side = META_SIDE_LEFT;
-          break;
-        case 1:
-          tmp = edge_data->right_edges;
-          side = META_SIDE_RIGHT;
-          break;
-        case 2:
-          tmp = edge_data->top_edges;
-          side = META_SIDE_TOP;
-          break;
-        case 3:
-          tmp = edge_data->bottom_edges;
-          side = META_SIDE_BOTTOM;
-          break;
-        default:
-          g_assert_not_reached ();
-        }
-
-      for (j = 0; j < tmp->len; j++)
-        {
-          MetaEdge *edge = g_array_index (tmp, MetaEdge*, j);
-          if (edge->edge_type == META_EDGE_WINDOW &&
-              edge->side_type == side)
-            {
-              /* The same edge will appear in two arrays, and we can't free
-               * it yet we still need to compare edge->side_type for the other
-               * array that it is in.  So store it in a hash table for later
-               * freeing.  Could also do this in a simple linked list.
-               */
-              g_hash_table_insert (edges_to_be_freed, edge, edge);
-            }
-        }
-    }
-
-  /* Now free all the window edges (the key destroy function is g_free) */
-  g_hash_table_destroy (edges_to_be_freed);
-
-  /* Now free the arrays and data */
+  /* The window edges belong to display->edge_cache and the monitor and
+   * screen edges to the workspace, so only the arrays need freeing.
+   */
   g_array_free (edge_data->left_edges, TRUE);
   g_array_free (edge_data->right_edges, TRUE);
   g_array_free (edge_data->top_edges, TRUE);
@@ -763,168 +715,625 @@ stupid_sort_requiring_extra_pointer_dereference (gconstpointer a,
   return meta_rectangle_edge_cmp_ignore_type (*a_edge, *b_edge);
 }
 
+/* Window edges are expensive to compute, since each one has to be clipped
+ * against every window stacked above it, but they only depend on the
+ * stacking order and outer rectangles of the relevant windows. So rather
+ * than throwing them away at the end of each grab, we keep them around
+ * and at the start of the next grab only recompute the edges of windows
+ * that could have been affected by whatever changed in between.
+ */
+typedef struct
+{
+  MetaWindow    *window; /* Only ever compared, never dereferenced */
+  MetaRectangle  rect;
+  gboolean       is_dock;
+  gboolean       edges_valid;
+  GList         *edges;
+} CachedWindowEdges;
+
+struct MetaEdgeCache
+{
+  MetaScreen    *screen;
+  MetaRectangle  screen_rect;
+
+  /* CachedWindowEdges for the relevant windows, from bottom to top */
+  GArray        *windows;
+
+  /* All of the window edges, sorted by
+   * meta_rectangle_edge_cmp_ignore_type()
+   */
+  GArray        *vertical_edges;
+  GArray        *horizontal_edges;
+};
+
 static void
-cache_edges (MetaDisplay *display,
-             GList *window_edges,
-             GList *monitor_edges,
-             GList *screen_edges)
+free_cached_window_edges (CachedWindowEdges *cached)
+{
+  g_list_foreach (cached->edges, (GFunc) g_free, NULL);
+  g_list_free (cached->edges);
+  cached->edges = NULL;
+  cached->edges_valid = FALSE;
+}
+
+void
+meta_display_free_edge_cache (MetaDisplay *display)
+{
+  MetaEdgeCache *cache = display->edge_cache;
+  guint i;
+
+  if (cache == NULL)
+    return;
+
+  for (i = 0; i < cache->windows->len; i++)
+    free_cached_window_edges (&g_array_index (cache->windows,
+                                              CachedWindowEdges, i));
+
+  g_array_free (cache->windows, TRUE);
+  g_array_free (cache->vertical_edges, TRUE);
+  g_array_free (cache->horizontal_edges, TRUE);
+  g_free (cache);
+
+  display->edge_cache = NULL;
+}
+
+/* Like meta_rectangle_overlap(), but also true for rectangles that
+ * merely touch, since an edge lying along the border of a window can
+ * still be split by it.
+ */
+static gboolean
+rectangles_touch (const MetaRectangle *a,
+                  const MetaRectangle *b)
+{
+  return a->x <= b->x + b->width  && b->x <= a->x + a->width &&
+         a->y <= b->y + b->height && b->y <= a->y + a->height;
+}
+
+static GList *
+compute_window_edges (const MetaRectangle *window_rect,
+                      const MetaRectangle *screen_rect,
+                      const GSList        *obscuring_windows)
+{
+  GList *new_edges;
+  MetaEdge *new_edge;
+  MetaRectangle reduced;
+
+  /* We don't care about snapping to any portion of the window that
+   * is offscreen (we also don't care about parts of edges covered
+   * by other windows or DOCKS, but that's handled below).
+   */
+  if (!meta_rectangle_intersect (window_rect, screen_rect, &reduced))
+    return NULL;
+
+  new_edges = NULL;
+
+  /* Left side of this window is resistance for the right edge of
+   * the window being moved.
+   */
+  new_edge = g_new (MetaEdge, 1);
+  new_edge->rect = reduced;
+  new_edge->rect.width = 0;
+  new_edge->side_type = META_SIDE_RIGHT;
+  new_edge->edge_type = META_EDGE_WINDOW;
+  new_edges = g_list_prepend (new_edges, new_edge);
+
+  /* Right side of this window is resistance for the left edge of
+   * the window being moved.
+   */
+  new_edge = g_new (MetaEdge, 1);
+  new_edge->rect = reduced;
+  new_edge->rect.x += new_edge->rect.width;
+  new_edge->rect.width = 0;
+  new_edge->side_type = META_SIDE_LEFT;
+  new_edge->edge_type = META_EDGE_WINDOW;
+  new_edges = g_list_prepend (new_edges, new_edge);
+
+  /* Top side of this window is resistance for the bottom edge of
+   * the window being moved.
+   */
+  new_edge = g_new (MetaEdge, 1);
+  new_edge->rect = reduced;
+  new_edge->rect.height = 0;
+  new_edge->side_type = META_SIDE_BOTTOM;
+  new_edge->edge_type = META_EDGE_WINDOW;
+  new_edges = g_list_prepend (new_edges, new_edge);
+
+  /* Top side of this window is resistance for the bottom edge of
+   * the window being moved.
+   */
+  new_edge = g_new (MetaEdge, 1);
+  new_edge->rect = reduced;
+  new_edge->rect.y += new_edge->rect.height;
+  new_edge->rect.height = 0;
+  new_edge->side_type = META_SIDE_TOP;
+  new_edge->edge_type = META_EDGE_WINDOW;
+  new_edges = g_list_prepend (new_edges, new_edge);
+
+  /* Remove edge portions overlapped by windows and docks above */
+  return meta_rectangle_remove_intersections_with_boxes_from_edges (
+           new_edges,
+           obscuring_windows);
+}
+
+static gboolean
+edge_is_vertical (const MetaEdge *edge)
+{
+  return edge->side_type == META_SIDE_LEFT ||
+         edge->side_type == META_SIDE_RIGHT;
+}
+
+static void
+insert_sorted_edge (GArray   *edges,
+                    MetaEdge *edge)
+{
+  int low, high, mid;
+
+  low = 0;
+  high = edges->len;
+  while (low < high)
+    {
+      mid = low + (high - low)/2;
+      if (meta_rectangle_edge_cmp_ignore_type (g_array_index (edges, MetaEdge*, mid),
+                                               edge) <= 0)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+  g_array_insert_val (edges, low, edge);
+}
+
+/* Removes the edges in the @stale set from @edges, preserving order */
+static void
+remove_stale_edges (GArray     *edges,
+                    GHashTable *stale)
+{
+  guint i, j;
+
+  for (i = 0, j = 0; i < edges->len; i++)
+    {
+      MetaEdge *edge = g_array_index (edges, MetaEdge*, i);
+      if (!g_hash_table_lookup (stale, edge))
+        g_array_index (edges, MetaEdge*, j++) = edge;
+    }
+
+  g_array_set_size (edges, j);
+}
+
+static void
+mark_edges_stale (GHashTable        *stale,
+                  CachedWindowEdges *cached)
 {
-  MetaEdgeResistanceData *edge_data;
   GList *tmp;
-  int num_left, num_right, num_top, num_bottom;
-  int i;
+
+  for (tmp = cached->edges; tmp; tmp = tmp->next)
+    g_hash_table_insert (stale, tmp->data, tmp->data);
+
+  /* The edges themselves are freed by the hash table */
+  g_list_free (cached->edges);
+  cached->edges = NULL;
+  cached->edges_valid = FALSE;
+}
+
+typedef struct
+{
+  GHashTable *positions;
+  guint above;
+  GArray *found;
+} FindObscuringData;
+
+static gboolean
+find_obscuring_window (MetaWindow          *window,
+                       const MetaRectangle *rect,
+                       gpointer             data)
+{
+  FindObscuringData *find_data = data;
+  guint position;
+
+  position = GPOINTER_TO_UINT (g_hash_table_lookup (find_data->positions,
+                                                    window));
+  if (position > find_data->above + 1)
+    g_array_append_val (find_data->found, position);
+
+  return FALSE;
+}
+
+static gint
+compare_positions (gconstpointer a,
+                   gconstpointer b)
+{
+  guint position_a = *(const guint *) a;
+  guint position_b = *(const guint *) b;
+
+  return position_a < position_b ? -1 : position_a > position_b;
+}
+
+/* Lists the rectangles of the windows above windows[above] that touch
+ * it, bottom to top.  positions maps each window of windows to its
+ * index + 1.
+ */
+static GSList *
+list_obscuring_rects (MetaScreen *screen,
+                      GArray     *windows,
+                      GHashTable *positions,
+                      guint       above)
+{
+  CachedWindowEdges *cached = &g_array_index (windows, CachedWindowEdges, above);
+  FindObscuringData find_data;
+  MetaRectangle touching;
+  GSList *rects;
+  guint i;
+
+  /* Overlapping this is the same as touching cached->rect */
+  touching = cached->rect;
+  touching.x -= 1;
+  touching.y -= 1;
+  touching.width += 2;
+  touching.height += 2;
+
+  find_data.positions = positions;
+  find_data.above = above;
+  find_data.found = g_array_new (FALSE, FALSE, sizeof (guint));
+  meta_screen_foreach_window_in_rect (screen, screen->active_workspace,
+                                      &touching, find_obscuring_window,
+                                      &find_data);
+  g_array_sort (find_data.found, compare_positions);
+
+  rects = NULL;
+  for (i = find_data.found->len; i > 0; i--)
+    {
+      guint position = g_array_index (find_data.found, guint, i - 1);
+      CachedWindowEdges *other = &g_array_index (windows, CachedWindowEdges,
+                                                 position - 1);
+      rects = g_slist_prepend (rects, &other->rect);
+    }
+  g_array_free (find_data.found, TRUE);
+
+  return rects;
+}
+
+static void
+update_edge_cache (MetaDisplay *display)
+{
+  MetaScreen *screen = display->grab_screen;
+  MetaEdgeCache *cache;
+  GList *stacked_windows, *tmp;
+  GArray *windows;
+  GArray *changed_rects;
+  GHashTable *old_positions;
+  GHashTable *stale;
+  GHashTable *positions;
+  GSList *obscuring_windows;
+  gboolean full_rebuild;
+  guint last_position;
+  guint n_recomputed;
+  guint i, j;
+
+  if (display->edge_cache == NULL)
+    {
+      cache = display->edge_cache = g_new0 (MetaEdgeCache, 1);
+      cache->windows = g_array_new (FALSE, FALSE, sizeof (CachedWindowEdges));
+      cache->vertical_edges = g_array_new (FALSE, FALSE, sizeof (MetaEdge*));
+      cache->horizontal_edges = g_array_new (FALSE, FALSE, sizeof (MetaEdge*));
+    }
+  cache = display->edge_cache;
+
+  full_rebuild = (cache->screen != screen ||
+                  !meta_rectangle_equal (&cache->screen_rect, &screen->rect));
 
   /*
-   * 0th: Print debugging information to the log about the edges
+   * 1st: Get the list of relevant windows, from bottom to top
    */
-#ifdef WITH_VERBOSE_MODE
-  if (meta_is_verbose())
+  windows = g_array_new (FALSE, TRUE, sizeof (CachedWindowEdges));
+
+  stacked_windows = meta_stack_list_windows (screen->stack,
+                                             screen->active_workspace);
+  for (tmp = stacked_windows; tmp != NULL; tmp = tmp->next)
     {
-      int max_edges = MAX (MAX( g_list_length (window_edges), 
-                                g_list_length (monitor_edges)),
-                           g_list_length (screen_edges));
-      char big_buffer[(EDGE_LENGTH+2)*max_edges];
+      MetaWindow *cur_window = tmp->data;
+      CachedWindowEdges cached;
+
+      if (!WINDOW_EDGES_RELEVANT (cur_window, display))
+        continue;
+
+      cached.window = cur_window;
+      meta_window_get_outer_rect (cur_window, &cached.rect);
+      cached.is_dock = cur_window->type == META_WINDOW_DOCK;
+      cached.edges_valid = FALSE;
+      cached.edges = NULL;
+      g_array_append_val (windows, cached);
+    }
+  g_list_free (stacked_windows);
 
-      meta_rectangle_edge_list_to_string (window_edges, ", ", big_buffer);
-      meta_topic (META_DEBUG_EDGE_RESISTANCE,
-                  "Window edges for resistance  : %s\n", big_buffer);
+  /*
+   * 2nd: Match the windows up with the ones we have cached edges for.
+   * Edges are taken over from windows that didn't move; the rectangles
+   * of everything that was added, removed or moved are collected so we
+   * can find out whose edges they might clip. If windows we already
+   * knew about changed their relative stacking, just start over.
+   */
+  changed_rects = g_array_new (FALSE, FALSE, sizeof (MetaRectangle));
+  old_positions = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < cache->windows->len; i++)
+    {
+      CachedWindowEdges *old = &g_array_index (cache->windows,
+                                               CachedWindowEdges, i);
+      g_hash_table_insert (old_positions, old->window, GUINT_TO_POINTER (i + 1));
+    }
 
-      meta_rectangle_edge_list_to_string (monitor_edges, ", ", big_buffer);
-      meta_topic (META_DEBUG_EDGE_RESISTANCE,
-                  "Monitor edges for resistance: %s\n", big_buffer);
+  last_position = 0;
+  for (i = 0; i < windows->len && !full_rebuild; i++)
+    {
+      CachedWindowEdges *cached = &g_array_index (windows, CachedWindowEdges, i);
+      CachedWindowEdges *old;
+      guint position;
 
-      meta_rectangle_edge_list_to_string (screen_edges, ", ", big_buffer);
-      meta_topic (META_DEBUG_EDGE_RESISTANCE,
-                  "Screen edges for resistance  : %s\n", big_buffer);
+      position = GPOINTER_TO_UINT (g_hash_table_lookup (old_positions,
+                                                        cached->window));
+      if (position == 0)
+        {
+          g_array_append_val (changed_rects, cached->rect);
+          continue;
+        }
+
+      if (position < last_position)
+        {
+          full_rebuild = TRUE;
+          break;
+        }
+      last_position = position;
+
+      g_hash_table_remove (old_positions, cached->window);
+
+      old = &g_array_index (cache->windows, CachedWindowEdges, position - 1);
+      if (meta_rectangle_equal (&old->rect, &cached->rect) &&
+          old->is_dock == cached->is_dock)
+        {
+          cached->edges = old->edges;
+          cached->edges_valid = old->edges_valid;
+          old->edges = NULL;
+          old->edges_valid = FALSE;
+        }
+      else
+        {
+          g_array_append_val (changed_rects, old->rect);
+          g_array_append_val (changed_rects, cached->rect);
+        }
     }
-#endif
+
+  /* Windows that went away also uncover what was below them */
+  for (i = 0; i < cache->windows->len && !full_rebuild; i++)
+    {
+      CachedWindowEdges *old = &g_array_index (cache->windows,
+                                               CachedWindowEdges, i);
+      if (g_hash_table_lookup (old_positions, old->window))
+        g_array_append_val (changed_rects, old->rect);
+    }
+  g_hash_table_destroy (old_positions);
 
   /*
-   * 1st: Get the total number of each kind of edge
+   * 3rd: Throw away the edges that can no longer be trusted: those of
+   * windows that went away or changed, and those of windows touching
+   * anything that changed.
    */
-  num_left = num_right = num_top = num_bottom = 0;
-  for (i = 0; i < 3; i++)
+  stale = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_free, NULL);
+
+  for (i = 0; i < cache->windows->len; i++)
+    mark_edges_stale (stale, &g_array_index (cache->windows,
+                                             CachedWindowEdges, i));
+
+  for (i = 0; i < windows->len; i++)
     {
-      tmp = NULL;
-      switch (i)
+      CachedWindowEdges *cached = &g_array_index (windows, CachedWindowEdges, i);
+
+      if (!cached->edges_valid)
+        continue;
+
+      if (full_rebuild)
         {
-        case 0:
-          tmp = window_edges;
-          break;
-        case 1:
-          tmp = monitor_edges;
-          break;
-        case 2:
-          tmp = screen_edges;
-          break;
-        default:
-          g_assert_not_reached ();
+          mark_edges_stale (stale, cached);
+          continue;
         }
 
-      while (tmp)
+      for (j = 0; j < changed_rects->len; j++)
         {
-          MetaEdge *edge = tmp->data;
-          switch (edge->side_type)
+          if (rectangles_touch (&cached->rect,
+                                &g_array_index (changed_rects, MetaRectangle, j)))
             {
-            case META_SIDE_LEFT:
-              num_left++;
+              mark_edges_stale (stale, cached);
               break;
-            case META_SIDE_RIGHT:
-              num_right++;
-              break;
-            case META_SIDE_TOP:
-              num_top++;
-              break;
-            case META_SIDE_BOTTOM:
-              num_bottom++;
-              break;
-            default:
-              g_assert_not_reached ();
             }
-          tmp = tmp->next;
         }
     }
+  g_array_free (changed_rects, TRUE);
 
-  /*
-   * 2nd: Allocate the edges
-   */
-  g_assert (display->grab_edge_resistance_data == NULL);
-  display->grab_edge_resistance_data = g_new0 (MetaEdgeResistanceData, 1);
-  edge_data = display->grab_edge_resistance_data;
-  edge_data->left_edges   = g_array_sized_new (FALSE,
-                                               FALSE,
-                                               sizeof(MetaEdge*),
-                                               num_left + num_right);
-  edge_data->right_edges  = g_array_sized_new (FALSE,
-                                               FALSE,
-                                               sizeof(MetaEdge*),
-                                               num_left + num_right);
-  edge_data->top_edges    = g_array_sized_new (FALSE,
-                                               FALSE,
-                                               sizeof(MetaEdge*),
-                                               num_top + num_bottom);
-  edge_data->bottom_edges = g_array_sized_new (FALSE,
-                                               FALSE,
-                                               sizeof(MetaEdge*),
-                                               num_top + num_bottom);
+  if (full_rebuild)
+    {
+      g_array_set_size (cache->vertical_edges, 0);
+      g_array_set_size (cache->horizontal_edges, 0);
+    }
+  else if (g_hash_table_size (stale) > 0)
+    {
+      remove_stale_edges (cache->vertical_edges, stale);
+      remove_stale_edges (cache->horizontal_edges, stale);
+    }
+
+  g_hash_table_destroy (stale);
 
   /*
-   * 3rd: Add the edges to the arrays
+   * 4th: Compute the edges that are missing, clipping each window's edges
+   * against the windows and docks above it that touch it, which we find
+   * in the spatial index of the workspace. Dock edges are considered
+   * screen edges which are handled separately.
    */
-  for (i = 0; i < 3; i++)
+  positions = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < windows->len; i++)
     {
-      tmp = NULL;
-      switch (i)
+      CachedWindowEdges *cached = &g_array_index (windows, CachedWindowEdges, i);
+      g_hash_table_insert (positions, cached->window, GUINT_TO_POINTER (i + 1));
+    }
+
+  n_recomputed = 0;
+  for (i = 0; i < windows->len; i++)
+    {
+      CachedWindowEdges *cached = &g_array_index (windows, CachedWindowEdges, i);
+
+      if (cached->edges_valid)
+        continue;
+
+      if (!cached->is_dock)
         {
-        case 0:
-          tmp = window_edges;
-          break;
-        case 1:
-          tmp = monitor_edges;
-          break;
-        case 2:
-          tmp = screen_edges;
-          break;
-        default:
-          g_assert_not_reached ();
+          obscuring_windows = list_obscuring_rects (screen, windows,
+                                                    positions, i);
+          cached->edges = compute_window_edges (&cached->rect, &screen->rect,
+                                                obscuring_windows);
+          g_slist_free (obscuring_windows);
         }
+      cached->edges_valid = TRUE;
+      n_recomputed++;
 
-      while (tmp)
+      for (tmp = cached->edges; tmp != NULL; tmp = tmp->next)
         {
           MetaEdge *edge = tmp->data;
-          switch (edge->side_type)
-            {
-            case META_SIDE_LEFT:
-            case META_SIDE_RIGHT:
-              g_array_append_val (edge_data->left_edges, edge);
-              g_array_append_val (edge_data->right_edges, edge);
-              break;
-            case META_SIDE_TOP:
-            case META_SIDE_BOTTOM:
-              g_array_append_val (edge_data->top_edges, edge);
-              g_array_append_val (edge_data->bottom_edges, edge);
-              break;
-            default:
-              g_assert_not_reached ();
-            }
-          tmp = tmp->next;
+          GArray *edges = edge_is_vertical (edge) ? cache->vertical_edges
+                                                  : cache->horizontal_edges;
+
+          if (full_rebuild)
+            g_array_append_val (edges, edge);
+          else
+            insert_sorted_edge (edges, edge);
+        }
+    }
+  g_hash_table_destroy (positions);
+
+  if (full_rebuild)
+    {
+      g_array_sort (cache->vertical_edges,
+                    stupid_sort_requiring_extra_pointer_dereference);
+      g_array_sort (cache->horizontal_edges,
+                    stupid_sort_requiring_extra_pointer_dereference);
+    }
+
+  g_array_free (cache->windows, TRUE);
+  cache->windows = windows;
+  cache->screen = screen;
+  cache->screen_rect = screen->rect;
+
+  meta_topic (META_DEBUG_EDGE_RESISTANCE,
+              "Recomputed edges of %u of %u windows%s\n",
+              n_recomputed, windows->len,
+              full_rebuild ? " (full rebuild)" : "");
+}
+
+/* Merges the already sorted window edges with the monitor and screen
+ * edges going in the same direction.
+ */
+static GArray *
+merge_edges (GArray   *window_edges,
+             GList    *monitor_edges,
+             GList    *screen_edges,
+             gboolean  vertical)
+{
+  GArray *other_edges, *result;
+  GList *tmp;
+  guint i, j;
+  int k;
+
+  other_edges = g_array_new (FALSE, FALSE, sizeof (MetaEdge*));
+  for (k = 0; k < 2; k++)
+    {
+      for (tmp = k == 0 ? monitor_edges : screen_edges; tmp; tmp = tmp->next)
+        {
+          MetaEdge *edge = tmp->data;
+          if (edge_is_vertical (edge) == vertical)
+            g_array_append_val (other_edges, edge);
         }
     }
+  g_array_sort (other_edges, stupid_sort_requiring_extra_pointer_dereference);
+
+  result = g_array_sized_new (FALSE, FALSE, sizeof (MetaEdge*),
+                              window_edges->len + other_edges->len);
+
+  i = j = 0;
+  while (i < window_edges->len || j < other_edges->len)
+    {
+      MetaEdge *edge;
+
+      if (j == other_edges->len ||
+          (i < window_edges->len &&
+           meta_rectangle_edge_cmp_ignore_type (g_array_index (window_edges, MetaEdge*, i),
+                                                g_array_index (other_edges, MetaEdge*, j)) <= 0))
+        edge = g_array_index (window_edges, MetaEdge*, i++);
+      else
+        edge = g_array_index (other_edges, MetaEdge*, j++);
+
+      g_array_append_val (result, edge);
+    }
+
+  g_array_free (other_edges, TRUE);
+
+  return result;
+}
+
+static GArray *
+copy_edges (GArray *edges)
+{
+  GArray *result;
+
+  result = g_array_sized_new (FALSE, FALSE, sizeof (MetaEdge*), edges->len);
+  g_array_append_vals (result, edges->data, edges->len);
+
+  return result;
+}
+
+static void
+cache_edges (MetaDisplay   *display,
+             MetaEdgeCache *cache,
+             GList         *monitor_edges,
+             GList         *screen_edges)
+{
+  MetaEdgeResistanceData *edge_data;
+
+  /*
+   * 0th: Print debugging information to the log about the edges
+   */
+#ifdef WITH_VERBOSE_MODE
+  if (meta_is_verbose())
+    {
+      int max_edges = MAX (g_list_length (monitor_edges),
+                           g_list_length (screen_edges));
+      char big_buffer[(EDGE_LENGTH+2)*max_edges];
+
+      meta_topic (META_DEBUG_EDGE_RESISTANCE,
+                  "Window edges for resistance  : %u vertical, %u horizontal\n",
+                  cache->vertical_edges->len, cache->horizontal_edges->len);
+
+      meta_rectangle_edge_list_to_string (monitor_edges, ", ", big_buffer);
+      meta_topic (META_DEBUG_EDGE_RESISTANCE,
+                  "Monitor edges for resistance: %s\n", big_buffer);
+
+      meta_rectangle_edge_list_to_string (screen_edges, ", ", big_buffer);
+      meta_topic (META_DEBUG_EDGE_RESISTANCE,
+                  "Screen edges for resistance  : %s\n", big_buffer);
+    }
+#endif
+
+  /*
+   * 1st: Allocate the edge data
+   */
+  g_assert (display->grab_edge_resistance_data == NULL);
+  display->grab_edge_resistance_data = g_new0 (MetaEdgeResistanceData, 1);
+  edge_data = display->grab_edge_resistance_data;
 
   /*
-   * 4th: Sort the arrays (FIXME: This is kinda dumb since the arrays were
-   * individually sorted earlier and we could have done this faster and
-   * avoided this sort by sticking them into the array with some simple
-   * merging of the lists).
+   * 2nd: Merge the sorted window edges with the monitor and screen edges.
+   * The left and right arrays (and top and bottom) have the same contents.
    */
-  g_array_sort (display->grab_edge_resistance_data->left_edges, 
-                stupid_sort_requiring_extra_pointer_dereference);
-  g_array_sort (display->grab_edge_resistance_data->right_edges, 
-                stupid_sort_requiring_extra_pointer_dereference);
-  g_array_sort (display->grab_edge_resistance_data->top_edges, 
-                stupid_sort_requiring_extra_pointer_dereference);
-  g_array_sort (display->grab_edge_resistance_data->bottom_edges, 
-                stupid_sort_requiring_extra_pointer_dereference);
+  edge_data->left_edges = merge_edges (cache->vertical_edges,
+                                       monitor_edges, screen_edges, TRUE);
+  edge_data->right_edges = copy_edges (edge_data->left_edges);
+  edge_data->top_edges = merge_edges (cache->horizontal_edges,
+                                      monitor_edges, screen_edges, FALSE);
+  edge_data->bottom_edges = copy_edges (edge_data->top_edges);
 }
 
 static void
@@ -946,191 +1355,27 @@ initialize_grab_edge_resistance_data (MetaDisplay *display)
 static void
 compute_resistance_and_snapping_edges (MetaDisplay *display)
 {
-  GList *stacked_windows;
-  GList *cur_window_iter;
-  GList *edges;
-  /* Lists of window positions (rects) and their relative stacking positions */
-  int stack_position;
-  GSList *obscuring_windows, *window_stacking;
-  /* The portions of the above lists that still remain at the stacking position
-   * in the layer that we are working on
-   */
-  GSList *rem_windows, *rem_win_stacking;
-
   g_assert (display->grab_window != NULL);
   meta_topic (META_DEBUG_WINDOW_OPS,
               "Computing edges to resist-movement or snap-to for %s.\n",
               display->grab_window->desc);
 
   /*
-   * 1st: Get the list of relevant windows, from bottom to top
-   */
-  stacked_windows = 
-    meta_stack_list_windows (display->grab_screen->stack,
-                             display->grab_screen->active_workspace);
-
-  /*
-   * 2nd: we need to separate that stacked list into a list of windows that
-   * can obscure other edges.  To make sure we only have windows obscuring
-   * those below it instead of going both ways, we also need to keep a
-   * counter list.  Messy, I know.
-   */
-  obscuring_windows = window_stacking = NULL;
-  cur_window_iter = stacked_windows;
-  stack_position = 0;
-  while (cur_window_iter != NULL)
-    {
-      MetaWindow *cur_window = cur_window_iter->data;
-      if (WINDOW_EDGES_RELEVANT (cur_window, display))
-        {
-          MetaRectangle *new_rect;
-          new_rect = g_new (MetaRectangle, 1);
-          meta_window_get_outer_rect (cur_window, new_rect);
-          obscuring_windows = g_slist_prepend (obscuring_windows, new_rect);
-          window_stacking = 
-            g_slist_prepend (window_stacking, GINT_TO_POINTER (stack_position));
-        }
-
-      stack_position++;
-      cur_window_iter = cur_window_iter->next;
-    }
-  /* Put 'em in bottom to top order */
-  rem_windows = obscuring_windows = g_slist_reverse (obscuring_windows);
-  rem_win_stacking = window_stacking = g_slist_reverse (window_stacking);
-
-  /*
-   * 3rd: loop over the windows again, this time getting the edges from
-   * them and removing intersections with the relevant obscuring_windows &
-   * obscuring_docks.
-   */
-  edges = NULL;
-  stack_position = 0;
-  cur_window_iter = stacked_windows;
-  while (cur_window_iter != NULL)
-    {
-      MetaRectangle  cur_rect;
-      MetaWindow    *cur_window = cur_window_iter->data;
-      meta_window_get_outer_rect (cur_window, &cur_rect);
-
-      /* Check if we want to use this window's edges for edge
-       * resistance (note that dock edges are considered screen edges
-       * which are handled separately
-       */
-      if (WINDOW_EDGES_RELEVANT (cur_window, display) &&
-          cur_window->type != META_WINDOW_DOCK)
-        {
-          GList *new_edges;
-          MetaEdge *new_edge;
-          MetaRectangle reduced;
-
-          /* We don't care about snapping to any portion of the window that
-           * is offscreen (we also don't care about parts of edges covered
-           * by other windows or DOCKS, but that's handled below).
-           */
-          meta_rectangle_intersect (&cur_rect, 
-                                    &display->grab_screen->rect,
-                                    &reduced);
-
-          new_edges = NULL;
-
-          /* Left side of this window is resistance for the right edge of
-           * the window being moved.
-           */
-          new_edge = g_new (MetaEdge, 1);
-          new_edge->rect = reduced;
-          new_edge->rect.width = 0;
-          new_edge->side_type = META_SIDE_RIGHT;
-          new_edge->edge_type = META_EDGE_WINDOW;
-          new_edges = g_list_prepend (new_edges, new_edge);
-
-          /* Right side of this window is resistance for the left edge of
-           * the window being moved.
-           */
-          new_edge = g_new (MetaEdge, 1);
-          new_edge->rect = reduced;
-          new_edge->rect.x += new_edge->rect.width;
-          new_edge->rect.width = 0;
-          new_edge->side_type = META_SIDE_LEFT;
-          new_edge->edge_type = META_EDGE_WINDOW;
-          new_edges = g_list_prepend (new_edges, new_edge);
-          
-          /* Top side of this window is resistance for the bottom edge of
-           * the window being moved.
-           */
-          new_edge = g_new (MetaEdge, 1);
-          new_edge->rect = reduced;
-          new_edge->rect.height = 0;
-          new_edge->side_type = META_SIDE_BOTTOM;
-          new_edge->edge_type = META_EDGE_WINDOW;
-          new_edges = g_list_prepend (new_edges, new_edge);
-
-          /* Top side of this window is resistance for the bottom edge of
-           * the window being moved.
-           */
-          new_edge = g_new (MetaEdge, 1);
-          new_edge->rect = reduced;
-          new_edge->rect.y += new_edge->rect.height;
-          new_edge->rect.height = 0;
-          new_edge->side_type = META_SIDE_TOP;
-          new_edge->edge_type = META_EDGE_WINDOW;
-          new_edges = g_list_prepend (new_edges, new_edge);
-
-          /* Update the remaining windows to only those at a higher
-           * stacking position than this one.
-           */
-          while (rem_win_stacking && 
-                 stack_position >= GPOINTER_TO_INT (rem_win_stacking->data))
-            {
-              rem_windows      = rem_windows->next;
-              rem_win_stacking = rem_win_stacking->next;
-            }
-
-          /* Remove edge portions overlapped by rem_windows and rem_docks */
-          new_edges = 
-            meta_rectangle_remove_intersections_with_boxes_from_edges (
-              new_edges,
-              rem_windows);
-
-          /* Save the new edges */
-          edges = g_list_concat (new_edges, edges);
-        }
-
-      stack_position++;
-      cur_window_iter = cur_window_iter->next;
-    }
-
-  /*
-   * 4th: Free the extra memory not needed and sort the list
-   */
-  g_list_free (stacked_windows);
-  /* Free the memory used by the obscuring windows/docks lists */
-  g_slist_free (window_stacking);
-  /* FIXME: Shouldn't there be a helper function to make this one line of code
-   * to free a list instead of four ugly ones?
-   */
-  g_slist_foreach (obscuring_windows, 
-                   (void (*)(gpointer,gpointer))&g_free, /* ew, for ugly */
-                   NULL);
-  g_slist_free (obscuring_windows);
-
-  /* Sort the list.  FIXME: Should I bother with this sorting?  I just
-   * sort again later in cache_edges() anyway...
+   * 1st: Bring the cached window edges up to date
    */
-  edges = g_list_sort (edges, meta_rectangle_edge_cmp);
+  update_edge_cache (display);
 
   /*
-   * 5th: Cache the combination of these edges with the onscreen and
-   * monitor edges in an array for quick access.  Free the edges since
-   * they've been cached elsewhere.
+   * 2nd: Combine these edges with the onscreen and monitor edges in
+   * arrays for quick access.
    */
   cache_edges (display,
-               edges,
+               display->edge_cache,
                display->grab_screen->active_workspace->monitor_edges,
                display->grab_screen->active_workspace->screen_edges);
-  g_list_free (edges);
 
   /*
-   * 6th: Initialize the resistance timeouts and buildups
+   * 3rd: Initialize the resistance timeouts and buildups
    */
   initialize_grab_edge_resistance_data (display);
 }
@@ -41,6 +41,71 @@
  * (See https://bugzilla.gnome.org/show_bug.cgi?id=630216 for restoring logging.)
  */
 
+/**
+ * meta_display_init_error_traps: (skip)
+ * @display: a #MetaDisplay
+ *
+ * Sets up counting the syncs meta_error_trap_pop_with_return() makes.
+ */
+void
+meta_display_init_error_traps (MetaDisplay *display)
+{
+  display->error_trap_syncs = g_hash_table_new (g_str_hash, g_str_equal);
+  display->error_trap_syncs_avoided = 0;
+}
+
+static void
+print_error_trap_syncs (gpointer key,
+                        gpointer value,
+                        gpointer data)
+{
+  meta_verbose ("  %u at %s\n", GPOINTER_TO_UINT (value), (const char *) key);
+}
+
+/**
+ * meta_display_shutdown_error_traps: (skip)
+ * @display: a #MetaDisplay
+ *
+ * Logs where meta_error_trap_pop_with_return() had to sync.
+ */
+void
+meta_display_shutdown_error_traps (MetaDisplay *display)
+{
+  meta_verbose ("Error traps avoided %u syncs; synced at:\n",
+                display->error_trap_syncs_avoided);
+  g_hash_table_foreach (display->error_trap_syncs,
+                        print_error_trap_syncs, NULL);
+  g_hash_table_destroy (display->error_trap_syncs);
+  display->error_trap_syncs = NULL;
+}
+
+/* GDK only syncs when popping a trap if the server hasn't processed
+ * the last request yet; count the pops at each location that will.
+ */
+static void
+count_error_trap_sync (MetaDisplay *display,
+                       const char  *location)
+{
+  guint n_syncs;
+
+  if (XLastKnownRequestProcessed (display->xdisplay) ==
+      XNextRequest (display->xdisplay) - 1)
+    {
+      display->error_trap_syncs_avoided++;
+      return;
+    }
+
+  n_syncs = GPOINTER_TO_UINT (g_hash_table_lookup (display->error_trap_syncs,
+                                                   location));
+  g_hash_table_insert (display->error_trap_syncs, (gpointer) location,
+                       GUINT_TO_POINTER (n_syncs + 1));
+
+  meta_topic (META_DEBUG_SYNC,
+              "Syncing to pop error trap at %s "
+              "(%u times there, %u syncs avoided so far)\n",
+              location, n_syncs + 1, display->error_trap_syncs_avoided);
+}
+
 void
 meta_error_trap_push (MetaDisplay *display)
 {
@@ -60,7 +125,19 @@ meta_error_trap_push_with_return (MetaDisplay *display)
 }
 
 int
-meta_error_trap_pop_with_return  (MetaDisplay *display)
+meta_error_trap_pop_with_return_at (MetaDisplay *display,
+                                    const char  *location)
 {
+  if (display->error_trap_syncs != NULL)
+    count_error_trap_sync (display, location);
+
   return gdk_error_trap_pop ();
 }
+
+/* For callers that weren't built with the macro in errors.h */
+#undef meta_error_trap_pop_with_return
+int
+meta_error_trap_pop_with_return (MetaDisplay *display)
+{
+  return meta_error_trap_pop_with_return_at (display, "unknown location");
+}
@@ -115,6 +115,8 @@ meta_window_ensure_frame (MetaWindow *window)
 			   frame->xwindow, CWEventMask, &attrs);
   
   meta_display_register_x_window (window->display, &frame->xwindow, window);
+  meta_stack_tracker_set_toplevel (window->screen->stack_tracker,
+                                   frame->xwindow, window);
 
   /* Reparent the client window; it may be destroyed,
    * thus the error trap. We'll get a destroy notify later
@@ -151,6 +153,7 @@ meta_window_ensure_frame (MetaWindow *window)
   
   /* stick frame to the window */
   window->frame = frame;
+  meta_window_update_spatial_index (window);
 
   /* Now that frame->xwindow is registered with window, we can set its
    * style and background.
@@ -215,8 +218,11 @@ meta_window_destroy_frame (MetaWindow *window)
 
   meta_display_unregister_x_window (window->display,
                                     frame->xwindow);
+  meta_stack_tracker_set_toplevel (window->screen->stack_tracker,
+                                   frame->xwindow, NULL);
   
   window->frame = NULL;
+  meta_window_update_spatial_index (window);
 
   /* Move keybindings to window instead of frame */
   meta_window_grab_keys (window);
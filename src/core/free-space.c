@@ -0,0 +1,253 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Free space tracking for window placement */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <config.h>
+#include "free-space.h"
+
+struct _MetaFreeSpace
+{
+  MetaRectangle area;
+
+  /* The maximal free rectangles, sorted by area, then topmost, then
+   * leftmost, so that the smallest ones a window fits in are found
+   * with a binary search.
+   */
+  GArray *rects;
+
+  /* Scratch array for the parts of split rectangles */
+  GArray *pieces;
+};
+
+static inline int
+rect_area (const MetaRectangle *rect)
+{
+  return rect->width * rect->height;
+}
+
+static int
+compare_rects (gconstpointer a,
+               gconstpointer b)
+{
+  const MetaRectangle *rect_a = a;
+  const MetaRectangle *rect_b = b;
+  int area_a = rect_area (rect_a);
+  int area_b = rect_area (rect_b);
+
+  if (area_a != area_b)
+    return area_a < area_b ? -1 : 1;
+  else if (rect_a->y != rect_b->y)
+    return rect_a->y < rect_b->y ? -1 : 1;
+  else if (rect_a->x != rect_b->x)
+    return rect_a->x < rect_b->x ? -1 : 1;
+  else if (rect_a->width != rect_b->width)
+    return rect_a->width < rect_b->width ? -1 : 1;
+  else
+    return 0;
+}
+
+/* The index of the first rectangle with at least the given area among
+ * the first n_rects, sorted, rectangles of rects
+ */
+static guint
+find_first_with_area (GArray *rects,
+                      guint   n_rects,
+                      int     area)
+{
+  guint lo = 0;
+  guint hi = n_rects;
+
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+
+      if (rect_area (&g_array_index (rects, MetaRectangle, mid)) < area)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+MetaFreeSpace *
+meta_free_space_new (const MetaRectangle *area)
+{
+  MetaFreeSpace *space = g_new (MetaFreeSpace, 1);
+
+  space->area = *area;
+  space->rects = g_array_new (FALSE, FALSE, sizeof (MetaRectangle));
+  space->pieces = g_array_new (FALSE, FALSE, sizeof (MetaRectangle));
+
+  if (area->width > 0 && area->height > 0)
+    g_array_append_val (space->rects, *area);
+
+  return space;
+}
+
+void
+meta_free_space_free (MetaFreeSpace *space)
+{
+  g_array_free (space->rects, TRUE);
+  g_array_free (space->pieces, TRUE);
+  g_free (space);
+}
+
+static void
+add_piece (MetaFreeSpace *space,
+           int            x,
+           int            y,
+           int            width,
+           int            height)
+{
+  MetaRectangle piece = meta_rect (x, y, width, height);
+
+  g_array_append_val (space->pieces, piece);
+}
+
+/* Whether a piece is contained in another rectangle.  The rectangles
+ * that weren't split can't be contained in a piece, since they were
+ * maximal and the pieces are parts of rectangles next to them.
+ */
+static gboolean
+piece_is_contained (MetaFreeSpace *space,
+                    guint          n_kept,
+                    guint          which)
+{
+  MetaRectangle *piece = &g_array_index (space->pieces, MetaRectangle, which);
+  guint i;
+
+  /* Smaller rectangles can't contain it */
+  for (i = find_first_with_area (space->rects, n_kept, rect_area (piece));
+       i < n_kept;
+       i++)
+    {
+      if (meta_rectangle_contains_rect (&g_array_index (space->rects,
+                                                        MetaRectangle, i),
+                                        piece))
+        return TRUE;
+    }
+
+  for (i = 0; i < space->pieces->len; i++)
+    {
+      MetaRectangle *other = &g_array_index (space->pieces, MetaRectangle, i);
+
+      if (i == which || !meta_rectangle_contains_rect (other, piece))
+        continue;
+
+      /* Of identical pieces, keep the first */
+      if (!meta_rectangle_equal (other, piece) || i < which)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+void
+meta_free_space_add_obstacle (MetaFreeSpace       *space,
+                              const MetaRectangle *obstacle)
+{
+  MetaRectangle clipped;
+  guint i, n_kept;
+
+  if (!meta_rectangle_intersect (&space->area, obstacle, &clipped))
+    return;
+
+  g_array_set_size (space->pieces, 0);
+
+  /* Replace each free rectangle the obstacle overlaps with the parts of
+   * it on each side of the obstacle, keeping the others in order.
+   */
+  n_kept = 0;
+  for (i = 0; i < space->rects->len; i++)
+    {
+      MetaRectangle rect = g_array_index (space->rects, MetaRectangle, i);
+
+      if (!meta_rectangle_overlap (&rect, &clipped))
+        {
+          g_array_index (space->rects, MetaRectangle, n_kept++) = rect;
+          continue;
+        }
+
+      if (clipped.x > rect.x)
+        add_piece (space, rect.x, rect.y,
+                   clipped.x - rect.x, rect.height);
+      if (clipped.x + clipped.width < rect.x + rect.width)
+        add_piece (space, clipped.x + clipped.width, rect.y,
+                   rect.x + rect.width - (clipped.x + clipped.width),
+                   rect.height);
+      if (clipped.y > rect.y)
+        add_piece (space, rect.x, rect.y,
+                   rect.width, clipped.y - rect.y);
+      if (clipped.y + clipped.height < rect.y + rect.height)
+        add_piece (space, rect.x, clipped.y + clipped.height,
+                   rect.width,
+                   rect.y + rect.height - (clipped.y + clipped.height));
+    }
+
+  g_array_set_size (space->rects, n_kept);
+
+  if (space->pieces->len == 0)
+    return;
+
+  /* Only the pieces no other rectangle contains are maximal */
+  for (i = 0; i < space->pieces->len; i++)
+    {
+      if (!piece_is_contained (space, n_kept, i))
+        g_array_append_val (space->rects,
+                            g_array_index (space->pieces, MetaRectangle, i));
+    }
+
+  g_array_sort (space->rects, compare_rects);
+}
+
+gboolean
+meta_free_space_find_best_fit (MetaFreeSpace *space,
+                               int            width,
+                               int            height,
+                               MetaRectangle *fit)
+{
+  guint i;
+
+  for (i = find_first_with_area (space->rects, space->rects->len,
+                                 width * height);
+       i < space->rects->len;
+       i++)
+    {
+      MetaRectangle *rect = &g_array_index (space->rects, MetaRectangle, i);
+
+      if (rect->width >= width && rect->height >= height)
+        {
+          *fit = *rect;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+const MetaRectangle *
+meta_free_space_get_rects (MetaFreeSpace *space,
+                           int           *n_rects)
+{
+  *n_rects = space->rects->len;
+
+  return (const MetaRectangle *) space->rects->data;
+}
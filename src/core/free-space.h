@@ -0,0 +1,53 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Free space tracking for window placement */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef META_FREE_SPACE_H
+#define META_FREE_SPACE_H
+
+#include <glib.h>
+#include <meta/boxes.h>
+
+/* A MetaFreeSpace keeps the maximal rectangles of an area (a monitor's
+ * work area) that aren't covered by any of a set of obstacles (the
+ * windows on it).  Every rectangle a window could be placed in without
+ * overlapping an obstacle lies inside one of them, and adding an
+ * obstacle only splits the free rectangles it overlaps.
+ */
+typedef struct _MetaFreeSpace MetaFreeSpace;
+
+MetaFreeSpace *meta_free_space_new  (const MetaRectangle *area);
+void           meta_free_space_free (MetaFreeSpace       *space);
+
+void meta_free_space_add_obstacle (MetaFreeSpace       *space,
+                                   const MetaRectangle *obstacle);
+
+/* Finds the smallest free rectangle that a width x height rectangle
+ * fits in, preferring the topmost, then leftmost, of equal ones.
+ */
+gboolean meta_free_space_find_best_fit (MetaFreeSpace *space,
+                                        int            width,
+                                        int            height,
+                                        MetaRectangle *fit);
+
+const MetaRectangle *meta_free_space_get_rects (MetaFreeSpace *space,
+                                                int           *n_rects);
+
+#endif
@@ -165,6 +165,7 @@ meta_window_compute_group (MetaWindow* window)
     }
 
   window->group->windows = g_slist_prepend (window->group->windows, window);
+  meta_display_invalidate_tab_lists (window->display);
 
   meta_topic (META_DEBUG_GROUPS,
               "Adding %s to group with leader 0x%lx\n",
@@ -186,6 +187,7 @@ remove_window_from_group (MetaWindow *window)
                         window);
       meta_group_unref (window->group);
       window->group = NULL;
+      meta_display_invalidate_tab_lists (window->display);
     }
 }
 
@@ -23,13 +23,18 @@
 
 #include <config.h>
 #include "iconcache.h"
+#include "window-private.h"
+#include "async-getprop.h"
 #include "ui.h"
 #include <meta/errors.h>
 
 #include <X11/Xatom.h>
+#include <string.h>
 
 /* The icon-reading code is also in libwnck, please sync bugfixes */
 
+static void drop_net_wm_icon (MetaIconCache *icon_cache);
+
 static void
 get_fallback_icons (MetaScreen     *screen,
                     GdkPixbuf     **iconp,
@@ -175,7 +180,7 @@ find_best_size (gulong  *data,
 }
 
 static void
-argbdata_to_pixdata (gulong *argb_data, int len, guchar **pixdata)
+argbdata_to_pixdata (const guint32 *argb_data, int len, guchar **pixdata)
 {
   guchar *p;
   int i;
@@ -206,85 +211,6 @@ argbdata_to_pixdata (gulong *argb_data, int len, guchar **pixdata)
     }
 }
 
-static gboolean
-read_rgb_icon (MetaDisplay   *display,
-               Window         xwindow,
-               int            ideal_width,
-               int            ideal_height,
-               int            ideal_mini_width,
-               int            ideal_mini_height,
-               int           *width,
-               int           *height,
-               guchar       **pixdata,
-               int           *mini_width,
-               int           *mini_height,
-               guchar       **mini_pixdata)
-{
-  Atom type;
-  int format;
-  gulong nitems;
-  gulong bytes_after;
-  int result, err;
-  guchar *data;
-  gulong *best;
-  int w, h;
-  gulong *best_mini;
-  int mini_w, mini_h;
-  gulong *data_as_long;
-
-  meta_error_trap_push_with_return (display);
-  type = None;
-  data = NULL;
-  result = XGetWindowProperty (display->xdisplay,
-			       xwindow,
-                               display->atom__NET_WM_ICON,
-			       0, G_MAXLONG,
-			       False, XA_CARDINAL, &type, &format, &nitems,
-			       &bytes_after, &data);
-  err = meta_error_trap_pop_with_return (display);
-
-  if (err != Success ||
-      result != Success)
-    return FALSE;
-
-  if (type != XA_CARDINAL)
-    {
-      XFree (data);
-      return FALSE;
-    }
-
-  data_as_long = (gulong *)data;
-
-  if (!find_best_size (data_as_long, nitems,
-                       ideal_width, ideal_height,
-                       &w, &h, &best))
-    {
-      XFree (data);
-      return FALSE;
-    }
-
-  if (!find_best_size (data_as_long, nitems,
-                       ideal_mini_width, ideal_mini_height,
-                       &mini_w, &mini_h, &best_mini))
-    {
-      XFree (data);
-      return FALSE;
-    }
-
-  *width = w;
-  *height = h;
-
-  *mini_width = mini_w;
-  *mini_height = mini_h;
-
-  argbdata_to_pixdata (best, w * h, pixdata);
-  argbdata_to_pixdata (best_mini, mini_w * mini_h, mini_pixdata);
-
-  XFree (data);
-
-  return TRUE;
-}
-
 static void
 free_pixels (guchar *pixels, gpointer data)
 {
@@ -556,6 +482,8 @@ meta_icon_cache_init (MetaIconCache *icon_cache)
   icon_cache->wm_hints_dirty = TRUE;
   icon_cache->kwm_win_icon_dirty = TRUE;
   icon_cache->net_wm_icon_dirty = TRUE;
+  icon_cache->net_wm_icon_fetch = NULL;
+  icon_cache->net_wm_icon = NULL;
 }
 
 static void
@@ -585,6 +513,7 @@ clear_icon_cache (MetaIconCache *icon_cache,
 void
 meta_icon_cache_free (MetaIconCache *icon_cache)
 {
+  drop_net_wm_icon (icon_cache);
   clear_icon_cache (icon_cache, FALSE);
 }
 
@@ -594,7 +523,11 @@ meta_icon_cache_property_changed (MetaIconCache *icon_cache,
                                   Atom           atom)
 {
   if (atom == display->atom__NET_WM_ICON)
-    icon_cache->net_wm_icon_dirty = TRUE;
+    {
+      /* Whatever we were loading or had loaded is out of date now */
+      drop_net_wm_icon (icon_cache);
+      icon_cache->net_wm_icon_dirty = TRUE;
+    }
   else if (atom == display->atom__KWM_WIN_ICON)
     icon_cache->kwm_win_icon_dirty = TRUE;
   else if (atom == XA_WM_HINTS)
@@ -704,6 +637,449 @@ scaled_from_pixdata (guchar *pixdata,
   return dest;
 }
 
+/* _NET_WM_ICON loading
+ *
+ * _NET_WM_ICON can be a megabyte or more for applications that ship
+ * 256x256 icons, so rather than a blocking XGetWindowProperty() it is
+ * requested with async-getprop.  Once the reply is in, the two sizes we
+ * want are picked out and handed to a worker thread to convert and
+ * scale, and the window's icon is updated when that's done.  In the
+ * meantime the window keeps its old icon, or gets one from the other
+ * sources.
+ *
+ * Decoded icons are kept in a table keyed on the pixels picked out, so
+ * that the windows of an application share a single decoded and scaled
+ * copy of its icon.
+ */
+
+struct _MetaIconFetch
+{
+  MetaDisplay       *display;
+  Window             xwindow;
+  AgGetPropertyTask *task;
+
+  /* NULL once the icon cache no longer wants the result */
+  MetaIconCache     *icon_cache;
+
+  int ideal_width;
+  int ideal_height;
+  int ideal_mini_width;
+  int ideal_mini_height;
+};
+
+struct _MetaIconData
+{
+  int          ref_count;
+  guint        hash;
+  MetaDisplay *display;
+
+  int ideal_width;
+  int ideal_height;
+  int ideal_mini_width;
+  int ideal_mini_height;
+
+  /* The ARGB pixels of the icon then of the mini icon */
+  guint32 *pixels;
+  int      width;
+  int      height;
+  int      mini_width;
+  int      mini_height;
+
+  /* Written by the worker thread, and only looked at once decoded is set */
+  GdkPixbuf *icon;
+  GdkPixbuf *mini_icon;
+  guint      decoded : 1;
+};
+
+static GSList      *pending_fetches = NULL;
+static GSource     *fetch_source = NULL;
+static GHashTable  *icon_data_table = NULL;
+static GThreadPool *decode_pool = NULL;
+
+static guint
+icon_data_hash (gconstpointer key)
+{
+  return ((const MetaIconData *) key)->hash;
+}
+
+static gboolean
+icon_data_equal (gconstpointer a,
+                 gconstpointer b)
+{
+  const MetaIconData *data_a = a;
+  const MetaIconData *data_b = b;
+
+  return data_a->ideal_width == data_b->ideal_width &&
+         data_a->ideal_height == data_b->ideal_height &&
+         data_a->ideal_mini_width == data_b->ideal_mini_width &&
+         data_a->ideal_mini_height == data_b->ideal_mini_height &&
+         data_a->width == data_b->width &&
+         data_a->height == data_b->height &&
+         data_a->mini_width == data_b->mini_width &&
+         data_a->mini_height == data_b->mini_height &&
+         memcmp (data_a->pixels, data_b->pixels,
+                 (data_a->width * data_a->height +
+                  data_a->mini_width * data_a->mini_height) * 4) == 0;
+}
+
+static void
+icon_data_unref (MetaIconData *data)
+{
+  data->ref_count--;
+  if (data->ref_count > 0)
+    return;
+
+  g_hash_table_remove (icon_data_table, data);
+
+  if (data->icon)
+    g_object_unref (G_OBJECT (data->icon));
+  if (data->mini_icon)
+    g_object_unref (G_OBJECT (data->mini_icon));
+
+  g_free (data->pixels);
+  g_free (data);
+}
+
+static void
+drop_net_wm_icon (MetaIconCache *icon_cache)
+{
+  if (icon_cache->net_wm_icon_fetch)
+    {
+      /* The reply still has to be collected, fetch_dispatch() will
+       * throw it away */
+      icon_cache->net_wm_icon_fetch->icon_cache = NULL;
+      icon_cache->net_wm_icon_fetch = NULL;
+    }
+
+  if (icon_cache->net_wm_icon)
+    {
+      icon_data_unref (icon_cache->net_wm_icon);
+      icon_cache->net_wm_icon = NULL;
+    }
+}
+
+static void
+queue_icon_update (MetaDisplay *display,
+                   Window       xwindow)
+{
+  MetaWindow *window;
+
+  window = meta_display_lookup_x_window (display, xwindow);
+  if (window && !window->override_redirect)
+    meta_window_queue (window, META_QUEUE_UPDATE_ICON);
+}
+
+static gboolean
+icon_data_decoded (gpointer user_data)
+{
+  MetaIconData *data = user_data;
+  GSList *windows, *tmp;
+
+  data->decoded = TRUE;
+
+  if (!data->icon || !data->mini_icon)
+    {
+      if (data->icon)
+        g_object_unref (G_OBJECT (data->icon));
+      if (data->mini_icon)
+        g_object_unref (G_OBJECT (data->mini_icon));
+      data->icon = NULL;
+      data->mini_icon = NULL;
+    }
+
+  windows = meta_display_list_windows (data->display, META_LIST_DEFAULT);
+  for (tmp = windows; tmp; tmp = tmp->next)
+    {
+      MetaWindow *window = tmp->data;
+
+      if (window->icon_cache.net_wm_icon == data)
+        meta_window_queue (window, META_QUEUE_UPDATE_ICON);
+    }
+  g_slist_free (windows);
+
+  /* Drop the worker's reference */
+  icon_data_unref (data);
+
+  return FALSE;
+}
+
+/* Runs in the decode thread */
+static void
+decode_icon_data (gpointer job,
+                  gpointer user_data)
+{
+  MetaIconData *data = job;
+  guchar *pixdata;
+  guchar *mini_pixdata;
+
+  argbdata_to_pixdata (data->pixels,
+                       data->width * data->height,
+                       &pixdata);
+  argbdata_to_pixdata (data->pixels + data->width * data->height,
+                       data->mini_width * data->mini_height,
+                       &mini_pixdata);
+
+  data->icon = scaled_from_pixdata (pixdata,
+                                    data->width, data->height,
+                                    data->ideal_width, data->ideal_height);
+  data->mini_icon = scaled_from_pixdata (mini_pixdata,
+                                         data->mini_width, data->mini_height,
+                                         data->ideal_mini_width,
+                                         data->ideal_mini_height);
+
+  g_idle_add (icon_data_decoded, data);
+}
+
+static guint32 *
+copy_argb_data (guint32      *dest,
+                const gulong *argb_data,
+                int           len)
+{
+  int i;
+
+  for (i = 0; i < len; i++)
+    dest[i] = argb_data[i];
+
+  return dest + len;
+}
+
+/* Finds the icon data for the sizes we want from _NET_WM_ICON, starting
+ * to decode them if nobody has yet; returns a new reference, or NULL if
+ * the property has nothing usable.
+ */
+static MetaIconData *
+get_icon_data (MetaIconFetch *fetch,
+               gulong        *data_as_long,
+               gulong         nitems)
+{
+  MetaIconData key;
+  MetaIconData *data;
+  gulong *best, *best_mini;
+  guint32 *end;
+  guint hash;
+  int n_pixels, i;
+
+  if (!find_best_size (data_as_long, nitems,
+                       fetch->ideal_width, fetch->ideal_height,
+                       &key.width, &key.height, &best))
+    return NULL;
+
+  if (!find_best_size (data_as_long, nitems,
+                       fetch->ideal_mini_width, fetch->ideal_mini_height,
+                       &key.mini_width, &key.mini_height, &best_mini))
+    return NULL;
+
+  key.ideal_width = fetch->ideal_width;
+  key.ideal_height = fetch->ideal_height;
+  key.ideal_mini_width = fetch->ideal_mini_width;
+  key.ideal_mini_height = fetch->ideal_mini_height;
+
+  n_pixels = key.width * key.height + key.mini_width * key.mini_height;
+  key.pixels = g_new (guint32, n_pixels);
+  end = copy_argb_data (key.pixels, best, key.width * key.height);
+  copy_argb_data (end, best_mini, key.mini_width * key.mini_height);
+
+  /* FNV-1a over the pixels and sizes */
+  hash = 2166136261u;
+  for (i = 0; i < n_pixels; i++)
+    hash = (hash ^ key.pixels[i]) * 16777619u;
+  hash = (hash ^ (key.width << 16 | key.height)) * 16777619u;
+  hash = (hash ^ (key.mini_width << 16 | key.mini_height)) * 16777619u;
+  key.hash = hash;
+
+  if (icon_data_table == NULL)
+    icon_data_table = g_hash_table_new (icon_data_hash, icon_data_equal);
+
+  data = g_hash_table_lookup (icon_data_table, &key);
+  if (data)
+    {
+      meta_verbose ("Sharing decoded _NET_WM_ICON with another window\n");
+
+      g_free (key.pixels);
+      data->ref_count++;
+      return data;
+    }
+
+  data = g_new (MetaIconData, 1);
+  *data = key;
+  data->display = fetch->display;
+  data->icon = NULL;
+  data->mini_icon = NULL;
+  data->decoded = FALSE;
+  /* One for the caller, one for the decode thread */
+  data->ref_count = 2;
+
+  g_hash_table_insert (icon_data_table, data, data);
+
+  if (decode_pool == NULL)
+    decode_pool = g_thread_pool_new (decode_icon_data, NULL,
+                                     1, FALSE, NULL);
+
+  g_thread_pool_push (decode_pool, data, NULL);
+
+  return data;
+}
+
+static void
+finish_fetch (MetaIconFetch *fetch)
+{
+  MetaIconCache *icon_cache = fetch->icon_cache;
+  MetaIconData *data;
+  Atom type;
+  int format;
+  gulong nitems;
+  gulong bytes_after;
+  guchar *prop;
+
+  if (ag_task_get_reply_and_free (fetch->task,
+                                  &type, &format, &nitems,
+                                  &bytes_after, &prop) != Success)
+    prop = NULL;
+
+  if (icon_cache == NULL)
+    {
+      if (prop)
+        XFree (prop);
+      return;
+    }
+
+  icon_cache->net_wm_icon_fetch = NULL;
+
+  data = NULL;
+  if (prop && type == XA_CARDINAL)
+    data = get_icon_data (fetch, (gulong *) prop, nitems);
+
+  if (prop)
+    XFree (prop);
+
+  if (data)
+    icon_cache->net_wm_icon = data;
+  else
+    /* We tried, and there's nothing to use */
+    icon_cache->net_wm_icon_dirty = FALSE;
+
+  if (data == NULL || data->decoded)
+    queue_icon_update (fetch->display, fetch->xwindow);
+}
+
+/* The replies are read off the connection by GDK's X event source,
+ * along with the events.  Like the Clutter event source in main.c, this
+ * source only picks up what has come in before the main loop blocks
+ * again, so it never wakes up by itself.
+ */
+
+static gboolean
+have_fetch_reply (void)
+{
+  GSList *tmp;
+
+  for (tmp = pending_fetches; tmp; tmp = tmp->next)
+    {
+      MetaIconFetch *fetch = tmp->data;
+
+      if (ag_task_have_reply (fetch->task))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+fetch_prepare (GSource *source,
+               gint    *timeout_)
+{
+  *timeout_ = -1;
+
+  return have_fetch_reply ();
+}
+
+static gboolean
+fetch_check (GSource *source)
+{
+  return have_fetch_reply ();
+}
+
+static gboolean
+fetch_dispatch (GSource     *source,
+                GSourceFunc  callback,
+                gpointer     user_data)
+{
+  GSList *tmp, *next;
+
+  for (tmp = pending_fetches; tmp; tmp = next)
+    {
+      MetaIconFetch *fetch = tmp->data;
+
+      next = tmp->next;
+
+      if (!ag_task_have_reply (fetch->task))
+        continue;
+
+      pending_fetches = g_slist_delete_link (pending_fetches, tmp);
+      finish_fetch (fetch);
+      g_free (fetch);
+    }
+
+  if (pending_fetches == NULL)
+    {
+      fetch_source = NULL;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static GSourceFuncs fetch_funcs = {
+  fetch_prepare,
+  fetch_check,
+  fetch_dispatch
+};
+
+static gboolean
+start_fetch (MetaIconCache *icon_cache,
+             MetaDisplay   *display,
+             Window         xwindow,
+             int            ideal_width,
+             int            ideal_height,
+             int            ideal_mini_width,
+             int            ideal_mini_height)
+{
+  AgGetPropertyTask *task;
+  MetaIconFetch *fetch;
+
+  task = ag_task_create (display->xdisplay, xwindow,
+                         display->atom__NET_WM_ICON,
+                         0, G_MAXLONG,
+                         False, XA_CARDINAL);
+  if (task == NULL)
+    return FALSE;
+
+  XFlush (display->xdisplay);
+
+  fetch = g_new (MetaIconFetch, 1);
+  fetch->display = display;
+  fetch->xwindow = xwindow;
+  fetch->task = task;
+  fetch->icon_cache = icon_cache;
+  fetch->ideal_width = ideal_width;
+  fetch->ideal_height = ideal_height;
+  fetch->ideal_mini_width = ideal_mini_width;
+  fetch->ideal_mini_height = ideal_mini_height;
+
+  icon_cache->net_wm_icon_fetch = fetch;
+
+  /* Replies come back in order, so keep the list in order too */
+  pending_fetches = g_slist_append (pending_fetches, fetch);
+  if (fetch_source == NULL)
+    {
+      fetch_source = g_source_new (&fetch_funcs, sizeof (GSource));
+      g_source_attach (fetch_source, NULL);
+      g_source_unref (fetch_source);
+    }
+
+  return TRUE;
+}
+
 gboolean
 meta_read_icons (MetaScreen     *screen,
                  Window          xwindow,
@@ -717,10 +1093,6 @@ meta_read_icons (MetaScreen     *screen,
                  int             ideal_mini_width,
                  int             ideal_mini_height)
 {
-  guchar *pixdata;
-  int w, h;
-  guchar *mini_pixdata;
-  int mini_w, mini_h;
   Pixmap pixmap;
   Pixmap mask;
 
@@ -747,8 +1119,6 @@ meta_read_icons (MetaScreen     *screen,
   if (!meta_icon_cache_get_icon_invalidated (icon_cache))
     return FALSE; /* we have no new info to use */
 
-  pixdata = NULL;
-
   /* Our algorithm here assumes that we can't have for example origin
    * < USING_NET_WM_ICON and icon_cache->net_wm_icon_dirty == FALSE
    * unless we have tried to read NET_WM_ICON.
@@ -760,36 +1130,37 @@ meta_read_icons (MetaScreen     *screen,
 
   if (icon_cache->origin <= USING_NET_WM_ICON &&
       icon_cache->net_wm_icon_dirty)
-
     {
-      icon_cache->net_wm_icon_dirty = FALSE;
+      MetaIconData *data = icon_cache->net_wm_icon;
 
-      if (read_rgb_icon (screen->display, xwindow,
-                         ideal_width, ideal_height,
-                         ideal_mini_width, ideal_mini_height,
-                         &w, &h, &pixdata,
-                         &mini_w, &mini_h, &mini_pixdata))
-        {
-          *iconp = scaled_from_pixdata (pixdata, w, h,
-                                        ideal_width, ideal_height);
+      if (data == NULL && icon_cache->net_wm_icon_fetch == NULL &&
+          !start_fetch (icon_cache, screen->display, xwindow,
+                        ideal_width, ideal_height,
+                        ideal_mini_width, ideal_mini_height))
+        icon_cache->net_wm_icon_dirty = FALSE;
 
-          *mini_iconp = scaled_from_pixdata (mini_pixdata, mini_w, mini_h,
-                                             ideal_mini_width, ideal_mini_height);
+      if (data && data->decoded)
+        {
+          icon_cache->net_wm_icon_dirty = FALSE;
 
-          if (*iconp && *mini_iconp)
+          if (data->icon && data->mini_icon)
             {
+              *iconp = g_object_ref (data->icon);
+              *mini_iconp = g_object_ref (data->mini_icon);
+
               replace_cache (icon_cache, USING_NET_WM_ICON,
                              *iconp, *mini_iconp);
-              
+
               return TRUE;
             }
-          else
-            {
-              if (*iconp)
-                g_object_unref (G_OBJECT (*iconp));
-              if (*mini_iconp)
-                g_object_unref (G_OBJECT (*mini_iconp));
-            }
+        }
+      else if (icon_cache->origin == USING_NET_WM_ICON &&
+               icon_cache->net_wm_icon_dirty)
+        {
+          /* Keep the icon we have until the new one is decoded; we'll
+           * be called again then.
+           */
+          return FALSE;
         }
     }
 
@@ -27,6 +27,8 @@
 #include "screen-private.h"
 
 typedef struct _MetaIconCache MetaIconCache;
+typedef struct _MetaIconFetch MetaIconFetch;
+typedef struct _MetaIconData  MetaIconData;
 
 typedef enum
 {
@@ -51,6 +53,11 @@ struct _MetaIconCache
   guint wm_hints_dirty : 1;
   guint kwm_win_icon_dirty : 1;
   guint net_wm_icon_dirty : 1;
+  /* _NET_WM_ICON is read and decoded asynchronously; this is the
+   * outstanding request for it, if any, and then the decoded result
+   */
+  MetaIconFetch *net_wm_icon_fetch;
+  MetaIconData  *net_wm_icon;
 };
 
 void           meta_icon_cache_init                 (MetaIconCache *icon_cache);
@@ -31,6 +31,8 @@
 
 #include <meta/keybindings.h>
 
+typedef struct _MetaKeyBindingIndex MetaKeyBindingIndex;
+
 void     meta_display_init_keys             (MetaDisplay *display);
 void     meta_display_shutdown_keys         (MetaDisplay *display);
 void     meta_screen_grab_keys              (MetaScreen  *screen);
@@ -52,6 +54,15 @@ void     meta_set_keybindings_disabled      (gboolean     setting);
 void     meta_display_process_mapping_event (MetaDisplay *display,
                                              XEvent      *event);
 
+MetaKeyBindingIndex *meta_key_binding_index_new    (MetaKeyBinding      *bindings,
+                                                    int                  n_bindings,
+                                                    unsigned int         ignored_modifier_mask);
+void                 meta_key_binding_index_free   (MetaKeyBindingIndex *index);
+MetaKeyBinding      *meta_key_binding_index_lookup (MetaKeyBindingIndex *index,
+                                                    unsigned int         keycode,
+                                                    unsigned int         state,
+                                                    gboolean             on_window);
+
 #endif
 
 
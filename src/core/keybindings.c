@@ -242,6 +242,139 @@ keysym_to_keycode (MetaDisplay *display,
     return XKeysymToKeycode (display->xdisplay, keysym);
 }
 
+/* The binding index lets us find the binding for a key press without
+ * scanning the whole binding table. It maps a keycode and modifier mask
+ * to the binding that a scan of the table in order would find first;
+ * since a per-window binding doesn't apply to key presses that aren't
+ * on a window, we also remember the first binding that isn't per-window.
+ */
+typedef struct
+{
+  MetaKeyBinding *first;
+  MetaKeyBinding *first_global;
+} MetaKeyBindingIndexEntry;
+
+struct _MetaKeyBindingIndex
+{
+  /* key from binding_index_key () => MetaKeyBindingIndexEntry */
+  GHashTable *table;
+  MetaKeyBindingIndexEntry *entries;
+  unsigned int ignored_modifier_mask;
+};
+
+static inline gpointer
+binding_index_key (unsigned int keycode,
+                   unsigned int mask)
+{
+  return GUINT_TO_POINTER ((keycode << 8) | mask);
+}
+
+/**
+ * meta_key_binding_index_new:
+ * @bindings: a binding table
+ * @n_bindings: number of bindings in @bindings
+ * @ignored_modifier_mask: modifiers ignored when matching key presses
+ *
+ * Creates an index of the keycodes and modifier masks of @bindings. The
+ * index is only valid as long as @bindings and the keycodes and masks
+ * within it are unchanged.
+ *
+ * Return value: the new index; free with meta_key_binding_index_free()
+ */
+MetaKeyBindingIndex *
+meta_key_binding_index_new (MetaKeyBinding *bindings,
+                            int             n_bindings,
+                            unsigned int    ignored_modifier_mask)
+{
+  MetaKeyBindingIndex *index;
+  int n_entries;
+  int i;
+
+  index = g_new (MetaKeyBindingIndex, 1);
+  index->table = g_hash_table_new (NULL, NULL);
+  index->entries = g_new0 (MetaKeyBindingIndexEntry, n_bindings);
+  index->ignored_modifier_mask = ignored_modifier_mask;
+
+  n_entries = 0;
+  for (i = 0; i < n_bindings; i++)
+    {
+      MetaKeyBinding *binding = &bindings[i];
+      MetaKeyBindingIndexEntry *entry;
+      gpointer key;
+
+      /* A key press never has these modifiers once they've been
+       * masked out, so such a binding can't be matched */
+      if ((binding->mask & ~0xff) != 0 ||
+          (binding->mask & ignored_modifier_mask) != 0)
+        continue;
+
+      key = binding_index_key (binding->keycode, binding->mask);
+      entry = g_hash_table_lookup (index->table, key);
+      if (entry == NULL)
+        {
+          entry = &index->entries[n_entries++];
+          g_hash_table_insert (index->table, key, entry);
+        }
+
+      if (entry->first == NULL)
+        entry->first = binding;
+
+      if (entry->first_global == NULL &&
+          (binding->handler == NULL ||
+           (binding->handler->flags & BINDING_PER_WINDOW) == 0))
+        entry->first_global = binding;
+    }
+
+  return index;
+}
+
+void
+meta_key_binding_index_free (MetaKeyBindingIndex *index)
+{
+  g_hash_table_destroy (index->table);
+  g_free (index->entries);
+  g_free (index);
+}
+
+/**
+ * meta_key_binding_index_lookup:
+ * @index: a #MetaKeyBindingIndex
+ * @keycode: keycode of the key press
+ * @state: modifier state of the key press
+ * @on_window: whether the key press is on a window, so per-window
+ *   bindings apply
+ *
+ * Return value: the binding to run for the key press, or %NULL
+ */
+MetaKeyBinding *
+meta_key_binding_index_lookup (MetaKeyBindingIndex *index,
+                               unsigned int         keycode,
+                               unsigned int         state,
+                               gboolean             on_window)
+{
+  MetaKeyBindingIndexEntry *entry;
+  unsigned int mask;
+
+  mask = state & 0xff & ~(index->ignored_modifier_mask);
+  entry = g_hash_table_lookup (index->table, binding_index_key (keycode, mask));
+  if (entry == NULL)
+    return NULL;
+
+  return on_window ? entry->first : entry->first_global;
+}
+
+/* Called whenever the binding table or the keycodes or masks in it
+ * change; the index is rebuilt on the next key press */
+static void
+invalidate_binding_index (MetaDisplay *display)
+{
+  if (display->key_binding_index)
+    {
+      meta_key_binding_index_free (display->key_binding_index);
+      display->key_binding_index = NULL;
+    }
+}
+
 static void
 reload_keycodes (MetaDisplay *display)
 {
@@ -270,6 +403,8 @@ reload_keycodes (MetaDisplay *display)
           ++i;
         }
     }
+
+  invalidate_binding_index (display);
 }
 
 static void
@@ -298,6 +433,8 @@ reload_modifiers (MetaDisplay *display)
           ++i;
         }
     }
+
+  invalidate_binding_index (display);
 }
 
 
@@ -436,6 +573,7 @@ rebuild_key_binding_table (MetaDisplay *display)
               "Rebuilding key binding table from preferences\n");
   
   meta_prefs_get_key_bindings (&prefs, &n_prefs);
+  invalidate_binding_index (display);
   rebuild_binding_table (display,
                          &display->key_bindings,
                          &display->n_key_bindings,
@@ -638,6 +776,7 @@ meta_display_init_keys (MetaDisplay *display)
   display->meta_mask = 0;
   display->key_bindings = NULL;
   display->n_key_bindings = 0;
+  display->key_binding_index = NULL;
 
   XDisplayKeycodes (display->xdisplay,
                     &display->min_keycode,
@@ -682,6 +821,7 @@ meta_display_shutdown_keys (MetaDisplay *display)
   
   if (display->modmap)
     XFreeModifiermap (display->modmap);
+  invalidate_binding_index (display);
   g_free (display->key_bindings);
 }
 
@@ -1289,70 +1429,69 @@ invoke_handler_by_name (MetaDisplay    *display,
     invoke_handler (display, screen, handler, window, event, NULL);
 }
 
-/* now called from only one place, may be worth merging */
 static gboolean
-process_event (MetaKeyBinding       *bindings,
-               int                   n_bindings,
-               MetaDisplay          *display,
+process_event (MetaDisplay          *display,
                MetaScreen           *screen,
                MetaWindow           *window,
                XEvent               *event,
                KeySym                keysym,
                gboolean              on_window)
 {
-  int i;
+  MetaKeyBinding *binding;
+  MetaKeyHandler *handler;
 
   /* we used to have release-based bindings but no longer. */
-  if (event->type == KeyRelease)
+  if (event->type != KeyPress)
     return FALSE;
 
-  /*
-   * TODO: This would be better done with a hash table;
-   * it doesn't suit to use O(n) for such a common operation.
-   */
-  for (i=0; i<n_bindings; i++)
-    {
-      MetaKeyHandler *handler = bindings[i].handler;
-
-      if ((!on_window && handler->flags & BINDING_PER_WINDOW) ||
-          event->type != KeyPress ||
-          bindings[i].keycode != event->xkey.keycode ||
-          ((event->xkey.state & 0xff & ~(display->ignored_modifier_mask)) !=
-           bindings[i].mask))
-        continue;
-        
-      /*
-       * window must be non-NULL for on_window to be true,
-       * and so also window must be non-NULL if we get here and
-       * this is a BINDING_PER_WINDOW binding.
-       */
+  if (display->key_binding_index == NULL)
+    display->key_binding_index =
+      meta_key_binding_index_new (display->key_bindings,
+                                  display->n_key_bindings,
+                                  display->ignored_modifier_mask);
 
+  binding = meta_key_binding_index_lookup (display->key_binding_index,
+                                           event->xkey.keycode,
+                                           event->xkey.state,
+                                           on_window);
+  if (binding == NULL)
+    {
       meta_topic (META_DEBUG_KEYBINDINGS,
-                  "Binding keycode 0x%x mask 0x%x matches event 0x%x state 0x%x\n",
-                  bindings[i].keycode, bindings[i].mask,
-                  event->xkey.keycode, event->xkey.state);
+                  "No handler found for this event in this binding table\n");
+      return FALSE;
+    }
 
-      if (handler == NULL)
-        meta_bug ("Binding %s has no handler\n", bindings[i].name);
-      else
-        meta_topic (META_DEBUG_KEYBINDINGS,
-                    "Running handler for %s\n",
-                    bindings[i].name);
-          
-      /* Global keybindings count as a let-the-terminal-lose-focus
-       * due to new window mapping until the user starts
-       * interacting with the terminal again.
-       */
-      display->allow_terminal_deactivation = TRUE;
+  /*
+   * window must be non-NULL for on_window to be true,
+   * and so also window must be non-NULL if we get here and
+   * this is a BINDING_PER_WINDOW binding.
+   */
 
-      invoke_handler (display, screen, handler, window, event, &bindings[i]);
+  meta_topic (META_DEBUG_KEYBINDINGS,
+              "Binding keycode 0x%x mask 0x%x matches event 0x%x state 0x%x\n",
+              binding->keycode, binding->mask,
+              event->xkey.keycode, event->xkey.state);
 
-      return TRUE;
+  handler = binding->handler;
+  if (handler == NULL)
+    {
+      meta_bug ("Binding %s has no handler\n", binding->name);
+      return FALSE;
     }
 
   meta_topic (META_DEBUG_KEYBINDINGS,
-              "No handler found for this event in this binding table\n");
-  return FALSE;
+              "Running handler for %s\n",
+              binding->name);
+
+  /* Global keybindings count as a let-the-terminal-lose-focus
+   * due to new window mapping until the user starts
+   * interacting with the terminal again.
+   */
+  display->allow_terminal_deactivation = TRUE;
+
+  invoke_handler (display, screen, handler, window, event, binding);
+
+  return TRUE;
 }
 
 static gboolean
@@ -1379,10 +1518,7 @@ process_overlay_key (MetaDisplay *display,
            * the event. Other clients with global grabs will be out of
            * luck.
            */
-          if (process_event (display->key_bindings,
-                             display->n_key_bindings,
-                             display, screen, NULL, event, keysym,
-                             FALSE))
+          if (process_event (display, screen, NULL, event, keysym, FALSE))
             {
               /* As normally, after we've handled a global key
                * binding, we unfreeze the keyboard but keep the grab
@@ -1587,9 +1723,7 @@ meta_display_process_key_event (MetaDisplay *display,
     }
   
   /* Do the normal keybindings */
-  return process_event (display->key_bindings,
-                        display->n_key_bindings,
-                        display, screen, window, event, keysym,
+  return process_event (display, screen, window, event, keysym,
                         !all_keys_grabbed && window);
 }
 
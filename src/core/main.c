@@ -390,6 +390,10 @@ meta_init (void)
   sigset_t empty_mask;
   GIOChannel *channel;
 
+  /* The icon cache decodes icons in a worker thread */
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
   g_type_init ();
   
   sigemptyset (&empty_mask);
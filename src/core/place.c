@@ -28,6 +28,7 @@
 
 #include "boxes-private.h"
 #include "place.h"
+#include "workspace-private.h"
 #include <meta/workspace.h>
 #include <meta/prefs.h>
 #include <gdk/gdk.h>
@@ -375,12 +376,35 @@ avoid_being_obscured_as_second_modal_dialog (MetaWindow *window,
     }
 }
 
+static gboolean
+blocks_placement_of (MetaWindow          *other,
+                     const MetaRectangle *rect,
+                     gpointer             data)
+{
+  MetaWindow *window = data;
+
+  return other != window && meta_window_is_placement_obstacle (other);
+}
+
+/* Whether rect overlaps any of windows or, if windows is NULL, any of
+ * the placement obstacles on the workspaces of window, found in the
+ * spatial index.
+ */
 static gboolean
 rectangle_overlaps_some_window (MetaRectangle *rect,
+                                MetaWindow    *window,
                                 GList         *windows)
 {
   GList *tmp;
   MetaRectangle dest;
+
+  if (windows == NULL)
+    return meta_screen_foreach_window_in_rect (window->screen,
+                                               window->on_all_workspaces ?
+                                               NULL : window->workspace,
+                                               rect,
+                                               blocks_placement_of,
+                                               window);
   
   tmp = windows;
   while (tmp != NULL)
@@ -388,32 +412,12 @@ rectangle_overlaps_some_window (MetaRectangle *rect,
       MetaWindow *other = tmp->data;
       MetaRectangle other_rect;      
 
-      switch (other->type)
+      if (meta_window_is_placement_obstacle (other))
         {
-        case META_WINDOW_DOCK:
-        case META_WINDOW_SPLASHSCREEN:
-        case META_WINDOW_DESKTOP:
-        case META_WINDOW_DIALOG:
-        case META_WINDOW_MODAL_DIALOG:
-	/* override redirect window types: */
-	case META_WINDOW_DROPDOWN_MENU:
-	case META_WINDOW_POPUP_MENU:
-	case META_WINDOW_TOOLTIP:
-	case META_WINDOW_NOTIFICATION:
-	case META_WINDOW_COMBO:
-	case META_WINDOW_DND:
-	case META_WINDOW_OVERRIDE_OTHER:
-          break;
-
-        case META_WINDOW_NORMAL:
-        case META_WINDOW_UTILITY:
-        case META_WINDOW_TOOLBAR:
-        case META_WINDOW_MENU:
           meta_window_get_outer_rect (other, &other_rect);
           
           if (meta_rectangle_intersect (rect, &other_rect, &dest))
             return TRUE;
-          break;
         }
       
       tmp = tmp->next;
@@ -422,60 +426,52 @@ rectangle_overlaps_some_window (MetaRectangle *rect,
   return FALSE;
 }
 
-static gint
-leftmost_cmp (gconstpointer a, gconstpointer b)
+static gboolean
+add_obstacle (MetaWindow          *other,
+              const MetaRectangle *rect,
+              gpointer             data)
 {
-  MetaWindow *aw = (gpointer) a;
-  MetaWindow *bw = (gpointer) b;
-  int ax, bx;
-
-  /* we're interested in the frame position for cascading,
-   * not meta_window_get_position()
-   */
-  if (aw->frame)
-    ax = aw->frame->rect.x;
-  else
-    ax = aw->rect.x;
-
-  if (bw->frame)
-    bx = bw->frame->rect.x;
-  else
-    bx = bw->rect.x;
+  /* The window being placed isn't an obstacle, since it isn't placed */
+  if (meta_window_is_placement_obstacle (other))
+    meta_free_space_add_obstacle (data, rect);
 
-  if (ax < bx)
-    return -1;
-  else if (ax > bx)
-    return 1;
-  else
-    return 0;
+  return FALSE;
 }
 
-static gint
-topmost_cmp (gconstpointer a, gconstpointer b)
+/* Gets the free space of the work area; the free space the workspace
+ * keeps when avoiding all the windows on the one workspace of window,
+ * which mustn't be freed, or else computes it.
+ */
+static MetaFreeSpace *
+get_free_space (MetaWindow    *window,
+                GList         *obstacles,
+                int            monitor,
+                MetaRectangle *work_area,
+                gboolean      *shared)
 {
-  MetaWindow *aw = (gpointer) a;
-  MetaWindow *bw = (gpointer) b;
-  int ay, by;
+  MetaFreeSpace *space;
+  GList *tmp;
 
-  /* we're interested in the frame position for cascading,
-   * not meta_window_get_position()
-   */
-  if (aw->frame)
-    ay = aw->frame->rect.y;
-  else
-    ay = aw->rect.y;
+  *shared = obstacles == NULL && window->workspace != NULL &&
+    !window->on_all_workspaces;
+  if (*shared)
+    return meta_workspace_get_free_space (window->workspace, monitor);
 
-  if (bw->frame)
-    by = bw->frame->rect.y;
-  else
-    by = bw->rect.y;
+  space = meta_free_space_new (work_area);
 
-  if (ay < by)
-    return -1;
-  else if (ay > by)
-    return 1;
-  else
-    return 0;
+  if (obstacles == NULL)
+    meta_screen_foreach_window_in_rect (window->screen, NULL, work_area,
+                                        add_obstacle, space);
+
+  for (tmp = obstacles; tmp != NULL; tmp = tmp->next)
+    {
+      MetaRectangle outer_rect;
+
+      meta_window_get_outer_rect (tmp->data, &outer_rect);
+      add_obstacle (tmp->data, &outer_rect, space);
+    }
+
+  return space;
 }
 
 static void
@@ -496,8 +492,11 @@ center_tile_rect_in_area (MetaRectangle *rect,
   rect->y = work_area->y + fluff;
 }
 
-/* Find the leftmost, then topmost, empty area on the workspace
- * that can contain the new window.
+/* Find the smallest empty area on the work area of the monitor that
+ * can contain the new window, and put the window in its top left
+ * corner.  The free space of each monitor's work area is kept by the
+ * workspace as windows come and go, so this doesn't have to look at
+ * the other windows.
  *
  * Cool feature to have: if we can't fit the current window size,
  * try shrinking the window (within geometry constraints). But
@@ -507,39 +506,22 @@ center_tile_rect_in_area (MetaRectangle *rect,
 static gboolean
 find_first_fit (MetaWindow *window,
                 MetaFrameBorders *borders,
-                /* visible windows on relevant workspaces */
-                GList      *windows,
+                /* windows to avoid, or NULL to avoid all the windows
+                 * on relevant workspaces
+                 */
+                GList      *obstacles,
 		int         monitor,
                 int         x,
                 int         y,
                 int        *new_x,
                 int        *new_y)
 {
-  /* This algorithm is limited - it just brute-force tries
-   * to fit the window in a small number of locations that are aligned
-   * with existing windows. It tries to place the window on
-   * the bottom of each existing window, and then to the right
-   * of each existing window, aligned with the left/top of the
-   * existing window in each of those cases.
-   */  
-  int retval;
-  GList *below_sorted;
-  GList *right_sorted;
-  GList *tmp;
+  gboolean retval;
+  gboolean shared;
+  MetaFreeSpace *space;
   MetaRectangle rect;
   MetaRectangle work_area;
-  
-  retval = FALSE;
-
-  /* Below each window */
-  below_sorted = g_list_copy (windows);
-  below_sorted = g_list_sort (below_sorted, leftmost_cmp);
-  below_sorted = g_list_sort (below_sorted, topmost_cmp);  
-
-  /* To the right of each window */
-  right_sorted = g_list_copy (windows);
-  right_sorted = g_list_sort (right_sorted, topmost_cmp);
-  right_sorted = g_list_sort (right_sorted, leftmost_cmp);
+  MetaRectangle fit;
   
   rect.width = window->rect.width;
   rect.height = window->rect.height;
@@ -561,92 +543,65 @@ find_first_fit (MetaWindow *window,
     }
 #endif
 
-    meta_window_get_work_area_for_monitor (window, monitor, &work_area);
+  meta_window_get_work_area_for_monitor (window, monitor, &work_area);
 
-    center_tile_rect_in_area (&rect, &work_area);
+  center_tile_rect_in_area (&rect, &work_area);
 
-    if (meta_rectangle_contains_rect (&work_area, &rect) &&
-        !rectangle_overlaps_some_window (&rect, windows))
-      {
-        *new_x = rect.x;
-        *new_y = rect.y;
-        if (borders)
-          {
-            *new_x += borders->visible.left;
-            *new_y += borders->visible.top;
-          }
-    
-        retval = TRUE;
-       
-        goto out;
-      }
+  retval = meta_rectangle_contains_rect (&work_area, &rect) &&
+    !rectangle_overlaps_some_window (&rect, window, obstacles);
 
-    /* try below each window */
-    tmp = below_sorted;
-    while (tmp != NULL)
-      {
-        MetaWindow *w = tmp->data;
-        MetaRectangle outer_rect;
+  if (!retval)
+    {
+      space = get_free_space (window, obstacles, monitor, &work_area, &shared);
 
-        meta_window_get_outer_rect (w, &outer_rect);
-      
-        rect.x = outer_rect.x;
-        rect.y = outer_rect.y + outer_rect.height;
-      
-        if (meta_rectangle_contains_rect (&work_area, &rect) &&
-            !rectangle_overlaps_some_window (&rect, below_sorted))
-          {
-            *new_x = rect.x;
-            *new_y = rect.y;
-            if (borders)
-              {
-                *new_x += borders->visible.left;
-                *new_y += borders->visible.top;
-              }
-          
-            retval = TRUE;
-          
-            goto out;
-          }
+      retval = meta_free_space_find_best_fit (space, rect.width, rect.height,
+                                              &fit);
 
-        tmp = tmp->next;
-      }
+      /* The free space the workspace keeps may not know about every
+       * change to the windows; if it was wrong, compute it again.
+       */
+      if (retval && shared)
+        {
+          rect.x = fit.x;
+          rect.y = fit.y;
 
-    /* try to the right of each window */
-    tmp = right_sorted;
-    while (tmp != NULL)
-      {
-        MetaWindow *w = tmp->data;
-        MetaRectangle outer_rect;
-   
-        meta_window_get_outer_rect (w, &outer_rect);
-     
-        rect.x = outer_rect.x + outer_rect.width;
-        rect.y = outer_rect.y;
-   
-        if (meta_rectangle_contains_rect (&work_area, &rect) &&
-            !rectangle_overlaps_some_window (&rect, right_sorted))
-          {
-            *new_x = rect.x;
-            *new_y = rect.y;
-            if (borders)
-              {
-                *new_x += borders->visible.left;
-                *new_y += borders->visible.top;
-              }
-        
-            retval = TRUE;
-       
-            goto out;
-          }
+          if (rectangle_overlaps_some_window (&rect, window, NULL))
+            {
+              meta_topic (META_DEBUG_PLACEMENT,
+                          "Free space of monitor %d was out of date\n",
+                          monitor);
+
+              meta_workspace_invalidate_free_space (window->workspace,
+                                                    monitor);
+              space = meta_workspace_get_free_space (window->workspace,
+                                                     monitor);
+              retval = meta_free_space_find_best_fit (space,
+                                                      rect.width, rect.height,
+                                                      &fit);
+            }
+        }
 
-        tmp = tmp->next;
-      }
-      
- out:
+      if (retval)
+        {
+          rect.x = fit.x;
+          rect.y = fit.y;
+        }
+
+      if (!shared)
+        meta_free_space_free (space);
+    }
+
+  if (retval)
+    {
+      *new_x = rect.x;
+      *new_y = rect.y;
+      if (borders)
+        {
+          *new_x += borders->visible.left;
+          *new_y += borders->visible.top;
+        }
+    }
 
-  g_list_free (below_sorted);
-  g_list_free (right_sorted);
   return retval;
 }
 
@@ -866,7 +821,7 @@ meta_window_place (MetaWindow        *window,
   x = xi->rect.x;
   y = xi->rect.y;
 
-  if (find_first_fit (window, borders, windows,
+  if (find_first_fit (window, borders, NULL,
                       xi->number,
                       x, y, &x, &y))
     goto done_check_denied_focus;
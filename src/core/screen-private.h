@@ -37,6 +37,7 @@
 #include <meta/screen.h>
 #include <X11/Xutil.h>
 #include "stack-tracker.h"
+#include "window-index.h"
 #include "ui.h"
 
 typedef struct _MetaMonitorInfo MetaMonitorInfo;
@@ -87,6 +88,9 @@ struct _MetaScreen
   
   GList *workspaces;
 
+  /* The windows that have struts */
+  GList *strut_windows;
+
   MetaStack *stack;
   MetaStackTracker *stack_tracker;
 
@@ -154,6 +158,11 @@ void          meta_screen_manage_all_windows  (MetaScreen                 *scree
 void          meta_screen_foreach_window      (MetaScreen                 *screen,
                                                MetaScreenWindowFunc        func,
                                                gpointer                    data);
+gboolean      meta_screen_foreach_window_in_rect (MetaScreen              *screen,
+                                                  MetaWorkspace           *workspace,
+                                                  const MetaRectangle     *rect,
+                                                  MetaWindowIndexFunc      func,
+                                                  gpointer                 data);
 void          meta_screen_queue_frame_redraws (MetaScreen                 *screen);
 void          meta_screen_queue_window_resizes (MetaScreen                 *screen);
 
@@ -181,6 +190,9 @@ void          meta_screen_tile_preview_update          (MetaScreen    *screen,
                                                         gboolean       delay);
 void          meta_screen_tile_preview_hide            (MetaScreen    *screen);
 
+void          meta_screen_get_pointer_position (MetaScreen                 *screen,
+                                               int                        *x,
+                                               int                        *y);
 MetaWindow*   meta_screen_get_mouse_window     (MetaScreen                 *screen,
                                                 MetaWindow                 *not_this_one);
 
@@ -38,6 +38,7 @@
 #include "keybindings-private.h"
 #include "stack.h"
 #include "xprops.h"
+#include "window-props.h"
 #include <meta/compositor.h>
 #include "mutter-marshal.h"
 #include "mutter-enum-types.h"
@@ -48,6 +49,9 @@
 #ifdef HAVE_XFREE_XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif
+#ifdef HAVE_XINPUT2
+#include <X11/extensions/XInput2.h>
+#endif
 
 #include <X11/Xatom.h>
 #include <locale.h>
@@ -643,7 +647,7 @@ meta_screen_new (MetaDisplay *display,
   
   replace_current_wm = meta_get_replace_current_wm ();
   
-  /* Only display->name, display->xdisplay, and display->error_traps
+  /* Only display->name, display->xdisplay, and the error traps
    * can really be used in this function, since normally screens are
    * created from the MetaDisplay constructor
    */
@@ -765,6 +769,20 @@ meta_screen_new (MetaDisplay *display,
       
       return NULL;
     }
+
+#ifdef HAVE_XINPUT2
+  /* Raw motion tells us the pointer moved even when we don't get any
+   * event with its new position; see update_pointer_position()
+   */
+  if (META_DISPLAY_HAS_XINPUT2 (display))
+    {
+      unsigned char mask_bits[XIMaskLen (XI_RawMotion)] = { 0 };
+      XIEventMask mask = { XIAllMasterDevices, sizeof (mask_bits), mask_bits };
+
+      XISetMask (mask_bits, XI_RawMotion);
+      XISelectEvents (xdisplay, xroot, &mask, 1);
+    }
+#endif
   
   screen = g_object_new (META_TYPE_SCREEN, NULL);
   screen->closing = 0;
@@ -793,6 +811,7 @@ meta_screen_new (MetaDisplay *display,
 
   screen->active_workspace = NULL;
   screen->workspaces = NULL;
+  screen->strut_windows = NULL;
   screen->rows_of_workspaces = 1;
   screen->columns_of_workspaces = -1;
   screen->vertical_workspaces = FALSE;
@@ -954,6 +973,8 @@ meta_screen_free (MetaScreen *screen,
   if (screen->work_area_later != 0)
     g_source_remove (screen->work_area_later);
 
+  g_list_free (screen->strut_windows);
+
   if (screen->monitor_infos)
     g_free (screen->monitor_infos);
 
@@ -1004,11 +1025,10 @@ list_windows (MetaScreen *screen)
           meta_verbose ("Failed to get attributes for window 0x%lx\n",
                         children[i]);
 	  g_free (info);
+          continue;
         }
-      else
-        {
-	  info->xwindow = children[i];
-	}
+
+      info->xwindow = children[i];
 
       result = g_list_prepend (result, info);
     }
@@ -1022,32 +1042,101 @@ list_windows (MetaScreen *screen)
 void
 meta_screen_manage_all_windows (MetaScreen *screen)
 {
+  MetaDisplay *display = screen->display;
+  MetaInitialProperties *props;
+  GTimer *timer;
   GList *windows;
   GList *list;
+  double fetch_time;
+  int n_windows, n_managed;
+  int i;
 
-  meta_display_grab (screen->display);
+  timer = g_timer_new ();
+
+  meta_display_grab (display);
 
   if (screen->guard_window == None)
-    screen->guard_window = create_guard_window (screen->display->xdisplay,
+    screen->guard_window = create_guard_window (display->xdisplay,
                                                 screen);
 
   windows = list_windows (screen);
+  n_windows = g_list_length (windows);
+
+  /* Select for property changes before requesting the initial values;
+   * anything that changes after the requests are sent will then generate
+   * a PropertyNotify that is handled once the window is managed. That
+   * lets us drop the server grab as soon as the replies are in, rather
+   * than holding it while every window is adopted.
+   */
+  props = g_new0 (MetaInitialProperties, n_windows);
+
+  meta_error_trap_push (display);
+  for (list = windows, i = 0; list != NULL; list = list->next, i++)
+    {
+      WindowInfo *info = list->data;
+
+      XSelectInput (display->xdisplay, info->xwindow,
+                    info->attrs.your_event_mask | PropertyChangeMask);
+
+      props[i].xwindow = info->xwindow;
+      props[i].override_redirect = info->attrs.override_redirect;
+    }
+
+  meta_display_fetch_initial_properties (display, props, n_windows);
+  meta_error_trap_pop (display);
+
+  meta_display_ungrab (display);
+
+  fetch_time = g_timer_elapsed (timer, NULL);
+
+  n_managed = 0;
 
   meta_stack_freeze (screen->stack);
-  for (list = windows; list != NULL; list = list->next)
+  for (list = windows, i = 0; list != NULL; list = list->next, i++)
     {
       WindowInfo *info = list->data;
+      MetaWindow *window;
+      double start;
+
+      start = g_timer_elapsed (timer, NULL);
+
+      window = meta_window_new_with_initial_properties (display, info->xwindow,
+                                                        TRUE,
+                                                        META_COMP_EFFECT_NONE,
+                                                        &info->attrs,
+                                                        &props[i]);
 
-      meta_window_new_with_attrs (screen->display, info->xwindow, TRUE,
-                                  META_COMP_EFFECT_NONE,
-                                  &info->attrs);
+      if (window != NULL)
+        {
+          n_managed++;
+          meta_topic (META_DEBUG_STARTUP,
+                      "Adopted window 0x%lx in %.3f ms\n", info->xwindow,
+                      (g_timer_elapsed (timer, NULL) - start) * 1000);
+        }
+      else
+        {
+          /* Put back the event mask we had before */
+          meta_error_trap_push (display);
+          XSelectInput (display->xdisplay, info->xwindow,
+                        info->attrs.your_event_mask);
+          meta_error_trap_pop (display);
+        }
     }
   meta_stack_thaw (screen->stack);
 
+  meta_topic (META_DEBUG_STARTUP,
+              "Adopted %d of %d windows in %.3f ms "
+              "(%.3f ms with the server grabbed)\n",
+              n_managed, n_windows,
+              g_timer_elapsed (timer, NULL) * 1000, fetch_time * 1000);
+
+  meta_initial_properties_free (props, n_windows);
+  g_free (props);
+
   g_list_foreach (windows, (GFunc)g_free, NULL);
   g_list_free (windows);
 
-  meta_display_ungrab (screen->display);
+  g_timer_destroy (timer);
 }
 
 void
@@ -1225,6 +1314,78 @@ meta_screen_foreach_window (MetaScreen *screen,
   g_slist_free (winlist);
 }
 
+typedef struct
+{
+  MetaWindowIndexFunc func;
+  gpointer data;
+} ForeachStickyData;
+
+static gboolean
+foreach_sticky_window (MetaWindow          *window,
+                       const MetaRectangle *rect,
+                       gpointer             data)
+{
+  ForeachStickyData *sticky_data = data;
+
+  if (!window->on_all_workspaces)
+    return FALSE;
+
+  return sticky_data->func (window, rect, sticky_data->data);
+}
+
+/**
+ * meta_screen_foreach_window_in_rect: (skip)
+ * @screen: a #MetaScreen
+ * @workspace: (allow-none): only look for windows located on this
+ *   workspace, or %NULL to look on all workspaces
+ * @rect: the area to look in
+ * @func: function to call for each window whose outer rectangle overlaps
+ *   @rect; it returns %TRUE to stop looking
+ * @data: data to pass to @func
+ *
+ * Finds the windows overlapping @rect using the spatial indexes of the
+ * workspaces (see meta_window_update_spatial_index()), in no particular
+ * order. Windows that are on all workspaces are kept in the index of
+ * the workspace they were added to, so the other workspaces are looked
+ * at for those.
+ *
+ * Return value: %TRUE if @func stopped the search
+ */
+gboolean
+meta_screen_foreach_window_in_rect (MetaScreen          *screen,
+                                    MetaWorkspace       *workspace,
+                                    const MetaRectangle *rect,
+                                    MetaWindowIndexFunc  func,
+                                    gpointer             data)
+{
+  ForeachStickyData sticky_data;
+  GList *tmp;
+
+  sticky_data.func = func;
+  sticky_data.data = data;
+
+  for (tmp = screen->workspaces; tmp != NULL; tmp = tmp->next)
+    {
+      MetaWorkspace *other = tmp->data;
+
+      if (workspace == NULL || other == workspace)
+        {
+          if (meta_window_index_foreach_in_rect (other->window_index,
+                                                 rect, func, data))
+            return TRUE;
+        }
+      else
+        {
+          if (meta_window_index_foreach_in_rect (other->window_index, rect,
+                                                 foreach_sticky_window,
+                                                 &sticky_data))
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
 static void
 queue_draw (MetaScreen *screen, MetaWindow *window, gpointer data)
 {
@@ -1945,30 +2106,67 @@ meta_screen_tile_preview_hide (MetaScreen *screen)
     meta_tile_preview_hide (screen->tile_preview);
 }
 
+/**
+ * meta_screen_get_pointer_position: (skip)
+ * @screen: a #MetaScreen
+ * @x: (out): return location for the pointer's x position
+ * @y: (out): return location for the pointer's y position
+ *
+ * Gets where the pointer is, relative to the root window of @screen.
+ * This uses the position from the last event that told us, and only
+ * asks the server if the pointer may have moved since.
+ */
+void
+meta_screen_get_pointer_position (MetaScreen *screen,
+                                  int        *x,
+                                  int        *y)
+{
+  MetaDisplay *display = screen->display;
+  Window root_return, child_return;
+  int win_x_return, win_y_return;
+  unsigned int mask_return;
+
+  if (display->pointer_position_valid &&
+      display->pointer_root == screen->xroot)
+    {
+      display->pointer_queries_avoided++;
+      *x = display->pointer_x;
+      *y = display->pointer_y;
+      return;
+    }
+
+  XQueryPointer (display->xdisplay,
+                 screen->xroot,
+                 &root_return,
+                 &child_return,
+                 x,
+                 y,
+                 &win_x_return,
+                 &win_y_return,
+                 &mask_return);
+
+  /* The position is relative to the root the pointer is on, which
+   * needn't be ours
+   */
+  display->pointer_position_valid = TRUE;
+  display->pointer_root = root_return;
+  display->pointer_x = *x;
+  display->pointer_y = *y;
+}
+
 MetaWindow*
 meta_screen_get_mouse_window (MetaScreen  *screen,
                               MetaWindow  *not_this_one)
 {
   MetaWindow *window;
-  Window root_return, child_return;
   int root_x_return, root_y_return;
-  int win_x_return, win_y_return;
-  unsigned int mask_return;
   
   if (not_this_one)
     meta_topic (META_DEBUG_FOCUS,
                 "Focusing mouse window excluding %s\n", not_this_one->desc);
 
   meta_error_trap_push (screen->display);
-  XQueryPointer (screen->display->xdisplay,
-                 screen->xroot,
-                 &root_return,
-                 &child_return,
-                 &root_x_return,
-                 &root_y_return,
-                 &win_x_return,
-                 &win_y_return,
-                 &mask_return);
+  meta_screen_get_pointer_position (screen, &root_x_return, &root_y_return);
   meta_error_trap_pop (screen->display);
 
   window = meta_stack_get_default_focus_window_at_point (screen->stack,
@@ -2157,29 +2355,17 @@ meta_screen_get_current_monitor (MetaScreen *screen)
   if (screen->n_monitor_infos == 1)
     return &screen->monitor_infos[0];
   
-  /* Sadly, we have to do it this way. Yuck.
-   */
-  
   if (screen->display->monitor_cache_invalidated)
     {
-      Window root_return, child_return;
-      int win_x_return, win_y_return;
-      unsigned int mask_return;
       int i;
       MetaRectangle pointer_position;
       
       screen->display->monitor_cache_invalidated = FALSE;
       
       pointer_position.width = pointer_position.height = 1;
-      XQueryPointer (screen->display->xdisplay,
-                     screen->xroot,
-                     &root_return,
-                     &child_return,
-                     &pointer_position.x,
-                     &pointer_position.y,
-                     &win_x_return,
-                     &win_y_return,
-                     &mask_return);
+      meta_screen_get_pointer_position (screen,
+                                        &pointer_position.x,
+                                        &pointer_position.y);
 
       screen->last_monitor_index = 0;
       for (i = 0; i < screen->n_monitor_infos; i++)
@@ -2193,8 +2379,10 @@ meta_screen_get_current_monitor (MetaScreen *screen)
         }
       
       meta_topic (META_DEBUG_XINERAMA,
-                  "Rechecked current monitor, now %d\n",
-                  screen->last_monitor_index);
+                  "Rechecked current monitor, now %d "
+                  "(%u pointer queries avoided so far)\n",
+                  screen->last_monitor_index,
+                  screen->display->pointer_queries_avoided);
     }
 
   return &screen->monitor_infos[screen->last_monitor_index];
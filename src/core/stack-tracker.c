@@ -54,14 +54,16 @@
  *
  * When we receive a new event: a) we compare the serial in the event to
  * the serial of the queued requests and remove any that are now
- * no longer pending b) if necessary, drop the predicted stacking
- * order to recompute it at the next opportunity.
+ * no longer pending b) if the event was just the server confirming
+ * requests we made, and the predicted stacking order already reflects
+ * it, we keep the predicted stacking order; otherwise we drop it to
+ * recompute it at the next opportunity.
  *
- * Possible optimizations:
- *  Keep the stacks as an array + reverse-mapping hash table to avoid
- *    linear lookups.
- *  Keep the stacks as a GList + reverse-mapping hash table to avoid
- *    linear lookups and to make restacking constant-time.
+ * Each stack is kept as an array plus a hash table mapping windows back
+ * to their positions, so applying an operation doesn't need linear
+ * lookups, and a parallel array of the MetaWindow (if any) that each
+ * window is the toplevel of, so syncing the compositor doesn't need to
+ * look windows up either.
  */
 
 typedef union _MetaStackOp MetaStackOp;
@@ -108,14 +110,34 @@ union _MetaStackOp
   } lower_below;
 };
 
+/* A stack of windows, bottom to top */
+typedef struct
+{
+  GArray *windows;
+
+  /* The MetaWindow each of the windows is the toplevel of, or NULL */
+  GPtrArray *meta_windows;
+
+  /* Window => its index in windows + 1 */
+  GHashTable *positions;
+
+  /* The tracker's Window => MetaWindow table, used when adding windows */
+  GHashTable *toplevels;
+} MetaTrackedStack;
+
 struct _MetaStackTracker
 {
   MetaScreen *screen;
 
+  /* The MetaWindows we know of, by the Window that is their toplevel
+   * (their frame, or their own window if they have no frame)
+   */
+  GHashTable *toplevels;
+
   /* This is the last state of the stack as based on events received
    * from the X server.
    */
-  GArray *server_stack;
+  MetaTrackedStack *server_stack;
 
   /* This is the serial of the last request we made that was reflected
    * in server_stack
@@ -130,7 +152,7 @@ struct _MetaStackTracker
   /* This is how we think the stack is, based on server_stack, and
    * on requests we've made subsequent to server_stack
    */
-  GArray *predicted_stack;
+  MetaTrackedStack *predicted_stack;
 
   /* Idle function used to sync the compositor's view of the window
    * stack up with our best guess before a frame is drawn.
@@ -180,13 +202,13 @@ meta_stack_tracker_dump (MetaStackTracker *tracker)
   meta_push_no_msg_prefix ();
   meta_topic (META_DEBUG_STACK, "  server_serial: %ld\n", tracker->server_serial);
   meta_topic (META_DEBUG_STACK, "  server_stack: ");
-  for (i = 0; i < tracker->server_stack->len; i++)
-    meta_topic (META_DEBUG_STACK, "  %#lx", g_array_index (tracker->server_stack, Window, i));
+  for (i = 0; i < tracker->server_stack->windows->len; i++)
+    meta_topic (META_DEBUG_STACK, "  %#lx", g_array_index (tracker->server_stack->windows, Window, i));
   if (tracker->predicted_stack)
     {
       meta_topic (META_DEBUG_STACK, "\n  predicted_stack: ");
-      for (i = 0; i < tracker->predicted_stack->len; i++)
-	meta_topic (META_DEBUG_STACK, "  %#lx", g_array_index (tracker->predicted_stack, Window, i));
+      for (i = 0; i < tracker->predicted_stack->windows->len; i++)
+	meta_topic (META_DEBUG_STACK, "  %#lx", g_array_index (tracker->predicted_stack->windows, Window, i));
     }
   meta_topic (META_DEBUG_STACK, "\n  queued_requests: [");
   for (l = tracker->queued_requests->head; l; l = l->next)
@@ -204,43 +226,160 @@ meta_stack_op_free (MetaStackOp *op)
   g_slice_free (MetaStackOp, op);
 }
 
-static int
-find_window (GArray *stack,
-	     Window  window)
+static MetaTrackedStack *
+tracked_stack_new (GHashTable *toplevels,
+                   Window     *windows,
+                   guint       n_windows)
 {
+  MetaTrackedStack *stack = g_slice_new (MetaTrackedStack);
   guint i;
 
-  for (i = 0; i < stack->len; i++)
-    if (g_array_index (stack, Window, i) == window)
-      return i;
+  stack->windows = g_array_sized_new (FALSE, FALSE, sizeof (Window), n_windows);
+  g_array_set_size (stack->windows, n_windows);
+  memcpy (stack->windows->data, windows, sizeof (Window) * n_windows);
+
+  stack->meta_windows = g_ptr_array_sized_new (n_windows);
+  g_ptr_array_set_size (stack->meta_windows, n_windows);
+
+  stack->positions = g_hash_table_new (NULL, NULL);
+  stack->toplevels = toplevels;
+
+  for (i = 0; i < n_windows; i++)
+    {
+      g_hash_table_insert (stack->positions,
+                           GSIZE_TO_POINTER (windows[i]), GUINT_TO_POINTER (i + 1));
+      g_ptr_array_index (stack->meta_windows, i) =
+        g_hash_table_lookup (toplevels, GSIZE_TO_POINTER (windows[i]));
+    }
+
+  return stack;
+}
+
+static MetaTrackedStack *
+tracked_stack_copy (MetaTrackedStack *other)
+{
+  MetaTrackedStack *stack = g_slice_new (MetaTrackedStack);
+  guint n_windows = other->windows->len;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  stack->windows = g_array_sized_new (FALSE, FALSE, sizeof (Window), n_windows);
+  g_array_set_size (stack->windows, n_windows);
+  memcpy (stack->windows->data, other->windows->data,
+          sizeof (Window) * n_windows);
+
+  stack->meta_windows = g_ptr_array_sized_new (n_windows);
+  g_ptr_array_set_size (stack->meta_windows, n_windows);
+  memcpy (stack->meta_windows->pdata, other->meta_windows->pdata,
+          sizeof (gpointer) * n_windows);
+
+  stack->positions = g_hash_table_new (NULL, NULL);
+  g_hash_table_iter_init (&iter, other->positions);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (stack->positions, key, value);
+
+  stack->toplevels = other->toplevels;
+
+  return stack;
+}
+
+static void
+tracked_stack_free (MetaTrackedStack *stack)
+{
+  g_array_free (stack->windows, TRUE);
+  g_ptr_array_free (stack->meta_windows, TRUE);
+  g_hash_table_destroy (stack->positions);
+  g_slice_free (MetaTrackedStack, stack);
+}
+
+static gboolean
+tracked_stack_equal (MetaTrackedStack *a,
+                     MetaTrackedStack *b)
+{
+  return a->windows->len == b->windows->len &&
+    memcmp (a->windows->data, b->windows->data,
+            sizeof (Window) * a->windows->len) == 0;
+}
+
+static int
+find_window (MetaTrackedStack *stack,
+	     Window            window)
+{
+  return GPOINTER_TO_UINT (g_hash_table_lookup (stack->positions,
+                                                GSIZE_TO_POINTER (window))) - 1;
+}
+
+/* Puts the window at position pos, keeping the index up to date */
+static void
+set_window (MetaTrackedStack *stack,
+            int               pos,
+            Window            window,
+            MetaWindow       *meta_window)
+{
+  g_array_index (stack->windows, Window, pos) = window;
+  g_ptr_array_index (stack->meta_windows, pos) = meta_window;
+  g_hash_table_insert (stack->positions,
+                       GSIZE_TO_POINTER (window), GUINT_TO_POINTER (pos + 1));
+}
+
+static void
+add_window (MetaTrackedStack *stack,
+            Window            window)
+{
+  int pos = stack->windows->len;
+
+  g_array_set_size (stack->windows, pos + 1);
+  g_ptr_array_set_size (stack->meta_windows, pos + 1);
+  set_window (stack, pos, window,
+              g_hash_table_lookup (stack->toplevels, GSIZE_TO_POINTER (window)));
+}
+
+static void
+remove_window (MetaTrackedStack *stack,
+               Window            window,
+               int               old_pos)
+{
+  int i;
+
+  for (i = old_pos; i < (int) stack->windows->len - 1; i++)
+    set_window (stack, i,
+                g_array_index (stack->windows, Window, i + 1),
+                g_ptr_array_index (stack->meta_windows, i + 1));
 
-  return -1;
+  g_array_set_size (stack->windows, stack->windows->len - 1);
+  g_ptr_array_set_size (stack->meta_windows, stack->meta_windows->len - 1);
+  g_hash_table_remove (stack->positions, GSIZE_TO_POINTER (window));
 }
 
 /* Returns TRUE if stack was changed */
 static gboolean
-move_window_above (GArray *stack,
-                   Window  window,
-                   int     old_pos,
-                   int     above_pos)
+move_window_above (MetaTrackedStack *stack,
+                   Window            window,
+                   int               old_pos,
+                   int               above_pos)
 {
+  MetaWindow *meta_window = g_ptr_array_index (stack->meta_windows, old_pos);
   int i;
 
   if (old_pos < above_pos)
     {
       for (i = old_pos; i < above_pos; i++)
-	g_array_index (stack, Window, i) = g_array_index (stack, Window, i + 1);
+	set_window (stack, i,
+                    g_array_index (stack->windows, Window, i + 1),
+                    g_ptr_array_index (stack->meta_windows, i + 1));
 
-      g_array_index (stack, Window, above_pos) = window;
+      set_window (stack, above_pos, window, meta_window);
 
       return TRUE;
     }
   else if (old_pos > above_pos + 1)
     {
       for (i = old_pos; i > above_pos + 1; i--)
-	g_array_index (stack, Window, i) = g_array_index (stack, Window, i - 1);
+	set_window (stack, i,
+                    g_array_index (stack->windows, Window, i - 1),
+                    g_ptr_array_index (stack->meta_windows, i - 1));
 
-      g_array_index (stack, Window, above_pos + 1) = window;
+      set_window (stack, above_pos + 1, window, meta_window);
 
       return TRUE;
     }
@@ -250,8 +389,8 @@ move_window_above (GArray *stack,
 
 /* Returns TRUE if stack was changed */
 static gboolean
-meta_stack_op_apply (MetaStackOp *op,
-		     GArray      *stack)
+meta_stack_op_apply (MetaStackOp      *op,
+		     MetaTrackedStack *stack)
 {
   switch (op->any.type)
     {
@@ -265,7 +404,7 @@ meta_stack_op_apply (MetaStackOp *op,
 	    return FALSE;
 	  }
 
-	g_array_append_val (stack, op->add.window);
+	add_window (stack, op->add.window);
 	return TRUE;
       }
     case STACK_OP_REMOVE:
@@ -278,7 +417,7 @@ meta_stack_op_apply (MetaStackOp *op,
 	    return FALSE;
 	  }
 
-	g_array_remove_index (stack, old_pos);
+	remove_window (stack, op->remove.window, old_pos);
 	return TRUE;
       }
     case STACK_OP_RAISE_ABOVE:
@@ -334,7 +473,7 @@ meta_stack_op_apply (MetaStackOp *op,
 	  }
 	else
 	  {
-	    above_pos = stack->len - 1;
+	    above_pos = stack->windows->len - 1;
 	  }
 
 	return move_window_above (stack, op->lower_below.window, old_pos, above_pos);
@@ -345,16 +484,50 @@ meta_stack_op_apply (MetaStackOp *op,
   return FALSE;
 }
 
-static GArray *
-copy_stack (Window *windows,
-	    guint   n_windows)
+/* Returns TRUE if stack already reflects the operation, as it does when
+ * the operation is the server confirming a request we made that we have
+ * already applied to the stack.
+ */
+static gboolean
+meta_stack_op_is_applied (MetaStackOp      *op,
+                          MetaTrackedStack *stack)
 {
-  GArray *stack = g_array_new (FALSE, FALSE, sizeof (Window));
+  switch (op->any.type)
+    {
+    case STACK_OP_ADD:
+      return find_window (stack, op->add.window) >= 0;
+    case STACK_OP_REMOVE:
+      return find_window (stack, op->remove.window) < 0;
+    case STACK_OP_RAISE_ABOVE:
+      {
+        int pos = find_window (stack, op->raise_above.window);
 
-  g_array_set_size (stack, n_windows);
-  memcpy (stack->data, windows, sizeof (Window) * n_windows);
+        if (pos < 0)
+          return FALSE;
 
-  return stack;
+        if (op->raise_above.sibling != None)
+          return pos > 0 &&
+            g_array_index (stack->windows, Window, pos - 1) == op->raise_above.sibling;
+        else
+          return pos == 0;
+      }
+    case STACK_OP_LOWER_BELOW:
+      {
+        int pos = find_window (stack, op->lower_below.window);
+
+        if (pos < 0)
+          return FALSE;
+
+        if (op->lower_below.sibling != None)
+          return pos < (int) stack->windows->len - 1 &&
+            g_array_index (stack->windows, Window, pos + 1) == op->lower_below.sibling;
+        else
+          return pos == (int) stack->windows->len - 1;
+      }
+    }
+
+  g_assert_not_reached ();
+  return FALSE;
 }
 
 MetaStackTracker *
@@ -367,13 +540,15 @@ meta_stack_tracker_new (MetaScreen *screen)
 
   tracker = g_new0 (MetaStackTracker, 1);
   tracker->screen = screen;
+  tracker->toplevels = g_hash_table_new (NULL, NULL);
 
   tracker->server_serial = XNextRequest (screen->display->xdisplay);
 
   XQueryTree (screen->display->xdisplay,
               screen->xroot,
               &ignored1, &ignored2, &children, &n_children);
-  tracker->server_stack = copy_stack (children, n_children);
+  tracker->server_stack = tracked_stack_new (tracker->toplevels,
+                                             children, n_children);
   XFree (children);
 
   tracker->queued_requests = g_queue_new ();
@@ -387,9 +562,10 @@ meta_stack_tracker_free (MetaStackTracker *tracker)
   if (tracker->sync_stack_later)
     meta_later_remove (tracker->sync_stack_later);
 
-  g_array_free (tracker->server_stack, TRUE);
+  tracked_stack_free (tracker->server_stack);
   if (tracker->predicted_stack)
-    g_array_free (tracker->predicted_stack, TRUE);
+    tracked_stack_free (tracker->predicted_stack);
+  g_hash_table_destroy (tracker->toplevels);
 
   g_queue_foreach (tracker->queued_requests, (GFunc)meta_stack_op_free, NULL);
   g_queue_free (tracker->queued_requests);
@@ -506,6 +682,7 @@ stack_tracker_event_received (MetaStackTracker *tracker,
 			      MetaStackOp      *op)
 {
   gboolean need_sync = FALSE;
+  gboolean confirmed = FALSE;
 
   meta_stack_op_dump (op, "Stack op event received: ", "\n");
 
@@ -526,19 +703,41 @@ stack_tracker_event_received (MetaStackTracker *tracker,
       g_queue_pop_head (tracker->queued_requests);
       meta_stack_op_free (queued_op);
       need_sync = TRUE;
+      confirmed = TRUE;
     }
 
-  if (need_sync)
+  if (need_sync && tracker->predicted_stack)
     {
-      if (tracker->predicted_stack)
+      if (tracker->queued_requests->length == 0)
         {
-          g_array_free (tracker->predicted_stack, TRUE);
+          /* Nothing is pending any more, so server_stack is the current
+           * view; if it is what we predicted, nothing visibly changed.
+           */
+          if (tracked_stack_equal (tracker->predicted_stack,
+                                   tracker->server_stack))
+            need_sync = FALSE;
+
+          tracked_stack_free (tracker->predicted_stack);
+          tracker->predicted_stack = NULL;
+        }
+      else if (confirmed &&
+               meta_stack_op_is_applied (op, tracker->predicted_stack))
+        {
+          /* The server did what we asked and we already predicted
+           * that; the remaining requests are still applied on top.
+           */
+          need_sync = FALSE;
+        }
+      else
+        {
+          tracked_stack_free (tracker->predicted_stack);
           tracker->predicted_stack = NULL;
         }
-
-      meta_stack_tracker_queue_sync_stack (tracker);
     }
 
+  if (need_sync)
+    meta_stack_tracker_queue_sync_stack (tracker);
+
   meta_stack_tracker_dump (tracker);
 }
 
@@ -608,6 +807,27 @@ meta_stack_tracker_configure_event (MetaStackTracker    *tracker,
   stack_tracker_event_received (tracker, &op);
 }
 
+static MetaTrackedStack *
+get_current_stack (MetaStackTracker *tracker)
+{
+  if (tracker->queued_requests->length == 0)
+    return tracker->server_stack;
+
+  if (tracker->predicted_stack == NULL)
+    {
+      GList *l;
+
+      tracker->predicted_stack = tracked_stack_copy (tracker->server_stack);
+      for (l = tracker->queued_requests->head; l; l = l->next)
+        {
+          MetaStackOp *op = l->data;
+          meta_stack_op_apply (op, tracker->predicted_stack);
+        }
+    }
+
+  return tracker->predicted_stack;
+}
+
 /**
  * meta_stack_tracker_get_stack:
  * @tracker: a #MetaStackTracker
@@ -630,34 +850,52 @@ meta_stack_tracker_get_stack (MetaStackTracker *tracker,
 			      Window          **windows,
 			      int              *n_windows)
 {
-  GArray *stack;
+  MetaTrackedStack *stack = get_current_stack (tracker);
 
-  if (tracker->queued_requests->length == 0)
-    {
-      stack = tracker->server_stack;
-    }
+  if (windows)
+    *windows = (Window *)stack->windows->data;
+  if (n_windows)
+    *n_windows = stack->windows->len;
+}
+
+/**
+ * meta_stack_tracker_set_toplevel:
+ * @tracker: a #MetaStackTracker
+ * @window: an X window
+ * @meta_window: (allow-none): the #MetaWindow that @window is the
+ *   toplevel of, or %NULL
+ *
+ * Records that @window is the toplevel window of @meta_window - its
+ * frame, or its own window if it has no frame - or, if @meta_window is
+ * %NULL, that it no longer is. The tracker uses this to map the
+ * windows in the stack to #MetaWindow objects when syncing the stack,
+ * without having to look each of them up.
+ */
+void
+meta_stack_tracker_set_toplevel (MetaStackTracker *tracker,
+                                 Window            window,
+                                 MetaWindow       *meta_window)
+{
+  int pos;
+
+  if (meta_window)
+    g_hash_table_insert (tracker->toplevels,
+                         GSIZE_TO_POINTER (window), meta_window);
   else
-    {
-      if (tracker->predicted_stack == NULL)
-        {
-          GList *l;
-
-          tracker->predicted_stack = copy_stack ((Window *)tracker->server_stack->data,
-                                                 tracker->server_stack->len);
-          for (l = tracker->queued_requests->head; l; l = l->next)
-            {
-              MetaStackOp *op = l->data;
-              meta_stack_op_apply (op, tracker->predicted_stack);
-            }
-        }
+    g_hash_table_remove (tracker->toplevels, GSIZE_TO_POINTER (window));
 
-      stack = tracker->predicted_stack;
+  pos = find_window (tracker->server_stack, window);
+  if (pos >= 0)
+    g_ptr_array_index (tracker->server_stack->meta_windows, pos) = meta_window;
+
+  if (tracker->predicted_stack)
+    {
+      pos = find_window (tracker->predicted_stack, window);
+      if (pos >= 0)
+        g_ptr_array_index (tracker->predicted_stack->meta_windows, pos) = meta_window;
     }
 
-  if (windows)
-    *windows = (Window *)stack->data;
-  if (n_windows)
-    *n_windows = stack->len;
+  meta_stack_tracker_queue_sync_stack (tracker);
 }
 
 /**
@@ -670,10 +908,9 @@ meta_stack_tracker_get_stack (MetaStackTracker *tracker,
 void
 meta_stack_tracker_sync_stack (MetaStackTracker *tracker)
 {
+  MetaTrackedStack *stack;
   GList *meta_windows;
-  Window *windows;
-  int n_windows;
-  int i;
+  guint i;
 
   if (tracker->sync_stack_later)
     {
@@ -681,24 +918,20 @@ meta_stack_tracker_sync_stack (MetaStackTracker *tracker)
       tracker->sync_stack_later = 0;
     }
 
-  meta_stack_tracker_get_stack (tracker, &windows, &n_windows);
+  stack = get_current_stack (tracker);
 
+  /* Children of the root could include unmapped windows created by
+   * toolkits for internal purposes, including ones that we have
+   * registered in our XID => window table (Wine uses a toplevel for
+   * _NET_WM_USER_TIME_WINDOW); only the toplevels recorded with
+   * meta_stack_tracker_set_toplevel() map back to a MetaWindow here.
+   */
   meta_windows = NULL;
-  for (i = 0; i < n_windows; i++)
+  for (i = 0; i < stack->meta_windows->len; i++)
     {
-      MetaWindow *meta_window;
-
-      meta_window = meta_display_lookup_x_window (tracker->screen->display,
-                                                  windows[i]);
-      /* When mapping back from xwindow to MetaWindow we have to be a bit careful;
-       * children of the root could include unmapped windows created by toolkits
-       * for internal purposes, including ones that we have registered in our
-       * XID => window table. (Wine uses a toplevel for _NET_WM_USER_TIME_WINDOW;
-       * see window-prop.c:reload_net_wm_user_time_window() for registration.)
-       */
-      if (meta_window &&
-          (windows[i] == meta_window->xwindow ||
-           (meta_window->frame && windows[i] == meta_window->frame->xwindow)))
+      MetaWindow *meta_window = g_ptr_array_index (stack->meta_windows, i);
+
+      if (meta_window)
         meta_windows = g_list_prepend (meta_windows, meta_window);
     }
 
@@ -83,6 +83,10 @@ void meta_stack_tracker_get_stack  (MetaStackTracker  *tracker,
                                     Window           **windows,
                                     int               *n_windows);
 
+void meta_stack_tracker_set_toplevel (MetaStackTracker *tracker,
+                                      Window            window,
+                                      MetaWindow       *meta_window);
+
 void meta_stack_tracker_sync_stack       (MetaStackTracker *tracker);
 void meta_stack_tracker_queue_sync_stack (MetaStackTracker *tracker);
 
@@ -31,11 +31,13 @@
 #include "window-private.h"
 #include <meta/errors.h>
 #include "frame.h"
+#include "util-private.h"
 #include <meta/group.h>
 #include <meta/prefs.h>
 #include <meta/workspace.h>
 
 #include <X11/Xatom.h>
+#include <string.h>
 
 #define WINDOW_HAS_TRANSIENT_TYPE(w)                    \
           (w->type == META_WINDOW_DIALOG ||             \
@@ -78,6 +80,11 @@ meta_stack_new (MetaScreen *screen)
 
   stack->freeze_count = 0;
   stack->last_root_children_stacked = NULL;
+  stack->last_all_hidden = NULL;
+  stack->last_client_list = NULL;
+  stack->last_client_list_stacking = NULL;
+  stack->n_sync_requests = 0;
+  stack->n_sync_bytes = 0;
 
   stack->n_positions = 0;
 
@@ -99,6 +106,12 @@ meta_stack_free (MetaStack *stack)
 
   if (stack->last_root_children_stacked)
     g_array_free (stack->last_root_children_stacked, TRUE);
+  if (stack->last_all_hidden)
+    g_array_free (stack->last_all_hidden, TRUE);
+  if (stack->last_client_list)
+    g_array_free (stack->last_client_list, TRUE);
+  if (stack->last_client_list_stacking)
+    g_array_free (stack->last_client_list_stacking, TRUE);
   
   g_free (stack);
 }
@@ -1050,16 +1063,146 @@ raise_window_relative_to_managed_windows (MetaScreen *screen,
     }
 }
 
+/* Approximate sizes on the wire of the requests we send while syncing,
+ * for meta_stack_get_sync_stats()
+ */
+#define CONFIGURE_WINDOW_BYTES(n_values) (12 + 4 * (n_values))
+#define CHANGE_PROPERTY_BYTES(n_items)   (24 + 4 * (n_items))
+
+static void
+count_requests (MetaStack *stack,
+                guint      n_requests,
+                guint      n_bytes)
+{
+  stack->n_sync_requests += n_requests;
+  stack->n_sync_bytes += n_bytes;
+}
+
+static void
+restack_windows (MetaStack    *stack,
+                 const Window *windows,
+                 int           n_windows)
+{
+  if (n_windows == 0)
+    return;
+
+  meta_stack_tracker_record_restack_windows (stack->screen->stack_tracker,
+                                             windows, n_windows,
+                                             XNextRequest (stack->screen->display->xdisplay));
+  XRestackWindows (stack->screen->display->xdisplay,
+                   (Window *) windows, n_windows);
+
+  /* Xlib sends a ConfigureWindow for each window after the first */
+  count_requests (stack, n_windows - 1,
+                  (n_windows - 1) * CONFIGURE_WINDOW_BYTES (2));
+}
+
+/**
+ * Finds the windows of new_stack that can stay where they are on the
+ * server: the longest sequence of them that old_stack already has in
+ * the same relative order.
+ *
+ * \param keep  set for each window of new_stack that can stay in place
+ */
+static void
+find_windows_in_place (const Window *old_stack,
+                       int           old_len,
+                       const Window *new_stack,
+                       int           new_len,
+                       gboolean     *keep)
+{
+  GHashTable *old_positions;
+  int *positions;
+  int i;
+
+  old_positions = g_hash_table_new (meta_unsigned_long_hash,
+                                    meta_unsigned_long_equal);
+  for (i = 0; i < old_len; i++)
+    g_hash_table_insert (old_positions, (gpointer) &old_stack[i],
+                         GINT_TO_POINTER (i + 1));
+
+  /* New windows get -1; they always have to be placed */
+  positions = g_new (int, new_len);
+  for (i = 0; i < new_len; i++)
+    positions[i] = GPOINTER_TO_INT (g_hash_table_lookup (old_positions,
+                                                         &new_stack[i])) - 1;
+
+  g_hash_table_destroy (old_positions);
+
+  meta_find_longest_increasing (positions, new_len, keep);
+
+  g_free (positions);
+}
+
+static gboolean
+window_arrays_equal (GArray *a,
+                     GArray *b)
+{
+  return a != NULL && b != NULL && a->len == b->len &&
+    memcmp (a->data, b->data, a->len * sizeof (Window)) == 0;
+}
+
+/**
+ * Sets a window list property on the root window, sending only what
+ * changed since we last set it: nothing if it is the same, only the new
+ * windows if the old list is a prefix of the new one (a window was
+ * added; for the stacking list, at the top), and the whole list
+ * otherwise.
+ *
+ * \param last  the value we last set, updated to the new value
+ */
+static void
+sync_window_list_property (MetaStack *stack,
+                           Atom       property,
+                           GArray    *windows,
+                           GArray   **last)
+{
+  Display *xdisplay = stack->screen->display->xdisplay;
+  int mode;
+  guint first;
+
+  if (window_arrays_equal (*last, windows))
+    return;
+
+  if (*last != NULL && (*last)->len < windows->len &&
+      memcmp ((*last)->data, windows->data,
+              (*last)->len * sizeof (Window)) == 0)
+    {
+      mode = PropModeAppend;
+      first = (*last)->len;
+    }
+  else
+    {
+      mode = PropModeReplace;
+      first = 0;
+    }
+
+  XChangeProperty (xdisplay,
+                   stack->screen->xroot,
+                   property,
+                   XA_WINDOW,
+                   32, mode,
+                   (unsigned char *) &g_array_index (windows, Window, first),
+                   windows->len - first);
+  count_requests (stack, 1, CHANGE_PROPERTY_BYTES (windows->len - first));
+
+  if (*last == NULL)
+    *last = g_array_new (FALSE, FALSE, sizeof (Window));
+  g_array_set_size (*last, windows->len);
+  memcpy ((*last)->data, windows->data, windows->len * sizeof (Window));
+}
+
 /**
  * Order the windows on the X server to be the same as in our structure.
- * We do this using XRestackWindows if we don't know the previous order,
- * or XConfigureWindow on a few particular windows if we do and can figure
- * out the minimum set of changes.  After that, we set __NET_CLIENT_LIST
- * and __NET_CLIENT_LIST_STACKING.
+ * We do this using XRestackWindows if we don't know the previous order.
+ * Otherwise we leave the longest run of windows that are still in the
+ * same relative order where they are, and move each of the others just
+ * below the window that should be above it, so raising or lowering a
+ * window costs a single request. After that, we set _NET_CLIENT_LIST
+ * and _NET_CLIENT_LIST_STACKING, if they changed.
  *
- * FIXME: Now that we have a good view of the stacking order on the server
- * with MetaStackTracker it should be possible to do a simpler and better
- * job of computing the minimal set of stacking requests needed.
+ * Every request is recorded with the stack tracker as we make it, so
+ * its predicted stack follows each move.
  */
 static void
 stack_sync_to_server (MetaStack *stack)
@@ -1069,6 +1212,8 @@ stack_sync_to_server (MetaStack *stack)
   GList *tmp;
   GArray *all_hidden;
   int n_override_redirect = 0;
+  int n_stacked;
+  gboolean raised_to_top = FALSE;
   
   /* Bail out if frozen */
   if (stack->freeze_count > 0)
@@ -1078,13 +1223,20 @@ stack_sync_to_server (MetaStack *stack)
 
   stack_ensure_sorted (stack);
 
+  stack->n_sync_requests = 0;
+  stack->n_sync_bytes = 0;
+
   /* Create stacked xwindow arrays.
    * Painfully, "stacked" is in bottom-to-top order for the
    * _NET hints, and "root_children_stacked" is in top-to-bottom
-   * order for XRestackWindows()
+   * order for XRestackWindows(); we fill "stacked" from the end.
    */
-  stacked = g_array_new (FALSE, FALSE, sizeof (Window));
-  root_children_stacked = g_array_new (FALSE, FALSE, sizeof (Window));
+  stacked = g_array_sized_new (FALSE, FALSE, sizeof (Window),
+                               stack->windows->len);
+  g_array_set_size (stacked, stack->windows->len);
+  n_stacked = 0;
+  root_children_stacked = g_array_sized_new (FALSE, FALSE, sizeof (Window),
+                                             stack->windows->len);
   all_hidden = g_array_new (FALSE, FALSE, sizeof (Window));
 
   /* The screen guard window sits above all hidden windows and acts as
@@ -1105,8 +1257,11 @@ stack_sync_to_server (MetaStack *stack)
       /* remember, stacked is in reverse order (bottom to top) */
       if (w->override_redirect)
 	n_override_redirect++;
-      else
-	g_array_prepend_val (stacked, w->xwindow);
+      else if (n_stacked < (int) stacked->len)
+        {
+          n_stacked++;
+          g_array_index (stacked, Window, stacked->len - n_stacked) = w->xwindow;
+        }
       
       if (w->frame)
 	top_level_window = w->frame->xwindow;
@@ -1130,9 +1285,12 @@ stack_sync_to_server (MetaStack *stack)
   meta_pop_no_msg_prefix ();
 
   /* All windows should be in some stacking order */
-  if (stacked->len != stack->windows->len - n_override_redirect)
-    meta_bug ("%u windows stacked, %u windows exist in stack\n",
-              stacked->len, stack->windows->len);
+  if ((guint) n_stacked != stack->windows->len - n_override_redirect)
+    meta_bug ("%d windows stacked, %u windows exist in stack\n",
+              n_stacked, stack->windows->len);
+
+  /* Drop the unused slots at the start */
+  g_array_remove_range (stacked, 0, stacked->len - n_stacked);
   
   /* Sync to server */
 
@@ -1148,20 +1306,13 @@ stack_sync_to_server (MetaStack *stack)
        */
       meta_topic (META_DEBUG_STACK, "Don't know last stack state, restacking everything\n");
 
-      if (root_children_stacked->len > 0)
-        {
-          meta_stack_tracker_record_restack_windows (stack->screen->stack_tracker,
-                                                     (Window *) root_children_stacked->data,
-                                                     root_children_stacked->len,
-                                                     XNextRequest (stack->screen->display->xdisplay));
-          XRestackWindows (stack->screen->display->xdisplay,
-                           (Window *) root_children_stacked->data,
-                           root_children_stacked->len);
-        }
+      restack_windows (stack,
+                       (Window *) root_children_stacked->data,
+                       root_children_stacked->len);
+      raised_to_top = TRUE;
     }
   else if (root_children_stacked->len > 0)
     {
-      /* Try to do minimal window moves to get the stack in order */
       /* A point of note: these arrays include frames not client windows,
        * so if a client window has changed frame since last_root_children_stacked
        * was saved, then we may have inefficiency, but I don't think things
@@ -1171,101 +1322,77 @@ stack_sync_to_server (MetaStack *stack)
       const Window *new_stack = (Window *) root_children_stacked->data;
       const int old_len = stack->last_root_children_stacked->len;
       const int new_len = root_children_stacked->len;
-      const Window *oldp = old_stack;
-      const Window *newp = new_stack;
-      const Window *old_end = old_stack + old_len;
-      const Window *new_end = new_stack + new_len;
-      Window last_window = None;
-      
-      while (oldp != old_end &&
-             newp != new_end)
+      gboolean *keep;
+      int i;
+
+      keep = g_new (gboolean, new_len);
+      find_windows_in_place (old_stack, old_len, new_stack, new_len, keep);
+
+      for (i = 0; i < new_len; i++)
         {
-          if (*oldp == *newp)
-            {
-              /* Stacks are the same here, move on */
-              ++oldp;
-              last_window = *newp;
-              ++newp;
-            }
-          else if (meta_display_lookup_x_window (stack->screen->display,
-                                                 *oldp) == NULL)
+          if (keep[i])
+            continue;
+
+          if (i == 0)
             {
-              /* *oldp is no longer known to us (probably destroyed),
-               * so we can just skip it
-               */
-              ++oldp;
+              meta_topic (META_DEBUG_STACK, "Using window 0x%lx as topmost (but leaving it in-place)\n", new_stack[i]);
+
+              raise_window_relative_to_managed_windows (stack->screen,
+                                                        new_stack[i]);
+              count_requests (stack, 1, CONFIGURE_WINDOW_BYTES (2));
+              raised_to_top = TRUE;
             }
           else
             {
-              /* Move *newp below last_window */
-              if (last_window == None)
-                {
-                  meta_topic (META_DEBUG_STACK, "Using window 0x%lx as topmost (but leaving it in-place)\n", *newp);
+              /* This means that if new_stack[i - 1] is dead, but not
+               * new_stack[i], then we fail to restack new_stack[i]; but
+               * on unmanaging the dead window, we'll fix it up.
+               */
+              XWindowChanges changes;
 
-                  raise_window_relative_to_managed_windows (stack->screen,
-                                                            *newp);
-                }
-              else
-                {
-                  /* This means that if last_window is dead, but not
-                   * *newp, then we fail to restack *newp; but on
-                   * unmanaging last_window, we'll fix it up.
-                   */
-                  
-                  XWindowChanges changes;
-
-                  changes.sibling = last_window;
-                  changes.stack_mode = Below;
-
-                  meta_topic (META_DEBUG_STACK, "Placing window 0x%lx below 0x%lx\n",
-                              *newp, last_window);
-
-                  meta_stack_tracker_record_lower_below (stack->screen->stack_tracker,
-                                                         *newp, last_window,
-                                                         XNextRequest (stack->screen->display->xdisplay));
-                  XConfigureWindow (stack->screen->display->xdisplay,
-                                    *newp,
-                                    CWSibling | CWStackMode,
-                                    &changes);
-                }
+              changes.sibling = new_stack[i - 1];
+              changes.stack_mode = Below;
 
-              last_window = *newp;
-              ++newp;
-            }
-        }
+              meta_topic (META_DEBUG_STACK, "Placing window 0x%lx below 0x%lx\n",
+                          new_stack[i], new_stack[i - 1]);
 
-      if (newp != new_end)
-        {
-          /* Restack remaining windows */
-          meta_topic (META_DEBUG_STACK, "Restacking remaining %d windows\n",
-                        (int) (new_end - newp));
-          /* We need to include an already-stacked window
-           * in the restack call, so we get in the proper position
-           * with respect to it.
-           */
-          if (newp != new_stack)
-            --newp;
-          meta_stack_tracker_record_restack_windows (stack->screen->stack_tracker,
-                                                     (Window *) newp, new_end - newp,
+              meta_stack_tracker_record_lower_below (stack->screen->stack_tracker,
+                                                     new_stack[i], new_stack[i - 1],
                                                      XNextRequest (stack->screen->display->xdisplay));
-          XRestackWindows (stack->screen->display->xdisplay,
-                           (Window *) newp, new_end - newp);
+              XConfigureWindow (stack->screen->display->xdisplay,
+                                new_stack[i],
+                                CWSibling | CWStackMode,
+                                &changes);
+              count_requests (stack, 1, CONFIGURE_WINDOW_BYTES (2));
+            }
         }
+
+      g_free (keep);
     }
 
-  /* Push hidden windows to the bottom of the stack under the guard window */
-  meta_stack_tracker_record_lower (stack->screen->stack_tracker,
-                                   stack->screen->guard_window,
-                                   XNextRequest (stack->screen->display->xdisplay));
-  XLowerWindow (stack->screen->display->xdisplay, stack->screen->guard_window);
-  meta_stack_tracker_record_restack_windows (stack->screen->stack_tracker,
-                                             (Window *)all_hidden->data,
-                                             all_hidden->len,
-                                             XNextRequest (stack->screen->display->xdisplay));
-  XRestackWindows (stack->screen->display->xdisplay,
-		   (Window *)all_hidden->data,
-		   all_hidden->len);
-  g_array_free (all_hidden, TRUE);
+  /* Push hidden windows to the bottom of the stack under the guard
+   * window. Windows moved relative to other visible windows stay above
+   * it, so this is only needed when the set of hidden windows changed,
+   * or when we raised a window relative to whatever managed window was
+   * topmost, which might have been a hidden one (and so below the
+   * guard window).
+   */
+  if (raised_to_top ||
+      !window_arrays_equal (stack->last_all_hidden, all_hidden))
+    {
+      meta_stack_tracker_record_lower (stack->screen->stack_tracker,
+                                       stack->screen->guard_window,
+                                       XNextRequest (stack->screen->display->xdisplay));
+      XLowerWindow (stack->screen->display->xdisplay, stack->screen->guard_window);
+      count_requests (stack, 1, CONFIGURE_WINDOW_BYTES (1));
+      restack_windows (stack,
+                       (Window *) all_hidden->data,
+                       all_hidden->len);
+    }
+
+  if (stack->last_all_hidden)
+    g_array_free (stack->last_all_hidden, TRUE);
+  stack->last_all_hidden = all_hidden;
 
   meta_error_trap_pop (stack->screen->display);
   /* on error, a window was destroyed; it should eventually
@@ -1275,20 +1402,14 @@ stack_sync_to_server (MetaStack *stack)
   
   /* Sync _NET_CLIENT_LIST and _NET_CLIENT_LIST_STACKING */
 
-  XChangeProperty (stack->screen->display->xdisplay,
-                   stack->screen->xroot,
-                   stack->screen->display->atom__NET_CLIENT_LIST,
-                   XA_WINDOW,
-                   32, PropModeReplace,
-                   (unsigned char *)stack->windows->data,
-                   stack->windows->len);
-  XChangeProperty (stack->screen->display->xdisplay,
-                   stack->screen->xroot,
-                   stack->screen->display->atom__NET_CLIENT_LIST_STACKING,
-                   XA_WINDOW,
-                   32, PropModeReplace,
-                   (unsigned char *)stacked->data,
-                   stacked->len);
+  sync_window_list_property (stack,
+                             stack->screen->display->atom__NET_CLIENT_LIST,
+                             stack->windows,
+                             &stack->last_client_list);
+  sync_window_list_property (stack,
+                             stack->screen->display->atom__NET_CLIENT_LIST_STACKING,
+                             stacked,
+                             &stack->last_client_list_stacking);
 
   g_array_free (stacked, TRUE);
 
@@ -1296,7 +1417,19 @@ stack_sync_to_server (MetaStack *stack)
     g_array_free (stack->last_root_children_stacked, TRUE);
   stack->last_root_children_stacked = root_children_stacked;
 
-  /* That was scary... */
+  meta_topic (META_DEBUG_STACK, "Stack sync sent %u requests, %u bytes\n",
+              stack->n_sync_requests, stack->n_sync_bytes);
+}
+
+void
+meta_stack_get_sync_stats (MetaStack *stack,
+                           guint     *n_requests,
+                           guint     *n_bytes)
+{
+  if (n_requests)
+    *n_requests = stack->n_sync_requests;
+  if (n_bytes)
+    *n_bytes = stack->n_sync_bytes;
 }
 
 MetaWindow*
@@ -1387,6 +1520,65 @@ window_contains_point (MetaWindow *window,
   return POINT_IN_RECT (root_x, root_y, rect);
 }
 
+static gboolean
+is_focus_candidate (MetaWindow    *window,
+                    MetaWorkspace *workspace,
+                    MetaWindow    *not_this_one)
+{
+  return window != not_this_one &&
+    (window->unmaps_pending == 0) &&
+    !window->minimized &&
+    (window->input || window->take_focus) &&
+    (workspace == NULL ||
+     meta_window_located_on_workspace (window, workspace));
+}
+
+/* Sorts windows from the top of the stack to the bottom */
+static int
+compare_topmost_first (gconstpointer a,
+                       gconstpointer b)
+{
+  const MetaWindow *window_a = a;
+  const MetaWindow *window_b = b;
+
+  if (window_a->layer != window_b->layer)
+    return window_b->layer - window_a->layer;
+  else
+    return window_b->stack_position - window_a->stack_position;
+}
+
+static gboolean
+prepend_stacked_window (MetaWindow          *window,
+                        const MetaRectangle *rect,
+                        gpointer             data)
+{
+  GList **windows = data;
+
+  /* Override redirect windows aren't in the stack */
+  if (window->stack_position >= 0)
+    *windows = g_list_prepend (*windows, window);
+
+  return FALSE;
+}
+
+/* Lists the windows in the stack located on workspace whose outer
+ * rectangle contains the point, from the top of the stack down.
+ */
+static GList *
+list_windows_at_point (MetaStack     *stack,
+                       MetaWorkspace *workspace,
+                       int            root_x,
+                       int            root_y)
+{
+  MetaRectangle point = meta_rect (root_x, root_y, 1, 1);
+  GList *windows = NULL;
+
+  meta_screen_foreach_window_in_rect (stack->screen, workspace, &point,
+                                      prepend_stacked_window, &windows);
+
+  return g_list_sort (windows, compare_topmost_first);
+}
+
 static MetaWindow*
 get_default_focus_window (MetaStack     *stack,
                           MetaWorkspace *workspace,
@@ -1406,6 +1598,7 @@ get_default_focus_window (MetaStack     *stack,
   MetaWindow *topmost_in_group;
   MetaWindow *topmost_overall;
   MetaGroup *not_this_one_group;
+  GList *candidates;
   GList *link;
   
   topmost_dock = NULL;
@@ -1419,20 +1612,24 @@ get_default_focus_window (MetaStack     *stack,
 
   stack_ensure_sorted (stack);
 
+  /* When looking at a point on a workspace, only the windows there
+   * matter (except for docks, see below); find them in the spatial
+   * index rather than checking every window in the stack.
+   */
+  if (must_be_at_point && workspace != NULL)
+    candidates = list_windows_at_point (stack, workspace, root_x, root_y);
+  else
+    candidates = stack->sorted;
+
   /* top of this layer is at the front of the list */
-  link = stack->sorted;
+  link = candidates;
       
   while (link)
     {
       MetaWindow *window = link->data;
 
       if (window &&
-          window != not_this_one &&
-          (window->unmaps_pending == 0) &&
-          !window->minimized &&
-          (window->input || window->take_focus) &&
-          (workspace == NULL ||
-           meta_window_located_on_workspace (window, workspace)))
+          is_focus_candidate (window, workspace, not_this_one))
         {
           if (topmost_dock == NULL &&
               window->type == META_WINDOW_DOCK)
@@ -1473,6 +1670,33 @@ get_default_focus_window (MetaStack     *stack,
       link = link->next;
     }
 
+  if (candidates != stack->sorted)
+    {
+      g_list_free (candidates);
+
+      /* The dock doesn't have to be at the point; it's the last
+       * resort, so only look for it if nothing else was found.
+       */
+      topmost_dock = NULL;
+      if (transient_parent == NULL &&
+          topmost_in_group == NULL &&
+          topmost_overall == NULL)
+        {
+          for (link = stack->sorted; link; link = link->next)
+            {
+              MetaWindow *window = link->data;
+
+              if (window &&
+                  window->type == META_WINDOW_DOCK &&
+                  is_focus_candidate (window, workspace, not_this_one))
+                {
+                  topmost_dock = window;
+                  break;
+                }
+            }
+        }
+    }
+
   if (transient_parent)
     return transient_parent;
   else if (topmost_in_group)
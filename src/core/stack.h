@@ -100,6 +100,19 @@ struct _MetaStack
    */
   GArray *last_root_children_stacked;
 
+  /**
+   * The hidden windows we last pushed below the guard window, and the
+   * values we last set for _NET_CLIENT_LIST and _NET_CLIENT_LIST_STACKING,
+   * so that we only resend them when they change.
+   */
+  GArray *last_all_hidden;
+  GArray *last_client_list;
+  GArray *last_client_list_stacking;
+
+  /** Requests, and their approximate size, sent by the last sync */
+  guint n_sync_requests;
+  guint n_sync_bytes;
+
   /**
    * Number of stack positions; same as the length of added, but
    * kept for quick reference.
@@ -383,4 +396,15 @@ GList* meta_stack_get_positions (MetaStack *stack);
 void   meta_stack_set_positions (MetaStack *stack,
                                  GList     *windows);
 
+/**
+ * Reports what the last sync of the stack to the X server cost.
+ *
+ * \param stack  The stack to examine.
+ * \param n_requests  Set to the number of requests sent (may be NULL).
+ * \param n_bytes  Set to their approximate size on the wire (may be NULL).
+ */
+void   meta_stack_get_sync_stats (MetaStack *stack,
+                                  guint     *n_requests,
+                                  guint     *n_bytes);
+
 #endif
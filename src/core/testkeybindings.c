@@ -0,0 +1,147 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Mutter key binding dispatch testing program */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "keybindings-private.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* For the BINDING_* flags */
+#define keybind(name, handler, param, flags, stroke, description)
+#include "all-keybindings.h"
+#undef keybind
+
+#define NUM_RANDOM_RUNS 200
+#define NUM_RANDOM_EVENTS 1000
+
+static MetaKeyHandler global_handler = { "global", NULL, NULL, 0, 0, NULL, NULL };
+static MetaKeyHandler window_handler = { "window", NULL, NULL, 0, BINDING_PER_WINDOW, NULL, NULL };
+
+/* This is how the binding for a key press used to be found */
+static MetaKeyBinding *
+find_binding_linear (MetaKeyBinding *bindings,
+                     int             n_bindings,
+                     unsigned int    ignored_modifier_mask,
+                     unsigned int    keycode,
+                     unsigned int    state,
+                     gboolean        on_window)
+{
+  int i;
+
+  for (i = 0; i < n_bindings; i++)
+    {
+      MetaKeyHandler *handler = bindings[i].handler;
+
+      if ((!on_window && handler->flags & BINDING_PER_WINDOW) ||
+          bindings[i].keycode != keycode ||
+          ((state & 0xff & ~ignored_modifier_mask) != bindings[i].mask))
+        continue;
+
+      return &bindings[i];
+    }
+
+  return NULL;
+}
+
+/* Uses a small range of keycodes and masks so that there are lots of
+ * duplicate bindings */
+static void
+get_random_binding (MetaKeyBinding *binding)
+{
+  binding->name = "binding";
+  binding->keysym = 0;
+  binding->keycode = g_random_int_range (8, 40);
+  binding->mask = g_random_int_range (0, 16) << 2;
+  binding->modifiers = 0;
+  binding->handler = g_random_boolean () ? &global_handler : &window_handler;
+}
+
+static void
+check_lookup (MetaKeyBindingIndex *index,
+              MetaKeyBinding      *bindings,
+              int                  n_bindings,
+              unsigned int         ignored_modifier_mask,
+              unsigned int         keycode,
+              unsigned int         state)
+{
+  g_assert (meta_key_binding_index_lookup (index, keycode, state, TRUE) ==
+            find_binding_linear (bindings, n_bindings, ignored_modifier_mask,
+                                 keycode, state, TRUE));
+  g_assert (meta_key_binding_index_lookup (index, keycode, state, FALSE) ==
+            find_binding_linear (bindings, n_bindings, ignored_modifier_mask,
+                                 keycode, state, FALSE));
+}
+
+static void
+test_binding_index (void)
+{
+  int run;
+
+  for (run = 0; run < NUM_RANDOM_RUNS; run++)
+    {
+      int n_bindings = g_random_int_range (0, 400);
+      MetaKeyBinding *bindings = g_new0 (MetaKeyBinding, n_bindings);
+      /* Lock and maybe Mod2 for Num Lock, as usual */
+      unsigned int ignored_modifier_mask = LockMask |
+        (g_random_boolean () ? Mod2Mask : 0);
+      MetaKeyBindingIndex *index;
+      int i;
+
+      for (i = 0; i < n_bindings; i++)
+        get_random_binding (&bindings[i]);
+
+      index = meta_key_binding_index_new (bindings, n_bindings,
+                                          ignored_modifier_mask);
+
+      /* Every binding, with and without ignored modifiers */
+      for (i = 0; i < n_bindings; i++)
+        {
+          check_lookup (index, bindings, n_bindings, ignored_modifier_mask,
+                        bindings[i].keycode, bindings[i].mask);
+          check_lookup (index, bindings, n_bindings, ignored_modifier_mask,
+                        bindings[i].keycode,
+                        bindings[i].mask | ignored_modifier_mask);
+        }
+
+      /* And key presses that may not match anything */
+      for (i = 0; i < NUM_RANDOM_EVENTS; i++)
+        check_lookup (index, bindings, n_bindings, ignored_modifier_mask,
+                      g_random_int_range (8, 48),
+                      g_random_int_range (0, 0x10000));
+
+      meta_key_binding_index_free (index);
+      g_free (bindings);
+    }
+
+  printf ("%s passed.\n", G_STRFUNC);
+}
+
+int
+main (void)
+{
+  g_random_set_seed (time (NULL));
+
+  test_binding_index ();
+
+  printf ("All tests passed.\n");
+  return 0;
+}
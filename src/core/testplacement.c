@@ -0,0 +1,445 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Mutter placement free space testing and benchmarking program */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "free-space.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_RANDOM_RUNS 200
+#define N_OBSTACLES 40
+
+/* How long to run each benchmark for, in seconds */
+#define BENCHMARK_TIME 2.0
+
+#define N_MONITORS 4
+#define N_WINDOWS 500
+
+#define MONITOR_WIDTH 1920
+#define MONITOR_HEIGHT 1080
+
+static void
+get_random_obstacle (const MetaRectangle *area,
+                     MetaRectangle       *rect)
+{
+  /* Sometimes partly outside the area */
+  rect->x = g_random_int_range (area->x - 100, area->x + area->width);
+  rect->y = g_random_int_range (area->y - 100, area->y + area->height);
+  rect->width = g_random_int_range (1, area->width / 2);
+  rect->height = g_random_int_range (1, area->height / 2);
+}
+
+static gboolean
+overlaps_some (const MetaRectangle *rect,
+               const MetaRectangle *obstacles,
+               int                  n_obstacles)
+{
+  int i;
+
+  for (i = 0; i < n_obstacles; i++)
+    if (meta_rectangle_overlap (rect, &obstacles[i]))
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Whether a width x height rectangle fits somewhere in area without
+ * overlapping an obstacle: if it does, it also fits with its left edge
+ * on the area's or an obstacle's right edge, and its top edge on the
+ * area's or an obstacle's bottom edge.
+ */
+static gboolean
+brute_force_fits (const MetaRectangle *area,
+                  const MetaRectangle *obstacles,
+                  int                  n_obstacles,
+                  int                  width,
+                  int                  height)
+{
+  int i, j;
+
+  for (i = -1; i < n_obstacles; i++)
+    for (j = -1; j < n_obstacles; j++)
+      {
+        MetaRectangle rect;
+
+        rect.x = i < 0 ? area->x : obstacles[i].x + obstacles[i].width;
+        rect.y = j < 0 ? area->y : obstacles[j].y + obstacles[j].height;
+        rect.width = width;
+        rect.height = height;
+
+        if (meta_rectangle_contains_rect (area, &rect) &&
+            !overlaps_some (&rect, obstacles, n_obstacles))
+          return TRUE;
+      }
+
+  return FALSE;
+}
+
+static void
+check_free_space (MetaFreeSpace       *space,
+                  const MetaRectangle *area,
+                  const MetaRectangle *obstacles,
+                  int                  n_obstacles)
+{
+  const MetaRectangle *rects;
+  int n_rects, i, j;
+
+  rects = meta_free_space_get_rects (space, &n_rects);
+
+  /* The rectangles are free and maximal */
+  for (i = 0; i < n_rects; i++)
+    {
+      MetaRectangle grown;
+
+      g_assert (rects[i].width > 0 && rects[i].height > 0);
+      g_assert (meta_rectangle_contains_rect (area, &rects[i]));
+      g_assert (!overlaps_some (&rects[i], obstacles, n_obstacles));
+
+      for (j = 0; j < 4; j++)
+        {
+          grown = rects[i];
+          switch (j)
+            {
+            case 0: grown.x--; grown.width++; break;
+            case 1: grown.width++; break;
+            case 2: grown.y--; grown.height++; break;
+            case 3: grown.height++; break;
+            }
+
+          g_assert (!meta_rectangle_contains_rect (area, &grown) ||
+                    overlaps_some (&grown, obstacles, n_obstacles));
+        }
+
+      for (j = 0; j < n_rects; j++)
+        g_assert (j == i ||
+                  !meta_rectangle_contains_rect (&rects[j], &rects[i]));
+    }
+
+  /* They cover all of the free space */
+  for (i = 0; i < 50; i++)
+    {
+      MetaRectangle point;
+
+      point = meta_rect (g_random_int_range (area->x, area->x + area->width),
+                         g_random_int_range (area->y, area->y + area->height),
+                         1, 1);
+
+      if (overlaps_some (&point, obstacles, n_obstacles))
+        continue;
+
+      for (j = 0; j < n_rects; j++)
+        if (meta_rectangle_contains_rect (&rects[j], &point))
+          break;
+      g_assert (j < n_rects);
+    }
+
+  /* Fits are found whenever there's room, in the smallest rectangle */
+  for (i = 0; i < 20; i++)
+    {
+      int width = g_random_int_range (1, area->width);
+      int height = g_random_int_range (1, area->height);
+      MetaRectangle fit;
+      gboolean found;
+
+      found = meta_free_space_find_best_fit (space, width, height, &fit);
+      g_assert (found == brute_force_fits (area, obstacles, n_obstacles,
+                                           width, height));
+
+      if (!found)
+        continue;
+
+      g_assert (fit.width >= width && fit.height >= height);
+      for (j = 0; j < n_rects; j++)
+        g_assert (rects[j].width < width || rects[j].height < height ||
+                  meta_rectangle_area (&rects[j]) >= meta_rectangle_area (&fit));
+    }
+}
+
+static void
+test_free_space_matches_brute_force (void)
+{
+  MetaRectangle area = meta_rect (100, 50, MONITOR_WIDTH, MONITOR_HEIGHT);
+  int run;
+
+  for (run = 0; run < NUM_RANDOM_RUNS; run++)
+    {
+      MetaRectangle obstacles[N_OBSTACLES];
+      MetaFreeSpace *space = meta_free_space_new (&area);
+      int n_obstacles = g_random_int_range (0, N_OBSTACLES);
+      int i;
+
+      check_free_space (space, &area, obstacles, 0);
+
+      for (i = 0; i < n_obstacles; i++)
+        {
+          get_random_obstacle (&area, &obstacles[i]);
+          meta_free_space_add_obstacle (space, &obstacles[i]);
+          check_free_space (space, &area, obstacles, i + 1);
+        }
+
+      meta_free_space_free (space);
+    }
+
+  printf ("Free space matches brute force.\n");
+}
+
+static void
+get_monitors (MetaRectangle *monitors)
+{
+  int i;
+
+  for (i = 0; i < N_MONITORS; i++)
+    monitors[i] = meta_rect (i * MONITOR_WIDTH, 0,
+                             MONITOR_WIDTH, MONITOR_HEIGHT);
+}
+
+static void
+get_random_sizes (MetaRectangle *windows)
+{
+  int i;
+
+  for (i = 0; i < N_WINDOWS; i++)
+    windows[i] = meta_rect (0, 0,
+                            g_random_int_range (100, 700),
+                            g_random_int_range (80, 500));
+}
+
+/* Where placement falls back to when nothing fits, the same for both
+ * placement algorithms.
+ */
+static void
+cascade (const MetaRectangle *monitor,
+         int                  n_cascaded,
+         MetaRectangle       *rect)
+{
+  rect->x = monitor->x + (n_cascaded * 32) % (monitor->width / 2);
+  rect->y = monitor->y + (n_cascaded * 32) % (monitor->height / 2);
+}
+
+static gboolean
+place_centered (const MetaRectangle *monitor,
+                const MetaRectangle *placed,
+                int                  n_placed,
+                MetaRectangle       *rect)
+{
+  rect->x = monitor->x + (monitor->width % (rect->width + 1)) / 2;
+  rect->y = monitor->y + (monitor->height % (rect->height + 1)) / 3;
+
+  return meta_rectangle_contains_rect (monitor, rect) &&
+    !overlaps_some (rect, placed, n_placed);
+}
+
+/* Returns how many windows were placed without overlapping others */
+static int
+place_with_free_space (MetaRectangle *windows)
+{
+  MetaRectangle monitors[N_MONITORS];
+  MetaFreeSpace *spaces[N_MONITORS];
+  int n_cascaded[N_MONITORS];
+  int n_fitted = 0;
+  int i;
+
+  get_monitors (monitors);
+  for (i = 0; i < N_MONITORS; i++)
+    {
+      spaces[i] = meta_free_space_new (&monitors[i]);
+      n_cascaded[i] = 0;
+    }
+
+  for (i = 0; i < N_WINDOWS; i++)
+    {
+      int monitor = i % N_MONITORS;
+      MetaRectangle *rect = &windows[i];
+      MetaRectangle fit;
+
+      if (place_centered (&monitors[monitor], windows, i, rect))
+        n_fitted++;
+      else if (meta_free_space_find_best_fit (spaces[monitor],
+                                              rect->width, rect->height,
+                                              &fit))
+        {
+          rect->x = fit.x;
+          rect->y = fit.y;
+          n_fitted++;
+        }
+      else
+        cascade (&monitors[monitor], n_cascaded[monitor]++, rect);
+
+      meta_free_space_add_obstacle (spaces[monitor], rect);
+    }
+
+  for (i = 0; i < N_MONITORS; i++)
+    meta_free_space_free (spaces[i]);
+
+  return n_fitted;
+}
+
+static int
+compare_below (gconstpointer a,
+               gconstpointer b)
+{
+  const MetaRectangle *rect_a = *(const MetaRectangle **) a;
+  const MetaRectangle *rect_b = *(const MetaRectangle **) b;
+
+  if (rect_a->y != rect_b->y)
+    return rect_a->y < rect_b->y ? -1 : 1;
+  return rect_a->x < rect_b->x ? -1 : rect_a->x > rect_b->x;
+}
+
+static int
+compare_right (gconstpointer a,
+               gconstpointer b)
+{
+  const MetaRectangle *rect_a = *(const MetaRectangle **) a;
+  const MetaRectangle *rect_b = *(const MetaRectangle **) b;
+
+  if (rect_a->x != rect_b->x)
+    return rect_a->x < rect_b->x ? -1 : 1;
+  return rect_a->y < rect_b->y ? -1 : rect_a->y > rect_b->y;
+}
+
+/* The placement find_first_fit() used to do: try below, then to the
+ * right of, each window, checking each position against every window.
+ */
+static int
+place_aligned_to_windows (MetaRectangle *windows)
+{
+  MetaRectangle monitors[N_MONITORS];
+  const MetaRectangle *sorted[N_WINDOWS];
+  int n_cascaded[N_MONITORS];
+  int n_fitted = 0;
+  int i, j, pass;
+
+  get_monitors (monitors);
+  for (i = 0; i < N_MONITORS; i++)
+    n_cascaded[i] = 0;
+
+  for (i = 0; i < N_WINDOWS; i++)
+    {
+      int monitor = i % N_MONITORS;
+      MetaRectangle *rect = &windows[i];
+      gboolean found;
+
+      found = place_centered (&monitors[monitor], windows, i, rect);
+
+      for (pass = 0; pass < 2 && !found; pass++)
+        {
+          for (j = 0; j < i; j++)
+            sorted[j] = &windows[j];
+          qsort (sorted, i, sizeof (MetaRectangle *),
+                 pass == 0 ? compare_below : compare_right);
+
+          for (j = 0; j < i && !found; j++)
+            {
+              rect->x = sorted[j]->x + (pass == 0 ? 0 : sorted[j]->width);
+              rect->y = sorted[j]->y + (pass == 0 ? sorted[j]->height : 0);
+
+              found = meta_rectangle_contains_rect (&monitors[monitor], rect) &&
+                !overlaps_some (rect, windows, i);
+            }
+        }
+
+      if (found)
+        n_fitted++;
+      else
+        cascade (&monitors[monitor], n_cascaded[monitor]++, rect);
+    }
+
+  return n_fitted;
+}
+
+static double
+get_overlap_area (const MetaRectangle *windows)
+{
+  double area = 0;
+  int i, j;
+
+  for (i = 0; i < N_WINDOWS; i++)
+    for (j = i + 1; j < N_WINDOWS; j++)
+      {
+        MetaRectangle overlap;
+
+        if (meta_rectangle_intersect (&windows[i], &windows[j], &overlap))
+          area += meta_rectangle_area (&overlap);
+      }
+
+  return area;
+}
+
+static void
+benchmark_placement (void)
+{
+  MetaRectangle sizes[N_WINDOWS], windows[N_WINDOWS];
+  GTimer *timer;
+  double elapsed;
+  int n_runs, n_fitted;
+
+  get_random_sizes (sizes);
+
+  timer = g_timer_new ();
+  n_runs = 0;
+  do
+    {
+      memcpy (windows, sizes, sizeof (windows));
+      n_fitted = place_with_free_space (windows);
+
+      n_runs++;
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  printf ("%d windows on %d monitors, free space: %.3f ms, "
+          "%d placed without overlap, %.1f monitors of overlap\n",
+          N_WINDOWS, N_MONITORS, 1000 * elapsed / n_runs, n_fitted,
+          get_overlap_area (windows) / (MONITOR_WIDTH * MONITOR_HEIGHT));
+
+  /* And the old placement, for comparison */
+  g_timer_start (timer);
+  n_runs = 0;
+  do
+    {
+      memcpy (windows, sizes, sizeof (windows));
+      n_fitted = place_aligned_to_windows (windows);
+
+      n_runs++;
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  printf ("%d windows on %d monitors, aligned to windows: %.3f ms, "
+          "%d placed without overlap, %.1f monitors of overlap\n",
+          N_WINDOWS, N_MONITORS, 1000 * elapsed / n_runs, n_fitted,
+          get_overlap_area (windows) / (MONITOR_WIDTH * MONITOR_HEIGHT));
+
+  g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  test_free_space_matches_brute_force ();
+
+  if (argc > 1 && strcmp (argv[1], "--benchmark") == 0)
+    benchmark_placement ();
+
+  return 0;
+}
@@ -0,0 +1,846 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Mutter spanning set region testing and benchmarking program */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "boxes-private.h"
+#include <meta/util.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_RANDOM_RUNS 2000
+
+/* How long to run each benchmark for, in seconds */
+#define BENCHMARK_TIME 2.0
+
+#define N_MONITORS 8
+#define N_STRUTS 50
+
+#define MONITOR_WIDTH 1920
+#define MONITOR_HEIGHT 1080
+
+static GSList *
+add_strut (GSList *struts,
+           int     x,
+           int     y,
+           int     width,
+           int     height,
+           MetaSide side)
+{
+  MetaStrut *strut = g_new (MetaStrut, 1);
+
+  strut->rect = meta_rect (x, y, width, height);
+  strut->side = side;
+
+  return g_slist_prepend (struts, strut);
+}
+
+static void
+free_struts (GSList *struts)
+{
+  GSList *tmp;
+
+  for (tmp = struts; tmp; tmp = tmp->next)
+    g_free (tmp->data);
+  g_slist_free (struts);
+}
+
+/* Adds a partial strut of random length along a random edge of the
+ * monitor, the way panels and docks set them.
+ */
+static GSList *
+add_random_strut (GSList              *struts,
+                  const MetaRectangle *monitor)
+{
+  int thickness = g_random_int_range (1, 64);
+  int length, offset;
+
+  switch (g_random_int_range (0, 4))
+    {
+    case 0:
+      length = g_random_int_range (1, monitor->width + 1);
+      offset = g_random_int_range (0, monitor->width - length + 1);
+      return add_strut (struts, monitor->x + offset, monitor->y,
+                        length, thickness, META_SIDE_TOP);
+    case 1:
+      length = g_random_int_range (1, monitor->width + 1);
+      offset = g_random_int_range (0, monitor->width - length + 1);
+      return add_strut (struts, monitor->x + offset,
+                        monitor->y + monitor->height - thickness,
+                        length, thickness, META_SIDE_BOTTOM);
+    case 2:
+      length = g_random_int_range (1, monitor->height + 1);
+      offset = g_random_int_range (0, monitor->height - length + 1);
+      return add_strut (struts, monitor->x, monitor->y + offset,
+                        thickness, length, META_SIDE_LEFT);
+    default:
+      length = g_random_int_range (1, monitor->height + 1);
+      offset = g_random_int_range (0, monitor->height - length + 1);
+      return add_strut (struts, monitor->x + monitor->width - thickness,
+                        monitor->y + offset,
+                        thickness, length, META_SIDE_RIGHT);
+    }
+}
+
+/* The spanning set computation and the queries on it as boxes.c did
+ * them on lists before MetaRegion, which the regions are checked and
+ * timed against.
+ */
+static gint
+list_compare_rect_areas (gconstpointer a, gconstpointer b)
+{
+  const MetaRectangle *a_rect = (gconstpointer) a;
+  const MetaRectangle *b_rect = (gconstpointer) b;
+
+  int a_area = meta_rectangle_area (a_rect);
+  int b_area = meta_rectangle_area (b_rect);
+
+  return b_area - a_area; /* positive ret value denotes b > a, ... */
+}
+
+static GList *
+list_merge_spanning_rects (GList *region)
+{
+  GList* compare;
+  compare = region;
+
+  if (region == NULL)
+    {
+      meta_warning ("Region to merge was empty!  Either you have a some "
+                    "pathological STRUT list or there's a bug somewhere!\n");
+      return NULL;
+    }
+
+  while (compare && compare->next)
+    {
+      MetaRectangle *a = compare->data;
+      GList *other = compare->next;
+
+      g_assert (a->width > 0 && a->height > 0);
+
+      while (other)
+        {
+          MetaRectangle *b = other->data;
+          GList *delete_me = NULL;
+
+          g_assert (b->width > 0 && b->height > 0);
+
+          /* If a contains b, just remove b */
+          if (meta_rectangle_contains_rect (a, b))
+            {
+              delete_me = other;
+            }
+          /* If b contains a, just remove a */
+          else if (meta_rectangle_contains_rect (a, b))
+            {
+              delete_me = compare;
+            }
+          /* If a and b might be mergeable horizontally */
+          else if (a->y == b->y && a->height == b->height)
+            {
+              /* If a and b overlap */
+              if (meta_rectangle_overlap (a, b))
+                {
+                  int new_x = MIN (a->x, b->x);
+                  a->width = MAX (a->x + a->width, b->x + b->width) - new_x;
+                  a->x = new_x;
+                  delete_me = other;
+                }
+              /* If a and b are adjacent */
+              else if (a->x + a->width == b->x || a->x == b->x + b->width)
+                {
+                  int new_x = MIN (a->x, b->x);
+                  a->width = MAX (a->x + a->width, b->x + b->width) - new_x;
+                  a->x = new_x;
+                  delete_me = other;
+                }
+            }
+          /* If a and b might be mergeable vertically */
+          else if (a->x == b->x && a->width == b->width)
+            {
+              /* If a and b overlap */
+              if (meta_rectangle_overlap (a, b))
+                {
+                  int new_y = MIN (a->y, b->y);
+                  a->height = MAX (a->y + a->height, b->y + b->height) - new_y;
+                  a->y = new_y;
+                  delete_me = other;
+                }
+              /* If a and b are adjacent */
+              else if (a->y + a->height == b->y || a->y == b->y + b->height)
+                {
+                  int new_y = MIN (a->y, b->y);
+                  a->height = MAX (a->y + a->height, b->y + b->height) - new_y;
+                  a->y = new_y;
+                  delete_me = other;
+                }
+            }
+
+          other = other->next;
+
+          /* Delete any rectangle in the list that is no longer wanted */
+          if (delete_me != NULL)
+            {
+              /* Deleting the rect we compare others to is a little tricker */
+              if (compare == delete_me)
+                {
+                  compare = compare->next;
+                  other = compare->next;
+                  a = compare->data;
+                }
+
+              /* Okay, we can free it now */
+              g_free (delete_me->data);
+              region = g_list_delete_link (region, delete_me);
+            }
+
+        }
+
+      compare = compare->next;
+    }
+
+  return region;
+}
+
+static GList *
+list_spanning_set (const MetaRectangle *basic_rect,
+                   const GSList        *all_struts)
+{
+  GList         *ret;
+  GList         *tmp_list;
+  const GSList  *strut_iter;
+  MetaRectangle *temp_rect;
+
+  /* The algorithm is basically as follows:
+   *   Initialize rectangle_set to basic_rect
+   *   Foreach strut:
+   *     Foreach rectangle in rectangle_set:
+   *       - Split the rectangle into new rectangles that don't overlap the
+   *         strut (but which are as big as possible otherwise)
+   *       - Remove the old (pre-split) rectangle from the rectangle_set,
+   *         and replace it with the new rectangles generated from the
+   *         splitting
+   */
+
+  temp_rect = g_new (MetaRectangle, 1);
+  *temp_rect = *basic_rect;
+  ret = g_list_prepend (NULL, temp_rect);
+
+  strut_iter = all_struts;
+  for (strut_iter = all_struts; strut_iter; strut_iter = strut_iter->next)
+    {
+      GList *rect_iter;
+      MetaRectangle *strut_rect = &((MetaStrut*)strut_iter->data)->rect;
+
+      tmp_list = ret;
+      ret = NULL;
+      rect_iter = tmp_list;
+      while (rect_iter)
+        {
+          MetaRectangle *rect = (MetaRectangle*) rect_iter->data;
+          if (!meta_rectangle_overlap (rect, strut_rect))
+            ret = g_list_prepend (ret, rect);
+          else
+            {
+              /* If there is area in rect left of strut */
+              if (BOX_LEFT (*rect) < BOX_LEFT (*strut_rect))
+                {
+                  temp_rect = g_new (MetaRectangle, 1);
+                  *temp_rect = *rect;
+                  temp_rect->width = BOX_LEFT (*strut_rect) - BOX_LEFT (*rect);
+                  ret = g_list_prepend (ret, temp_rect);
+                }
+              /* If there is area in rect right of strut */
+              if (BOX_RIGHT (*rect) > BOX_RIGHT (*strut_rect))
+                {
+                  int new_x;
+                  temp_rect = g_new (MetaRectangle, 1);
+                  *temp_rect = *rect;
+                  new_x = BOX_RIGHT (*strut_rect);
+                  temp_rect->width = BOX_RIGHT(*rect) - new_x;
+                  temp_rect->x = new_x;
+                  ret = g_list_prepend (ret, temp_rect);
+                }
+              /* If there is area in rect above strut */
+              if (BOX_TOP (*rect) < BOX_TOP (*strut_rect))
+                {
+                  temp_rect = g_new (MetaRectangle, 1);
+                  *temp_rect = *rect;
+                  temp_rect->height = BOX_TOP (*strut_rect) - BOX_TOP (*rect);
+                  ret = g_list_prepend (ret, temp_rect);
+                }
+              /* If there is area in rect below strut */
+              if (BOX_BOTTOM (*rect) > BOX_BOTTOM (*strut_rect))
+                {
+                  int new_y;
+                  temp_rect = g_new (MetaRectangle, 1);
+                  *temp_rect = *rect;
+                  new_y = BOX_BOTTOM (*strut_rect);
+                  temp_rect->height = BOX_BOTTOM (*rect) - new_y;
+                  temp_rect->y = new_y;
+                  ret = g_list_prepend (ret, temp_rect);
+                }
+              g_free (rect);
+            }
+          rect_iter = rect_iter->next;
+        }
+      g_list_free (tmp_list);
+    }
+
+  /* Sort by maximal area, just because I feel like it... */
+  ret = g_list_sort (ret, list_compare_rect_areas);
+
+  /* Merge rectangles if possible so that the list really is minimal */
+  ret = list_merge_spanning_rects (ret);
+
+  return ret;
+}
+
+static gboolean
+list_could_fit_rect (const GList         *spanning_rects,
+                     const MetaRectangle *rect)
+{
+  const GList *temp;
+  gboolean     could_fit;
+
+  temp = spanning_rects;
+  could_fit = FALSE;
+  while (!could_fit && temp != NULL)
+    {
+      could_fit = could_fit || meta_rectangle_could_fit_rect (temp->data, rect);
+      temp = temp->next;
+    }
+
+  return could_fit;
+}
+
+static gboolean
+list_contains_rect (const GList         *spanning_rects,
+                    const MetaRectangle *rect)
+{
+  const GList *temp;
+  gboolean     contained;
+
+  temp = spanning_rects;
+  contained = FALSE;
+  while (!contained && temp != NULL)
+    {
+      contained = contained || meta_rectangle_contains_rect (temp->data, rect);
+      temp = temp->next;
+    }
+
+  return contained;
+}
+
+static gboolean
+list_overlaps_rect (const GList         *spanning_rects,
+                    const MetaRectangle *rect)
+{
+  const GList *temp;
+  gboolean     overlaps;
+
+  temp = spanning_rects;
+  overlaps = FALSE;
+  while (!overlaps && temp != NULL)
+    {
+      overlaps = overlaps || meta_rectangle_overlap (temp->data, rect);
+      temp = temp->next;
+    }
+
+  return overlaps;
+}
+
+static void
+list_shove_rect (const GList         *spanning_rects,
+                 FixedDirections      fixed_directions,
+                 MetaRectangle       *rect)
+{
+  const GList *temp;
+  const MetaRectangle *best_rect = NULL;
+  int                  best_overlap = 0;
+  int                  shortest_distance = G_MAXINT;
+
+  /* First, find best rectangle from spanning_rects to which we will shove
+   * rect into.
+   */
+
+  for (temp = spanning_rects; temp; temp = temp->next)
+    {
+      MetaRectangle *compare_rect = temp->data;
+      int            maximal_overlap_amount_for_compare;
+      int            dist_to_compare;
+
+      /* If x is fixed and the entire width of rect doesn't fit in compare,
+       * skip this rectangle.
+       */
+      if ((fixed_directions & FIXED_DIRECTION_X) &&
+          (compare_rect->x > rect->x ||
+           compare_rect->x + compare_rect->width < rect->x + rect->width))
+        continue;
+
+      /* If y is fixed and the entire height of rect doesn't fit in compare,
+       * skip this rectangle.
+       */
+      if ((fixed_directions & FIXED_DIRECTION_Y) &&
+          (compare_rect->y > rect->y ||
+           compare_rect->y + compare_rect->height < rect->y + rect->height))
+        continue;
+
+      /* Determine maximal overlap amount between rect & compare_rect */
+      maximal_overlap_amount_for_compare =
+        MIN (rect->width,  compare_rect->width) *
+        MIN (rect->height, compare_rect->height);
+
+      /* Determine distance necessary to put rect into compare_rect */
+      dist_to_compare = 0;
+      if (compare_rect->x > rect->x)
+        dist_to_compare += compare_rect->x - rect->x;
+      if (compare_rect->x + compare_rect->width < rect->x + rect->width)
+        dist_to_compare += (rect->x + rect->width) -
+                           (compare_rect->x + compare_rect->width);
+      if (compare_rect->y > rect->y)
+        dist_to_compare += compare_rect->y - rect->y;
+      if (compare_rect->y + compare_rect->height < rect->y + rect->height)
+        dist_to_compare += (rect->y + rect->height) -
+                           (compare_rect->y + compare_rect->height);
+
+      /* See if this is the best rect so far */
+      if ((maximal_overlap_amount_for_compare > best_overlap) ||
+          (maximal_overlap_amount_for_compare == best_overlap &&
+           dist_to_compare                    <  shortest_distance))
+        {
+          best_rect         = compare_rect;
+          best_overlap      = maximal_overlap_amount_for_compare;
+          shortest_distance = dist_to_compare;
+        }
+    }
+
+  /* Shove rect appropriately */
+  if (best_rect == NULL)
+    meta_warning ("No rect to shove into found!\n");
+  else
+    {
+      /* Extra precaution with checking fixed direction shouldn't be needed
+       * due to logic above, but it shouldn't hurt either.
+       */
+      if (!(fixed_directions & FIXED_DIRECTION_X))
+        {
+          /* Shove to the right, if needed */
+          if (best_rect->x > rect->x)
+            rect->x = best_rect->x;
+
+          /* Shove to the left, if needed */
+          if (best_rect->x + best_rect->width < rect->x + rect->width)
+            rect->x = (best_rect->x + best_rect->width) - rect->width;
+        }
+
+      /* Extra precaution with checking fixed direction shouldn't be needed
+       * due to logic above, but it shouldn't hurt either.
+       */
+      if (!(fixed_directions & FIXED_DIRECTION_Y))
+        {
+          /* Shove down, if needed */
+          if (best_rect->y > rect->y)
+            rect->y = best_rect->y;
+
+          /* Shove up, if needed */
+          if (best_rect->y + best_rect->height < rect->y + rect->height)
+            rect->y = (best_rect->y + best_rect->height) - rect->height;
+        }
+    }
+}
+
+static void
+list_clip_rect (const GList         *spanning_rects,
+                FixedDirections      fixed_directions,
+                MetaRectangle       *rect)
+{
+  const GList *temp;
+  const MetaRectangle *best_rect = NULL;
+  int                  best_overlap = 0;
+
+  /* First, find best rectangle from spanning_rects to which we will clip
+   * rect into.
+   */
+  for (temp = spanning_rects; temp; temp = temp->next)
+    {
+      MetaRectangle *compare_rect = temp->data;
+      MetaRectangle  overlap;
+      int            maximal_overlap_amount_for_compare;
+
+      /* If x is fixed and the entire width of rect doesn't fit in compare,
+       * skip the rectangle.
+       */
+      if ((fixed_directions & FIXED_DIRECTION_X) &&
+          (compare_rect->x > rect->x ||
+           compare_rect->x + compare_rect->width < rect->x + rect->width))
+        continue;
+
+      /* If y is fixed and the entire height of rect doesn't fit in compare,
+       * skip the rectangle.
+       */
+      if ((fixed_directions & FIXED_DIRECTION_Y) &&
+          (compare_rect->y > rect->y ||
+           compare_rect->y + compare_rect->height < rect->y + rect->height))
+        continue;
+
+      /* Determine maximal overlap amount */
+      meta_rectangle_intersect (rect, compare_rect, &overlap);
+      maximal_overlap_amount_for_compare = meta_rectangle_area (&overlap);
+
+      /* See if this is the best rect so far */
+      if (maximal_overlap_amount_for_compare > best_overlap)
+        {
+          best_rect    = compare_rect;
+          best_overlap = maximal_overlap_amount_for_compare;
+        }
+    }
+
+  /* Clip rect appropriately */
+  if (best_rect == NULL)
+    meta_warning ("No rect to clip to found!\n");
+  else
+    {
+      /* Extra precaution with checking fixed direction shouldn't be needed
+       * due to logic above, but it shouldn't hurt either.
+       */
+      if (!(fixed_directions & FIXED_DIRECTION_X))
+        {
+          /* Find the new left and right */
+          int new_x = MAX (rect->x, best_rect->x);
+          rect->width = MIN ((rect->x + rect->width)           - new_x,
+                             (best_rect->x + best_rect->width) - new_x);
+          rect->x = new_x;
+        }
+
+      /* Extra precaution with checking fixed direction shouldn't be needed
+       * due to logic above, but it shouldn't hurt either.
+       */
+      if (!(fixed_directions & FIXED_DIRECTION_Y))
+        {
+          /* Clip the top, if needed */
+          int new_y = MAX (rect->y, best_rect->y);
+          rect->height = MIN ((rect->y + rect->height)           - new_y,
+                              (best_rect->y + best_rect->height) - new_y);
+          rect->y = new_y;
+        }
+    }
+}
+
+static void
+list_clamp_rect_to_fit (const GList         *spanning_rects,
+                        FixedDirections      fixed_directions,
+                        MetaRectangle       *rect,
+                        const MetaRectangle *min_size)
+{
+  const GList *temp;
+  const MetaRectangle *best_rect = NULL;
+  int                  best_overlap = 0;
+
+  /* First, find best rectangle from spanning_rects to which we can clamp
+   * rect to fit into.
+   */
+  for (temp = spanning_rects; temp; temp = temp->next)
+    {
+      MetaRectangle *compare_rect = temp->data;
+      int            maximal_overlap_amount_for_compare;
+
+      /* If x is fixed and the entire width of rect doesn't fit in compare,
+       * skip this rectangle.
+       */
+      if ((fixed_directions & FIXED_DIRECTION_X) &&
+          (compare_rect->x > rect->x ||
+           compare_rect->x + compare_rect->width < rect->x + rect->width))
+        continue;
+
+      /* If y is fixed and the entire height of rect doesn't fit in compare,
+       * skip this rectangle.
+       */
+      if ((fixed_directions & FIXED_DIRECTION_Y) &&
+          (compare_rect->y > rect->y ||
+           compare_rect->y + compare_rect->height < rect->y + rect->height))
+        continue;
+
+      /* If compare can't hold the min_size window, skip this rectangle. */
+      if (compare_rect->width  < min_size->width ||
+          compare_rect->height < min_size->height)
+        continue;
+
+      /* Determine maximal overlap amount */
+      maximal_overlap_amount_for_compare =
+        MIN (rect->width,  compare_rect->width) *
+        MIN (rect->height, compare_rect->height);
+
+      /* See if this is the best rect so far */
+      if (maximal_overlap_amount_for_compare > best_overlap)
+        {
+          best_rect    = compare_rect;
+          best_overlap = maximal_overlap_amount_for_compare;
+        }
+    }
+
+  /* Clamp rect appropriately */
+  if (best_rect == NULL)
+    {
+      meta_warning ("No rect whose size to clamp to found!\n");
+
+      /* If it doesn't fit, at least make it no bigger than it has to be */
+      if (!(fixed_directions & FIXED_DIRECTION_X))
+        rect->width  = min_size->width;
+      if (!(fixed_directions & FIXED_DIRECTION_Y))
+        rect->height = min_size->height;
+    }
+  else
+    {
+      rect->width  = MIN (rect->width,  best_rect->width);
+      rect->height = MIN (rect->height, best_rect->height);
+    }
+}
+
+/* Eight monitors in a 4x2 grid */
+static void
+get_monitors (MetaRectangle *monitors,
+              MetaRectangle *screen)
+{
+  int i;
+
+  for (i = 0; i < N_MONITORS; i++)
+    monitors[i] = meta_rect ((i % 4) * MONITOR_WIDTH,
+                             (i / 4) * MONITOR_HEIGHT,
+                             MONITOR_WIDTH, MONITOR_HEIGHT);
+
+  *screen = meta_rect (0, 0, 4 * MONITOR_WIDTH, 2 * MONITOR_HEIGHT);
+}
+
+static GSList *
+get_random_struts (const MetaRectangle *monitors,
+                   int                  n_struts)
+{
+  GSList *struts = NULL;
+  int i;
+
+  for (i = 0; i < n_struts; i++)
+    struts = add_random_strut (struts,
+                               &monitors[g_random_int_range (0, N_MONITORS)]);
+
+  return struts;
+}
+
+static void
+get_random_rect (MetaRectangle *rect)
+{
+  rect->x = g_random_int_range (-200, 4 * MONITOR_WIDTH);
+  rect->y = g_random_int_range (-200, 2 * MONITOR_HEIGHT);
+  rect->width = g_random_int_range (1, 2 * MONITOR_WIDTH);
+  rect->height = g_random_int_range (1, 2 * MONITOR_HEIGHT);
+}
+
+static void
+test_region_matches_list (void)
+{
+  MetaRectangle monitors[N_MONITORS], screen;
+  int run;
+
+  get_monitors (monitors, &screen);
+
+  for (run = 0; run < NUM_RANDOM_RUNS; run++)
+    {
+      GSList *struts = get_random_struts (monitors,
+                                          g_random_int_range (0, N_STRUTS));
+      GList *list, *tmp;
+      MetaRegion *region;
+      int i;
+
+      list = list_spanning_set (&screen, struts);
+      region = meta_region_new_spanning_set (&screen, struts);
+
+      g_assert (region->n_rects == (int) g_list_length (list));
+      for (tmp = list, i = 0; tmp; tmp = tmp->next, i++)
+        g_assert (meta_rectangle_equal (tmp->data, &region->rects[i]));
+
+      for (i = 0; i < 10; i++)
+        {
+          MetaRectangle rect, from_list, from_region, min_size;
+          FixedDirections fixed = g_random_int_range (0, 4);
+
+          get_random_rect (&rect);
+          min_size = meta_rect (0, 0, g_random_int_range (1, 400),
+                                g_random_int_range (1, 400));
+
+          g_assert (list_could_fit_rect (list, &rect) ==
+                    meta_region_could_fit_rect (region, &rect));
+          g_assert (list_contains_rect (list, &rect) ==
+                    meta_region_contains_rect (region, &rect));
+          g_assert (list_overlaps_rect (list, &rect) ==
+                    meta_region_overlaps_rect (region, &rect));
+
+          from_list = from_region = rect;
+          list_shove_rect (list, fixed, &from_list);
+          meta_region_shove_rect (region, fixed, &from_region);
+          g_assert (meta_rectangle_equal (&from_list, &from_region));
+
+          from_list = from_region = rect;
+          list_clip_rect (list, fixed, &from_list);
+          meta_region_clip_rect (region, fixed, &from_region);
+          g_assert (meta_rectangle_equal (&from_list, &from_region));
+
+          from_list = from_region = rect;
+          list_clamp_rect_to_fit (list, fixed, &from_list, &min_size);
+          meta_region_clamp_rect_to_fit (region, fixed,
+                                         &from_region, &min_size);
+          g_assert (meta_rectangle_equal (&from_list, &from_region));
+        }
+
+      meta_rectangle_free_list_and_elements (list);
+      meta_region_free (region);
+      free_struts (struts);
+    }
+
+  printf ("Regions match the old spanning set lists.\n");
+}
+
+/* What ensure_work_areas_validated() does with the workspace's struts:
+ * one spanning set per monitor and one for the whole screen.
+ */
+static void
+benchmark_spanning_sets (void)
+{
+  MetaRectangle monitors[N_MONITORS], screen;
+  GTimer *timer;
+  GSList *struts;
+  double elapsed;
+  int n_runs, n_rects, i;
+
+  get_monitors (monitors, &screen);
+  struts = get_random_struts (monitors, N_STRUTS);
+
+  n_rects = 0;
+  timer = g_timer_new ();
+  n_runs = 0;
+  do
+    {
+      MetaRegion *region;
+
+      for (i = 0; i < N_MONITORS; i++)
+        {
+          region = meta_region_new_spanning_set (&monitors[i], struts);
+          meta_region_free (region);
+        }
+
+      region = meta_region_new_spanning_set (&screen, struts);
+      n_rects = region->n_rects;
+      meta_region_free (region);
+
+      n_runs++;
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  printf ("%d monitors, %d struts (%d screen rects): "
+          "%.1f work area validations per second\n",
+          N_MONITORS, N_STRUTS, n_rects, n_runs / elapsed);
+
+  /* And the old lists, for comparison */
+  g_timer_start (timer);
+  n_runs = 0;
+  do
+    {
+      for (i = 0; i < N_MONITORS; i++)
+        meta_rectangle_free_list_and_elements (
+          list_spanning_set (&monitors[i], struts));
+
+      meta_rectangle_free_list_and_elements (
+        list_spanning_set (&screen, struts));
+
+      n_runs++;
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  printf ("%d monitors, %d struts, old lists: "
+          "%.1f work area validations per second\n",
+          N_MONITORS, N_STRUTS, n_runs / elapsed);
+
+  g_timer_destroy (timer);
+  free_struts (struts);
+}
+
+/* What constrain_fully_onscreen() does for each constrained move */
+static void
+benchmark_constraints (void)
+{
+  MetaRectangle monitors[N_MONITORS], screen, rects[1024];
+  MetaRegion *region;
+  GTimer *timer;
+  GSList *struts;
+  double elapsed;
+  int n_runs, i;
+
+  get_monitors (monitors, &screen);
+  struts = get_random_struts (monitors, N_STRUTS);
+  region = meta_region_new_spanning_set (&screen, struts);
+
+  for (i = 0; i < (int) G_N_ELEMENTS (rects); i++)
+    {
+      get_random_rect (&rects[i]);
+      rects[i].width /= 4;
+      rects[i].height /= 4;
+    }
+
+  timer = g_timer_new ();
+  n_runs = 0;
+  do
+    {
+      for (i = 0; i < (int) G_N_ELEMENTS (rects); i++)
+        {
+          MetaRectangle rect = rects[i];
+
+          if (meta_region_could_fit_rect (region, &rect) &&
+              !meta_region_contains_rect (region, &rect))
+            meta_region_shove_rect (region, FIXED_DIRECTION_NONE, &rect);
+        }
+
+      n_runs += G_N_ELEMENTS (rects);
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  printf ("%d rect region: %.1f constrained moves per second\n",
+          region->n_rects, n_runs / elapsed);
+
+  g_timer_destroy (timer);
+  meta_region_free (region);
+  free_struts (struts);
+}
+
+int
+main (int argc, char **argv)
+{
+  test_region_matches_list ();
+
+  if (argc > 1 && strcmp (argv[1], "--benchmark") == 0)
+    {
+      benchmark_spanning_sets ();
+      benchmark_constraints ();
+    }
+
+  return 0;
+}
@@ -0,0 +1,254 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Mutter window spatial index testing and benchmarking program */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "window-index.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_RANDOM_RUNS 50
+#define N_OPERATIONS 1000
+#define N_WINDOWS 500
+
+/* How long to run each benchmark for, in seconds */
+#define BENCHMARK_TIME 2.0
+
+#define SCREEN_WIDTH (4 * 1920)
+#define SCREEN_HEIGHT 1080
+
+/* The index never looks at the windows, so we can use fake ones: the
+ * address of the window's slot in our own array of rectangles.
+ */
+static MetaRectangle rects[N_WINDOWS];
+static gboolean present[N_WINDOWS];
+
+#define FAKE_WINDOW(i) ((MetaWindow *) &rects[i])
+#define FAKE_WINDOW_INDEX(window) ((MetaRectangle *) (window) - rects)
+
+static void
+get_random_rect (MetaRectangle *rect)
+{
+  /* Mostly windows, sometimes partly or far offscreen */
+  rect->x = g_random_int_range (-2000, SCREEN_WIDTH + 2000);
+  rect->y = g_random_int_range (-2000, SCREEN_HEIGHT + 2000);
+  rect->width = g_random_int_range (0, 2500);
+  rect->height = g_random_int_range (0, 1500);
+}
+
+static gboolean
+mark_found (MetaWindow          *window,
+            const MetaRectangle *rect,
+            gpointer             data)
+{
+  gboolean *found = data;
+  int i = FAKE_WINDOW_INDEX (window);
+
+  g_assert (i >= 0 && i < N_WINDOWS);
+  g_assert (present[i]);
+  g_assert (meta_rectangle_equal (rect, &rects[i]));
+
+  /* Each window is reported only once */
+  g_assert (!found[i]);
+  found[i] = TRUE;
+
+  return FALSE;
+}
+
+static gboolean
+stop_at_first (MetaWindow          *window,
+               const MetaRectangle *rect,
+               gpointer             data)
+{
+  int *n_found = data;
+
+  (*n_found)++;
+
+  return TRUE;
+}
+
+static void
+check_query (MetaWindowIndex     *index,
+             const MetaRectangle *query)
+{
+  gboolean found[N_WINDOWS];
+  gboolean any = FALSE;
+  int n_found = 0;
+  int i;
+
+  memset (found, 0, sizeof (found));
+  meta_window_index_foreach_in_rect (index, query, mark_found, found);
+
+  for (i = 0; i < N_WINDOWS; i++)
+    {
+      gboolean expected = present[i] && meta_rectangle_overlap (&rects[i], query);
+
+      g_assert (found[i] == expected);
+      any = any || expected;
+    }
+
+  g_assert (meta_window_index_foreach_in_rect (index, query,
+                                               stop_at_first, &n_found) == any);
+  g_assert (n_found == (any ? 1 : 0));
+}
+
+static void
+test_index_matches_brute_force (void)
+{
+  int run, i;
+
+  for (run = 0; run < NUM_RANDOM_RUNS; run++)
+    {
+      MetaWindowIndex *index = meta_window_index_new ();
+
+      memset (present, 0, sizeof (present));
+
+      for (i = 0; i < N_OPERATIONS; i++)
+        {
+          int window = g_random_int_range (0, N_WINDOWS);
+          MetaRectangle query;
+
+          switch (g_random_int_range (0, 4))
+            {
+            case 0:
+              meta_window_index_remove (index, FAKE_WINDOW (window));
+              present[window] = FALSE;
+              break;
+            case 1:
+              /* A small move, usually staying in the same cells */
+              if (present[window])
+                {
+                  rects[window].x += g_random_int_range (-20, 21);
+                  rects[window].y += g_random_int_range (-20, 21);
+                  meta_window_index_set_rect (index, FAKE_WINDOW (window),
+                                              &rects[window]);
+                }
+              break;
+            default:
+              get_random_rect (&rects[window]);
+              meta_window_index_set_rect (index, FAKE_WINDOW (window),
+                                          &rects[window]);
+              present[window] = TRUE;
+              break;
+            }
+
+          get_random_rect (&query);
+          check_query (index, &query);
+
+          /* Points, as for finding the window under the pointer */
+          query.width = query.height = 1;
+          check_query (index, &query);
+        }
+
+      meta_window_index_free (index);
+    }
+
+  printf ("Index queries match brute force.\n");
+}
+
+static gboolean
+count_found (MetaWindow          *window,
+             const MetaRectangle *rect,
+             gpointer             data)
+{
+  int *n_found = data;
+
+  (*n_found)++;
+
+  return FALSE;
+}
+
+/* The overlap tests placement does: is this window-sized rectangle
+ * free of other windows?
+ */
+static void
+benchmark_overlap_queries (void)
+{
+  MetaWindowIndex *index = meta_window_index_new ();
+  MetaRectangle queries[1024];
+  GTimer *timer;
+  double elapsed;
+  int n_runs, n_found, i, j;
+
+  for (i = 0; i < N_WINDOWS; i++)
+    {
+      rects[i] = meta_rect (g_random_int_range (0, SCREEN_WIDTH - 800),
+                            g_random_int_range (0, SCREEN_HEIGHT - 600),
+                            g_random_int_range (200, 800),
+                            g_random_int_range (150, 600));
+      meta_window_index_set_rect (index, FAKE_WINDOW (i), &rects[i]);
+    }
+
+  for (i = 0; i < (int) G_N_ELEMENTS (queries); i++)
+    queries[i] = meta_rect (g_random_int_range (0, SCREEN_WIDTH - 800),
+                            g_random_int_range (0, SCREEN_HEIGHT - 600),
+                            g_random_int_range (200, 800),
+                            g_random_int_range (150, 600));
+
+  timer = g_timer_new ();
+  n_runs = 0;
+  n_found = 0;
+  do
+    {
+      for (i = 0; i < (int) G_N_ELEMENTS (queries); i++)
+        meta_window_index_foreach_in_rect (index, &queries[i],
+                                           count_found, &n_found);
+
+      n_runs += G_N_ELEMENTS (queries);
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  printf ("%d windows, indexed: %.1f overlap queries per second\n",
+          N_WINDOWS, n_runs / elapsed);
+
+  /* And checking every window, for comparison */
+  g_timer_start (timer);
+  n_runs = 0;
+  do
+    {
+      for (i = 0; i < (int) G_N_ELEMENTS (queries); i++)
+        for (j = 0; j < N_WINDOWS; j++)
+          if (meta_rectangle_overlap (&rects[j], &queries[i]))
+            n_found++;
+
+      n_runs += G_N_ELEMENTS (queries);
+      elapsed = g_timer_elapsed (timer, NULL);
+    }
+  while (elapsed < BENCHMARK_TIME);
+
+  printf ("%d windows, linear scan: %.1f overlap queries per second\n",
+          N_WINDOWS, n_runs / elapsed);
+
+  g_timer_destroy (timer);
+  meta_window_index_free (index);
+}
+
+int
+main (int argc, char **argv)
+{
+  test_index_matches_brute_force ();
+
+  if (argc > 1 && strcmp (argv[1], "--benchmark") == 0)
+    benchmark_overlap_queries ();
+
+  return 0;
+}
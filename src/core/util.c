@@ -27,7 +27,7 @@
 
 #include <config.h>
 #include <meta/common.h>
-#include <meta/util.h>
+#include "util-private.h"
 #include <meta/main.h>
 
 #include <clutter/clutter.h> /* For clutter_threads_add_repaint_func() */
@@ -715,9 +715,32 @@ typedef struct
   GDestroyNotify notify;
   int source;
   gboolean run_once;
+
+  /* The queue the later is in and its link there, until it's removed */
+  GQueue *queue;
+  GList *link;
 } MetaLater;
 
-static GSList *laters = NULL;
+typedef struct
+{
+  guint n_run;
+  gdouble time;
+} MetaLaterStats;
+
+#define N_LATER_TYPES (META_LATER_IDLE + 1)
+
+/* The laters of each type, most recently added first */
+static GQueue laters[N_LATER_TYPES];
+/* Later ID => MetaLater */
+static GHashTable *laters_by_id = NULL;
+
+/* Time spent running the laters of each type in the current frame
+ * and in the last one
+ */
+static MetaLaterStats later_stats[N_LATER_TYPES];
+static MetaLaterStats last_later_stats[N_LATER_TYPES];
+static GTimer *later_timer = NULL;
+
 /* This is a dummy timeline used to get the Clutter master clock running */
 static ClutterTimeline *later_timeline;
 static guint later_repaint_func = 0;
@@ -750,54 +773,82 @@ destroy_later (MetaLater *later)
   unref_later (later);
 }
 
-/* Used to sort the list of laters with the highest priority
- * functions first.
- */
-static int
-compare_laters (gconstpointer a,
-                gconstpointer b)
+static gboolean
+run_later (MetaLater *later)
 {
-  return ((const MetaLater *)a)->when - ((const MetaLater *)b)->when;
+  MetaLaterStats *stats = &later_stats[later->when];
+  gdouble start;
+  gboolean result;
+
+  if (!later_timer)
+    later_timer = g_timer_new ();
+
+  start = g_timer_elapsed (later_timer, NULL);
+  result = later->func (later->data);
+
+  stats->n_run++;
+  stats->time += g_timer_elapsed (later_timer, NULL) - start;
+
+  return result;
 }
 
 static gboolean
 run_repaint_laters (gpointer data)
 {
-  GSList *laters_copy;
-  GSList *l;
+  GQueue running[META_LATER_BEFORE_REDRAW + 1];
   gboolean keep_timeline_running = FALSE;
+  int when;
+  GList *l;
 
-  laters_copy = NULL;
-  for (l = laters; l; l = l->next)
+  /* Take the laters queued so far; ones added by the callbacks we run
+   * here wait for the next repaint.
+   */
+  for (when = META_LATER_RESIZE; when <= META_LATER_BEFORE_REDRAW; when++)
     {
-      MetaLater *later = l->data;
-      if (later->source == 0 ||
-          (later->when <= META_LATER_BEFORE_REDRAW && !later->run_once))
-        {
-          later->ref_count++;
-          laters_copy = g_slist_prepend (laters_copy, later);
-        }
+      running[when] = laters[when];
+      g_queue_init (&laters[when]);
+
+      for (l = running[when].head; l; l = l->next)
+        ((MetaLater *)l->data)->queue = &running[when];
     }
-  laters_copy = g_slist_reverse (laters_copy);
 
-  for (l = laters_copy; l; l = l->next)
+  for (when = META_LATER_RESIZE; when <= META_LATER_BEFORE_REDRAW; when++)
     {
-      MetaLater *later = l->data;
-
-      if (later->func && later->func (later->data))
+      while ((l = running[when].head) != NULL)
         {
-          if (later->source == 0)
-            keep_timeline_running = TRUE;
+          MetaLater *later = l->data;
+
+          /* Put it back first, so that the callback can remove it */
+          g_queue_unlink (&running[when], l);
+          g_queue_push_tail_link (&laters[when], l);
+          later->queue = &laters[when];
+
+          /* Resize laters that already ran from their idle wait for it */
+          if (later->source != 0 && later->run_once)
+            continue;
+
+          later->ref_count++;
+
+          if (later->func && run_later (later))
+            {
+              if (later->source == 0)
+                keep_timeline_running = TRUE;
+            }
+          else
+            meta_later_remove (later->id);
+          unref_later (later);
         }
-      else
-        meta_later_remove (later->id);
-      unref_later (later);
     }
 
   if (!keep_timeline_running)
     clutter_timeline_stop (later_timeline);
 
-  g_slist_free (laters_copy);
+  for (when = 0; when < N_LATER_TYPES; when++)
+    {
+      last_later_stats[when] = later_stats[when];
+      later_stats[when].n_run = 0;
+      later_stats[when].time = 0;
+    }
 
   /* Just keep the repaint func around - it's cheap if the list is empty */
   return TRUE;
@@ -822,7 +873,7 @@ call_idle_later (gpointer data)
 {
   MetaLater *later = data;
 
-  if (!later->func (later->data))
+  if (!run_later (later))
     {
       meta_later_remove (later->id);
       return FALSE;
@@ -866,7 +917,13 @@ meta_later_add (MetaLaterType  when,
   later->data = data;
   later->notify = notify;
 
-  laters = g_slist_insert_sorted (laters, later, compare_laters);
+  if (!laters_by_id)
+    laters_by_id = g_hash_table_new (NULL, NULL);
+
+  g_hash_table_insert (laters_by_id, GUINT_TO_POINTER (later->id), later);
+  g_queue_push_head (&laters[when], later);
+  later->queue = &laters[when];
+  later->link = laters[when].head;
 
   switch (when)
     {
@@ -902,20 +959,117 @@ meta_later_add (MetaLaterType  when,
 void
 meta_later_remove (guint later_id)
 {
-  GSList *l;
+  MetaLater *later;
 
-  for (l = laters; l; l = l->next)
+  if (!laters_by_id)
+    return;
+
+  later = g_hash_table_lookup (laters_by_id, GUINT_TO_POINTER (later_id));
+  if (!later)
+    return;
+
+  g_hash_table_remove (laters_by_id, GUINT_TO_POINTER (later_id));
+  g_queue_delete_link (later->queue, later->link);
+  later->queue = NULL;
+  later->link = NULL;
+
+  /* If this was a "repaint func" later, we just let the
+   * repaint func run and get removed
+   */
+  destroy_later (later);
+}
+
+/**
+ * meta_later_get_stats:
+ * @when: the phase to report on
+ * @n_queued: (out) (allow-none): location to store the number of callbacks
+ *   currently added for @when, or %NULL
+ * @n_run: (out) (allow-none): location to store the number of callbacks run
+ *   for @when during the last frame, or %NULL
+ * @time_ms: (out) (allow-none): location to store the time those callbacks
+ *   took, in milliseconds, or %NULL
+ *
+ * Debugging API: reports how much of the last frame went to running the
+ * callbacks added with meta_later_add() for @when. A frame ends after the
+ * #META_LATER_BEFORE_REDRAW callbacks run before a redraw, so idle
+ * callbacks run between two redraws count towards the second one.
+ */
+void
+meta_later_get_stats (MetaLaterType when,
+                      guint        *n_queued,
+                      guint        *n_run,
+                      gdouble      *time_ms)
+{
+  g_return_if_fail (when < N_LATER_TYPES);
+
+  if (n_queued)
+    *n_queued = laters[when].length;
+  if (n_run)
+    *n_run = last_later_stats[when].n_run;
+  if (time_ms)
+    *time_ms = last_later_stats[when].time * 1000.;
+}
+
+/**
+ * meta_find_longest_increasing: (skip)
+ * @positions: positions, negative for elements that are never part of
+ *   the subsequence
+ * @n_positions: the number of @positions
+ * @keep: set for each element of the longest increasing subsequence
+ *
+ * Marks in @keep the longest subsequence of @positions that is
+ * increasing. This is the usual O(n log n) method: tails[l] is the
+ * index of the smallest value that ends an increasing subsequence of
+ * length l + 1 found so far. It is used to find the longest run of a
+ * stack that is already in the right order, so only the rest has to
+ * move.
+ */
+void
+meta_find_longest_increasing (const int *positions,
+                              int        n_positions,
+                              gboolean  *keep)
+{
+  int *tails;
+  int *prev;
+  int length;
+  int i;
+
+  tails = g_new (int, n_positions);
+  prev = g_new (int, n_positions);
+  length = 0;
+
+  for (i = 0; i < n_positions; i++)
     {
-      MetaLater *later = l->data;
-      if (later->id == later_id)
+      int lo, hi;
+
+      keep[i] = FALSE;
+
+      if (positions[i] < 0)
+        continue;
+
+      lo = 0;
+      hi = length;
+      while (lo < hi)
         {
-          laters = g_slist_remove_link (laters, l);
-          /* If this was a "repaint func" later, we just let the
-           * repaint func run and get removed
-           */
-          destroy_later (later);
+          int mid = (lo + hi) / 2;
+
+          if (positions[tails[mid]] < positions[i])
+            lo = mid + 1;
+          else
+            hi = mid;
         }
+
+      prev[i] = lo > 0 ? tails[lo - 1] : -1;
+      tails[lo] = i;
+      if (lo == length)
+        length++;
     }
+
+  for (i = length > 0 ? tails[length - 1] : -1; i >= 0; i = prev[i])
+    keep[i] = TRUE;
+
+  g_free (tails);
+  g_free (prev);
 }
 
 /* eof util.c */
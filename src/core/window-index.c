@@ -0,0 +1,267 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Spatial index of window rectangles */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <config.h>
+#include "window-index.h"
+
+#include <string.h>
+
+/* Cells are 256 pixels square; a maximized window on a 1080p
+ * monitor covers about 40 of them.
+ */
+#define CELL_SHIFT 8
+
+/* Cells beyond these are folded into the ones at the edge, so that a
+ * huge or far offscreen window doesn't cover thousands of cells.  This
+ * only costs precision: queries there look at more windows.
+ */
+#define MIN_CELL (-16)
+#define MAX_CELL 255
+
+typedef struct
+{
+  MetaWindow *window;
+  MetaRectangle rect;
+  /* The query that last found this entry, to report it only once */
+  guint stamp;
+} MetaWindowIndexEntry;
+
+struct _MetaWindowIndex
+{
+  /* Cell => GPtrArray of the MetaWindowIndexEntry overlapping it */
+  GHashTable *cells;
+  /* MetaWindow => MetaWindowIndexEntry */
+  GHashTable *entries;
+  guint stamp;
+};
+
+typedef struct
+{
+  int x1, y1, x2, y2;
+} CellRange;
+
+static int
+cell_for_coord (int coord)
+{
+  /* Arithmetic right shift rounds towards negative infinity */
+  int cell = coord >> CELL_SHIFT;
+
+  return CLAMP (cell, MIN_CELL, MAX_CELL);
+}
+
+static void
+get_cell_range (const MetaRectangle *rect,
+                CellRange           *range)
+{
+  range->x1 = cell_for_coord (rect->x);
+  range->y1 = cell_for_coord (rect->y);
+  range->x2 = cell_for_coord (rect->x + MAX (rect->width, 1) - 1);
+  range->y2 = cell_for_coord (rect->y + MAX (rect->height, 1) - 1);
+}
+
+static gpointer
+cell_key (int x,
+          int y)
+{
+  return GUINT_TO_POINTER (((guint) (y - MIN_CELL) << 16) | (guint) (x - MIN_CELL));
+}
+
+static void
+free_cell (gpointer data)
+{
+  g_ptr_array_free (data, TRUE);
+}
+
+MetaWindowIndex *
+meta_window_index_new (void)
+{
+  MetaWindowIndex *index = g_new (MetaWindowIndex, 1);
+
+  index->cells = g_hash_table_new_full (NULL, NULL, NULL, free_cell);
+  index->entries = g_hash_table_new (NULL, NULL);
+  index->stamp = 0;
+
+  return index;
+}
+
+static void
+free_entry (gpointer key,
+            gpointer value,
+            gpointer data)
+{
+  g_slice_free (MetaWindowIndexEntry, value);
+}
+
+void
+meta_window_index_free (MetaWindowIndex *index)
+{
+  g_hash_table_foreach (index->entries, free_entry, NULL);
+  g_hash_table_destroy (index->entries);
+  g_hash_table_destroy (index->cells);
+  g_free (index);
+}
+
+static void
+add_to_cells (MetaWindowIndex      *index,
+              MetaWindowIndexEntry *entry)
+{
+  CellRange range;
+  int x, y;
+
+  get_cell_range (&entry->rect, &range);
+
+  for (y = range.y1; y <= range.y2; y++)
+    for (x = range.x1; x <= range.x2; x++)
+      {
+        GPtrArray *cell = g_hash_table_lookup (index->cells, cell_key (x, y));
+
+        if (cell == NULL)
+          {
+            cell = g_ptr_array_new ();
+            g_hash_table_insert (index->cells, cell_key (x, y), cell);
+          }
+
+        g_ptr_array_add (cell, entry);
+      }
+}
+
+static void
+remove_from_cells (MetaWindowIndex      *index,
+                   MetaWindowIndexEntry *entry)
+{
+  CellRange range;
+  int x, y;
+
+  get_cell_range (&entry->rect, &range);
+
+  for (y = range.y1; y <= range.y2; y++)
+    for (x = range.x1; x <= range.x2; x++)
+      {
+        GPtrArray *cell = g_hash_table_lookup (index->cells, cell_key (x, y));
+
+        g_ptr_array_remove_fast (cell, entry);
+        if (cell->len == 0)
+          g_hash_table_remove (index->cells, cell_key (x, y));
+      }
+}
+
+void
+meta_window_index_set_rect (MetaWindowIndex     *index,
+                            MetaWindow          *window,
+                            const MetaRectangle *rect)
+{
+  MetaWindowIndexEntry *entry;
+  CellRange old_range, new_range;
+
+  entry = g_hash_table_lookup (index->entries, window);
+  if (entry == NULL)
+    {
+      entry = g_slice_new (MetaWindowIndexEntry);
+      entry->window = window;
+      entry->rect = *rect;
+      entry->stamp = index->stamp;
+      g_hash_table_insert (index->entries, window, entry);
+      add_to_cells (index, entry);
+      return;
+    }
+
+  get_cell_range (&entry->rect, &old_range);
+  get_cell_range (rect, &new_range);
+
+  /* Moves within the same cells are the common case */
+  if (memcmp (&old_range, &new_range, sizeof (CellRange)) == 0)
+    {
+      entry->rect = *rect;
+      return;
+    }
+
+  remove_from_cells (index, entry);
+  entry->rect = *rect;
+  add_to_cells (index, entry);
+}
+
+void
+meta_window_index_remove (MetaWindowIndex *index,
+                          MetaWindow      *window)
+{
+  MetaWindowIndexEntry *entry;
+
+  entry = g_hash_table_lookup (index->entries, window);
+  if (entry == NULL)
+    return;
+
+  remove_from_cells (index, entry);
+  g_hash_table_remove (index->entries, window);
+  g_slice_free (MetaWindowIndexEntry, entry);
+}
+
+static void
+reset_stamp (gpointer key,
+             gpointer value,
+             gpointer data)
+{
+  MetaWindowIndexEntry *entry = value;
+
+  entry->stamp = 0;
+}
+
+gboolean
+meta_window_index_foreach_in_rect (MetaWindowIndex     *index,
+                                   const MetaRectangle *rect,
+                                   MetaWindowIndexFunc  func,
+                                   gpointer             data)
+{
+  CellRange range;
+  int x, y;
+  guint i;
+
+  if (++index->stamp == 0)
+    {
+      g_hash_table_foreach (index->entries, reset_stamp, NULL);
+      index->stamp = 1;
+    }
+
+  get_cell_range (rect, &range);
+
+  for (y = range.y1; y <= range.y2; y++)
+    for (x = range.x1; x <= range.x2; x++)
+      {
+        GPtrArray *cell = g_hash_table_lookup (index->cells, cell_key (x, y));
+
+        if (cell == NULL)
+          continue;
+
+        for (i = 0; i < cell->len; i++)
+          {
+            MetaWindowIndexEntry *entry = g_ptr_array_index (cell, i);
+
+            if (entry->stamp == index->stamp)
+              continue;
+            entry->stamp = index->stamp;
+
+            if (meta_rectangle_overlap (&entry->rect, rect) &&
+                func (entry->window, &entry->rect, data))
+              return TRUE;
+          }
+      }
+
+  return FALSE;
+}
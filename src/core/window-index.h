@@ -0,0 +1,63 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Spatial index of window rectangles */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef META_WINDOW_INDEX_H
+#define META_WINDOW_INDEX_H
+
+#include <glib.h>
+#include <meta/types.h>
+#include <meta/boxes.h>
+
+/* A MetaWindowIndex keeps a rectangle for each of a set of windows (the
+ * outer rectangles of the windows of a workspace, see
+ * meta_window_update_spatial_index()) in a uniform grid, so that finding
+ * the windows overlapping a rectangle only looks at the windows in the
+ * grid cells the rectangle covers, not at every window.
+ */
+typedef struct _MetaWindowIndex MetaWindowIndex;
+
+/* Called for each window found; return TRUE to stop looking.  The
+ * function must not change the index.
+ */
+typedef gboolean (* MetaWindowIndexFunc) (MetaWindow          *window,
+                                          const MetaRectangle *rect,
+                                          gpointer             data);
+
+MetaWindowIndex *meta_window_index_new  (void);
+void             meta_window_index_free (MetaWindowIndex *index);
+
+/* Adds the window to the index, or moves it if it's already there */
+void meta_window_index_set_rect (MetaWindowIndex     *index,
+                                 MetaWindow          *window,
+                                 const MetaRectangle *rect);
+void meta_window_index_remove   (MetaWindowIndex     *index,
+                                 MetaWindow          *window);
+
+/* Calls func, in no particular order, for each window whose rectangle
+ * overlaps rect (see meta_rectangle_overlap()).  Returns TRUE if func
+ * stopped the search.
+ */
+gboolean meta_window_index_foreach_in_rect (MetaWindowIndex     *index,
+                                            const MetaRectangle *rect,
+                                            MetaWindowIndexFunc  func,
+                                            gpointer             data);
+
+#endif
@@ -261,6 +261,9 @@ struct _MetaWindow
   /* Have we placed this window? */
   guint placed : 1;
 
+  /* Is obstacle_rect part of the free space placement keeps? */
+  guint is_placement_obstacle : 1;
+
   /* Must we force_save_user_window_placement? */
   guint force_save_user_rect : 1;
 
@@ -375,6 +378,13 @@ struct _MetaWindow
    * Position always in root coords, unlike window->rect.
    */
   MetaRectangle user_rect;
+
+  /* The outer rect last added to the free space of obstacle_workspace,
+   * or of all workspaces if that is NULL; see
+   * meta_window_update_placement_obstacle()
+   */
+  MetaRectangle obstacle_rect;
+  MetaWorkspace *obstacle_workspace;
   
   /* Requested geometry */
   int border_width;
@@ -438,6 +448,13 @@ MetaWindow* meta_window_new_with_attrs     (MetaDisplay       *display,
                                             gboolean           must_be_viewable,
                                             MetaCompEffect     effect,
                                             XWindowAttributes *attrs);
+MetaWindow* meta_window_new_with_initial_properties
+                                           (MetaDisplay                  *display,
+                                            Window                        xwindow,
+                                            gboolean                      must_be_viewable,
+                                            MetaCompEffect                effect,
+                                            XWindowAttributes            *attrs,
+                                            struct _MetaInitialProperties *initial_props);
 void        meta_window_unmanage           (MetaWindow  *window,
                                             guint32      timestamp);
 void        meta_window_calc_showing       (MetaWindow  *window);
@@ -638,6 +655,9 @@ void meta_window_update_icon_now (MetaWindow *window);
 void meta_window_update_role (MetaWindow *window);
 void meta_window_update_net_wm_type (MetaWindow *window);
 void meta_window_update_monitor (MetaWindow *window);
+void meta_window_update_spatial_index (MetaWindow *window);
+gboolean meta_window_is_placement_obstacle (MetaWindow *window);
+void meta_window_update_placement_obstacle (MetaWindow *window);
 void meta_window_update_on_all_workspaces (MetaWindow *window);
 
 void meta_window_propagate_focus_appearance (MetaWindow *window,
@@ -65,7 +65,7 @@ struct _MetaWindowPropHooks
   gboolean include_override_redirect;
 };
 
-static void init_prop_value            (MetaWindow          *window,
+static void init_prop_value            (gboolean             override_redirect,
                                         MetaWindowPropHooks *hooks,
                                         MetaPropValue       *value);
 static void reload_prop_value          (MetaWindow          *window,
@@ -126,7 +126,7 @@ meta_window_reload_properties_from_xwindow (MetaWindow *window,
   while (i < n_properties)
     {
       MetaWindowPropHooks *hooks = find_hooks (window->display, properties[i]);
-      init_prop_value (window, hooks, &values[i]);
+      init_prop_value (window->override_redirect, hooks, &values[i]);
       ++i;
     }
   
@@ -147,29 +147,36 @@ meta_window_reload_properties_from_xwindow (MetaWindow *window,
   g_free (values);
 }
 
-void
-meta_window_load_initial_properties (MetaWindow *window)
+/* Fills in @values, which must have room for display->n_prop_hooks
+ * elements, with the properties loaded when a window is first managed.
+ * Returns the number of values used.
+ */
+static int
+init_initial_prop_values (MetaDisplay   *display,
+                          gboolean       override_redirect,
+                          MetaPropValue *values)
 {
   int i, j;
-  MetaPropValue *values;
-  int n_properties = 0;
-
-  values = g_new0 (MetaPropValue, window->display->n_prop_hooks);
 
   j = 0;
-  for (i = 0; i < window->display->n_prop_hooks; i++)
+  for (i = 0; i < display->n_prop_hooks; i++)
     {
-      MetaWindowPropHooks *hooks = &window->display->prop_hooks_table[i];
+      MetaWindowPropHooks *hooks = &display->prop_hooks_table[i];
       if (hooks->load_initially)
         {
-          init_prop_value (window, hooks, &values[j]);
+          init_prop_value (override_redirect, hooks, &values[j]);
           ++j;
         }
     }
-  n_properties = j;
 
-  meta_prop_get_values (window->display, window->xwindow,
-                        values, n_properties);
+  return j;
+}
+
+static void
+reload_initial_prop_values (MetaWindow    *window,
+                            MetaPropValue *values)
+{
+  int i, j;
 
   j = 0;
   for (i = 0; i < window->display->n_prop_hooks; i++)
@@ -186,20 +193,97 @@ meta_window_load_initial_properties (MetaWindow *window)
           ++j;
         }
     }
+}
+
+void
+meta_window_load_initial_properties (MetaWindow *window)
+{
+  MetaPropValue *values;
+  int n_properties = 0;
+
+  values = g_new0 (MetaPropValue, window->display->n_prop_hooks);
+
+  n_properties = init_initial_prop_values (window->display,
+                                           window->override_redirect,
+                                           values);
+
+  meta_prop_get_values (window->display, window->xwindow,
+                        values, n_properties);
+
+  reload_initial_prop_values (window, values);
 
   meta_prop_free_values (values, n_properties);
 
   g_free (values);
 }
 
+void
+meta_display_fetch_initial_properties (MetaDisplay           *display,
+                                       MetaInitialProperties *props,
+                                       int                    n_windows)
+{
+  Window *xwindows;
+  MetaPropValue **values;
+  int *n_values;
+  int i;
+
+  xwindows = g_new (Window, n_windows);
+  values = g_new (MetaPropValue*, n_windows);
+  n_values = g_new (int, n_windows);
+
+  for (i = 0; i < n_windows; i++)
+    {
+      props[i].values = g_new0 (MetaPropValue, display->n_prop_hooks);
+      props[i].n_values = init_initial_prop_values (display,
+                                                    props[i].override_redirect,
+                                                    props[i].values);
+
+      xwindows[i] = props[i].xwindow;
+      values[i] = props[i].values;
+      n_values[i] = props[i].n_values;
+    }
+
+  meta_prop_get_values_for_windows (display, xwindows, values, n_values,
+                                    n_windows);
+
+  g_free (xwindows);
+  g_free (values);
+  g_free (n_values);
+}
+
+void
+meta_initial_properties_free (MetaInitialProperties *props,
+                              int                    n_windows)
+{
+  int i;
+
+  for (i = 0; i < n_windows; i++)
+    {
+      meta_prop_free_values (props[i].values, props[i].n_values);
+      g_free (props[i].values);
+      props[i].values = NULL;
+      props[i].n_values = 0;
+    }
+}
+
+void
+meta_window_apply_initial_properties (MetaWindow            *window,
+                                      MetaInitialProperties *props)
+{
+  g_return_if_fail (props->xwindow == window->xwindow);
+  g_return_if_fail (props->override_redirect == window->override_redirect);
+
+  reload_initial_prop_values (window, props->values);
+}
+
 /* Fill in the MetaPropValue used to get the value of "property" */
 static void
-init_prop_value (MetaWindow          *window,
+init_prop_value (gboolean             override_redirect,
                  MetaWindowPropHooks *hooks,
                  MetaPropValue       *value)
 {
   if (!hooks || hooks->type == META_PROP_VALUE_INVALID ||
-      (window->override_redirect && !hooks->include_override_redirect))
+      (override_redirect && !hooks->include_override_redirect))
     {
       value->type = META_PROP_VALUE_INVALID;
       value->atom = None;
@@ -1379,6 +1463,9 @@ reload_wm_protocols (MetaWindow    *window,
         window->net_wm_ping = TRUE;
       ++i;
     }
+
+  /* take_focus decides whether the window is in the tab lists */
+  meta_display_invalidate_tab_lists (window->display);
   
   meta_verbose ("New _NET_STARTUP_ID \"%s\" for %s\n",
                 window->startup_id ? window->startup_id : "unset",
@@ -1433,6 +1520,9 @@ reload_wm_hints (MetaWindow    *window,
                     window->wm_hints_mask);
     }
 
+  /* input decides whether the window is in the tab lists */
+  meta_display_invalidate_tab_lists (window->display);
+
   if (window->xgroup_leader != old_group_leader)
     {
       meta_verbose ("Window %s changed its group leader to 0x%lx\n",
@@ -33,6 +33,19 @@
 #define META_WINDOW_PROPS_H
 
 #include "window-private.h"
+#include "xprops.h"
+
+/**
+ * The standard properties of a window that isn't managed yet, fetched
+ * ahead of time by meta_display_fetch_initial_properties().
+ */
+typedef struct _MetaInitialProperties
+{
+  Window         xwindow;
+  gboolean       override_redirect;
+  MetaPropValue *values;
+  int            n_values;
+} MetaInitialProperties;
 
 /**
  * Requests the current values of a single property for a given
@@ -104,6 +117,40 @@ void meta_window_reload_properties_from_xwindow
  */
 void meta_window_load_initial_properties (MetaWindow *window);
 
+/**
+ * Requests the current values for standard properties for many
+ * windows at once, sending all requests before waiting for any reply.
+ * The caller fills in the xwindow and override_redirect fields of each
+ * element; the values are filled in by this function and must be freed
+ * with meta_initial_properties_free().
+ *
+ * \param display    The display.
+ * \param props      An array of "n_windows" windows.
+ * \param n_windows  The length of the props array.
+ */
+void meta_display_fetch_initial_properties (MetaDisplay           *display,
+                                            MetaInitialProperties *props,
+                                            int                    n_windows);
+
+/**
+ * Frees the values fetched by meta_display_fetch_initial_properties().
+ *
+ * \param props      An array of "n_windows" windows.
+ * \param n_windows  The length of the props array.
+ */
+void meta_initial_properties_free (MetaInitialProperties *props,
+                                   int                    n_windows);
+
+/**
+ * Deals with standard properties fetched ahead of time, in the same
+ * way as meta_window_load_initial_properties().
+ *
+ * \param window  The window.
+ * \param props   The properties fetched for the window.
+ */
+void meta_window_apply_initial_properties (MetaWindow            *window,
+                                           MetaInitialProperties *props);
+
 /**
  * Initialises the hooks used for the reload_propert* functions
  * on a particular display, and stores a pointer to them in the
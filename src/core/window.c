@@ -675,6 +675,23 @@ meta_window_new_with_attrs (MetaDisplay       *display,
                             gboolean           must_be_viewable,
                             MetaCompEffect     effect,
                             XWindowAttributes *attrs)
+{
+  return meta_window_new_with_initial_properties (display, xwindow,
+                                                  must_be_viewable, effect,
+                                                  attrs, NULL);
+}
+
+/* Like meta_window_new_with_attrs(), but if @initial_props is not %NULL
+ * the standard properties it holds are used rather than being requested
+ * from the server; see meta_display_fetch_initial_properties().
+ */
+MetaWindow*
+meta_window_new_with_initial_properties (MetaDisplay           *display,
+                                         Window                 xwindow,
+                                         gboolean               must_be_viewable,
+                                         MetaCompEffect         effect,
+                                         XWindowAttributes     *attrs,
+                                         MetaInitialProperties *initial_props)
 {
   MetaWindow *window;
   GSList *tmp;
@@ -1053,6 +1070,8 @@ meta_window_new_with_attrs (MetaDisplay       *display,
     }
 
   meta_display_register_x_window (display, &window->xwindow, window);
+  meta_stack_tracker_set_toplevel (window->screen->stack_tracker,
+                                   window->xwindow, window);
 
   /* Assign this #MetaWindow a sequence number which can be used
    * for sorting.
@@ -1065,7 +1084,10 @@ meta_window_new_with_attrs (MetaDisplay       *display,
   window->xgroup_leader = None;
   meta_window_compute_group (window);
 
-  meta_window_load_initial_properties (window);
+  if (initial_props)
+    meta_window_apply_initial_properties (window, initial_props);
+  else
+    meta_window_load_initial_properties (window);
 
   if (!window->override_redirect)
     {
@@ -1519,6 +1541,7 @@ meta_window_unmanage (MetaWindow  *window,
               window->desc);
 
   window->unmanaging = TRUE;
+  meta_display_update_attention_windows (window->display, window);
 
   if (window->fullscreen)
     {
@@ -1578,6 +1601,8 @@ meta_window_unmanage (MetaWindow  *window,
     {
       meta_free_gslist_and_elements (window->struts);
       window->struts = NULL;
+      window->screen->strut_windows =
+        g_list_remove (window->screen->strut_windows, window);
 
       meta_topic (META_DEBUG_WORKAREA,
                   "Unmanaging window %s which has struts, so invalidating work areas\n",
@@ -1593,6 +1618,7 @@ meta_window_unmanage (MetaWindow  *window,
   if (window->display->focus_window == window)
     {
       window->display->focus_window = NULL;
+      meta_display_invalidate_tab_lists (window->display);
       g_object_notify (G_OBJECT (window->display), "focus-window");
     }
 
@@ -1692,6 +1718,8 @@ meta_window_unmanage (MetaWindow  *window,
   meta_display_ungrab_focus_window_button (window->display, window);
 
   meta_display_unregister_x_window (window->display, window->xwindow);
+  meta_stack_tracker_set_toplevel (window->screen->stack_tracker,
+                                   window->xwindow, NULL);
 
 
   meta_error_trap_push (window->display);
@@ -1788,7 +1816,9 @@ meta_window_update_on_all_workspaces (MetaWindow *window)
               tmp = tmp->next;
             }
         }
+      meta_display_invalidate_tab_lists (window->display);
       meta_window_set_current_workspace_hint (window);
+      meta_window_update_placement_obstacle (window);
     }
 }
 
@@ -1829,6 +1859,8 @@ set_net_wm_state (MetaWindow *window)
   int i;
   unsigned long data[12];
 
+  meta_display_update_attention_windows (window->display, window);
+
   i = 0;
   if (window->shaded)
     {
@@ -2059,6 +2091,11 @@ implement_showing (MetaWindow *window,
     meta_window_show (window);
 
   window->pending_compositor_effect = META_COMP_EFFECT_NONE;
+
+  /* Minimizing, showing the desktop and first placing all change
+   * whether the window keeps others from being placed over it
+   */
+  meta_window_update_placement_obstacle (window);
 }
 
 void
@@ -3167,6 +3204,7 @@ meta_window_minimize (MetaWindow  *window)
     {
       window->minimized = TRUE;
       window->pending_compositor_effect = META_COMP_EFFECT_MINIMIZE;
+      meta_display_invalidate_tab_lists (window->display);
       meta_window_queue(window, META_QUEUE_CALC_SHOWING);
 
       meta_window_foreach_transient (window,
@@ -3198,6 +3236,7 @@ meta_window_unminimize (MetaWindow  *window)
     {
       window->minimized = FALSE;
       window->pending_compositor_effect = META_COMP_EFFECT_UNMINIMIZE;
+      meta_display_invalidate_tab_lists (window->display);
       meta_window_queue(window, META_QUEUE_CALC_SHOWING);
 
       meta_window_foreach_transient (window,
@@ -4264,6 +4303,141 @@ meta_window_get_monitor (MetaWindow *window)
   return window->monitor->number;
 }
 
+/**
+ * meta_window_update_spatial_index: (skip)
+ * @window: a #MetaWindow
+ *
+ * Updates the outer rectangle of @window in the spatial index of its
+ * workspace, and in the free space placement keeps. This needs to be
+ * called whenever the outer rectangle changes.
+ */
+void
+meta_window_update_spatial_index (MetaWindow *window)
+{
+  MetaRectangle outer;
+
+  if (window->workspace != NULL)
+    {
+      meta_window_get_outer_rect (window, &outer);
+      meta_window_index_set_rect (window->workspace->window_index,
+                                  window, &outer);
+    }
+
+  meta_window_update_placement_obstacle (window);
+}
+
+/**
+ * meta_window_is_placement_obstacle: (skip)
+ * @window: a #MetaWindow
+ *
+ * Returns: %TRUE if new windows should be placed so that they don't
+ *   overlap @window.
+ */
+gboolean
+meta_window_is_placement_obstacle (MetaWindow *window)
+{
+  /* Windows that haven't been placed yet aren't where they'll be */
+  if (!window->placed)
+    return FALSE;
+
+  switch (window->type)
+    {
+    case META_WINDOW_DOCK:
+    case META_WINDOW_SPLASHSCREEN:
+    case META_WINDOW_DESKTOP:
+    case META_WINDOW_DIALOG:
+    case META_WINDOW_MODAL_DIALOG:
+    /* override redirect window types: */
+    case META_WINDOW_DROPDOWN_MENU:
+    case META_WINDOW_POPUP_MENU:
+    case META_WINDOW_TOOLTIP:
+    case META_WINDOW_NOTIFICATION:
+    case META_WINDOW_COMBO:
+    case META_WINDOW_DND:
+    case META_WINDOW_OVERRIDE_OTHER:
+      return FALSE;
+
+    case META_WINDOW_NORMAL:
+    case META_WINDOW_UTILITY:
+    case META_WINDOW_TOOLBAR:
+    case META_WINDOW_MENU:
+      break;
+    }
+
+  return meta_window_showing_on_its_workspace (window);
+}
+
+static void
+update_free_space (MetaWindow          *window,
+                   MetaWorkspace       *workspace,
+                   const MetaRectangle *old_rect,
+                   const MetaRectangle *new_rect)
+{
+  GList *tmp;
+
+  if (workspace != NULL)
+    {
+      meta_workspace_update_free_space (workspace, old_rect, new_rect);
+      return;
+    }
+
+  for (tmp = window->screen->workspaces; tmp != NULL; tmp = tmp->next)
+    meta_workspace_update_free_space (tmp->data, old_rect, new_rect);
+}
+
+/**
+ * meta_window_update_placement_obstacle: (skip)
+ * @window: a #MetaWindow
+ *
+ * Updates the free space placement keeps for the workspaces of @window
+ * with its outer rectangle, if it is a placement obstacle (see
+ * meta_window_is_placement_obstacle()). This needs to be called whenever
+ * that, the outer rectangle, or the workspaces of @window change.
+ */
+void
+meta_window_update_placement_obstacle (MetaWindow *window)
+{
+  MetaWorkspace *workspace;
+  MetaRectangle outer;
+  gboolean is_obstacle;
+
+  is_obstacle = window->workspace != NULL &&
+    meta_window_is_placement_obstacle (window);
+  workspace = window->on_all_workspaces ? NULL : window->workspace;
+
+  if (is_obstacle)
+    {
+      meta_window_get_outer_rect (window, &outer);
+
+      if (window->is_placement_obstacle &&
+          window->obstacle_workspace == workspace &&
+          meta_rectangle_equal (&window->obstacle_rect, &outer))
+        return;
+    }
+  else if (!window->is_placement_obstacle)
+    return;
+
+  if (window->is_placement_obstacle &&
+      (!is_obstacle || window->obstacle_workspace != workspace))
+    {
+      update_free_space (window, window->obstacle_workspace,
+                         &window->obstacle_rect, NULL);
+      window->is_placement_obstacle = FALSE;
+      window->obstacle_workspace = NULL;
+    }
+
+  if (is_obstacle)
+    {
+      update_free_space (window, workspace,
+                         window->is_placement_obstacle ?
+                         &window->obstacle_rect : NULL,
+                         &outer);
+      window->is_placement_obstacle = TRUE;
+      window->obstacle_workspace = workspace;
+      window->obstacle_rect = outer;
+    }
+}
+
 void
 meta_window_update_monitor (MetaWindow *window)
 {
@@ -4751,6 +4925,7 @@ meta_window_move_resize_internal (MetaWindow          *window,
 
   meta_window_refresh_resize_popup (window);
 
+  meta_window_update_spatial_index (window);
   meta_window_update_monitor (window);
 
   /* Invariants leaving this function are:
@@ -5017,6 +5192,7 @@ meta_window_configure_notify (MetaWindow      *window,
   window->rect.y = event->y;
   window->rect.width = event->width;
   window->rect.height = event->height;
+  meta_window_update_spatial_index (window);
   meta_window_update_monitor (window);
 
   if (!event->override_redirect && !event->send_event)
@@ -6606,6 +6782,7 @@ meta_window_notify_focus (MetaWindow *window,
       if (window->override_redirect)
         {
           window->display->focus_window = NULL;
+          meta_display_invalidate_tab_lists (window->display);
           g_object_notify (G_OBJECT (window->display), "focus-window");
           return FALSE;
         }
@@ -6616,6 +6793,7 @@ meta_window_notify_focus (MetaWindow *window,
                       "* Focus --> %s\n", window->desc);
           window->display->focus_window = window;
           window->has_focus = TRUE;
+          meta_display_invalidate_tab_lists (window->display);
 
           /* Move to the front of the focusing workspace's MRU list.
            * We should only be "removing" it from the MRU list if it's
@@ -6709,6 +6887,7 @@ meta_window_notify_focus (MetaWindow *window,
           meta_window_propagate_focus_appearance (window, FALSE);
 
           window->display->focus_window = NULL;
+          meta_display_invalidate_tab_lists (window->display);
           g_object_notify (G_OBJECT (window->display), "focus-window");
           window->has_focus = FALSE;
 
@@ -7338,6 +7517,13 @@ meta_window_update_struts (MetaWindow *window)
   /* Update appropriately */
   meta_free_gslist_and_elements (old_struts);
   window->struts = new_struts;
+
+  if (old_struts == NULL && new_struts != NULL)
+    window->screen->strut_windows =
+      g_list_prepend (window->screen->strut_windows, window);
+  else if (old_struts != NULL && new_struts == NULL)
+    window->screen->strut_windows =
+      g_list_remove (window->screen->strut_windows, window);
   if (changed)
     {
       meta_topic (META_DEBUG_WORKAREA,
@@ -7498,6 +7684,8 @@ recalc_window_type (MetaWindow *window)
       g_object_notify (object, "window-type");
 
       g_object_thaw_notify (object);
+
+      meta_window_update_placement_obstacle (window);
     }
 }
 
@@ -7762,6 +7950,9 @@ recalc_window_features (MetaWindow *window)
       break;
     }
 
+  /* skip_taskbar decides which tab list the window is in */
+  meta_display_invalidate_tab_lists (window->display);
+
   meta_topic (META_DEBUG_WINDOW_OPS,
               "Window %s decorated = %d border_only = %d has_close = %d has_minimize = %d has_maximize = %d has_move = %d has_shade = %d skip_taskbar = %d skip_pager = %d\n",
               window->desc,
@@ -8080,7 +8271,7 @@ void
 meta_window_shove_titlebar_onscreen (MetaWindow *window)
 {
   MetaRectangle  outer_rect;
-  GList         *onscreen_region;
+  MetaRegion    *onscreen_region;
   int            horiz_amount, vert_amount;
   int            newx, newy;
 
@@ -8092,7 +8283,8 @@ meta_window_shove_titlebar_onscreen (MetaWindow *window)
 
   /* Get the basic info we need */
   meta_window_get_outer_rect (window, &outer_rect);
-  onscreen_region = window->screen->active_workspace->screen_region;
+  onscreen_region =
+    meta_workspace_get_onscreen_region (window->screen->active_workspace);
 
   /* Extend the region (just in case the window is too big to fit on the
    * screen), then shove the window on screen, then return the region to
@@ -8100,19 +8292,19 @@ meta_window_shove_titlebar_onscreen (MetaWindow *window)
    */
   horiz_amount = outer_rect.width;
   vert_amount  = outer_rect.height;
-  meta_rectangle_expand_region (onscreen_region,
-                                horiz_amount,
-                                horiz_amount,
-                                0,
-                                vert_amount);
-  meta_rectangle_shove_into_region(onscreen_region,
-                                   FIXED_DIRECTION_X,
-                                   &outer_rect);
-  meta_rectangle_expand_region (onscreen_region,
-                                -horiz_amount,
-                                -horiz_amount,
-                                0,
-                                -vert_amount);
+  meta_region_expand (onscreen_region,
+                      horiz_amount,
+                      horiz_amount,
+                      0,
+                      vert_amount);
+  meta_region_shove_rect (onscreen_region,
+                          FIXED_DIRECTION_X,
+                          &outer_rect);
+  meta_region_expand (onscreen_region,
+                      -horiz_amount,
+                      -horiz_amount,
+                      0,
+                      -vert_amount);
 
   newx = outer_rect.x + window->frame->child_x;
   newy = outer_rect.y + window->frame->child_y;
@@ -8128,8 +8320,9 @@ gboolean
 meta_window_titlebar_is_onscreen (MetaWindow *window)
 {
   MetaRectangle  titlebar_rect;
-  GList         *onscreen_region;
+  MetaRegion    *onscreen_region;
   gboolean       is_onscreen;
+  int            i;
 
   const int min_height_needed  = 8;
   const int min_width_percent  = 0.5;
@@ -8147,10 +8340,11 @@ meta_window_titlebar_is_onscreen (MetaWindow *window)
    * them overlaps with the titlebar sufficiently to consider it onscreen.
    */
   is_onscreen = FALSE;
-  onscreen_region = window->screen->active_workspace->screen_region;
-  while (onscreen_region)
+  onscreen_region =
+    meta_workspace_get_onscreen_region (window->screen->active_workspace);
+  for (i = 0; i < onscreen_region->n_rects; i++)
     {
-      MetaRectangle *spanning_rect = onscreen_region->data;
+      MetaRectangle *spanning_rect = &onscreen_region->rects[i];
       MetaRectangle overlap;
 
       meta_rectangle_intersect (&titlebar_rect, spanning_rect, &overlap);
@@ -8161,8 +8355,6 @@ meta_window_titlebar_is_onscreen (MetaWindow *window)
           is_onscreen = TRUE;
           break;
         }
-
-      onscreen_region = onscreen_region->next;
     }
 
   return is_onscreen;
@@ -9493,6 +9685,9 @@ warp_grab_pointer (MetaWindow          *window,
                 0, 0, 0, 0,
                 *x, *y);
 
+  /* Warping doesn't generate raw motion */
+  meta_display_invalidate_pointer_position (display);
+
   if (meta_error_trap_pop_with_return (display) != Success)
     {
       meta_verbose ("Failed to warp pointer for window %s\n",
@@ -9614,6 +9809,7 @@ ensure_mru_position_after (MetaWindow *window,
         g_list_insert_before (window->screen->active_workspace->mru_list,
                               after_this_one_position->next,
                               window);
+      meta_display_invalidate_tab_lists (window->display);
     }
 }
 
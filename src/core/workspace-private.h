@@ -35,6 +35,11 @@
 
 #include <meta/workspace.h>
 #include "window-private.h"
+#include "boxes-private.h"
+#include "window-index.h"
+#include "free-space.h"
+
+typedef struct _MetaStrutSet MetaStrutSet;
 
 struct _MetaWorkspace
 {
@@ -44,13 +49,33 @@ struct _MetaWorkspace
   GList *windows;
   GList *mru_list;
 
+  /* The tab lists, built from mru_list when needed */
+  MetaTabChain *tab_chains[META_N_TAB_LISTS];
+
+  /* The outer rectangles of windows */
+  MetaWindowIndex *window_index;
+
   GList  *list_containing_self;
 
+  /* The struts and what is computed from them, shared with the other
+   * workspaces that have the same struts.  The work areas, regions,
+   * edges and all_struts below point into it while it's valid.
+   */
+  MetaStrutSet *strut_set;
+  /* The strut set from before the work areas were last invalidated, to
+   * reuse what didn't change when computing the new one
+   */
+  MetaStrutSet *old_strut_set;
+
   MetaRectangle work_area_screen;
   MetaRectangle *work_area_monitor;
-  GList  *screen_region;
-  GList  **monitor_region;
+  MetaRegion  *screen_region;
+  MetaRegion **monitor_region;
   gint n_monitor_regions;
+  /* Free space for placement in each monitor's work area, computed
+   * when first needed
+   */
+  MetaFreeSpace **free_space;
   GList  *screen_edges;
   GList  *monitor_edges;
   GSList *builtin_struts;
@@ -80,10 +105,18 @@ void meta_workspace_invalidate_work_area (MetaWorkspace *workspace);
 void meta_workspace_get_work_area_for_monitor   (MetaWorkspace *workspace,
                                                  int            which_monitor,
                                                  MetaRectangle *area);
-GList* meta_workspace_get_onscreen_region       (MetaWorkspace *workspace);
-GList* meta_workspace_get_onmonitor_region      (MetaWorkspace *workspace,
+MetaRegion* meta_workspace_get_onscreen_region  (MetaWorkspace *workspace);
+MetaRegion* meta_workspace_get_onmonitor_region (MetaWorkspace *workspace,
                                                  int            which_monitor);
 
+MetaFreeSpace* meta_workspace_get_free_space       (MetaWorkspace       *workspace,
+                                                    int                  which_monitor);
+void           meta_workspace_invalidate_free_space (MetaWorkspace       *workspace,
+                                                    int                  which_monitor);
+void           meta_workspace_update_free_space    (MetaWorkspace       *workspace,
+                                                    const MetaRectangle *old_rect,
+                                                    const MetaRectangle *new_rect);
+
 void meta_workspace_focus_default_window (MetaWorkspace *workspace,
                                           MetaWindow    *not_this_one,
                                           guint32        timestamp);
@@ -51,6 +51,7 @@ static void focus_ancestor_or_mru_window (MetaWorkspace *workspace,
                                           guint32        timestamp);
 static void free_this                    (gpointer candidate,
                                           gpointer dummy);
+static void strut_set_unref              (MetaStrutSet  *set);
 
 G_DEFINE_TYPE (MetaWorkspace, meta_workspace, G_TYPE_OBJECT);
 
@@ -163,6 +164,7 @@ MetaWorkspace*
 meta_workspace_new (MetaScreen *screen)
 {
   MetaWorkspace *workspace;
+  int i;
 
   workspace = g_object_new (META_TYPE_WORKSPACE, NULL);
 
@@ -171,6 +173,9 @@ meta_workspace_new (MetaScreen *screen)
     g_list_append (workspace->screen->workspaces, workspace);
   workspace->windows = NULL;
   workspace->mru_list = NULL;
+  for (i = 0; i < META_N_TAB_LISTS; i++)
+    workspace->tab_chains[i] = NULL;
+  workspace->window_index = meta_window_index_new ();
   meta_screen_foreach_window (screen, maybe_add_to_list, &workspace->mru_list);
 
   workspace->work_areas_invalid = TRUE;
@@ -180,8 +185,11 @@ meta_workspace_new (MetaScreen *screen)
   workspace->work_area_screen.width = 0;
   workspace->work_area_screen.height = 0;
 
+  workspace->strut_set = NULL;
+  workspace->old_strut_set = NULL;
   workspace->screen_region = NULL;
   workspace->monitor_region = NULL;
+  workspace->free_space = NULL;
   workspace->screen_edges = NULL;
   workspace->monitor_edges = NULL;
   workspace->list_containing_self = g_list_prepend (NULL, workspace);
@@ -201,22 +209,6 @@ free_this (gpointer candidate, gpointer dummy)
   g_free (candidate);
 }
 
-/**
- * Frees the combined struts list of a workspace.
- *
- * \param workspace  The workspace.
- */
-static void
-workspace_free_all_struts (MetaWorkspace *workspace)
-{
-  if (workspace->all_struts == NULL)
-    return;
-    
-  g_slist_foreach (workspace->all_struts, free_this, NULL);
-  g_slist_free (workspace->all_struts);
-  workspace->all_struts = NULL;
-}
-
 /**
  * Frees the struts list set with meta_workspace_set_builtin_struts
  *
@@ -233,11 +225,22 @@ workspace_free_builtin_struts (MetaWorkspace *workspace)
   workspace->builtin_struts = NULL;
 }
 
+static void
+workspace_free_all_free_space (MetaWorkspace *workspace)
+{
+  int i;
+
+  for (i = 0; i < workspace->screen->n_monitor_infos; i++)
+    if (workspace->free_space[i])
+      meta_free_space_free (workspace->free_space[i]);
+  g_free (workspace->free_space);
+  workspace->free_space = NULL;
+}
+
 void
 meta_workspace_remove (MetaWorkspace *workspace)
 {
   GList *tmp;
-  MetaScreen *screen;
   int i;
 
   g_return_if_fail (workspace != workspace->screen->active_workspace);
@@ -262,15 +265,15 @@ meta_workspace_remove (MetaWorkspace *workspace)
 
   g_assert (workspace->windows == NULL);
 
-  screen = workspace->screen;
-  
   workspace->screen->workspaces =
     g_list_remove (workspace->screen->workspaces, workspace);
   
-  g_free (workspace->work_area_monitor);
-
   g_list_free (workspace->mru_list);
+  for (i = 0; i < META_N_TAB_LISTS; i++)
+    if (workspace->tab_chains[i])
+      meta_tab_chain_free (workspace->tab_chains[i]);
   g_list_free (workspace->list_containing_self);
+  meta_window_index_free (workspace->window_index);
 
   workspace_free_builtin_struts (workspace);
 
@@ -283,14 +286,11 @@ meta_workspace_remove (MetaWorkspace *workspace)
 
   if (!workspace->work_areas_invalid)
     {
-      workspace_free_all_struts (workspace);
-      for (i = 0; i < screen->n_monitor_infos; i++)
-        meta_rectangle_free_list_and_elements (workspace->monitor_region[i]);
-      g_free (workspace->monitor_region);
-      meta_rectangle_free_list_and_elements (workspace->screen_region);
-      meta_rectangle_free_list_and_elements (workspace->screen_edges);
-      meta_rectangle_free_list_and_elements (workspace->monitor_edges);
+      strut_set_unref (workspace->strut_set);
+      workspace_free_all_free_space (workspace);
     }
+  if (workspace->old_strut_set)
+    strut_set_unref (workspace->old_strut_set);
 
   g_object_unref (workspace);
 
@@ -330,8 +330,10 @@ meta_workspace_add_window (MetaWorkspace *workspace,
     }
 
   workspace->windows = g_list_prepend (workspace->windows, window);
+  meta_display_invalidate_tab_lists (workspace->screen->display);
 
   window->workspace = workspace;
+  meta_window_update_spatial_index (window);
 
   meta_window_set_current_workspace_hint (window);
   
@@ -359,7 +361,10 @@ meta_workspace_remove_window (MetaWorkspace *workspace,
   g_return_if_fail (window->workspace == workspace);
 
   workspace->windows = g_list_remove (workspace->windows, window);
+  meta_display_invalidate_tab_lists (workspace->screen->display);
+  meta_window_index_remove (workspace->window_index, window);
   window->workspace = NULL;
+  meta_window_update_placement_obstacle (window);
 
   /* If the window is on all workspaces, we don't want to remove it
    * from the MRU list unless this causes it to be removed from all 
@@ -757,7 +762,6 @@ meta_workspace_invalidate_work_area (MetaWorkspace *workspace)
 {
   GList *tmp;
   GList *windows;
-  int i;
   
   if (workspace->work_areas_invalid)
     {
@@ -776,17 +780,16 @@ meta_workspace_invalidate_work_area (MetaWorkspace *workspace)
   if (workspace == workspace->screen->active_workspace)
     meta_display_cleanup_edges (workspace->screen->display);
 
-  g_free (workspace->work_area_monitor);
-  workspace->work_area_monitor = NULL;
-      
-  workspace_free_all_struts (workspace);
+  /* Keep the strut set around until the new one is computed, to reuse
+   * the parts of it that don't change
+   */
+  g_assert (workspace->old_strut_set == NULL);
+  workspace->old_strut_set = workspace->strut_set;
+  workspace->strut_set = NULL;
 
-  for (i = 0; i < workspace->screen->n_monitor_infos; i++)
-    meta_rectangle_free_list_and_elements (workspace->monitor_region[i]);
-  g_free (workspace->monitor_region);
-  meta_rectangle_free_list_and_elements (workspace->screen_region);
-  meta_rectangle_free_list_and_elements (workspace->screen_edges);
-  meta_rectangle_free_list_and_elements (workspace->monitor_edges);
+  workspace_free_all_free_space (workspace);
+  workspace->all_struts = NULL;
+  workspace->work_area_monitor = NULL;
   workspace->monitor_region = NULL;
   workspace->screen_region = NULL;
   workspace->screen_edges = NULL;
@@ -831,71 +834,308 @@ copy_strut_list(GSList *original)
   return g_slist_reverse (result);
 }
 
+static gboolean
+strut_lists_equal (GSList *l,
+                   GSList *m)
+{
+  for (; l && m; l = l->next, m = m->next)
+    {
+      MetaStrut *a = l->data;
+      MetaStrut *b = m->data;
+
+      if (a->side != b->side ||
+          !meta_rectangle_equal (&a->rect, &b->rect))
+        return FALSE;
+    }
+
+  return l == NULL && m == NULL;
+}
+
+/* The struts of a workspace, and the regions, work areas and edges
+ * computed from them.  Since panels and docks are usually on all
+ * workspaces, most workspaces have the same struts; they all share one
+ * strut set, found in strut_sets, so that the struts are only stored
+ * and the regions only computed once.
+ */
+struct _MetaStrutSet
+{
+  int ref_count;
+  guint hash;
+
+  /* The geometry everything was computed for */
+  MetaRectangle screen_rect;
+  MetaRectangle *monitor_rects;
+  int n_monitors;
+
+  /* Sorted with compare_struts(), without duplicates */
+  GSList *struts;
+
+  MetaRectangle work_area_screen;
+  MetaRectangle *work_area_monitor;
+  MetaRegion *screen_region;
+  MetaRegion **monitor_region;
+  GList *screen_edges;
+  GList *monitor_edges;
+};
+
+/* The strut sets in use, by their struts and geometry */
+static GHashTable *strut_sets = NULL;
+
+static int
+compare_struts (gconstpointer a,
+                gconstpointer b)
+{
+  const MetaStrut *strut_a = a;
+  const MetaStrut *strut_b = b;
+
+  if (strut_a->side != strut_b->side)
+    return strut_a->side < strut_b->side ? -1 : 1;
+  else if (strut_a->rect.y != strut_b->rect.y)
+    return strut_a->rect.y < strut_b->rect.y ? -1 : 1;
+  else if (strut_a->rect.x != strut_b->rect.x)
+    return strut_a->rect.x < strut_b->rect.x ? -1 : 1;
+  else if (strut_a->rect.height != strut_b->rect.height)
+    return strut_a->rect.height < strut_b->rect.height ? -1 : 1;
+  else if (strut_a->rect.width != strut_b->rect.width)
+    return strut_a->rect.width < strut_b->rect.width ? -1 : 1;
+  else
+    return 0;
+}
+
+static guint
+hash_rect (guint                hash,
+           const MetaRectangle *rect)
+{
+  hash = hash * 31 + rect->x;
+  hash = hash * 31 + rect->y;
+  hash = hash * 31 + rect->width;
+  hash = hash * 31 + rect->height;
+
+  return hash;
+}
+
+static guint
+compute_strut_set_hash (const MetaStrutSet *set)
+{
+  guint hash;
+  GSList *tmp;
+  int i;
+
+  hash = hash_rect (set->n_monitors, &set->screen_rect);
+  for (i = 0; i < set->n_monitors; i++)
+    hash = hash_rect (hash, &set->monitor_rects[i]);
+
+  for (tmp = set->struts; tmp != NULL; tmp = tmp->next)
+    {
+      MetaStrut *strut = tmp->data;
+
+      hash = hash_rect (hash * 31 + strut->side, &strut->rect);
+    }
+
+  return hash;
+}
+
+static guint
+strut_set_hash (gconstpointer key)
+{
+  const MetaStrutSet *set = key;
+
+  return set->hash;
+}
+
+static gboolean
+strut_set_equal (gconstpointer a,
+                 gconstpointer b)
+{
+  const MetaStrutSet *set_a = a;
+  const MetaStrutSet *set_b = b;
+
+  return set_a->hash == set_b->hash &&
+    set_a->n_monitors == set_b->n_monitors &&
+    meta_rectangle_equal (&set_a->screen_rect, &set_b->screen_rect) &&
+    memcmp (set_a->monitor_rects, set_b->monitor_rects,
+            set_a->n_monitors * sizeof (MetaRectangle)) == 0 &&
+    strut_lists_equal (set_a->struts, set_b->struts);
+}
+
 static void
-ensure_work_areas_validated (MetaWorkspace *workspace)
+strut_set_unref (MetaStrutSet *set)
 {
-  GList         *windows;
-  GList         *tmp;
-  MetaRectangle  work_area;
-  int            i;  /* C89 absolutely sucks... */
+  int i;
 
-  if (!workspace->work_areas_invalid)
+  if (--set->ref_count > 0)
     return;
 
-  g_assert (workspace->all_struts == NULL);
-  g_assert (workspace->monitor_region == NULL);
-  g_assert (workspace->screen_region == NULL);
-  g_assert (workspace->screen_edges == NULL);
-  g_assert (workspace->monitor_edges == NULL);
+  g_hash_table_remove (strut_sets, set);
+  if (g_hash_table_size (strut_sets) == 0)
+    {
+      g_hash_table_destroy (strut_sets);
+      strut_sets = NULL;
+    }
 
-  /* STEP 1: Get the list of struts */
+  for (i = 0; i < set->n_monitors; i++)
+    meta_region_free (set->monitor_region[i]);
+  g_free (set->monitor_region);
+  meta_region_free (set->screen_region);
+  meta_rectangle_free_list_and_elements (set->screen_edges);
+  meta_rectangle_free_list_and_elements (set->monitor_edges);
+  g_free (set->work_area_monitor);
+  g_free (set->monitor_rects);
+  meta_free_gslist_and_elements (set->struts);
+  g_slice_free (MetaStrutSet, set);
+}
 
-  workspace->all_struts = copy_strut_list (workspace->builtin_struts);
+/* The struts in struts (sorted) that overlap rect, which are the only
+ * ones that make a difference to its region
+ */
+static GSList *
+struts_in_rect (GSList              *struts,
+                const MetaRectangle *rect)
+{
+  GSList *result = NULL;
 
-  windows = meta_workspace_list_windows (workspace);
-  for (tmp = windows; tmp != NULL; tmp = tmp->next)
+  for (; struts != NULL; struts = struts->next)
+    {
+      MetaStrut *strut = struts->data;
+
+      if (meta_rectangle_overlap (&strut->rect, rect))
+        result = g_slist_prepend (result, strut);
+    }
+
+  return g_slist_reverse (result);
+}
+
+/* Gets the struts of the windows on the workspace, and the builtin
+ * ones, sorted and without duplicates.  The struts aren't copied.
+ */
+static GSList *
+workspace_list_struts (MetaWorkspace *workspace)
+{
+  GSList *struts;
+  GSList *s_iter;
+  GList  *tmp;
+
+  struts = g_slist_copy (workspace->builtin_struts);
+
+  for (tmp = workspace->screen->strut_windows; tmp != NULL; tmp = tmp->next)
     {
       MetaWindow *win = tmp->data;
-      GSList *s_iter;
 
-      for (s_iter = win->struts; s_iter != NULL; s_iter = s_iter->next) {
-        workspace->all_struts = g_slist_prepend (workspace->all_struts,
-                                                 copy_strut(s_iter->data));
-      }
+      if (!meta_window_located_on_workspace (win, workspace))
+        continue;
+
+      for (s_iter = win->struts; s_iter != NULL; s_iter = s_iter->next)
+        struts = g_slist_prepend (struts, s_iter->data);
     }
-  g_list_free (windows);
 
-  /* STEP 2: Get the maximal/spanning rects for the onscreen and
-   *         on-single-monitor regions
-   */  
-  g_assert (workspace->monitor_region == NULL);
-  g_assert (workspace->screen_region   == NULL);
+  struts = g_slist_sort (struts, compare_struts);
 
-  workspace->monitor_region = g_new (GList*,
-                                      workspace->screen->n_monitor_infos);
-  for (i = 0; i < workspace->screen->n_monitor_infos; i++)
+  s_iter = struts;
+  while (s_iter != NULL && s_iter->next != NULL)
     {
-      workspace->monitor_region[i] =
-        meta_rectangle_get_minimal_spanning_set_for_region (
-          &workspace->screen->monitor_infos[i].rect,
-          workspace->all_struts);
+      if (compare_struts (s_iter->data, s_iter->next->data) == 0)
+        s_iter->next = g_slist_delete_link (s_iter->next, s_iter->next);
+      else
+        s_iter = s_iter->next;
     }
-  workspace->screen_region =
-    meta_rectangle_get_minimal_spanning_set_for_region (
-      &workspace->screen->rect,
-      workspace->all_struts);
 
-  /* STEP 3: Get the work areas (region-to-maximize-to) for the screen and
+  return struts;
+}
+
+/* Computes everything in the strut set from its struts and geometry.
+ * The region and work area of each monitor whose struts are the same as
+ * in old_set are copied from there instead.
+ */
+static void
+strut_set_compute (MetaStrutSet  *set,
+                   MetaStrutSet  *old_set,
+                   MetaWorkspace *workspace)
+{
+  MetaRectangle  work_area;
+  GList         *tmp;
+  int            i;
+
+  /* STEP 1: Get the maximal/spanning rects for the on-single-monitor
+   *         regions and the work areas (region-to-maximize-to) of the
    *         monitors.
    */
-  work_area = workspace->screen->rect;  /* start with the screen */
-  if (workspace->screen_region == NULL)
-    work_area = meta_rect (0, 0, -1, -1);
-  else
-    meta_rectangle_clip_to_region (workspace->screen_region,
+  set->monitor_region = g_new (MetaRegion*, set->n_monitors);
+  set->work_area_monitor = g_new (MetaRectangle, set->n_monitors);
+
+  for (i = 0; i < set->n_monitors; i++)
+    {
+      const MetaRectangle *monitor_rect = &set->monitor_rects[i];
+      GSList *monitor_struts;
+      gboolean reused = FALSE;
+
+      monitor_struts = struts_in_rect (set->struts, monitor_rect);
+
+      if (old_set != NULL &&
+          i < old_set->n_monitors &&
+          meta_rectangle_equal (&old_set->monitor_rects[i], monitor_rect))
+        {
+          GSList *old_monitor_struts;
+
+          old_monitor_struts = struts_in_rect (old_set->struts, monitor_rect);
+          if (strut_lists_equal (monitor_struts, old_monitor_struts))
+            {
+              MetaRegion *old_region = old_set->monitor_region[i];
+
+              set->monitor_region[i] = meta_region_new (old_region->rects,
+                                                        old_region->n_rects);
+              set->work_area_monitor[i] = old_set->work_area_monitor[i];
+              reused = TRUE;
+            }
+          g_slist_free (old_monitor_struts);
+        }
+
+      if (!reused)
+        {
+          set->monitor_region[i] =
+            meta_region_new_spanning_set (monitor_rect, monitor_struts);
+
+          work_area = *monitor_rect;
+          if (set->monitor_region[i]->n_rects == 0)
+            /* FIXME: constraints.c untested with this, but it might be nice for
+             * a screen reader or magnifier.
+             */
+            work_area = meta_rect (work_area.x, work_area.y, -1, -1);
+          else
+            meta_region_clip_rect (set->monitor_region[i],
                                    FIXED_DIRECTION_NONE,
                                    &work_area);
 
+          set->work_area_monitor[i] = work_area;
+        }
+
+      g_slist_free (monitor_struts);
+
+      meta_topic (META_DEBUG_WORKAREA,
+                  "%s work area for workspace %d "
+                  "monitor %d: %d,%d %d x %d\n",
+                  reused ? "Kept" : "Computed",
+                  meta_workspace_index (workspace),
+                  i,
+                  set->work_area_monitor[i].x,
+                  set->work_area_monitor[i].y,
+                  set->work_area_monitor[i].width,
+                  set->work_area_monitor[i].height);
+    }
+
+  /* STEP 2: Get the maximal/spanning rects for the onscreen region and
+   *         the work area of the screen.
+   */
+  set->screen_region =
+    meta_region_new_spanning_set (&set->screen_rect, set->struts);
+
+  work_area = set->screen_rect;  /* start with the screen */
+  if (set->screen_region->n_rects == 0)
+    work_area = meta_rect (0, 0, -1, -1);
+  else
+    meta_region_clip_rect (set->screen_region,
+                           FIXED_DIRECTION_NONE,
+                           &work_area);
+
   /* Lots of paranoia checks, forcing work_area_screen to be sane */
 #define MIN_SANE_AREA 100
   if (work_area.width < MIN_SANE_AREA)
@@ -905,7 +1145,7 @@ ensure_work_areas_validated (MetaWorkspace *workspace)
                     work_area.width, MIN_SANE_AREA);
       if (work_area.width < 1)
         {
-          work_area.x = (workspace->screen->rect.width - MIN_SANE_AREA)/2;
+          work_area.x = (set->screen_rect.width - MIN_SANE_AREA)/2;
           work_area.width = MIN_SANE_AREA;
         }
       else
@@ -922,7 +1162,7 @@ ensure_work_areas_validated (MetaWorkspace *workspace)
                     work_area.height, MIN_SANE_AREA);
       if (work_area.height < 1)
         {
-          work_area.y = (workspace->screen->rect.height - MIN_SANE_AREA)/2;
+          work_area.y = (set->screen_rect.height - MIN_SANE_AREA)/2;
           work_area.height = MIN_SANE_AREA;
         }
       else
@@ -932,70 +1172,118 @@ ensure_work_areas_validated (MetaWorkspace *workspace)
           work_area.height += 2*amount;
         }
     }
-  workspace->work_area_screen = work_area;
+  set->work_area_screen = work_area;
   meta_topic (META_DEBUG_WORKAREA,
               "Computed work area for workspace %d: %d,%d %d x %d\n",
               meta_workspace_index (workspace),
-              workspace->work_area_screen.x,
-              workspace->work_area_screen.y,
-              workspace->work_area_screen.width,
-              workspace->work_area_screen.height);    
+              set->work_area_screen.x,
+              set->work_area_screen.y,
+              set->work_area_screen.width,
+              set->work_area_screen.height);    
 
-  /* Now find the work areas for each monitor */
-  g_free (workspace->work_area_monitor);
-  workspace->work_area_monitor = g_new (MetaRectangle,
-                                         workspace->screen->n_monitor_infos);
-
-  for (i = 0; i < workspace->screen->n_monitor_infos; i++)
+  /* STEP 3: Make sure the screen_region is nonempty (separate from step 2
+   *         since it relies on the work area).
+   */  
+  if (set->screen_region->n_rects == 0)
     {
-      work_area = workspace->screen->monitor_infos[i].rect;
+      meta_region_free (set->screen_region);
+      set->screen_region = meta_region_new (&set->work_area_screen, 1);
+    }
 
-      if (workspace->monitor_region[i] == NULL)
-        /* FIXME: constraints.c untested with this, but it might be nice for
-         * a screen reader or magnifier.
-         */
-        work_area = meta_rect (work_area.x, work_area.y, -1, -1);
-      else
-        meta_rectangle_clip_to_region (workspace->monitor_region[i],
-                                       FIXED_DIRECTION_NONE,
-                                       &work_area);
+  /* STEP 4: Cache screen and monitor edges for edge resistance and snapping */
+  set->screen_edges =
+    meta_rectangle_find_onscreen_edges (&set->screen_rect, set->struts);
+  tmp = NULL;
+  for (i = 0; i < set->n_monitors; i++)
+    tmp = g_list_prepend (tmp, &set->monitor_rects[i]);
+  set->monitor_edges =
+    meta_rectangle_find_nonintersected_monitor_edges (tmp, set->struts);
+  g_list_free (tmp);
+}
 
-      workspace->work_area_monitor[i] = work_area;
+/* Finds the strut set for the current struts of the workspace, sharing
+ * the one of another workspace with the same struts if there is one
+ */
+static MetaStrutSet *
+workspace_get_strut_set (MetaWorkspace *workspace)
+{
+  MetaScreen   *screen = workspace->screen;
+  MetaStrutSet  key;
+  MetaStrutSet *set;
+  int           i;
+
+  key.screen_rect = screen->rect;
+  key.n_monitors = screen->n_monitor_infos;
+  key.monitor_rects = g_new (MetaRectangle, key.n_monitors);
+  for (i = 0; i < key.n_monitors; i++)
+    key.monitor_rects[i] = screen->monitor_infos[i].rect;
+  key.struts = workspace_list_struts (workspace);
+  key.hash = compute_strut_set_hash (&key);
+
+  if (strut_sets == NULL)
+    strut_sets = g_hash_table_new (strut_set_hash, strut_set_equal);
+
+  set = g_hash_table_lookup (strut_sets, &key);
+  if (set != NULL)
+    {
       meta_topic (META_DEBUG_WORKAREA,
-                  "Computed work area for workspace %d "
-                  "monitor %d: %d,%d %d x %d\n",
-                  meta_workspace_index (workspace),
-                  i,
-                  workspace->work_area_monitor[i].x,
-                  workspace->work_area_monitor[i].y,
-                  workspace->work_area_monitor[i].width,
-                  workspace->work_area_monitor[i].height);
+                  "Sharing work areas of workspace %d with %d other workspaces\n",
+                  meta_workspace_index (workspace), set->ref_count);
+
+      set->ref_count++;
+      g_free (key.monitor_rects);
+      g_slist_free (key.struts);
+
+      return set;
     }
 
-  /* STEP 4: Make sure the screen_region is nonempty (separate from step 2
-   *         since it relies on step 3).
-   */  
-  if (workspace->screen_region == NULL)
+  set = g_slice_new (MetaStrutSet);
+  set->ref_count = 1;
+  set->hash = key.hash;
+  set->screen_rect = key.screen_rect;
+  set->n_monitors = key.n_monitors;
+  set->monitor_rects = key.monitor_rects;
+  set->struts = copy_strut_list (key.struts);
+  g_slist_free (key.struts);
+
+  strut_set_compute (set, workspace->old_strut_set, workspace);
+
+  g_hash_table_insert (strut_sets, set, set);
+
+  return set;
+}
+
+static void
+ensure_work_areas_validated (MetaWorkspace *workspace)
+{
+  MetaStrutSet *set;
+
+  if (!workspace->work_areas_invalid)
+    return;
+
+  g_assert (workspace->strut_set == NULL);
+  g_assert (workspace->free_space == NULL);
+
+  set = workspace_get_strut_set (workspace);
+  workspace->strut_set = set;
+
+  if (workspace->old_strut_set)
     {
-      MetaRectangle *nonempty_region;
-      nonempty_region = g_new (MetaRectangle, 1);
-      *nonempty_region = workspace->work_area_screen;
-      workspace->screen_region = g_list_prepend (NULL, nonempty_region);
+      strut_set_unref (workspace->old_strut_set);
+      workspace->old_strut_set = NULL;
     }
 
-  /* STEP 5: Cache screen and monitor edges for edge resistance and snapping */
-  g_assert (workspace->screen_edges    == NULL);
-  g_assert (workspace->monitor_edges  == NULL);
-  workspace->screen_edges =
-    meta_rectangle_find_onscreen_edges (&workspace->screen->rect,
-                                        workspace->all_struts);
-  tmp = NULL;
-  for (i = 0; i < workspace->screen->n_monitor_infos; i++)
-    tmp = g_list_prepend (tmp, &workspace->screen->monitor_infos[i].rect);
-  workspace->monitor_edges =
-    meta_rectangle_find_nonintersected_monitor_edges (tmp,
-                                                       workspace->all_struts);
-  g_list_free (tmp);
+  workspace->all_struts = set->struts;
+  workspace->monitor_region = set->monitor_region;
+  workspace->screen_region = set->screen_region;
+  workspace->work_area_screen = set->work_area_screen;
+  workspace->work_area_monitor = set->work_area_monitor;
+  workspace->screen_edges = set->screen_edges;
+  workspace->monitor_edges = set->monitor_edges;
+
+  /* Placement computes the free space in the work areas when needed */
+  workspace->free_space = g_new0 (MetaFreeSpace*,
+                                  workspace->screen->n_monitor_infos);
 
   /* We're all done, YAAY!  Record that everything has been validated. */
   workspace->work_areas_invalid = FALSE;
@@ -1013,23 +1301,6 @@ ensure_work_areas_validated (MetaWorkspace *workspace)
   }
 }
 
-static gboolean
-strut_lists_equal (GSList *l,
-                   GSList *m)
-{
-  for (; l && m; l = l->next, m = m->next)
-    {
-      MetaStrut *a = l->data;
-      MetaStrut *b = m->data;
-
-      if (a->side != b->side ||
-          !meta_rectangle_equal (&a->rect, &b->rect))
-        return FALSE;
-    }
-
-  return l == NULL && m == NULL;
-}
-
 /**
  * meta_workspace_set_builtin_struts:
  * @workspace: a #MetaWorkspace
@@ -1077,7 +1348,7 @@ meta_workspace_get_work_area_all_monitors (MetaWorkspace *workspace,
   *area = workspace->work_area_screen;
 }
 
-GList*
+MetaRegion*
 meta_workspace_get_onscreen_region (MetaWorkspace *workspace)
 {
   ensure_work_areas_validated (workspace);
@@ -1085,7 +1356,7 @@ meta_workspace_get_onscreen_region (MetaWorkspace *workspace)
   return workspace->screen_region;
 }
 
-GList*
+MetaRegion*
 meta_workspace_get_onmonitor_region (MetaWorkspace *workspace,
                                      int            which_monitor)
 {
@@ -1094,6 +1365,117 @@ meta_workspace_get_onmonitor_region (MetaWorkspace *workspace,
   return workspace->monitor_region[which_monitor];
 }
 
+static gboolean
+add_obstacle (MetaWindow          *window,
+              const MetaRectangle *rect,
+              gpointer             data)
+{
+  MetaFreeSpace *space = data;
+
+  if (meta_window_is_placement_obstacle (window))
+    meta_free_space_add_obstacle (space, rect);
+
+  return FALSE;
+}
+
+/**
+ * meta_workspace_get_free_space: (skip)
+ * @workspace: a #MetaWorkspace
+ * @which_monitor: the monitor to get the free space of
+ *
+ * Gets the parts of the work area of @which_monitor that no placement
+ * obstacle (see meta_window_is_placement_obstacle()) on @workspace
+ * covers.  It is kept up to date as the obstacles change, see
+ * meta_workspace_update_free_space().
+ *
+ * Return value: (transfer none): the free space
+ */
+MetaFreeSpace*
+meta_workspace_get_free_space (MetaWorkspace *workspace,
+                               int            which_monitor)
+{
+  MetaFreeSpace *space;
+  MetaRectangle *work_area;
+
+  ensure_work_areas_validated (workspace);
+  g_assert (which_monitor >= 0 &&
+            which_monitor < workspace->screen->n_monitor_infos);
+
+  if (workspace->free_space[which_monitor] != NULL)
+    return workspace->free_space[which_monitor];
+
+  work_area = &workspace->work_area_monitor[which_monitor];
+  space = meta_free_space_new (work_area);
+  meta_screen_foreach_window_in_rect (workspace->screen, workspace, work_area,
+                                      add_obstacle, space);
+
+  meta_topic (META_DEBUG_PLACEMENT,
+              "Computed free space of workspace %d monitor %d\n",
+              meta_workspace_index (workspace), which_monitor);
+
+  workspace->free_space[which_monitor] = space;
+
+  return space;
+}
+
+/**
+ * meta_workspace_invalidate_free_space: (skip)
+ * @workspace: a #MetaWorkspace
+ * @which_monitor: the monitor to recompute the free space of
+ *
+ * Makes meta_workspace_get_free_space() compute the free space of
+ * @which_monitor from scratch next time.
+ */
+void
+meta_workspace_invalidate_free_space (MetaWorkspace *workspace,
+                                      int            which_monitor)
+{
+  if (workspace->work_areas_invalid ||
+      workspace->free_space[which_monitor] == NULL)
+    return;
+
+  meta_free_space_free (workspace->free_space[which_monitor]);
+  workspace->free_space[which_monitor] = NULL;
+}
+
+/**
+ * meta_workspace_update_free_space: (skip)
+ * @workspace: a #MetaWorkspace
+ * @old_rect: (allow-none): the rectangle a placement obstacle covered
+ * @new_rect: (allow-none): the rectangle it covers now
+ *
+ * Updates the free space of @workspace after a placement obstacle was
+ * added (@old_rect is %NULL), moved or removed (@new_rect is %NULL).
+ */
+void
+meta_workspace_update_free_space (MetaWorkspace       *workspace,
+                                  const MetaRectangle *old_rect,
+                                  const MetaRectangle *new_rect)
+{
+  int i;
+
+  if (workspace->work_areas_invalid)
+    return;
+
+  for (i = 0; i < workspace->screen->n_monitor_infos; i++)
+    {
+      MetaFreeSpace *space = workspace->free_space[i];
+
+      if (space == NULL)
+        continue;
+
+      /* Obstacles can only be added to the free space; if one moved off
+       * part of it, compute it again when it's next needed.
+       */
+      if (old_rect &&
+          meta_rectangle_overlap (old_rect, &workspace->work_area_monitor[i]) &&
+          !(new_rect && meta_rectangle_contains_rect (new_rect, old_rect)))
+        meta_workspace_invalidate_free_space (workspace, i);
+      else if (new_rect)
+        meta_free_space_add_obstacle (space, new_rect);
+    }
+}
+
 #ifdef WITH_VERBOSE_MODE
 static char *
 meta_motion_direction_to_string (MetaMotionDirection direction)
@@ -947,22 +947,17 @@ latin1_to_utf8 (const char *text)
   return g_string_free (str, FALSE);
 }
 
-void
-meta_prop_get_values (MetaDisplay   *display,
-                      Window         xwindow,
-                      MetaPropValue *values,
-                      int            n_values)
+/* Sends GetProperty requests for all of @values without waiting for
+ * the replies; tasks[i] is left %NULL for values that aren't requested.
+ */
+static void
+start_value_tasks (MetaDisplay        *display,
+                   Window              xwindow,
+                   MetaPropValue      *values,
+                   int                 n_values,
+                   AgGetPropertyTask **tasks)
 {
   int i;
-  AgGetPropertyTask **tasks;
-
-  meta_verbose ("Requesting %d properties of 0x%lx at once\n",
-                n_values, xwindow);
-  
-  if (n_values == 0)
-    return;
-  
-  tasks = g_new0 (AgGetPropertyTask*, n_values);
 
   /* Start up tasks. The "values" array can have values
    * with atom == None, which means to ignore that element.
@@ -1025,13 +1020,21 @@ meta_prop_get_values (MetaDisplay   *display,
                              values[i].atom, values[i].required_type);
       
       ++i;
-    }  
-  
-  /* Get replies for all our tasks */
-  meta_topic (META_DEBUG_SYNC, "Syncing to get %d GetProperty replies in %s\n",
-              n_values, G_STRFUNC);
-  XSync (display->xdisplay, False);
-  
+    }
+}
+
+/* Collects the replies to the tasks started by start_value_tasks(). The
+ * replies must already have arrived and must be the next completed tasks.
+ */
+static void
+collect_value_replies (MetaDisplay        *display,
+                       Window              xwindow,
+                       MetaPropValue      *values,
+                       int                 n_values,
+                       AgGetPropertyTask **tasks)
+{
+  int i;
+
   /* Collect results, should arrive in order requested */
   i = 0;
   while (i < n_values)
@@ -1048,8 +1051,10 @@ meta_prop_get_values (MetaDisplay   *display,
           goto next;
         }
       
-      task = ag_get_next_completed_task (display->xdisplay);
-      g_assert (task != NULL);
+      /* Don't just take the next completed task; other async-getprop
+       * users such as the icon cache may have requests in flight too.
+       */
+      task = tasks[i];
       g_assert (ag_task_have_reply (task));
 
       results.display = display;
@@ -1184,6 +1189,91 @@ meta_prop_get_values (MetaDisplay   *display,
     next:
       ++i;
     }
+}
+
+void
+meta_prop_get_values (MetaDisplay   *display,
+                      Window         xwindow,
+                      MetaPropValue *values,
+                      int            n_values)
+{
+  AgGetPropertyTask **tasks;
+
+  meta_verbose ("Requesting %d properties of 0x%lx at once\n",
+                n_values, xwindow);
+  
+  if (n_values == 0)
+    return;
+  
+  tasks = g_new0 (AgGetPropertyTask*, n_values);
+
+  start_value_tasks (display, xwindow, values, n_values, tasks);
+
+  /* Get replies for all our tasks */
+  meta_topic (META_DEBUG_SYNC, "Syncing to get %d GetProperty replies in %s\n",
+              n_values, G_STRFUNC);
+  XSync (display->xdisplay, False);
+
+  collect_value_replies (display, xwindow, values, n_values, tasks);
+
+  g_free (tasks);
+}
+
+/**
+ * meta_prop_get_values_for_windows:
+ * @display: a #MetaDisplay
+ * @xwindows: the windows to get properties of
+ * @values: for each window, the values to get, as for meta_prop_get_values()
+ * @n_values: for each window, the number of elements of @values
+ * @n_windows: the number of windows
+ *
+ * Like meta_prop_get_values(), but for many windows at once. All requests
+ * are sent before waiting, so there is only a single round trip no matter
+ * how many windows and properties there are.
+ */
+void
+meta_prop_get_values_for_windows (MetaDisplay    *display,
+                                  const Window   *xwindows,
+                                  MetaPropValue **values,
+                                  const int      *n_values,
+                                  int             n_windows)
+{
+  AgGetPropertyTask ***tasks;
+  int total;
+  int i;
+
+  if (n_windows == 0)
+    return;
+
+  tasks = g_new0 (AgGetPropertyTask**, n_windows);
+
+  total = 0;
+  for (i = 0; i < n_windows; i++)
+    {
+      if (n_values[i] == 0)
+        continue;
+
+      tasks[i] = g_new0 (AgGetPropertyTask*, n_values[i]);
+      start_value_tasks (display, xwindows[i], values[i], n_values[i], tasks[i]);
+      total += n_values[i];
+    }
+
+  meta_verbose ("Requesting %d properties of %d windows at once\n",
+                total, n_windows);
+
+  meta_topic (META_DEBUG_SYNC, "Syncing to get %d GetProperty replies in %s\n",
+              total, G_STRFUNC);
+  XSync (display->xdisplay, False);
+
+  /* Replies arrive in the order the requests were sent */
+  for (i = 0; i < n_windows; i++)
+    {
+      if (tasks[i] == NULL)
+        continue;
+
+      collect_value_replies (display, xwindows[i], values[i], n_values[i], tasks[i]);
+      g_free (tasks[i]);
+    }
 
   g_free (tasks);
 }
@@ -217,6 +217,12 @@ void meta_prop_get_values (MetaDisplay   *display,
                            MetaPropValue *values,
                            int            n_values);
 
+void meta_prop_get_values_for_windows (MetaDisplay    *display,
+                                       const Window   *xwindows,
+                                       MetaPropValue **values,
+                                       const int      *n_values,
+                                       int             n_windows);
+
 void meta_prop_free_values (MetaPropValue *values,
                             int            n_values);
 
@@ -36,5 +36,14 @@ void      meta_error_trap_push_with_return (MetaDisplay *display);
 /* returns X error code, or 0 for no error */
 int       meta_error_trap_pop_with_return  (MetaDisplay *display);
 
+/* The same, with where it was called from, to report if it has to
+ * wait for the server; the macro below passes the caller's location.
+ */
+int       meta_error_trap_pop_with_return_at (MetaDisplay *display,
+                                              const char  *location);
+
+#define meta_error_trap_pop_with_return(display) \
+  meta_error_trap_pop_with_return_at ((display), G_STRLOC)
+
 
 #endif
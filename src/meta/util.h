@@ -156,6 +156,11 @@ guint meta_later_add    (MetaLaterType  when,
                          GDestroyNotify notify);
 void  meta_later_remove (guint          later_id);
 
+void  meta_later_get_stats (MetaLaterType  when,
+                            guint         *n_queued,
+                            guint         *n_run,
+                            gdouble       *time_ms);
+
 #endif /* META_UTIL_H */
 
 
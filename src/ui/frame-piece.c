@@ -0,0 +1,292 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Frame borders rendered once and stretched to any size */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <config.h>
+#include "frame-piece.h"
+
+static guint32
+image_pixel (cairo_surface_t *image,
+             int              x,
+             int              y)
+{
+  guchar *row = cairo_image_surface_get_data (image) +
+    y * cairo_image_surface_get_stride (image);
+
+  /* The top byte of RGB24 pixels is unused */
+  return ((guint32 *) row)[x] & 0xffffff;
+}
+
+static int
+image_length (cairo_surface_t *image,
+              gboolean         vertical)
+{
+  if (vertical)
+    return cairo_image_surface_get_height (image);
+  else
+    return cairo_image_surface_get_width (image);
+}
+
+/* Whether line a of one rendered border is the same as line b of
+ * another, lines being the columns of the top and bottom borders and
+ * the rows of the left and right ones
+ */
+static gboolean
+lines_equal (cairo_surface_t *image_a,
+             int              a,
+             cairo_surface_t *image_b,
+             int              b,
+             gboolean         vertical)
+{
+  int thickness = image_length (image_a, !vertical);
+  int i;
+
+  for (i = 0; i < thickness; i++)
+    {
+      if (vertical ?
+          image_pixel (image_a, i, a) != image_pixel (image_b, i, b) :
+          image_pixel (image_a, a, i) != image_pixel (image_b, b, i))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Finds the longest run of identical lines in a rendered border */
+void
+meta_frame_piece_find_middle (cairo_surface_t *image,
+                              gboolean         vertical,
+                              int             *start,
+                              int             *end)
+{
+  int length = image_length (image, vertical);
+  int run_start = 0;
+  int i;
+
+  cairo_surface_flush (image);
+
+  *start = 0;
+  *end = 0;
+
+  for (i = 1; i <= length; i++)
+    {
+      if (i < length && lines_equal (image, i - 1, image, i, vertical))
+        continue;
+
+      if (i - run_start > *end - *start)
+        {
+          *start = run_start;
+          *end = i;
+        }
+      run_start = i;
+    }
+}
+
+/* Whether a border rendered at a larger size is the one rendered at
+ * the original size with the middle line repeated
+ */
+gboolean
+meta_frame_piece_check_stretched (cairo_surface_t *image,
+                                  cairo_surface_t *stretched,
+                                  gboolean         vertical,
+                                  int              start,
+                                  int              end)
+{
+  int length = image_length (image, vertical);
+  int growth = image_length (stretched, vertical) - length;
+  int i;
+
+  cairo_surface_flush (image);
+  cairo_surface_flush (stretched);
+
+  for (i = 0; i < length + growth; i++)
+    {
+      int line;
+
+      if (i < start)
+        line = i;
+      else if (i < end + growth)
+        line = start;
+      else
+        line = i - growth;
+
+      if (!lines_equal (image, line, stretched, i, vertical))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static cairo_surface_t *
+copy_to_similar (cairo_surface_t *image,
+                 cairo_surface_t *similar,
+                 int              x,
+                 int              y,
+                 int              width,
+                 int              height,
+                 gsize           *size)
+{
+  cairo_surface_t *result;
+  cairo_t *cr;
+
+  if (width <= 0 || height <= 0)
+    return NULL;
+
+  result = cairo_surface_create_similar (similar, CAIRO_CONTENT_COLOR,
+                                         width, height);
+
+  cr = cairo_create (result);
+  cairo_set_source_surface (cr, image, -x, -y);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  *size += width * height * 4;
+
+  return result;
+}
+
+/* Splits a rendered border at the line it repeats across its middle,
+ * or keeps all of it as the start if it can't be stretched, copying
+ * the parts to surfaces like similar.  Returns the bytes of pixels the
+ * piece holds.
+ */
+gsize
+meta_frame_piece_init (MetaFramePiece  *piece,
+                       cairo_surface_t *image,
+                       cairo_surface_t *similar,
+                       gboolean         vertical,
+                       gboolean         stretches,
+                       int              start,
+                       int              end)
+{
+  int length = image_length (image, vertical);
+  int thickness = image_length (image, !vertical);
+  gsize size = 0;
+
+  if (!stretches)
+    {
+      start = length;
+      end = length;
+    }
+
+  piece->start_length = start;
+  piece->end_length = length - end;
+  piece->middle = NULL;
+
+  if (vertical)
+    {
+      piece->start = copy_to_similar (image, similar,
+                                      0, 0, thickness, start, &size);
+      if (end > start)
+        piece->middle = copy_to_similar (image, similar,
+                                         0, start, thickness, 1, &size);
+      piece->end = copy_to_similar (image, similar,
+                                    0, end, thickness, length - end, &size);
+    }
+  else
+    {
+      piece->start = copy_to_similar (image, similar,
+                                      0, 0, start, thickness, &size);
+      if (end > start)
+        piece->middle = copy_to_similar (image, similar,
+                                         start, 0, 1, thickness, &size);
+      piece->end = copy_to_similar (image, similar,
+                                    end, 0, length - end, thickness, &size);
+    }
+
+  return size;
+}
+
+void
+meta_frame_piece_clear (MetaFramePiece *piece)
+{
+  if (piece->start)
+    cairo_surface_destroy (piece->start);
+  if (piece->middle)
+    cairo_surface_destroy (piece->middle);
+  if (piece->end)
+    cairo_surface_destroy (piece->end);
+
+  piece->start = NULL;
+  piece->middle = NULL;
+  piece->end = NULL;
+}
+
+/* Whether the border can be drawn this long */
+gboolean
+meta_frame_piece_fits (const MetaFramePiece *piece,
+                       int                   length)
+{
+  return length >= piece->start_length + piece->end_length;
+}
+
+void
+meta_frame_piece_draw (const MetaFramePiece        *piece,
+                       cairo_t                     *cr,
+                       const cairo_rectangle_int_t *rect,
+                       gboolean                     vertical)
+{
+  int length = vertical ? rect->height : rect->width;
+  int end_offset = length - piece->end_length;
+
+  if (piece->start)
+    {
+      cairo_set_source_surface (cr, piece->start, rect->x, rect->y);
+      cairo_paint (cr);
+    }
+
+  if (piece->middle && end_offset > piece->start_length)
+    {
+      cairo_save (cr);
+
+      if (vertical)
+        {
+          cairo_set_source_surface (cr, piece->middle,
+                                    rect->x, rect->y + piece->start_length);
+          cairo_rectangle (cr,
+                           rect->x, rect->y + piece->start_length,
+                           rect->width, end_offset - piece->start_length);
+        }
+      else
+        {
+          cairo_set_source_surface (cr, piece->middle,
+                                    rect->x + piece->start_length, rect->y);
+          cairo_rectangle (cr,
+                           rect->x + piece->start_length, rect->y,
+                           end_offset - piece->start_length, rect->height);
+        }
+
+      cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_REPEAT);
+      cairo_fill (cr);
+
+      cairo_restore (cr);
+    }
+
+  if (piece->end)
+    {
+      if (vertical)
+        cairo_set_source_surface (cr, piece->end,
+                                  rect->x, rect->y + end_offset);
+      else
+        cairo_set_source_surface (cr, piece->end,
+                                  rect->x + end_offset, rect->y);
+      cairo_paint (cr);
+    }
+}
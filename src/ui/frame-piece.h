@@ -0,0 +1,69 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Frame borders rendered once and stretched to any size */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#ifndef META_FRAME_PIECE_H
+#define META_FRAME_PIECE_H
+
+#include <glib.h>
+#include <cairo.h>
+
+/* A rendered frame border, split into the part before its middle, a
+ * single column (or row, for the left and right borders) repeated
+ * across the middle, and the part after it.  Borders that can only be
+ * drawn at the size they were rendered at have no middle or end.
+ *
+ * Borders are rendered into CAIRO_FORMAT_RGB24 image surfaces to be
+ * compared, and kept in surfaces similar to the ones they're drawn to.
+ */
+typedef struct
+{
+  cairo_surface_t *start;
+  cairo_surface_t *middle;
+  cairo_surface_t *end;
+  int start_length;
+  int end_length;
+} MetaFramePiece;
+
+void     meta_frame_piece_find_middle     (cairo_surface_t             *image,
+                                           gboolean                     vertical,
+                                           int                         *start,
+                                           int                         *end);
+gboolean meta_frame_piece_check_stretched (cairo_surface_t             *image,
+                                           cairo_surface_t             *stretched,
+                                           gboolean                     vertical,
+                                           int                          start,
+                                           int                          end);
+
+gsize    meta_frame_piece_init            (MetaFramePiece              *piece,
+                                           cairo_surface_t             *image,
+                                           cairo_surface_t             *similar,
+                                           gboolean                     vertical,
+                                           gboolean                     stretches,
+                                           int                          start,
+                                           int                          end);
+void     meta_frame_piece_clear           (MetaFramePiece              *piece);
+gboolean meta_frame_piece_fits            (const MetaFramePiece        *piece,
+                                           int                          length);
+void     meta_frame_piece_draw            (const MetaFramePiece        *piece,
+                                           cairo_t                     *cr,
+                                           const cairo_rectangle_int_t *rect,
+                                           gboolean                     vertical);
+
+#endif /* META_FRAME_PIECE_H */
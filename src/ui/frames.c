@@ -28,6 +28,7 @@
 #include <string.h>
 #include <meta/boxes.h>
 #include "frames.h"
+#include "frame-piece.h"
 #include <meta/util.h>
 #include "core.h"
 #include "menu.h"
@@ -75,6 +76,10 @@ static void meta_frames_paint        (MetaFrames   *frames,
                                       MetaUIFrame  *frame,
                                       cairo_t      *cr);
 
+static void get_button_states (MetaFrames      *frames,
+                               MetaUIFrame     *frame,
+                               MetaButtonState  button_states[META_BUTTON_TYPE_LAST]);
+
 static void meta_frames_set_window_background (MetaFrames   *frames,
                                                MetaUIFrame  *frame);
 
@@ -105,6 +110,9 @@ static void invalidate_whole_window (MetaFrames *frames,
 
 G_DEFINE_TYPE (MetaFrames, meta_frames, GTK_TYPE_WINDOW);
 
+/* All the MetaFrames, whose caches have to go when the theme changes */
+static GSList *all_frames = NULL;
+
 static GObject *
 meta_frames_constructor (GType                  gtype,
                          guint                  n_properties,
@@ -256,6 +264,128 @@ update_style_contexts (MetaFrames *frames)
   g_list_free (variants);
 }
 
+/* The most memory the rendered frame borders and titles kept for reuse
+ * may take
+ */
+#define CACHE_BUDGET (4 * 1024 * 1024)
+
+typedef struct
+{
+  /* The frame whose title and icons are kept, with the rest of the key
+   * cleared, or NULL for borders
+   */
+  MetaUIFrame *frame;
+  MetaFrameStyle *style;
+  GtkStyleContext *style_context;
+  GdkVisual *visual;
+  MetaFrameType type;
+  MetaFrameFlags flags;
+  int text_height;
+  MetaButtonState button_states[META_BUTTON_TYPE_LAST];
+  /* The geometry with the sizes cleared, and the positions of the
+   * buttons on the right relative to the right edge, so that it is the
+   * same for frames of any size with the buttons laid out the same way
+   */
+  MetaFrameGeometry fgeom;
+  /* The client size the borders were rendered at, or -1 if they stretch
+   * to any size
+   */
+  int width;
+  int height;
+} CachedPixelsKey;
+
+typedef struct _CachedTitle CachedTitle;
+
+typedef struct
+{
+  /* Rendered borders are shared by all frames drawn the same way.  The
+   * title and icons, which differ between them, are left out, and drawn
+   * over the borders for each frame.
+   */
+
+  /* Order: top (titlebar), left, right, bottom. */
+  MetaFramePiece piece[4];
+
+  /* Or, kept under a frame's own key, the title and icons drawn over
+   * its borders
+   */
+  CachedTitle *title;
+
+  /* Bytes of pixels held */
+  gsize size;
+} CachedPixels;
+
+struct _CachedTitle
+{
+  /* What the title and icons were drawn for; unlike in the shared
+   * cache, the key holds the frame's own client size
+   */
+  CachedPixelsKey key;
+  PangoLayout *layout;
+  GdkPixbuf *mini_icon;
+  GdkPixbuf *icon;
+
+  /* The area of the frame around the title and the menu button, which
+   * usually shows the window's icon, fully drawn
+   */
+  cairo_surface_t *surface;
+  cairo_rectangle_int_t rect;
+};
+
+static void
+cached_title_free (CachedTitle *title)
+{
+  g_object_unref (title->layout);
+  if (title->mini_icon)
+    g_object_unref (title->mini_icon);
+  if (title->icon)
+    g_object_unref (title->icon);
+  if (title->surface)
+    cairo_surface_destroy (title->surface);
+
+  g_free (title);
+}
+
+static void
+cached_pixels_free (gpointer data)
+{
+  CachedPixels *pixels = data;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    meta_frame_piece_clear (&pixels->piece[i]);
+
+  if (pixels->title)
+    cached_title_free (pixels->title);
+
+  g_free (pixels);
+}
+
+static void
+title_key_init (MetaUIFrame     *frame,
+                CachedPixelsKey *key)
+{
+  memset (key, 0, sizeof (CachedPixelsKey));
+  key->frame = frame;
+}
+
+static void
+invalidate_cached_title (MetaFrames  *frames,
+                         MetaUIFrame *frame)
+{
+  CachedPixelsKey key;
+
+  title_key_init (frame, &key);
+  meta_lru_cache_remove (frames->cache, &key);
+}
+
+static void
+invalidate_all_caches (MetaFrames *frames)
+{
+  meta_lru_cache_clear (frames->cache);
+  g_hash_table_remove_all (frames->unstretchable_styles);
+}
+
 static void
 meta_frames_init (MetaFrames *frames)
 {
@@ -267,9 +397,10 @@ meta_frames_init (MetaFrames *frames)
 
   frames->expose_delay_count = 0;
 
-  frames->invalidate_cache_timeout_id = 0;
-  frames->invalidate_frames = NULL;
-  frames->cache = g_hash_table_new (g_direct_hash, g_direct_equal);
+  frames->cache = meta_lru_cache_new (sizeof (CachedPixelsKey), CACHE_BUDGET,
+                                      cached_pixels_free);
+  frames->unstretchable_styles = g_hash_table_new (NULL, NULL);
+  all_frames = g_slist_prepend (all_frames, frames);
 
   frames->style_variants = g_hash_table_new_full (g_str_hash, g_str_equal,
                                                   g_free, g_object_unref);
@@ -340,88 +471,16 @@ meta_frames_finalize (GObject *object)
   g_hash_table_destroy (frames->text_heights);
 
   invalidate_all_caches (frames);
-  if (frames->invalidate_cache_timeout_id)
-    g_source_remove (frames->invalidate_cache_timeout_id);
   
   g_assert (g_hash_table_size (frames->frames) == 0);
   g_hash_table_destroy (frames->frames);
-  g_hash_table_destroy (frames->cache);
+  meta_lru_cache_free (frames->cache);
+  g_hash_table_destroy (frames->unstretchable_styles);
+  all_frames = g_slist_remove (all_frames, frames);
 
   G_OBJECT_CLASS (meta_frames_parent_class)->finalize (object);
 }
 
-typedef struct
-{
-  cairo_rectangle_int_t rect;
-  cairo_surface_t *pixmap;
-} CachedFramePiece;
-
-typedef struct
-{
-  /* Caches of the four rendered sides in a MetaFrame.
-   * Order: top (titlebar), left, right, bottom.
-   */
-  CachedFramePiece piece[4];
-} CachedPixels;
-
-static CachedPixels *
-get_cache (MetaFrames *frames,
-           MetaUIFrame *frame)
-{
-  CachedPixels *pixels;
-  
-  pixels = g_hash_table_lookup (frames->cache, frame);
-
-  if (!pixels)
-    {
-      pixels = g_new0 (CachedPixels, 1);
-      g_hash_table_insert (frames->cache, frame, pixels);
-    }
-
-  return pixels;
-}
-
-static void
-invalidate_cache (MetaFrames *frames,
-                  MetaUIFrame *frame)
-{
-  CachedPixels *pixels = get_cache (frames, frame);
-  int i;
-  
-  for (i = 0; i < 4; i++)
-    if (pixels->piece[i].pixmap)
-      cairo_surface_destroy (pixels->piece[i].pixmap);
-  
-  g_free (pixels);
-  g_hash_table_remove (frames->cache, frame);
-}
-
-static void
-invalidate_all_caches (MetaFrames *frames)
-{
-  GList *l;
-
-  for (l = frames->invalidate_frames; l; l = l->next)
-    {
-      MetaUIFrame *frame = l->data;
-
-      invalidate_cache (frames, frame);
-    }
-  
-  g_list_free (frames->invalidate_frames);
-  frames->invalidate_frames = NULL;
-}
-
-static gboolean
-invalidate_cache_timeout (gpointer data)
-{
-  MetaFrames *frames = data;
-  
-  invalidate_all_caches (frames);
-  frames->invalidate_cache_timeout_id = 0;
-  return FALSE;
-}
-
 static void
 queue_recalc_func (gpointer key, gpointer value, gpointer data)
 {
@@ -513,6 +572,10 @@ meta_frames_style_updated  (GtkWidget *widget)
 
   meta_frames_font_changed (frames);
 
+  /* The cached borders refer to the old style contexts */
+  invalidate_all_caches (frames);
+  meta_draw_op_cache_clear ();
+
   update_style_contexts (frames);
 
   g_hash_table_foreach (frames->frames,
@@ -729,11 +792,6 @@ meta_frames_unmanage_window (MetaFrames *frames,
 
   if (frame)
     {
-      /* invalidating all caches ensures the frame
-       * is not actually referenced anymore
-       */
-      invalidate_all_caches (frames);
-      
       /* restore the cursor */
       meta_core_set_screen_cursor (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()),
                                    frame->xwindow,
@@ -755,6 +813,8 @@ meta_frames_unmanage_window (MetaFrames *frames,
 
       if (frame->title)
         g_free (frame->title);
+
+      invalidate_cached_title (frames, frame);
       
       g_free (frame);
     }
@@ -1284,7 +1344,6 @@ redraw_control (MetaFrames *frames,
   rect = control_rect (control, &fgeom);
 
   gdk_window_invalidate_rect (frame->window, rect, FALSE);
-  invalidate_cache (frames, frame);
 }
 
 static gboolean
@@ -2069,50 +2128,321 @@ setup_bg_cr (cairo_t *cr, GdkWindow *window, int x_offset, int y_offset)
     }
 }
 
-/* Returns a pixmap with a piece of the windows frame painted on it.
-*/
+/* How much larger than a frame its borders are rendered again, to check
+ * that they can be stretched
+ */
+#define STRETCH_CHECK_DELTA 64
+
+static gboolean
+piece_is_vertical (int i)
+{
+  /* The left and right borders */
+  return i == 1 || i == 2;
+}
+
+static void
+get_piece_rects (const MetaFrameBorders *borders,
+                 int                     width,
+                 int                     height,
+                 cairo_rectangle_int_t   rects[4])
+{
+  /* Setup the rectangles for the four visible frame borders. First top, then
+   * left, right and bottom. Top and bottom extend to the invisible borders
+   * while left and right snugly fit in between:
+   *   -----
+   *   |   |
+   *   -----
+   */
+
+  /* width and height refer to the client window's
+   * size without any border added. */
 
+  /* top */
+  rects[0].x = borders->invisible.left;
+  rects[0].y = borders->invisible.top;
+  rects[0].width = width + borders->visible.left + borders->visible.right;
+  rects[0].height = borders->visible.top;
+
+  /* left */
+  rects[1].x = borders->invisible.left;
+  rects[1].y = borders->total.top;
+  rects[1].height = height;
+  rects[1].width = borders->visible.left;
+
+  /* right */
+  rects[2].x = borders->total.left + width;
+  rects[2].y = borders->total.top;
+  rects[2].width = borders->visible.right;
+  rects[2].height = height;
+
+  /* bottom */
+  rects[3].x = borders->invisible.left;
+  rects[3].y = borders->total.top + height;
+  rects[3].width = width + borders->visible.left + borders->visible.right;
+  rects[3].height = borders->visible.bottom;
+}
+
+static void
+normalize_geometry (MetaFrameGeometry *fgeom)
+{
+  GdkRectangle *rects = (GdkRectangle *) ADDRESS_OF_BUTTON_RECTS (fgeom);
+  int n_rects = LENGTH_OF_BUTTON_RECTS / sizeof (GdkRectangle);
+  int i;
+
+  for (i = 0; i < n_rects; i++)
+    {
+      if (rects[i].width > 0 &&
+          rects[i].x + rects[i].width / 2 > fgeom->width / 2)
+        rects[i].x -= fgeom->width;
+    }
+
+  /* Keep the distance of the title from the right edge instead of
+   * its width
+   */
+  fgeom->title_rect.width =
+    fgeom->width - (fgeom->title_rect.x + fgeom->title_rect.width);
+
+  fgeom->width = 0;
+  fgeom->height = 0;
+}
+
+static void
+calc_normalized_geometry (const CachedPixelsKey *key,
+                          int                    width,
+                          int                    height,
+                          MetaFrameGeometry     *fgeom)
+{
+  MetaButtonLayout button_layout;
+
+  /* Keys are compared as bytes, so clear anything not set */
+  memset (fgeom, 0, sizeof (MetaFrameGeometry));
+
+  meta_prefs_get_button_layout (&button_layout);
+
+  meta_theme_calc_geometry (meta_theme_get_current (),
+                            key->type,
+                            key->text_height,
+                            key->flags,
+                            width, height,
+                            &button_layout,
+                            fgeom);
+  normalize_geometry (fgeom);
+}
+
+static void
+cached_pixels_key_init (MetaFrames      *frames,
+                        MetaUIFrame     *frame,
+                        MetaFrameType    type,
+                        MetaFrameFlags   flags,
+                        int              width,
+                        int              height,
+                        CachedPixelsKey *key)
+{
+  memset (key, 0, sizeof (CachedPixelsKey));
+
+  meta_frames_ensure_layout (frames, frame);
+
+  key->style = meta_theme_get_frame_style (meta_theme_get_current (),
+                                           type, flags);
+  key->style_context = frame->style;
+  key->visual = gdk_window_get_visual (frame->window);
+  key->type = type;
+  key->flags = flags;
+  key->text_height = frame->text_height;
+  get_button_states (frames, frame, key->button_states);
+
+  calc_normalized_geometry (key, width, height, &key->fgeom);
+
+  key->width = width;
+  key->height = height;
+}
+
+/* Renders a border of a frame drawn as the key says, without a title
+ * or icons, at the given client size
+ */
 static cairo_surface_t *
-generate_pixmap (MetaFrames            *frames,
-                 MetaUIFrame           *frame,
-                 cairo_rectangle_int_t *rect)
+render_piece (MetaFrames            *frames,
+              MetaUIFrame           *frame,
+              const CachedPixelsKey *key,
+              int                    width,
+              int                    height,
+              cairo_rectangle_int_t *rect)
 {
+  MetaButtonState button_states[META_BUTTON_TYPE_LAST];
+  MetaButtonLayout button_layout;
   cairo_surface_t *result;
   cairo_t *cr;
 
-  /* do not create a pixmap for nonexisting areas */
+  /* do not create a surface for nonexisting areas */
   if (rect->width <= 0 || rect->height <= 0)
     return NULL;
 
-  result = gdk_window_create_similar_surface (frame->window,
-                                              CAIRO_CONTENT_COLOR,
-                                              rect->width, rect->height);
-  
+  result = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                       rect->width, rect->height);
+
   cr = cairo_create (result);
   cairo_translate (cr, -rect->x, -rect->y);
 
   setup_bg_cr (cr, frame->window, 0, 0);
   cairo_paint (cr);
 
-  meta_frames_paint (frames, frame, cr);
+  memcpy (button_states, key->button_states, sizeof (button_states));
+  meta_prefs_get_button_layout (&button_layout);
+
+  meta_theme_draw_frame_with_style (meta_theme_get_current (),
+                                    key->style_context,
+                                    GTK_WIDGET (frames),
+                                    cr,
+                                    key->type,
+                                    key->flags,
+                                    width, height,
+                                    NULL,
+                                    key->text_height,
+                                    &button_layout,
+                                    button_states,
+                                    NULL, NULL);
 
   cairo_destroy (cr);
 
   return result;
 }
 
+/* Renders the borders of a frame drawn as the key says, at the client
+ * size in the key, and if check_stretch is set, whether they stretch
+ */
+static CachedPixels *
+render_cached_pixels (MetaFrames            *frames,
+                      MetaUIFrame           *frame,
+                      const CachedPixelsKey *key,
+                      gboolean               check_stretch,
+                      gboolean              *stretches)
+{
+  CachedPixels *pixels;
+  MetaFrameGeometry stretched_fgeom;
+  cairo_surface_t *similar;
+  cairo_surface_t *images[4];
+  cairo_rectangle_int_t rects[4], stretched_rects[4];
+  int starts[4], ends[4];
+  int stretched_width, stretched_height;
+  int i;
 
-static void
-populate_cache (MetaFrames *frames,
-                MetaUIFrame *frame)
+  get_piece_rects (&key->fgeom.borders, key->width, key->height, rects);
+
+  for (i = 0; i < 4; i++)
+    {
+      images[i] = render_piece (frames, frame, key,
+                                key->width, key->height, &rects[i]);
+      starts[i] = 0;
+      ends[i] = 0;
+    }
+
+  /* Most themes draw the middle of each border the same all along, so
+   * a frame of any size can be drawn by repeating a line of it.  Make
+   * sure by rendering the borders larger and comparing; only the
+   * middle of the titlebar could differ, and that holds the title,
+   * which is drawn for each frame anyway.
+   */
+  stretched_width = key->width + STRETCH_CHECK_DELTA;
+  stretched_height = key->height + STRETCH_CHECK_DELTA;
+
+  *stretches = FALSE;
+  if (check_stretch)
+    {
+      calc_normalized_geometry (key, stretched_width, stretched_height,
+                                &stretched_fgeom);
+      *stretches = memcmp (&stretched_fgeom, &key->fgeom,
+                           sizeof (MetaFrameGeometry)) == 0;
+    }
+
+  get_piece_rects (&key->fgeom.borders, stretched_width, stretched_height,
+                   stretched_rects);
+
+  for (i = 0; i < 4 && *stretches; i++)
+    {
+      gboolean vertical = piece_is_vertical (i);
+      cairo_surface_t *stretched;
+
+      stretched = render_piece (frames, frame, key,
+                                stretched_width, stretched_height,
+                                &stretched_rects[i]);
+
+      if (images[i] == NULL || stretched == NULL)
+        {
+          /* Only fine if the border is never drawn */
+          *stretches = images[i] == stretched;
+        }
+      else
+        {
+          meta_frame_piece_find_middle (images[i], vertical,
+                                        &starts[i], &ends[i]);
+          *stretches = meta_frame_piece_check_stretched (images[i], stretched,
+                                                         vertical,
+                                                         starts[i], ends[i]);
+        }
+
+      if (stretched)
+        cairo_surface_destroy (stretched);
+    }
+
+  pixels = g_new0 (CachedPixels, 1);
+
+  /* The pieces are kept in surfaces like the frame's, so drawing them
+   * is a copy on the server
+   */
+  similar = gdk_window_create_similar_surface (frame->window,
+                                               CAIRO_CONTENT_COLOR, 1, 1);
+
+  for (i = 0; i < 4; i++)
+    {
+      if (images[i] == NULL)
+        continue;
+
+      pixels->size += meta_frame_piece_init (&pixels->piece[i], images[i],
+                                             similar, piece_is_vertical (i),
+                                             *stretches, starts[i], ends[i]);
+      cairo_surface_destroy (images[i]);
+    }
+
+  cairo_surface_destroy (similar);
+
+  return pixels;
+}
+
+/* Whether the borders can be drawn in the given rectangles */
+static gboolean
+cached_pixels_fit (CachedPixels                *pixels,
+                   const cairo_rectangle_int_t  rects[4])
 {
-  MetaFrameBorders borders;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    {
+      int length = piece_is_vertical (i) ? rects[i].height : rects[i].width;
+
+      if (!meta_frame_piece_fits (&pixels->piece[i], length))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Gets the rendered borders to draw a frame with, rendering them if no
+ * frame drawn the same way has been recently, and where they go; key
+ * is set to how the frame is drawn, at its own client size.  Returns
+ * NULL for frames too large to keep borders for.
+ */
+static CachedPixels *
+get_cache (MetaFrames            *frames,
+           MetaUIFrame           *frame,
+           CachedPixelsKey       *key,
+           cairo_rectangle_int_t  rects[4])
+{
+  CachedPixels *pixels, *stretched_pixels;
   int width, height;
   int frame_width, frame_height, screen_width, screen_height;
-  CachedPixels *pixels;
   MetaFrameType frame_type;
   MetaFrameFlags frame_flags;
-  int i;
+  gboolean check_stretch, stretches;
 
   meta_core_get (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()),
                  frame->xwindow,
@@ -2130,69 +2460,131 @@ populate_cache (MetaFrames *frames,
   if (frame_width > 2 * screen_width ||
       frame_height > 2 * screen_height)
     {
-      return;
+      return NULL;
     }
-  
-  meta_theme_get_frame_borders (meta_theme_get_current (),
-                                frame_type,
-                                frame->text_height,
-                                frame_flags,
-                                &borders);
 
-  pixels = get_cache (frames, frame);
+  cached_pixels_key_init (frames, frame, frame_type, frame_flags,
+                          width, height, key);
 
-  /* Setup the rectangles for the four visible frame borders. First top, then
-   * left, right and bottom. Top and bottom extend to the invisible borders
-   * while left and right snugly fit in between:
-   *   -----
-   *   |   |
-   *   -----
+  get_piece_rects (&key->fgeom.borders, width, height, rects);
+
+  /* Borders that stretch to any size, or else ones rendered at this size */
+  key->width = -1;
+  key->height = -1;
+  stretched_pixels = meta_lru_cache_lookup (frames->cache, key);
+
+  key->width = width;
+  key->height = height;
+
+  if (stretched_pixels && cached_pixels_fit (stretched_pixels, rects))
+    return stretched_pixels;
+
+  pixels = meta_lru_cache_lookup (frames->cache, key);
+  if (pixels)
+    return pixels;
+
+  /* Rendering the borders again larger is wasted on styles that have
+   * failed to stretch before; they would render twice every resize step
    */
+  check_stretch = g_hash_table_lookup (frames->unstretchable_styles,
+                                       key->style) == NULL;
 
-  /* width and height refer to the client window's
-   * size without any border added. */
+  pixels = render_cached_pixels (frames, frame, key, check_stretch,
+                                 &stretches);
 
-  /* top */
-  pixels->piece[0].rect.x = borders.invisible.left;
-  pixels->piece[0].rect.y = borders.invisible.top;
-  pixels->piece[0].rect.width = width + borders.visible.left + borders.visible.right;
-  pixels->piece[0].rect.height = borders.visible.top;
+  /* Unless borders that don't fit this frame are there already */
+  if (stretches && stretched_pixels == NULL)
+    {
+      key->width = -1;
+      key->height = -1;
+    }
+  else if (!stretches && check_stretch)
+    {
+      g_hash_table_insert (frames->unstretchable_styles,
+                           key->style, key->style);
+    }
 
-  /* left */
-  pixels->piece[1].rect.x = borders.invisible.left;
-  pixels->piece[1].rect.y = borders.total.top;
-  pixels->piece[1].rect.height = height;
-  pixels->piece[1].rect.width = borders.visible.left;
+  meta_lru_cache_insert (frames->cache, key, pixels, pixels->size);
 
-  /* right */
-  pixels->piece[2].rect.x = borders.total.left + width;
-  pixels->piece[2].rect.y = borders.total.top;
-  pixels->piece[2].rect.width = borders.visible.right;
-  pixels->piece[2].rect.height = height;
+  key->width = width;
+  key->height = height;
 
-  /* bottom */
-  pixels->piece[3].rect.x = borders.invisible.left;
-  pixels->piece[3].rect.y = borders.total.top + height;
-  pixels->piece[3].rect.width = width + borders.visible.left + borders.visible.right;
-  pixels->piece[3].rect.height = borders.visible.bottom;
+  return pixels;
+}
 
-  for (i = 0; i < 4; i++)
+/* Gets the title and icons of a frame drawn as the key says, drawing
+ * them again only if they, the frame's size or how it is drawn changed
+ */
+static CachedTitle *
+get_cached_title (MetaFrames            *frames,
+                  MetaUIFrame           *frame,
+                  const CachedPixelsKey *key)
+{
+  CachedPixelsKey title_key;
+  CachedPixels *pixels;
+  CachedTitle *title;
+  MetaFrameGeometry fgeom;
+  GdkPixbuf *mini_icon;
+  GdkPixbuf *icon;
+  cairo_region_t *area;
+  cairo_t *cr;
+
+  meta_core_get (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()),
+                 frame->xwindow,
+                 META_CORE_GET_MINI_ICON, &mini_icon,
+                 META_CORE_GET_ICON, &icon,
+                 META_CORE_GET_END);
+
+  /* The layout is made again whenever the title or font changes, and
+   * we hold references, so comparing pointers is enough
+   */
+  title_key_init (frame, &title_key);
+  pixels = meta_lru_cache_lookup (frames->cache, &title_key);
+  if (pixels &&
+      pixels->title->layout == frame->layout &&
+      pixels->title->mini_icon == mini_icon &&
+      pixels->title->icon == icon &&
+      memcmp (&pixels->title->key, key, sizeof (CachedPixelsKey)) == 0)
+    return pixels->title;
+
+  title = g_new0 (CachedTitle, 1);
+  memcpy (&title->key, key, sizeof (CachedPixelsKey));
+  title->layout = g_object_ref (frame->layout);
+  title->mini_icon = mini_icon ? g_object_ref (mini_icon) : NULL;
+  title->icon = icon ? g_object_ref (icon) : NULL;
+
+  meta_frames_calc_geometry (frames, frame, &fgeom);
+
+  area = cairo_region_create_rectangle (&fgeom.title_rect);
+  cairo_region_union_rectangle (area, &fgeom.menu_rect.visible);
+  cairo_region_get_extents (area, &title->rect);
+  cairo_region_destroy (area);
+
+  if (title->rect.width > 0 && title->rect.height > 0)
     {
-      CachedFramePiece *piece = &pixels->piece[i];
-      /* generate_pixmap() returns NULL for 0 width/height pieces, but
-       * does so cheaply so we don't need to cache the NULL return */
-      if (!piece->pixmap)
-        piece->pixmap = generate_pixmap (frames, frame, &piece->rect);
+      title->surface = gdk_window_create_similar_surface (frame->window,
+                                                          CAIRO_CONTENT_COLOR,
+                                                          title->rect.width,
+                                                          title->rect.height);
+
+      cr = cairo_create (title->surface);
+      cairo_translate (cr, -title->rect.x, -title->rect.y);
+
+      setup_bg_cr (cr, frame->window, 0, 0);
+      cairo_paint (cr);
+
+      meta_frames_paint (frames, frame, cr);
+
+      cairo_destroy (cr);
     }
-  
-  if (frames->invalidate_cache_timeout_id)
-    g_source_remove (frames->invalidate_cache_timeout_id);
-  
-  frames->invalidate_cache_timeout_id = g_timeout_add (1000, invalidate_cache_timeout, frames);
 
-  if (!g_list_find (frames->invalidate_frames, frame))
-    frames->invalidate_frames =
-      g_list_prepend (frames->invalidate_frames, frame);
+  /* Replaces the frame's previous title */
+  pixels = g_new0 (CachedPixels, 1);
+  pixels->title = title;
+  pixels->size = title->rect.width * title->rect.height * 4;
+  meta_lru_cache_insert (frames->cache, &title_key, pixels, pixels->size);
+
+  return title;
 }
 
 static void
@@ -2262,40 +2654,51 @@ subtract_client_area (cairo_region_t *region,
 }
 
 static void
-cached_pixels_draw (CachedPixels   *pixels,
-                    cairo_t        *cr,
-                    cairo_region_t *region)
+cached_pixels_draw (CachedPixels                *pixels,
+                    cairo_t                     *cr,
+                    cairo_region_t              *region,
+                    const cairo_rectangle_int_t  rects[4])
 {
-  cairo_region_t *region_piece;
   int i;
 
   for (i = 0; i < 4; i++)
     {
-      CachedFramePiece *piece;
-      piece = &pixels->piece[i];
-      
-      if (piece->pixmap)
+      MetaFramePiece *piece = &pixels->piece[i];
+
+      if (piece->start || piece->middle || piece->end)
         {
-          cairo_set_source_surface (cr, piece->pixmap,
-                                    piece->rect.x, piece->rect.y);
-          cairo_paint (cr);
-          
-          region_piece = cairo_region_create_rectangle (&piece->rect);
-          cairo_region_subtract (region, region_piece);
-          cairo_region_destroy (region_piece);
+          meta_frame_piece_draw (piece, cr, &rects[i],
+                                 piece_is_vertical (i));
+          cairo_region_subtract_rectangle (region, &rects[i]);
         }
     }
 }
 
+static void
+cached_title_draw (CachedTitle *title,
+                   cairo_t     *cr)
+{
+  if (title->surface == NULL)
+    return;
+
+  cairo_set_source_surface (cr, title->surface,
+                            title->rect.x, title->rect.y);
+  cairo_rectangle (cr, title->rect.x, title->rect.y,
+                   title->rect.width, title->rect.height);
+  cairo_fill (cr);
+}
+
 static gboolean
 meta_frames_draw (GtkWidget *widget,
                   cairo_t   *cr)
 {
   MetaUIFrame *frame;
   MetaFrames *frames;
+  CachedPixelsKey key;
   CachedPixels *pixels;
   cairo_region_t *region;
   cairo_rectangle_int_t clip;
+  cairo_rectangle_int_t rects[4];
   int i, n_areas;
   cairo_surface_t *target;
 
@@ -2315,13 +2718,18 @@ meta_frames_draw (GtkWidget *widget,
       return TRUE;
     }
 
-  populate_cache (frames, frame);
+  pixels = get_cache (frames, frame, &key, rects);
 
   region = cairo_region_create_rectangle (&clip);
-  
-  pixels = get_cache (frames, frame);
 
-  cached_pixels_draw (pixels, cr, region);
+  if (pixels)
+    {
+      /* Getting the title may push the borders out of the cache, so
+       * they have to be drawn first
+       */
+      cached_pixels_draw (pixels, cr, region, rects);
+      cached_title_draw (get_cached_title (frames, frame, &key), cr);
+    }
   
   clip_to_screen (region, frame);
   subtract_client_area (region, frame);
@@ -2355,24 +2763,15 @@ meta_frames_draw (GtkWidget *widget,
 }
 
 static void
-meta_frames_paint (MetaFrames   *frames,
-                   MetaUIFrame  *frame,
-                   cairo_t      *cr)
+get_button_states (MetaFrames      *frames,
+                   MetaUIFrame     *frame,
+                   MetaButtonState  button_states[META_BUTTON_TYPE_LAST])
 {
-  GtkWidget *widget;
-  MetaFrameFlags flags;
-  MetaFrameType type;
-  GdkPixbuf *mini_icon;
-  GdkPixbuf *icon;
-  int w, h;
-  MetaButtonState button_states[META_BUTTON_TYPE_LAST];
   Window grab_frame;
-  int i;
-  MetaButtonLayout button_layout;
   MetaGrabOp grab_op;
   Display *display;
-  
-  widget = GTK_WIDGET (frames);
+  int i;
+
   display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
 
   for (i = 0; i < META_BUTTON_TYPE_LAST; i++)
@@ -2455,7 +2854,28 @@ meta_frames_paint (MetaFrames   *frames,
     default:
       break;
     }
+}
+
+static void
+meta_frames_paint (MetaFrames   *frames,
+                   MetaUIFrame  *frame,
+                   cairo_t      *cr)
+{
+  GtkWidget *widget;
+  MetaFrameFlags flags;
+  MetaFrameType type;
+  GdkPixbuf *mini_icon;
+  GdkPixbuf *icon;
+  int w, h;
+  MetaButtonState button_states[META_BUTTON_TYPE_LAST];
+  MetaButtonLayout button_layout;
+  Display *display;
   
+  widget = GTK_WIDGET (frames);
+  display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+
+  get_button_states (frames, frame, button_states);
+
   meta_core_get (display, frame->xwindow,
                  META_CORE_GET_FRAME_FLAGS, &flags,
                  META_CORE_GET_FRAME_TYPE, &type,
@@ -2832,10 +3252,21 @@ meta_frames_pop_delay_exposes  (MetaFrames *frames)
     }
 }
 
+/* Drops the borders and titles rendered with the previous theme; the
+ * frame styles in their keys belonged to it, and may have been freed
+ */
+void
+meta_frames_theme_changed (void)
+{
+  GSList *tmp;
+
+  for (tmp = all_frames; tmp != NULL; tmp = tmp->next)
+    invalidate_all_caches (tmp->data);
+}
+
 static void
 invalidate_whole_window (MetaFrames *frames,
                          MetaUIFrame *frame)
 {
   gdk_window_invalidate_rect (frame->window, NULL, FALSE);
-  invalidate_cache (frames, frame);
 }
@@ -28,6 +28,7 @@
 #include <gdk/gdkx.h>
 #include <meta/common.h>
 #include "theme-private.h"
+#include "lru-cache.h"
 
 typedef enum
 {
@@ -103,9 +104,12 @@ struct _MetaFrames
 
   int expose_delay_count;
 
-  int invalidate_cache_timeout_id;
-  GList *invalidate_frames;
-  GHashTable *cache;
+  /* Rendered borders shared by frames drawn the same way, and the
+   * titles of single frames
+   */
+  MetaLruCache *cache;
+  /* Frame styles whose borders didn't stretch when last checked */
+  GHashTable *unstretchable_styles;
 };
 
 struct _MetaFramesClass
@@ -172,4 +176,6 @@ Window meta_frames_get_moving_frame (MetaFrames *frames);
 void meta_frames_push_delay_exposes (MetaFrames *frames);
 void meta_frames_pop_delay_exposes  (MetaFrames *frames);
 
+void meta_frames_theme_changed (void);
+
 #endif
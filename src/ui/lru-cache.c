@@ -0,0 +1,191 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Least recently used caches of rendered pixels */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <config.h>
+#include "lru-cache.h"
+#include <string.h>
+
+struct _MetaLruCache
+{
+  gsize key_size;
+  gsize max_size;
+  gsize size;
+  GDestroyNotify value_destroy;
+
+  GHashTable *entries;
+  /* The entries, most recently used first */
+  GQueue lru;
+};
+
+typedef struct
+{
+  /* The hash table only hands entries to its functions, so they need
+   * to know the key size
+   */
+  MetaLruCache *cache;
+  gconstpointer key;
+  gpointer value;
+  gsize size;
+  GList link;
+} MetaLruEntry;
+
+static guint
+entry_hash (gconstpointer data)
+{
+  const MetaLruEntry *entry = data;
+  const guchar *bytes = entry->key;
+  guint hash = 5381;
+  gsize i;
+
+  for (i = 0; i < entry->cache->key_size; i++)
+    hash = hash * 33 + bytes[i];
+
+  return hash;
+}
+
+static gboolean
+entry_equal (gconstpointer a,
+             gconstpointer b)
+{
+  const MetaLruEntry *entry_a = a;
+  const MetaLruEntry *entry_b = b;
+
+  return memcmp (entry_a->key, entry_b->key, entry_a->cache->key_size) == 0;
+}
+
+static void
+remove_entry (MetaLruCache *cache,
+              MetaLruEntry *entry)
+{
+  g_hash_table_remove (cache->entries, entry);
+  g_queue_unlink (&cache->lru, &entry->link);
+  cache->size -= entry->size;
+
+  if (cache->value_destroy)
+    cache->value_destroy (entry->value);
+
+  g_free (entry);
+}
+
+/* Creates a cache for keys of key_size bytes, holding values up to
+ * max_size in total
+ */
+MetaLruCache *
+meta_lru_cache_new (gsize          key_size,
+                    gsize          max_size,
+                    GDestroyNotify value_destroy)
+{
+  MetaLruCache *cache;
+
+  cache = g_new0 (MetaLruCache, 1);
+  cache->key_size = key_size;
+  cache->max_size = max_size;
+  cache->value_destroy = value_destroy;
+  cache->entries = g_hash_table_new (entry_hash, entry_equal);
+  g_queue_init (&cache->lru);
+
+  return cache;
+}
+
+void
+meta_lru_cache_free (MetaLruCache *cache)
+{
+  meta_lru_cache_clear (cache);
+  g_hash_table_destroy (cache->entries);
+  g_free (cache);
+}
+
+/* Returns the value for key, marking it as the most recently used, or
+ * NULL if it isn't there
+ */
+gpointer
+meta_lru_cache_lookup (MetaLruCache  *cache,
+                       gconstpointer  key)
+{
+  MetaLruEntry probe;
+  MetaLruEntry *entry;
+
+  probe.cache = cache;
+  probe.key = key;
+
+  entry = g_hash_table_lookup (cache->entries, &probe);
+  if (entry == NULL)
+    return NULL;
+
+  g_queue_unlink (&cache->lru, &entry->link);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+
+  return entry->value;
+}
+
+/* Adds a value of the given size for key, replacing any there already,
+ * then drops the least recently used other values over the budget
+ */
+void
+meta_lru_cache_insert (MetaLruCache  *cache,
+                       gconstpointer  key,
+                       gpointer       value,
+                       gsize          size)
+{
+  MetaLruEntry *entry;
+
+  entry = g_malloc (sizeof (MetaLruEntry) + cache->key_size);
+  entry->cache = cache;
+  entry->key = entry + 1;
+  memcpy (entry + 1, key, cache->key_size);
+  entry->value = value;
+  entry->size = size;
+  entry->link.data = entry;
+  entry->link.prev = NULL;
+  entry->link.next = NULL;
+
+  meta_lru_cache_remove (cache, key);
+
+  g_hash_table_insert (cache->entries, entry, entry);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+  cache->size += size;
+
+  while (cache->size > cache->max_size &&
+         g_queue_peek_tail (&cache->lru) != entry)
+    remove_entry (cache, g_queue_peek_tail (&cache->lru));
+}
+
+void
+meta_lru_cache_remove (MetaLruCache  *cache,
+                       gconstpointer  key)
+{
+  if (meta_lru_cache_lookup (cache, key) != NULL)
+    remove_entry (cache, g_queue_peek_head (&cache->lru));
+}
+
+void
+meta_lru_cache_clear (MetaLruCache *cache)
+{
+  while (!g_queue_is_empty (&cache->lru))
+    remove_entry (cache, g_queue_peek_head (&cache->lru));
+}
+
+/* Returns the total size of the values held */
+gsize
+meta_lru_cache_get_size (MetaLruCache *cache)
+{
+  return cache->size;
+}
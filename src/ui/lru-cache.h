@@ -0,0 +1,48 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Least recently used caches of rendered pixels */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#ifndef META_LRU_CACHE_H
+#define META_LRU_CACHE_H
+
+#include <glib.h>
+
+/* Keys are fixed-size structs compared as bytes, so their users have
+ * to clear them, padding included, before filling them in.  Values
+ * are dropped, least recently used first, once their sizes add up to
+ * more than the cache's budget.
+ */
+typedef struct _MetaLruCache MetaLruCache;
+
+MetaLruCache *meta_lru_cache_new      (gsize           key_size,
+                                       gsize           max_size,
+                                       GDestroyNotify  value_destroy);
+void          meta_lru_cache_free     (MetaLruCache   *cache);
+gpointer      meta_lru_cache_lookup   (MetaLruCache   *cache,
+                                       gconstpointer   key);
+void          meta_lru_cache_insert   (MetaLruCache   *cache,
+                                       gconstpointer   key,
+                                       gpointer        value,
+                                       gsize           size);
+void          meta_lru_cache_remove   (MetaLruCache   *cache,
+                                       gconstpointer   key);
+void          meta_lru_cache_clear    (MetaLruCache   *cache);
+gsize         meta_lru_cache_get_size (MetaLruCache   *cache);
+
+#endif /* META_LRU_CACHE_H */
@@ -0,0 +1,274 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Mutter frame border stretching test program */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "frame-piece.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* How much larger the frames check borders at, as in frames.c */
+#define STRETCH_CHECK_DELTA 64
+
+#define BORDER_LENGTH 200
+#define BORDER_THICKNESS 9
+
+typedef enum
+{
+  /* Shaded across, with corners and buttons at the ends */
+  BORDER_BEVELED,
+  /* Shaded along, so no two lines are alike */
+  BORDER_GRADIENT,
+  /* With a mark halfway along, like a centered title */
+  BORDER_CENTERED
+} BorderKind;
+
+static const char *kind_names[] = {
+  "beveled", "gradient", "centered"
+};
+
+/* Fills a rectangle given along and across the border */
+static void
+fill_lines (cairo_t  *cr,
+            gboolean  vertical,
+            int       along,
+            int       across,
+            int       along_length,
+            int       across_length)
+{
+  if (vertical)
+    cairo_rectangle (cr, across, along, across_length, along_length);
+  else
+    cairo_rectangle (cr, along, across, along_length, across_length);
+  cairo_fill (cr);
+}
+
+/* Renders a border of the given kind at the given length, the way a
+ * theme would draw it
+ */
+static cairo_surface_t *
+render_border (BorderKind kind,
+               gboolean   vertical,
+               int        length)
+{
+  cairo_surface_t *image;
+  cairo_t *cr;
+  int i;
+
+  if (vertical)
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                        BORDER_THICKNESS, length);
+  else
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                        length, BORDER_THICKNESS);
+
+  cr = cairo_create (image);
+
+  for (i = 0; i < BORDER_THICKNESS; i++)
+    {
+      cairo_set_source_rgb (cr, 0.3 + i * 0.05, 0.4, 0.6 - i * 0.05);
+      fill_lines (cr, vertical, 0, i, length, 1);
+    }
+
+  /* A rounded corner at the start, a corner and two buttons kept at the
+   * same distance from the end
+   */
+  cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
+  for (i = 0; i < 4; i++)
+    fill_lines (cr, vertical, 0, i, 4 - i, 1);
+  fill_lines (cr, vertical, length - 3, 0, 3, BORDER_THICKNESS);
+
+  cairo_set_source_rgb (cr, 0.9, 0.2, 0.2);
+  fill_lines (cr, vertical, length - 12, 2, 6, 5);
+  cairo_set_source_rgb (cr, 0.2, 0.9, 0.2);
+  fill_lines (cr, vertical, length - 22, 2, 6, 5);
+
+  switch (kind)
+    {
+    case BORDER_BEVELED:
+      break;
+
+    case BORDER_GRADIENT:
+      for (i = 4; i < length - 22; i++)
+        {
+          cairo_set_source_rgb (cr, i / (double) length, 0.5, 0.5);
+          fill_lines (cr, vertical, i, 0, 1, 1);
+        }
+      break;
+
+    case BORDER_CENTERED:
+      cairo_set_source_rgb (cr, 1.0, 1.0, 1.0);
+      fill_lines (cr, vertical, length / 2 - 5, 3, 10, 3);
+      break;
+    }
+
+  cairo_destroy (cr);
+  cairo_surface_flush (image);
+
+  return image;
+}
+
+static gboolean
+images_equal (cairo_surface_t *a,
+              cairo_surface_t *b)
+{
+  int width = cairo_image_surface_get_width (a);
+  int height = cairo_image_surface_get_height (a);
+  int x, y;
+
+  if (width != cairo_image_surface_get_width (b) ||
+      height != cairo_image_surface_get_height (b))
+    return FALSE;
+
+  for (y = 0; y < height; y++)
+    {
+      guint32 *row_a = (guint32 *) (cairo_image_surface_get_data (a) +
+                                    y * cairo_image_surface_get_stride (a));
+      guint32 *row_b = (guint32 *) (cairo_image_surface_get_data (b) +
+                                    y * cairo_image_surface_get_stride (b));
+
+      /* The top byte of RGB24 pixels is unused */
+      for (x = 0; x < width; x++)
+        if ((row_a[x] & 0xffffff) != (row_b[x] & 0xffffff))
+          return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Draws the piece at the given length, as the frames draw it over a
+ * frame of another size than it was rendered at
+ */
+static cairo_surface_t *
+draw_piece (const MetaFramePiece *piece,
+            gboolean              vertical,
+            int                   length)
+{
+  cairo_surface_t *image;
+  cairo_rectangle_int_t rect;
+  cairo_t *cr;
+
+  rect.x = 0;
+  rect.y = 0;
+  rect.width = vertical ? BORDER_THICKNESS : length;
+  rect.height = vertical ? length : BORDER_THICKNESS;
+
+  image = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                      rect.width, rect.height);
+
+  cr = cairo_create (image);
+  meta_frame_piece_draw (piece, cr, &rect, vertical);
+  cairo_destroy (cr);
+  cairo_surface_flush (image);
+
+  return image;
+}
+
+static void
+check_drawn_at (const MetaFramePiece *piece,
+                BorderKind            kind,
+                gboolean              vertical,
+                int                   length)
+{
+  cairo_surface_t *drawn, *expected;
+
+  drawn = draw_piece (piece, vertical, length);
+  expected = render_border (kind, vertical, length);
+
+  if (!images_equal (drawn, expected))
+    {
+      g_printerr ("%s %s border rendered at %d and drawn at %d differs "
+                  "from one rendered at %d\n",
+                  kind_names[kind], vertical ? "vertical" : "horizontal",
+                  BORDER_LENGTH, length, length);
+      exit (1);
+    }
+
+  cairo_surface_destroy (drawn);
+  cairo_surface_destroy (expected);
+}
+
+static void
+check_border (BorderKind kind,
+              gboolean   vertical,
+              gboolean   should_stretch)
+{
+  static const int deltas[] = { -1, 0, 1, 13, STRETCH_CHECK_DELTA, 257 };
+  cairo_surface_t *image, *stretched;
+  MetaFramePiece piece;
+  gboolean stretches;
+  int start, end;
+  guint i;
+
+  image = render_border (kind, vertical, BORDER_LENGTH);
+  stretched = render_border (kind, vertical,
+                             BORDER_LENGTH + STRETCH_CHECK_DELTA);
+
+  meta_frame_piece_find_middle (image, vertical, &start, &end);
+  stretches = meta_frame_piece_check_stretched (image, stretched, vertical,
+                                                start, end);
+  if (stretches != should_stretch)
+    {
+      g_printerr ("%s %s border %s stretched\n",
+                  kind_names[kind], vertical ? "vertical" : "horizontal",
+                  stretches ? "wrongly found to be" : "not found to be");
+      exit (1);
+    }
+
+  /* The image itself is a fine template for the piece's surfaces */
+  meta_frame_piece_init (&piece, image, image, vertical, stretches,
+                         start, end);
+
+  /* Borders that don't stretch are only drawn at their own size */
+  check_drawn_at (&piece, kind, vertical, BORDER_LENGTH);
+
+  if (stretches)
+    {
+      int min_length = piece.start_length + piece.end_length;
+
+      g_assert (meta_frame_piece_fits (&piece, min_length));
+      g_assert (!meta_frame_piece_fits (&piece, min_length - 1));
+
+      check_drawn_at (&piece, kind, vertical, min_length);
+      for (i = 0; i < G_N_ELEMENTS (deltas); i++)
+        check_drawn_at (&piece, kind, vertical, BORDER_LENGTH + deltas[i]);
+    }
+
+  meta_frame_piece_clear (&piece);
+  cairo_surface_destroy (image);
+  cairo_surface_destroy (stretched);
+}
+
+int
+main (int argc, char **argv)
+{
+  int vertical;
+
+  for (vertical = FALSE; vertical <= TRUE; vertical++)
+    {
+      check_border (BORDER_BEVELED, vertical, TRUE);
+      check_border (BORDER_GRADIENT, vertical, FALSE);
+      check_border (BORDER_CENTERED, vertical, FALSE);
+    }
+
+  printf ("Frame borders drawn stretched match ones rendered at that size.\n");
+
+  return 0;
+}
@@ -441,16 +441,70 @@ typedef struct
   } d;
 } PosToken;
 
+/**
+ * The instructions of a compiled expression. Operands are pushed onto
+ * a small stack and operators replace the top two entries with their
+ * result. Types are known when the expression is compiled, so each
+ * operator comes in an integer and a floating-point flavour, and
+ * integers are explicitly converted where they meet doubles.
+ *
+ * \ingroup parser
+ */
+typedef enum
+{
+  /** Push d.i */
+  POS_CODE_INT,
+  /** Push d.d */
+  POS_CODE_DOUBLE,
+  /** Push the int at offset d.i in the MetaPositionExprEnv */
+  POS_CODE_VARIABLE,
+  /** Like POS_CODE_VARIABLE, but fails if the value is unset (negative) */
+  POS_CODE_OBJECT_VARIABLE,
+  /** Convert the top of the stack from int to double */
+  POS_CODE_TO_DOUBLE,
+  /** Convert the top of the stack from double to int */
+  POS_CODE_TO_INT,
+  POS_CODE_ADD_INT,
+  POS_CODE_SUBTRACT_INT,
+  POS_CODE_MULTIPLY_INT,
+  POS_CODE_DIVIDE_INT,
+  POS_CODE_MOD_INT,
+  POS_CODE_MAX_INT,
+  POS_CODE_MIN_INT,
+  POS_CODE_ADD_DOUBLE,
+  POS_CODE_SUBTRACT_DOUBLE,
+  POS_CODE_MULTIPLY_DOUBLE,
+  POS_CODE_DIVIDE_DOUBLE,
+  POS_CODE_MAX_DOUBLE,
+  POS_CODE_MIN_DOUBLE
+} PosCodeType;
+
+/**
+ * A single instruction of a compiled expression.
+ *
+ * \ingroup parser
+ */
+typedef struct
+{
+  PosCodeType type;
+
+  union
+  {
+    int i;
+    double d;
+  } d;
+} PosCode;
+
 /**
  * MetaDrawSpec: (skip)
  *
  * A computed expression in our simple vector drawing language.
- * While it appears to take the form of a tree, this is actually
- * merely a list; concerns such as precedence of operators are
- * currently recomputed on every recalculation.
+ * The tokens are kept as a flat list. Unless the expression is
+ * constant, they are also compiled into stack code when the spec is
+ * created, with precedence resolved, variables turned into offsets
+ * into the MetaPositionExprEnv and constant subexpressions folded.
  *
  * Created by meta_draw_spec_new(), destroyed by meta_draw_spec_free().
- * pos_eval() fills this with ...FIXME. Are tokens a tree or a list?
  * \ingroup parser
  */
 typedef struct _MetaDrawSpec MetaDrawSpec;
@@ -468,6 +522,16 @@ struct _MetaDrawSpec
   /** How many tokens are in the tokens list. */
   int n_tokens;
 
+  /**
+   * The compiled expression, or NULL if the expression is constant or
+   * could not be compiled; in the latter case it is evaluated from
+   * the tokens, which also reports the error.
+   */
+  PosCode *code;
+
+  /** How many instructions are in the compiled expression. */
+  int n_code;
+
   /** Does the expression contain any variables? */
   gboolean constant : 1;
 };
@@ -954,6 +1018,7 @@ MetaDrawSpec* meta_draw_spec_new (MetaTheme  *theme,
                                   const char *expr,
                                   GError    **error);
 void          meta_draw_spec_free (MetaDrawSpec *spec);
+void          meta_draw_spec_set_use_code (gboolean use_code);
 
 MetaColorSpec* meta_color_spec_new             (MetaColorSpecType  type);
 MetaColorSpec* meta_color_spec_new_from_string (const char        *str,
@@ -968,6 +1033,11 @@ void           meta_color_spec_render          (MetaColorSpec     *spec,
 
 MetaDrawOp*    meta_draw_op_new  (MetaDrawType        type);
 void           meta_draw_op_free (MetaDrawOp          *op);
+
+void meta_draw_op_cache_clear     (void);
+void meta_draw_op_cache_get_stats (guint *n_hits,
+                                   guint *n_misses,
+                                   gsize *size);
 void           meta_draw_op_draw (const MetaDrawOp    *op,
                                   GtkWidget           *widget,
                                   cairo_t             *cr,
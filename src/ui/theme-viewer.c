@@ -954,55 +954,25 @@ create_title_layout (GtkWidget *widget)
   return layout;
 }
 
-static void
-run_theme_benchmark (void)
+#define ITERATIONS 100
+
+static double
+time_frame_draws (GtkWidget        *widget,
+                  MetaFrameBorders *borders,
+                  PangoLayout      *layout,
+                  MetaButtonLayout *button_layout,
+                  MetaButtonState  *button_states,
+                  clock_t          *clock_elapsed)
 {
-  GtkWidget* widget;
   cairo_surface_t *pixmap;
-  MetaFrameBorders borders;
-  MetaButtonState button_states[META_BUTTON_TYPE_LAST] =
-  {
-    META_BUTTON_STATE_NORMAL,
-    META_BUTTON_STATE_NORMAL,
-    META_BUTTON_STATE_NORMAL,
-    META_BUTTON_STATE_NORMAL
-  };
-  PangoLayout *layout;
   clock_t start;
-  clock_t end;
   GTimer *timer;
+  double elapsed;
   int i;
-  MetaButtonLayout button_layout;
-#define ITERATIONS 100
   int client_width;
   int client_height;
   cairo_t *cr;
   int inc;
-  
-  widget = gtk_window_new (GTK_WINDOW_TOPLEVEL);
-  gtk_widget_realize (widget);
-  
-  meta_theme_get_frame_borders (global_theme,
-                                META_FRAME_TYPE_NORMAL,
-                                get_text_height (widget),
-                                get_flags (widget),
-                                &borders);
-  
-  layout = create_title_layout (widget);
-  
-  i = 0;
-  while (i < MAX_BUTTONS_PER_CORNER)
-    {
-      button_layout.left_buttons[i] = META_BUTTON_FUNCTION_LAST;
-      button_layout.right_buttons[i] = META_BUTTON_FUNCTION_LAST;
-      ++i;
-    }
-  
-  button_layout.left_buttons[0] = META_BUTTON_FUNCTION_MENU;
-
-  button_layout.right_buttons[0] = META_BUTTON_FUNCTION_MINIMIZE;
-  button_layout.right_buttons[1] = META_BUTTON_FUNCTION_MAXIMIZE;
-  button_layout.right_buttons[2] = META_BUTTON_FUNCTION_CLOSE;
 
   timer = g_timer_new ();
   start = clock ();
@@ -1021,8 +991,8 @@ run_theme_benchmark (void)
        */
       pixmap = gdk_window_create_similar_surface (gtk_widget_get_window (widget),
                                                   CAIRO_CONTENT_COLOR,
-                                                  client_width + borders.visible.left + borders.visible.right,
-                                                  client_height + borders.visible.top + borders.visible.bottom);
+                                                  client_width + borders->visible.left + borders->visible.right,
+                                                  client_height + borders->visible.top + borders->visible.bottom);
 
       cr = cairo_create (pixmap);
 
@@ -1034,7 +1004,7 @@ run_theme_benchmark (void)
                              client_width, client_height,
                              layout,
                              get_text_height (widget),
-                             &button_layout,
+                             button_layout,
                              button_states,
                              meta_preview_get_mini_icon (),
                              meta_preview_get_icon ());
@@ -1047,24 +1017,94 @@ run_theme_benchmark (void)
       client_height += inc;
     }
 
-  end = clock ();
+  *clock_elapsed = clock () - start;
   g_timer_stop (timer);
 
-  milliseconds_to_draw_frame = (g_timer_elapsed (timer, NULL) / (double) ITERATIONS) * 1000;
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  return elapsed;
+}
+
+static void
+run_theme_benchmark (void)
+{
+  GtkWidget* widget;
+  MetaFrameBorders borders;
+  MetaButtonState button_states[META_BUTTON_TYPE_LAST] =
+  {
+    META_BUTTON_STATE_NORMAL,
+    META_BUTTON_STATE_NORMAL,
+    META_BUTTON_STATE_NORMAL,
+    META_BUTTON_STATE_NORMAL
+  };
+  PangoLayout *layout;
+  clock_t clock_elapsed;
+  double elapsed;
+  double token_elapsed;
+  guint n_hits, n_misses;
+  gsize cache_size;
+  int i;
+  MetaButtonLayout button_layout;
+  
+  widget = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_widget_realize (widget);
+  
+  meta_theme_get_frame_borders (global_theme,
+                                META_FRAME_TYPE_NORMAL,
+                                get_text_height (widget),
+                                get_flags (widget),
+                                &borders);
+  
+  layout = create_title_layout (widget);
+  
+  i = 0;
+  while (i < MAX_BUTTONS_PER_CORNER)
+    {
+      button_layout.left_buttons[i] = META_BUTTON_FUNCTION_LAST;
+      button_layout.right_buttons[i] = META_BUTTON_FUNCTION_LAST;
+      ++i;
+    }
+  
+  button_layout.left_buttons[0] = META_BUTTON_FUNCTION_MENU;
+
+  button_layout.right_buttons[0] = META_BUTTON_FUNCTION_MINIMIZE;
+  button_layout.right_buttons[1] = META_BUTTON_FUNCTION_MAXIMIZE;
+  button_layout.right_buttons[2] = META_BUTTON_FUNCTION_CLOSE;
+
+  elapsed = time_frame_draws (widget, &borders, layout,
+                              &button_layout, button_states,
+                              &clock_elapsed);
+
+  milliseconds_to_draw_frame = (elapsed / (double) ITERATIONS) * 1000;
   
   g_print (_("Drew %d frames in %g client-side seconds (%g milliseconds per frame) and %g seconds wall clock time including X server resources (%g milliseconds per frame)\n"),
            ITERATIONS,
-           ((double)end - (double)start) / CLOCKS_PER_SEC,
-           (((double)end - (double)start) / CLOCKS_PER_SEC / (double) ITERATIONS) * 1000,
-           g_timer_elapsed (timer, NULL),
+           (double) clock_elapsed / CLOCKS_PER_SEC,
+           ((double) clock_elapsed / CLOCKS_PER_SEC / (double) ITERATIONS) * 1000,
+           elapsed,
            milliseconds_to_draw_frame);
 
-  g_timer_destroy (timer);
+  /* Again without the compiled position expressions, for comparison */
+  meta_draw_spec_set_use_code (FALSE);
+  token_elapsed = time_frame_draws (widget, &borders, layout,
+                                    &button_layout, button_states,
+                                    &clock_elapsed);
+  meta_draw_spec_set_use_code (TRUE);
+
+  g_print (_("%g frames per second with compiled expressions, %g frames per second evaluating expressions from tokens\n"),
+           ITERATIONS / elapsed,
+           ITERATIONS / token_elapsed);
+
+  meta_draw_op_cache_get_stats (&n_hits, &n_misses, &cache_size);
+  g_print (_("Rendered draw ops reused %u times and rendered %u times, keeping %lu bytes\n"),
+           n_hits, n_misses, (gulong) cache_size);
+
   g_object_unref (G_OBJECT (layout));
   gtk_widget_destroy (widget);
+}
 
 #undef ITERATIONS
-}
 
 typedef struct
 {
@@ -54,6 +54,7 @@
 
 #include <config.h>
 #include "theme-private.h"
+#include "lru-cache.h"
 #include <meta/util.h>
 #include <meta/gradient.h>
 #include <meta/prefs.h>
@@ -2471,9 +2472,9 @@ pos_eval_get_variable (PosToken                  *t,
  * \param env  The environment context in which to evaluate the expression.
  * \param[out] result  The current value of the expression
  * 
- * \bug Yes, we really do reparse the expression every time it's evaluated.
- *      We should keep the parse tree around all the time and just
- *      run the new values through it.
+ * Expressions are normally compiled by pos_compile() and run by
+ * pos_code_eval(); this is used for the ones that couldn't be, and to
+ * report errors.
  * \ingroup parser
  */
 static gboolean
@@ -2631,6 +2632,521 @@ pos_eval_helper (PosToken                   *tokens,
   return TRUE;
 }
 
+/**
+ * The variables an expression can refer to, and where their values live
+ * in a MetaPositionExprEnv. This must agree with pos_eval_get_variable().
+ * \ingroup parser
+ */
+static const struct
+{
+  const char *name;
+  int offset;
+  gboolean object_size;
+} pos_variables[] = {
+  { "width", G_STRUCT_OFFSET (MetaPositionExprEnv, rect.width), FALSE },
+  { "height", G_STRUCT_OFFSET (MetaPositionExprEnv, rect.height), FALSE },
+  { "object_width", G_STRUCT_OFFSET (MetaPositionExprEnv, object_width), TRUE },
+  { "object_height", G_STRUCT_OFFSET (MetaPositionExprEnv, object_height), TRUE },
+  { "left_width", G_STRUCT_OFFSET (MetaPositionExprEnv, left_width), FALSE },
+  { "right_width", G_STRUCT_OFFSET (MetaPositionExprEnv, right_width), FALSE },
+  { "top_height", G_STRUCT_OFFSET (MetaPositionExprEnv, top_height), FALSE },
+  { "bottom_height", G_STRUCT_OFFSET (MetaPositionExprEnv, bottom_height), FALSE },
+  { "mini_icon_width", G_STRUCT_OFFSET (MetaPositionExprEnv, mini_icon_width), FALSE },
+  { "mini_icon_height", G_STRUCT_OFFSET (MetaPositionExprEnv, mini_icon_height), FALSE },
+  { "icon_width", G_STRUCT_OFFSET (MetaPositionExprEnv, icon_width), FALSE },
+  { "icon_height", G_STRUCT_OFFSET (MetaPositionExprEnv, icon_height), FALSE },
+  { "title_width", G_STRUCT_OFFSET (MetaPositionExprEnv, title_width), FALSE },
+  { "title_height", G_STRUCT_OFFSET (MetaPositionExprEnv, title_height), FALSE },
+  { "frame_x_center", G_STRUCT_OFFSET (MetaPositionExprEnv, frame_x_center), FALSE },
+  { "frame_y_center", G_STRUCT_OFFSET (MetaPositionExprEnv, frame_y_center), FALSE }
+};
+
+/**
+ * Deepest stack a compiled expression may need; matches the number of
+ * terms pos_eval_helper() is prepared to handle.
+ * \ingroup parser
+ */
+#define POS_CODE_MAX_STACK 32
+
+typedef enum
+{
+  POS_NODE_CONSTANT,
+  POS_NODE_VARIABLE,
+  POS_NODE_OPERATOR
+} PosNodeType;
+
+/**
+ * A node of the expression tree built while compiling. Nodes refer
+ * to their operands by index into the compiler's node array.
+ * \ingroup parser
+ */
+typedef struct
+{
+  PosNodeType type;
+  PosExpr constant;
+  int offset;
+  gboolean object_size;
+  PosOperatorType op;
+  int left;
+  int right;
+  gboolean is_double;
+} PosNode;
+
+typedef struct
+{
+  PosToken *tokens;
+  int n_tokens;
+  int pos;
+
+  PosNode *nodes;
+  int n_nodes;
+
+  PosCode *code;
+  int n_code;
+  int depth;
+  int max_depth;
+} PosCompiler;
+
+static int pos_compile_level (PosCompiler *compiler,
+                              int          precedence);
+
+/* Parses an operand: a number, a variable or a parenthesized
+ * expression. Returns the node index, or -1 if the tokens don't form
+ * an expression we can compile.
+ */
+static int
+pos_compile_operand (PosCompiler *compiler)
+{
+  PosToken *t;
+  PosNode *node;
+  int i;
+
+  if (compiler->pos == compiler->n_tokens)
+    return -1;
+
+  t = &compiler->tokens[compiler->pos++];
+
+  switch (t->type)
+    {
+    case POS_TOKEN_INT:
+      node = &compiler->nodes[compiler->n_nodes];
+      node->type = POS_NODE_CONSTANT;
+      node->constant.type = POS_EXPR_INT;
+      node->constant.d.int_val = t->d.i.val;
+      return compiler->n_nodes++;
+
+    case POS_TOKEN_DOUBLE:
+      node = &compiler->nodes[compiler->n_nodes];
+      node->type = POS_NODE_CONSTANT;
+      node->constant.type = POS_EXPR_DOUBLE;
+      node->constant.d.double_val = t->d.d.val;
+      return compiler->n_nodes++;
+
+    case POS_TOKEN_VARIABLE:
+      for (i = 0; i < (int) G_N_ELEMENTS (pos_variables); i++)
+        if (strcmp (t->d.v.name, pos_variables[i].name) == 0)
+          break;
+
+      if (i == (int) G_N_ELEMENTS (pos_variables))
+        return -1;
+
+      node = &compiler->nodes[compiler->n_nodes];
+      node->type = POS_NODE_VARIABLE;
+      node->offset = pos_variables[i].offset;
+      node->object_size = pos_variables[i].object_size;
+      return compiler->n_nodes++;
+
+    case POS_TOKEN_OPEN_PAREN:
+      i = pos_compile_level (compiler, 0);
+      if (i < 0 ||
+          compiler->pos == compiler->n_tokens ||
+          compiler->tokens[compiler->pos].type != POS_TOKEN_CLOSE_PAREN)
+        return -1;
+      compiler->pos++;
+      return i;
+
+    case POS_TOKEN_CLOSE_PAREN:
+    case POS_TOKEN_OPERATOR:
+      break;
+    }
+
+  return -1;
+}
+
+static int
+op_precedence (PosOperatorType op)
+{
+  switch (op)
+    {
+    case POS_OP_MULTIPLY:
+    case POS_OP_DIVIDE:
+    case POS_OP_MOD:
+      return 2;
+    case POS_OP_ADD:
+    case POS_OP_SUBTRACT:
+      return 1;
+    case POS_OP_MAX:
+    case POS_OP_MIN:
+      return 0;
+    case POS_OP_NONE:
+      break;
+    }
+
+  return -1;
+}
+
+/* Parses a left-associative chain of operators of the given precedence,
+ * the same grouping do_operations() arrives at. Operations on two
+ * constants are folded as they are found.
+ */
+static int
+pos_compile_level (PosCompiler *compiler,
+                   int          precedence)
+{
+  int left;
+
+  if (precedence > 2)
+    return pos_compile_operand (compiler);
+
+  left = pos_compile_level (compiler, precedence + 1);
+
+  while (left >= 0 &&
+         compiler->pos < compiler->n_tokens &&
+         compiler->tokens[compiler->pos].type == POS_TOKEN_OPERATOR &&
+         op_precedence (compiler->tokens[compiler->pos].d.o.op) == precedence)
+    {
+      PosOperatorType op = compiler->tokens[compiler->pos].d.o.op;
+      PosNode *a, *b, *node;
+      int right;
+
+      compiler->pos++;
+
+      right = pos_compile_level (compiler, precedence + 1);
+      if (right < 0)
+        return -1;
+
+      a = &compiler->nodes[left];
+      b = &compiler->nodes[right];
+
+      if (a->type == POS_NODE_CONSTANT && b->type == POS_NODE_CONSTANT)
+        {
+          /* Leave division by zero and the like to the evaluator,
+           * which will complain about it.
+           */
+          if (!do_operation (&a->constant, &b->constant, op, NULL))
+            return -1;
+          continue;
+        }
+
+      node = &compiler->nodes[compiler->n_nodes];
+      node->type = POS_NODE_OPERATOR;
+      node->op = op;
+      node->left = left;
+      node->right = right;
+      node->is_double =
+        (a->type == POS_NODE_CONSTANT && a->constant.type == POS_EXPR_DOUBLE) ||
+        (a->type == POS_NODE_OPERATOR && a->is_double) ||
+        (b->type == POS_NODE_CONSTANT && b->constant.type == POS_EXPR_DOUBLE) ||
+        (b->type == POS_NODE_OPERATOR && b->is_double);
+
+      if (op == POS_OP_MOD && node->is_double)
+        return -1;
+
+      left = compiler->n_nodes++;
+    }
+
+  return left;
+}
+
+static void
+pos_compile_push (PosCompiler *compiler,
+                  PosCodeType  type)
+{
+  compiler->code[compiler->n_code++].type = type;
+  compiler->depth++;
+  compiler->max_depth = MAX (compiler->max_depth, compiler->depth);
+}
+
+/* Emits the code for a node, leaving its value on the stack as a
+ * double if want_double is set, or in its natural type otherwise.
+ */
+static void
+pos_compile_emit (PosCompiler *compiler,
+                  int          index,
+                  gboolean     want_double)
+{
+  PosNode *node = &compiler->nodes[index];
+  PosCode *code;
+
+  switch (node->type)
+    {
+    case POS_NODE_CONSTANT:
+      code = &compiler->code[compiler->n_code];
+      if (node->constant.type == POS_EXPR_DOUBLE)
+        {
+          pos_compile_push (compiler, POS_CODE_DOUBLE);
+          code->d.d = node->constant.d.double_val;
+        }
+      else if (want_double)
+        {
+          pos_compile_push (compiler, POS_CODE_DOUBLE);
+          code->d.d = node->constant.d.int_val;
+        }
+      else
+        {
+          pos_compile_push (compiler, POS_CODE_INT);
+          code->d.i = node->constant.d.int_val;
+        }
+      return;
+
+    case POS_NODE_VARIABLE:
+      code = &compiler->code[compiler->n_code];
+      pos_compile_push (compiler, node->object_size ?
+                        POS_CODE_OBJECT_VARIABLE : POS_CODE_VARIABLE);
+      code->d.i = node->offset;
+      break;
+
+    case POS_NODE_OPERATOR:
+      pos_compile_emit (compiler, node->left, node->is_double);
+      pos_compile_emit (compiler, node->right, node->is_double);
+
+      code = &compiler->code[compiler->n_code++];
+      compiler->depth--;
+
+      switch (node->op)
+        {
+        case POS_OP_ADD:
+          code->type = node->is_double ? POS_CODE_ADD_DOUBLE : POS_CODE_ADD_INT;
+          break;
+        case POS_OP_SUBTRACT:
+          code->type = node->is_double ? POS_CODE_SUBTRACT_DOUBLE : POS_CODE_SUBTRACT_INT;
+          break;
+        case POS_OP_MULTIPLY:
+          code->type = node->is_double ? POS_CODE_MULTIPLY_DOUBLE : POS_CODE_MULTIPLY_INT;
+          break;
+        case POS_OP_DIVIDE:
+          code->type = node->is_double ? POS_CODE_DIVIDE_DOUBLE : POS_CODE_DIVIDE_INT;
+          break;
+        case POS_OP_MOD:
+          g_assert (!node->is_double);
+          code->type = POS_CODE_MOD_INT;
+          break;
+        case POS_OP_MAX:
+          code->type = node->is_double ? POS_CODE_MAX_DOUBLE : POS_CODE_MAX_INT;
+          break;
+        case POS_OP_MIN:
+          code->type = node->is_double ? POS_CODE_MIN_DOUBLE : POS_CODE_MIN_INT;
+          break;
+        case POS_OP_NONE:
+          g_assert_not_reached ();
+          break;
+        }
+
+      if (node->is_double)
+        return;
+      break;
+    }
+
+  /* An int value where a double is wanted */
+  if (want_double)
+    compiler->code[compiler->n_code++].type = POS_CODE_TO_DOUBLE;
+}
+
+/**
+ * Compiles the tokens of a spec into stack code. Expressions that
+ * would fail to evaluate whatever the environment (syntax errors,
+ * unknown variables, dividing constants by zero and so on) are left
+ * uncompiled, so that pos_eval_helper() gets to report the problem.
+ *
+ * \param spec  The spec to compile; its constants must already have
+ *              been replaced.
+ * \ingroup parser
+ */
+static void
+pos_compile (MetaDrawSpec *spec)
+{
+  PosCompiler compiler;
+  int root;
+
+  compiler.tokens = spec->tokens;
+  compiler.n_tokens = spec->n_tokens;
+  compiler.pos = 0;
+  compiler.nodes = g_new (PosNode, spec->n_tokens);
+  compiler.n_nodes = 0;
+  compiler.code = NULL;
+  compiler.n_code = 0;
+  compiler.depth = 0;
+  compiler.max_depth = 0;
+
+  root = pos_compile_level (&compiler, 0);
+
+  if (root >= 0 && compiler.pos == compiler.n_tokens)
+    {
+      /* Each node needs at most one instruction, and one more to
+       * convert its value; a double result is truncated at the end.
+       */
+      compiler.code = g_new (PosCode, 2 * compiler.n_nodes + 1);
+
+      pos_compile_emit (&compiler, root, FALSE);
+
+      if (compiler.nodes[root].type == POS_NODE_OPERATOR &&
+          compiler.nodes[root].is_double)
+        compiler.code[compiler.n_code++].type = POS_CODE_TO_INT;
+      else if (compiler.nodes[root].type == POS_NODE_CONSTANT &&
+               compiler.nodes[root].constant.type == POS_EXPR_DOUBLE)
+        compiler.code[compiler.n_code++].type = POS_CODE_TO_INT;
+
+      if (compiler.max_depth <= POS_CODE_MAX_STACK)
+        {
+          spec->code = g_renew (PosCode, compiler.code, compiler.n_code);
+          spec->n_code = compiler.n_code;
+        }
+      else
+        g_free (compiler.code);
+    }
+
+  g_free (compiler.nodes);
+}
+
+/**
+ * Runs a compiled expression.
+ *
+ * \param code  The instructions
+ * \param n_code  How many instructions there are
+ * \param env  The environment context in which to evaluate the expression.
+ * \param[out] val_p  The integer value of the expression
+ *
+ * \return  FALSE if the expression can't be evaluated in this environment
+ *          (division by zero, or an object size that isn't available);
+ *          the caller should fall back to pos_eval_helper() to find out
+ *          what went wrong.
+ * \ingroup parser
+ */
+static gboolean
+pos_code_eval (const PosCode             *code,
+               int                        n_code,
+               const MetaPositionExprEnv *env,
+               int                       *val_p)
+{
+  union
+  {
+    int i;
+    double d;
+  } stack[POS_CODE_MAX_STACK];
+  int sp;
+  int i;
+
+  sp = 0;
+  for (i = 0; i < n_code; i++)
+    {
+      switch (code[i].type)
+        {
+        case POS_CODE_INT:
+          stack[sp++].i = code[i].d.i;
+          break;
+        case POS_CODE_DOUBLE:
+          stack[sp++].d = code[i].d.d;
+          break;
+        case POS_CODE_VARIABLE:
+          stack[sp++].i = G_STRUCT_MEMBER (int, env, code[i].d.i);
+          break;
+        case POS_CODE_OBJECT_VARIABLE:
+          stack[sp].i = G_STRUCT_MEMBER (int, env, code[i].d.i);
+          if (stack[sp].i < 0)
+            return FALSE;
+          sp++;
+          break;
+        case POS_CODE_TO_DOUBLE:
+          stack[sp - 1].d = stack[sp - 1].i;
+          break;
+        case POS_CODE_TO_INT:
+          stack[sp - 1].i = stack[sp - 1].d;
+          break;
+
+        case POS_CODE_ADD_INT:
+          sp--;
+          stack[sp - 1].i = stack[sp - 1].i + stack[sp].i;
+          break;
+        case POS_CODE_SUBTRACT_INT:
+          sp--;
+          stack[sp - 1].i = stack[sp - 1].i - stack[sp].i;
+          break;
+        case POS_CODE_MULTIPLY_INT:
+          sp--;
+          stack[sp - 1].i = stack[sp - 1].i * stack[sp].i;
+          break;
+        case POS_CODE_DIVIDE_INT:
+          sp--;
+          if (stack[sp].i == 0)
+            return FALSE;
+          stack[sp - 1].i = stack[sp - 1].i / stack[sp].i;
+          break;
+        case POS_CODE_MOD_INT:
+          sp--;
+          if (stack[sp].i == 0)
+            return FALSE;
+          stack[sp - 1].i = stack[sp - 1].i % stack[sp].i;
+          break;
+        case POS_CODE_MAX_INT:
+          sp--;
+          stack[sp - 1].i = MAX (stack[sp - 1].i, stack[sp].i);
+          break;
+        case POS_CODE_MIN_INT:
+          sp--;
+          stack[sp - 1].i = MIN (stack[sp - 1].i, stack[sp].i);
+          break;
+
+        case POS_CODE_ADD_DOUBLE:
+          sp--;
+          stack[sp - 1].d = stack[sp - 1].d + stack[sp].d;
+          break;
+        case POS_CODE_SUBTRACT_DOUBLE:
+          sp--;
+          stack[sp - 1].d = stack[sp - 1].d - stack[sp].d;
+          break;
+        case POS_CODE_MULTIPLY_DOUBLE:
+          sp--;
+          stack[sp - 1].d = stack[sp - 1].d * stack[sp].d;
+          break;
+        case POS_CODE_DIVIDE_DOUBLE:
+          sp--;
+          if (stack[sp].d == 0.0)
+            return FALSE;
+          stack[sp - 1].d = stack[sp - 1].d / stack[sp].d;
+          break;
+        case POS_CODE_MAX_DOUBLE:
+          sp--;
+          stack[sp - 1].d = MAX (stack[sp - 1].d, stack[sp].d);
+          break;
+        case POS_CODE_MIN_DOUBLE:
+          sp--;
+          stack[sp - 1].d = MIN (stack[sp - 1].d, stack[sp].d);
+          break;
+        }
+    }
+
+  g_assert (sp == 1);
+
+  *val_p = stack[0].i;
+
+  return TRUE;
+}
+
+/* Whether pos_eval() may use compiled code; the theme viewer turns
+ * this off to compare against the token evaluator.
+ */
+static gboolean use_pos_code = TRUE;
+
+/**
+ * meta_draw_spec_set_use_code: (skip)
+ *
+ */
+void
+meta_draw_spec_set_use_code (gboolean use_code)
+{
+  use_pos_code = use_code;
+}
+
 /*
  *   expr = int | double | expr * expr | expr / expr |
  *          expr + expr | expr - expr | (expr)
@@ -2661,6 +3177,10 @@ pos_eval (MetaDrawSpec              *spec,
 {
   PosExpr expr;
 
+  if (spec->code != NULL && use_pos_code &&
+      pos_code_eval (spec->code, spec->n_code, env, val_p))
+    return TRUE;
+
   *val_p = 0;
 
   if (pos_eval_helper (spec->tokens, spec->n_tokens, env, &expr, err))
@@ -2877,6 +3397,7 @@ meta_draw_spec_free (MetaDrawSpec *spec)
 {
   if (!spec) return;
   free_tokens (spec->tokens, spec->n_tokens);
+  g_free (spec->code);
   g_slice_free (MetaDrawSpec, spec);
 }
 
@@ -2908,6 +3429,8 @@ meta_draw_spec_new (MetaTheme  *theme,
           return NULL;
         }
     }
+  else
+    pos_compile (spec);
     
   return spec;
 }
@@ -2994,6 +3517,11 @@ meta_draw_op_free (MetaDrawOp *op)
 {
   g_return_if_fail (op != NULL);
 
+  /* Pixbufs rendered for it could be found for a new op at the
+   * same address
+   */
+  meta_draw_op_cache_clear ();
+
   switch (op->type)
     {
     case META_DRAW_LINE:
@@ -3402,11 +3930,11 @@ scale_and_alpha_pixbuf (GdkPixbuf             *src,
 }
 
 static GdkPixbuf*
-draw_op_as_pixbuf (const MetaDrawOp    *op,
-                   GtkStyleContext     *context,
-                   const MetaDrawInfo  *info,
-                   int                  width,
-                   int                  height)
+render_op_as_pixbuf (const MetaDrawOp    *op,
+                     GtkStyleContext     *context,
+                     const MetaDrawInfo  *info,
+                     int                  width,
+                     int                  height)
 {
   /* Try to get the op as a pixbuf, assuming w/h in the op
    * matches the width/height passed in. return NULL
@@ -3583,6 +4111,215 @@ draw_op_as_pixbuf (const MetaDrawOp    *op,
   return pixbuf;
 }
 
+/* Ops rendered as pixbufs are kept as premultiplied image surfaces,
+ * most recently used first, up to a total size set with
+ * MUTTER_DRAW_OP_CACHE_SIZE, in kilobytes, so that redrawing a frame of
+ * the same size doesn't render its gradients and scale its images again,
+ * nor convert them for cairo.
+ */
+#define DEFAULT_DRAW_OP_CACHE_SIZE (4 * 1024 * 1024)
+
+/* Gradients with more colors than this aren't cached */
+#define DRAW_OP_CACHE_MAX_COLORS 8
+
+typedef struct
+{
+  const MetaDrawOp *op;
+  int width;
+  int height;
+  /* The colors the op's color specs resolved to */
+  int n_colors;
+  guint32 colors[DRAW_OP_CACHE_MAX_COLORS];
+} DrawOpCacheKey;
+
+static MetaLruCache *draw_op_cache = NULL;
+static gsize draw_op_cache_max_size = 0;
+static guint draw_op_cache_hits = 0;
+static guint draw_op_cache_misses = 0;
+
+static gboolean
+add_key_color (DrawOpCacheKey  *key,
+               MetaColorSpec   *spec,
+               GtkStyleContext *context)
+{
+  GdkRGBA color;
+
+  if (key->n_colors == DRAW_OP_CACHE_MAX_COLORS)
+    return FALSE;
+
+  meta_color_spec_render (spec, context, &color);
+
+  key->colors[key->n_colors++] = (ALPHA_TO_UCHAR (color.red) << 24 |
+                                  ALPHA_TO_UCHAR (color.green) << 16 |
+                                  ALPHA_TO_UCHAR (color.blue) << 8 |
+                                  ALPHA_TO_UCHAR (color.alpha));
+  return TRUE;
+}
+
+/* Sets up the key an op rendered at the given size is cached with, or
+ * returns FALSE if it isn't cached
+ */
+static gboolean
+draw_op_cache_key_init (DrawOpCacheKey   *key,
+                        const MetaDrawOp *op,
+                        GtkStyleContext  *context,
+                        int               width,
+                        int               height)
+{
+  GSList *tmp;
+
+  if (draw_op_cache_max_size == 0)
+    return FALSE;
+
+  /* Keys are compared as bytes */
+  memset (key, 0, sizeof (DrawOpCacheKey));
+
+  key->op = op;
+  key->width = width;
+  key->height = height;
+
+  switch (op->type)
+    {
+    case META_DRAW_TINT:
+      return add_key_color (key, op->data.tint.color_spec, context);
+
+    case META_DRAW_GRADIENT:
+      for (tmp = op->data.gradient.gradient_spec->color_specs;
+           tmp != NULL;
+           tmp = tmp->next)
+        {
+          if (!add_key_color (key, tmp->data, context))
+            return FALSE;
+        }
+      return TRUE;
+
+    case META_DRAW_IMAGE:
+      return op->data.image.colorize_spec == NULL ||
+        add_key_color (key, op->data.image.colorize_spec, context);
+
+    default:
+      /* The others either aren't drawn from pixbufs, or, like the
+       * window icon, depend on more than the op
+       */
+      return FALSE;
+    }
+}
+
+static cairo_surface_t*
+surface_from_pixbuf (GdkPixbuf *pixbuf)
+{
+  cairo_surface_t *surface;
+  cairo_t *cr;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        gdk_pixbuf_get_width (pixbuf),
+                                        gdk_pixbuf_get_height (pixbuf));
+
+  cr = cairo_create (surface);
+  gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  return surface;
+}
+
+static cairo_surface_t*
+draw_op_as_surface (const MetaDrawOp    *op,
+                    GtkStyleContext     *context,
+                    const MetaDrawInfo  *info,
+                    int                  width,
+                    int                  height)
+{
+  DrawOpCacheKey key;
+  GdkPixbuf *pixbuf;
+  cairo_surface_t *surface;
+  gboolean cached;
+  gsize size;
+
+  if (draw_op_cache == NULL)
+    {
+      const char *size = g_getenv ("MUTTER_DRAW_OP_CACHE_SIZE");
+
+      if (size)
+        draw_op_cache_max_size = (gsize) g_ascii_strtoull (size, NULL, 10) * 1024;
+      else
+        draw_op_cache_max_size = DEFAULT_DRAW_OP_CACHE_SIZE;
+
+      draw_op_cache = meta_lru_cache_new (sizeof (DrawOpCacheKey),
+                                          draw_op_cache_max_size,
+                                          (GDestroyNotify) cairo_surface_destroy);
+    }
+
+  cached = draw_op_cache_key_init (&key, op, context, width, height);
+  if (cached)
+    {
+      surface = meta_lru_cache_lookup (draw_op_cache, &key);
+      if (surface)
+        {
+          draw_op_cache_hits++;
+
+          return cairo_surface_reference (surface);
+        }
+
+      draw_op_cache_misses++;
+    }
+
+  pixbuf = render_op_as_pixbuf (op, context, info, width, height);
+  if (pixbuf == NULL)
+    return NULL;
+
+  surface = surface_from_pixbuf (pixbuf);
+  g_object_unref (G_OBJECT (pixbuf));
+
+  size = (cairo_image_surface_get_stride (surface) *
+          cairo_image_surface_get_height (surface));
+  if (cached && size <= draw_op_cache_max_size)
+    meta_lru_cache_insert (draw_op_cache, &key,
+                           cairo_surface_reference (surface), size);
+
+  return surface;
+}
+
+/**
+ * meta_draw_op_cache_clear: (skip)
+ *
+ * Drops all the draw ops kept rendered as surfaces.  This happens
+ * whenever a draw op is freed, as when the theme changes; the frames
+ * also call this when their style changes, since surfaces rendered with
+ * the old colors won't be used again.
+ */
+void
+meta_draw_op_cache_clear (void)
+{
+  if (draw_op_cache)
+    meta_lru_cache_clear (draw_op_cache);
+}
+
+/**
+ * meta_draw_op_cache_get_stats: (skip)
+ * @n_hits: (out) (allow-none): location to store the number of draws
+ *   that found the op rendered already
+ * @n_misses: (out) (allow-none): location to store the number of draws
+ *   that had to render the op
+ * @size: (out) (allow-none): location to store the bytes of pixels
+ *   kept
+ *
+ * Gets statistics about how well rendered draw ops are reused.
+ */
+void
+meta_draw_op_cache_get_stats (guint *n_hits,
+                              guint *n_misses,
+                              gsize *size)
+{
+  if (n_hits)
+    *n_hits = draw_op_cache_hits;
+  if (n_misses)
+    *n_misses = draw_op_cache_misses;
+  if (size)
+    *size = draw_op_cache ? meta_lru_cache_get_size (draw_op_cache) : 0;
+}
+
 static void
 fill_env (MetaPositionExprEnv *env,
           const MetaDrawInfo  *info,
@@ -3826,17 +4563,17 @@ meta_draw_op_draw_with_env (const MetaDrawOp    *op,
           }
         else
           {
-            GdkPixbuf *pixbuf;
+            cairo_surface_t *surface;
 
-            pixbuf = draw_op_as_pixbuf (op, style_gtk, info,
-                                        rwidth, rheight);
+            surface = draw_op_as_surface (op, style_gtk, info,
+                                          rwidth, rheight);
 
-            if (pixbuf)
+            if (surface)
               {
-                gdk_cairo_set_source_pixbuf (cr, pixbuf, rx, ry);
+                cairo_set_source_surface (cr, surface, rx, ry);
                 cairo_paint (cr);
 
-                g_object_unref (G_OBJECT (pixbuf));
+                cairo_surface_destroy (surface);
               }
           }
       }
@@ -3845,22 +4582,22 @@ meta_draw_op_draw_with_env (const MetaDrawOp    *op,
     case META_DRAW_GRADIENT:
       {
         int rx, ry, rwidth, rheight;
-        GdkPixbuf *pixbuf;
+        cairo_surface_t *surface;
 
         rx = parse_x_position_unchecked (op->data.gradient.x, env);
         ry = parse_y_position_unchecked (op->data.gradient.y, env);
         rwidth = parse_size_unchecked (op->data.gradient.width, env);
         rheight = parse_size_unchecked (op->data.gradient.height, env);
 
-        pixbuf = draw_op_as_pixbuf (op, style_gtk, info,
-                                    rwidth, rheight);
+        surface = draw_op_as_surface (op, style_gtk, info,
+                                      rwidth, rheight);
 
-        if (pixbuf)
+        if (surface)
           {
-            gdk_cairo_set_source_pixbuf (cr, pixbuf, rx, ry);
+            cairo_set_source_surface (cr, surface, rx, ry);
             cairo_paint (cr);
 
-            g_object_unref (G_OBJECT (pixbuf));
+            cairo_surface_destroy (surface);
           }
       }
       break;
@@ -3868,7 +4605,7 @@ meta_draw_op_draw_with_env (const MetaDrawOp    *op,
     case META_DRAW_IMAGE:
       {
         int rx, ry, rwidth, rheight;
-        GdkPixbuf *pixbuf;
+        cairo_surface_t *surface;
 
         if (op->data.image.pixbuf)
           {
@@ -3879,18 +4616,18 @@ meta_draw_op_draw_with_env (const MetaDrawOp    *op,
         rwidth = parse_size_unchecked (op->data.image.width, env);
         rheight = parse_size_unchecked (op->data.image.height, env);
         
-        pixbuf = draw_op_as_pixbuf (op, style_gtk, info,
-                                    rwidth, rheight);
+        surface = draw_op_as_surface (op, style_gtk, info,
+                                      rwidth, rheight);
 
-        if (pixbuf)
+        if (surface)
           {
             rx = parse_x_position_unchecked (op->data.image.x, env);
             ry = parse_y_position_unchecked (op->data.image.y, env);
 
-            gdk_cairo_set_source_pixbuf (cr, pixbuf, rx, ry);
+            cairo_set_source_surface (cr, surface, rx, ry);
             cairo_paint (cr);
 
-            g_object_unref (G_OBJECT (pixbuf));
+            cairo_surface_destroy (surface);
           }
       }
       break;
@@ -3966,8 +4703,8 @@ meta_draw_op_draw_with_env (const MetaDrawOp    *op,
         rwidth = parse_size_unchecked (op->data.icon.width, env);
         rheight = parse_size_unchecked (op->data.icon.height, env);
         
-        pixbuf = draw_op_as_pixbuf (op, style_gtk, info,
-                                    rwidth, rheight);
+        pixbuf = render_op_as_pixbuf (op, style_gtk, info,
+                                      rwidth, rheight);
 
         if (pixbuf)
           {
@@ -760,6 +760,7 @@ meta_ui_set_current_theme (const char *name,
                            gboolean    force_reload)
 {
   meta_theme_set_current (name, force_reload);
+  meta_frames_theme_changed ();
   meta_invalidate_default_icons ();
 }
 